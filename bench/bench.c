@@ -0,0 +1,384 @@
+// smm_bench, microbenchmarks for the game's hot functions
+// The game is one translation unit, including it whole keeps every helper reachable without exporting anything
+#define SMM_BENCH
+#include "main.c"
+
+#if defined(_WIN32)
+#include <io.h>
+#define dup _dup
+#define dup2 _dup2
+#define close _close
+#define fileno _fileno
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+// Platform and compiler go into the JSON so x86 and armv7l runs can be told apart
+#if defined(__x86_64__) || defined(_M_X64)
+#define BENCH_ARCH "x86_64"
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define BENCH_ARCH "aarch64"
+#elif defined(__arm__) || defined(_M_ARM)
+#define BENCH_ARCH "armv7l"
+#elif defined(__i386__) || defined(_M_IX86)
+#define BENCH_ARCH "x86"
+#else
+#define BENCH_ARCH "unknown"
+#endif
+
+#if defined(__clang__)
+#define BENCH_COMPILER TextFormat("clang %d.%d", __clang_major__, __clang_minor__)
+#elif defined(__GNUC__)
+#define BENCH_COMPILER TextFormat("gcc %d.%d", __GNUC__, __GNUC_MINOR__)
+#elif defined(_MSC_VER)
+#define BENCH_COMPILER TextFormat("msvc %d", _MSC_VER)
+#else
+#define BENCH_COMPILER "unknown"
+#endif
+
+#define MAX_BENCH_RESULTS 32
+#define BENCH_MIN_SECONDS 0.02              // A repetition runs at least this long, short ones are all timer noise
+
+typedef void (*BenchFunction)(long long iterations);
+
+typedef struct {
+    const char* name;
+    BenchFunction run;
+    bool logs;                              // Logging benchmarks write to a null stdout while timed
+} Benchmark;
+
+typedef struct {
+    const char* name;
+    long long iterations;                   // Per repetition
+    int repetitions;
+    double mean;                            // All in ns/op
+    double variance;
+    double min;
+    double max;
+} BenchResult;
+
+BenchResult benchResults[MAX_BENCH_RESULTS];
+int benchResultCount = 0;
+
+// Results are folded in here so the optimizer cannot drop the work
+volatile int benchSink = 0;
+
+// Counter state shared by the benchmarks, set up once like GameEnter does
+Cup benchCups[MAX_CUPS];
+DragSource benchDragSources[INGREDIENT_COUNT];
+DragController benchDragController;
+HitIndex benchHitIndex;
+Shift benchShift;
+Shift benchSimulatedShift;
+int benchCustomer = NO_CUSTOMER;
+Camera2D benchCamera = { 0 };
+
+void BenchUpdateCupImage(long long iterations)
+{
+    Cup cup = benchCups[0];
+    for (long long i = 0; i < iterations; i++)
+    {
+        cup.powderType = (i & 1) ? GREEN_TEA : COCOA;
+        cup.hasWater = (i & 2) != 0;
+        cup.creamerType = cup.hasWater ? ((i & 4) ? MILK : CONDENSED_MILK) : NONE;
+        UpdateCupImage(&cup, &ingredients[INGREDIENT_HOT_WATER]);
+        benchSink += cup.recipe;
+    }
+}
+
+void BenchRandomGenerateOrder(long long iterations)
+{
+    for (long long i = 0; i < iterations; i++)
+        benchSink += RandomGenerateOrder(&benchShift);
+}
+
+void BenchRandomGenerateOrderSimulated(long long iterations)
+{
+    for (long long i = 0; i < iterations; i++)
+        benchSink += RandomGenerateOrder(&benchSimulatedShift);
+}
+
+void BenchValidiator(long long iterations)
+{
+    for (long long i = 0; i < iterations; i++)
+        benchSink += validiator(&benchShift.customers, benchCustomer, (Recipe)(i % RECIPE_TABLE_SIZE));
+}
+
+void BenchLogDebug(long long iterations)
+{
+    for (long long i = 0; i < iterations; i++)
+        LogDebug("Bench message %lld", i);
+}
+
+void BenchFrameRect(long long iterations)
+{
+    for (long long i = 0; i < iterations; i++)
+    {
+        const Ingredient* ingredient = &ingredients[i % INGREDIENT_COUNT];
+        int totalFrames = ingredientInfo[ingredient->id].totalFrames;
+        Rectangle frame = frameRect(ingredient, totalFrames, 1 + (int)(i % totalFrames));
+        benchSink += (int)frame.x;
+    }
+}
+
+void BenchColorLerp(long long iterations)
+{
+    for (long long i = 0; i < iterations; i++)
+    {
+        Color color = ColorLerp(SKYBLUE, ORANGE, (i & 255) / 255.0f);
+        benchSink += color.r + color.g + color.b;
+    }
+}
+
+void BenchDrawFpsGraph(long long iterations)
+{
+    for (long long i = 0; i < iterations; i++)
+        DrawFpsGraph(&benchCamera);
+}
+
+void BenchDrawFrameTime(long long iterations)
+{
+    for (long long i = 0; i < iterations; i++)
+        DrawFrameTime(&benchCamera);
+}
+
+// One frame of hovering, the same chain GameUpdate runs before the drag controller
+void BenchHoverChain(long long iterations)
+{
+    for (long long i = 0; i < iterations; i++)
+    {
+        BuildHitIndex(&benchHitIndex, &benchDragController, &ingredients[INGREDIENT_TRASH_CAN]);
+
+        Vector2 point = { baseX + (float)(i * 37 % BASE_SCREEN_WIDTH), baseY + 300 + (float)(i * 13 % (BASE_SCREEN_HEIGHT - 300)) };
+        const HitEntry* hovered = QueryHitIndex(&benchHitIndex, point);
+
+        bool isHovering = false;
+        for (int j = 0; j < INGREDIENT_COUNT; j++)
+            isHovering = highlightItem(&ingredients[j], hovered) || isHovering;
+        benchSink += isHovering;
+    }
+}
+
+// Picks up a station, drags it across the counter and lets go where nothing takes it
+void BenchDragChain(long long iterations)
+{
+    Ingredient* station = &ingredients[INGREDIENT_TEA_POWDER];
+    Vector2 start = IngredientCenter(station);
+    Vector2 end = RectangleCenter(plate.position, plate.texture.width, plate.texture.height);
+
+    for (long long i = 0; i < iterations; i++)
+    {
+        BuildHitIndex(&benchHitIndex, &benchDragController, &ingredients[INGREDIENT_TRASH_CAN]);
+
+        DragPointer* pointer = &benchDragController.pointers[0];
+        *pointer = (DragPointer){ 0 };
+        pointer->active = true;
+        pointer->position = start;
+        PressDragPointer(&benchDragController, pointer, &benchHitIndex);
+
+        for (int step = 1; step <= 8; step++)
+        {
+            pointer->position = Vector2Lerp(start, end, step / 8.0f);
+            MoveDragPointer(&benchDragController, pointer, &ingredients[INGREDIENT_TRASH_CAN]);
+        }
+
+        ReleaseDragPointer(&benchDragController, pointer, &benchShift);
+        pointer->active = false;
+        benchSink += pointer->kind;
+    }
+}
+
+const Benchmark benchmarks[] = {
+    { "UpdateCupImage", BenchUpdateCupImage, true },
+    { "RandomGenerateOrder", BenchRandomGenerateOrder, true },
+    { "RandomGenerateOrder/simulated", BenchRandomGenerateOrderSimulated, false },
+    { "validiator", BenchValidiator, true },
+    { "LogDebug", BenchLogDebug, true },
+    { "frameRect", BenchFrameRect, false },
+    { "ColorLerp", BenchColorLerp, false },
+    { "DrawFpsGraph/null", BenchDrawFpsGraph, false },
+    { "DrawFrameTime/null", BenchDrawFrameTime, false },
+    { "HoverChain", BenchHoverChain, false },
+    { "DragChain", BenchDragChain, false },
+};
+
+// Redirects stdout so logging benchmarks measure the logger and not the terminal
+int SilenceStdout()
+{
+    fflush(stdout);
+    int saved = dup(fileno(stdout));
+    FILE* nullDevice = fopen(NULL_DEVICE, "w");
+    if (nullDevice != NULL)
+    {
+        dup2(fileno(nullDevice), fileno(stdout));
+        fclose(nullDevice);
+    }
+    return saved;
+}
+
+void RestoreStdout(int saved)
+{
+    fflush(stdout);
+    if (saved < 0) return;
+    dup2(saved, fileno(stdout));
+    close(saved);
+}
+
+double TimeBenchmark(const Benchmark* benchmark, long long iterations)
+{
+    int saved = benchmark->logs ? SilenceStdout() : -1;
+
+    double startTime = GetTime();
+    benchmark->run(iterations);
+    double elapsed = GetTime() - startTime;
+
+    if (benchmark->logs) RestoreStdout(saved);
+    return elapsed;
+}
+
+// Doubles the iteration count until a repetition is long enough, then times each repetition on its own
+void RunBenchmark(const Benchmark* benchmark, int repetitions)
+{
+    long long iterations = 1;
+    while (TimeBenchmark(benchmark, iterations) < BENCH_MIN_SECONDS && iterations < (1LL << 40))
+        iterations *= 2;
+
+    BenchResult* result = &benchResults[benchResultCount++];
+    *result = (BenchResult){ benchmark->name, iterations, repetitions, 0, 0, 1e300, 0 };
+
+    double sum = 0;
+    double sumSquares = 0;
+    for (int i = 0; i < repetitions; i++)
+    {
+        double nsPerOp = TimeBenchmark(benchmark, iterations) * 1e9 / iterations;
+        sum += nsPerOp;
+        sumSquares += nsPerOp * nsPerOp;
+        result->min = fmin(result->min, nsPerOp);
+        result->max = fmax(result->max, nsPerOp);
+    }
+
+    result->mean = sum / repetitions;
+    result->variance = repetitions > 1 ? fmax((sumSquares - sum * sum / repetitions) / (repetitions - 1), 0.0) : 0.0;
+
+    printf("%-32s %12lld %12.2f %12.2f %12.2f %12.2f\n", result->name, result->iterations, result->mean, sqrt(result->variance), result->min, result->max);
+}
+
+bool WriteBenchJson(const char* fileName)
+{
+    FILE* file = fopen(fileName, "w");
+    if (file == NULL) return false;
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"arch\": \"%s\",\n", BENCH_ARCH);
+    fprintf(file, "  \"compiler\": \"%s\",\n", BENCH_COMPILER);
+#if defined(NDEBUG)
+    fprintf(file, "  \"build\": \"release\",\n");
+#else
+    fprintf(file, "  \"build\": \"debug\",\n");
+#endif
+    fprintf(file, "  \"unit\": \"ns/op\",\n");
+    fprintf(file, "  \"benchmarks\": [\n");
+    for (int i = 0; i < benchResultCount; i++)
+    {
+        const BenchResult* result = &benchResults[i];
+        fprintf(file, "    { \"name\": \"%s\", \"iterations\": %lld, \"repetitions\": %d, \"mean\": %.3f, \"variance\": %.3f, \"stddev\": %.3f, \"min\": %.3f, \"max\": %.3f }%s\n",
+            result->name, result->iterations, result->repetitions, result->mean, result->variance, sqrt(result->variance), result->min, result->max,
+            i + 1 < benchResultCount ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    fclose(file);
+    return true;
+}
+
+// Hidden window for the GL context the textures need, drawing goes through the null renderer
+void SetupBench()
+{
+    static GameOptions benchOptions;
+    benchOptions.difficulty = MEDIUM;
+    benchOptions.resolution = (Resolution){ BASE_SCREEN_WIDTH, BASE_SCREEN_HEIGHT };
+    benchOptions.targetFps = 60;
+    benchOptions.musicEnabled = false;
+    benchOptions.soundFxEnabled = false;
+    benchOptions.quality = QUALITY_HIGH;
+    benchOptions.fallingItemCount = MAX_MENU_FALLING_ITEMS;
+    benchOptions.cloudCount = MAX_MOVING_CLOUDS;
+    benchOptions.textureFilter = TEXTURE_FILTER_POINT;
+    options = &benchOptions;
+
+    nullRenderer.enabled = true;
+#if defined(__linux__)
+    setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+#endif
+    SetTraceLogLevel(LOG_WARNING);
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+
+    // The game logs through the ring with the writer running, so the bench does too. A writer that falls behind a
+    // tight loop makes pushes take the dropped path, which is what a burst of logging costs the game as well
+    StartLogWriter(NULL_DEVICE);
+    InitWindow(BASE_SCREEN_WIDTH, BASE_SCREEN_HEIGHT, "smm_bench");
+
+    benchCamera.offset = (Vector2){ BASE_SCREEN_WIDTH / 2.0f, BASE_SCREEN_HEIGHT / 2.0f };
+    benchCamera.zoom = 1.0f;
+
+    SeedRandomStreams(1);
+    LoadGlobalAssets();
+
+    plate = (DropArea){ LoadTexture(ASSETS_PATH"/spritesheets/MAT.png"), oriplatePosition };
+    ResetCounter(benchCups);
+    int sourceCount = CollectDragSources(benchDragSources);
+    benchDragController = CreateDragController(benchDragSources, sourceCount, benchCups, MAX_CUPS);
+
+    BeginShift(&benchShift, MEDIUM, randomStreams, false);
+    benchCustomer = AcquireCustomer(&benchShift);
+
+    SeedRandomStreamSet(benchSimulatedShift.ownRandom, 1);
+    BeginShift(&benchSimulatedShift, MEDIUM, benchSimulatedShift.ownRandom, true);
+
+    // A jittery history so the graphs take every color branch
+    for (int i = 0; i < DEBUG_MAX_FPS_HISTORY; i++)
+    {
+        DebugFpsHistory[i] = 30 + (i * 7) % 40;
+        DebugFrameTimeHistory[i] = 10 + (i * 3) % 30;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    SetTraceLogCallback(CustomLogger);
+
+    const char* jsonFile = "smm_bench.json";
+    const char* filter = NULL;
+    int repetitions = 10;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonFile = argv[++i];
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            filter = argv[++i];
+        else if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc)
+            repetitions = atoi(argv[++i]);
+    }
+    // Variance needs at least two samples
+    if (repetitions < 2) repetitions = 2;
+
+    SetupBench();
+
+    printf("smm_bench %s, %s, %d repetitions\n", BENCH_ARCH, BENCH_COMPILER, repetitions);
+    printf("%-32s %12s %12s %12s %12s %12s\n", "Benchmark", "Iterations", "ns/op", "StdDev", "Min", "Max");
+    for (int i = 0; i < (int)(sizeof(benchmarks) / sizeof(benchmarks[0])); i++)
+    {
+        if (filter != NULL && strstr(benchmarks[i].name, filter) == NULL) continue;
+        RunBenchmark(&benchmarks[i], repetitions);
+    }
+
+    if (!WriteBenchJson(jsonFile))
+        Log(LOG_WARNING, "Could not write %s", jsonFile);
+    else
+        printf("Results written to %s\n", jsonFile);
+
+    StopLogWriter();
+    CloseWindow();
+    return 0;
+}
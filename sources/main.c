@@ -5,9 +5,360 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <time.h> 
 #include <string.h>
 
+// Batched simulation runs shifts on worker threads, builds without pthreads run them one after another
+#if !defined(_WIN32)
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#define SIM_THREADS 1
+#else
+#define SIM_THREADS 0
+#endif
+
+// Desktop builds hook GLFW input directly for the event queue and late-latched dragging
+#if defined(USE_GLFW_INPUT)
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#endif
+
+// Headless runs keep the window hidden and count draw calls instead of issuing them, textures still load
+// through the GL context (llvmpipe on machines without a GPU)
+typedef enum {
+    DRAW_CALL_CLEAR = 0,
+    DRAW_CALL_TEXTURE,
+    DRAW_CALL_SHAPE,
+    DRAW_CALL_TEXT,
+    DRAW_CALL_KIND_COUNT
+} DrawCallKind;
+
+typedef struct {
+    bool enabled;
+    long long calls[DRAW_CALL_KIND_COUNT];
+} NullRenderer;
+
+NullRenderer nullRenderer = { 0 };
+
+// The macro name is not expanded again inside its own body, so the inner call reaches raylib
+#define NULL_RENDERED(kind, call) (nullRenderer.enabled ? (void)nullRenderer.calls[kind]++ : (void)(call))
+#define ClearBackground(...) NULL_RENDERED(DRAW_CALL_CLEAR, ClearBackground(__VA_ARGS__))
+#define DrawTexture(...) NULL_RENDERED(DRAW_CALL_TEXTURE, DrawTexture(__VA_ARGS__))
+#define DrawTextureEx(...) NULL_RENDERED(DRAW_CALL_TEXTURE, DrawTextureEx(__VA_ARGS__))
+#define DrawTextureRec(...) NULL_RENDERED(DRAW_CALL_TEXTURE, DrawTextureRec(__VA_ARGS__))
+#define DrawTexturePro(...) NULL_RENDERED(DRAW_CALL_TEXTURE, DrawTexturePro(__VA_ARGS__))
+#define DrawLine(...) NULL_RENDERED(DRAW_CALL_SHAPE, DrawLine(__VA_ARGS__))
+#define DrawLineEx(...) NULL_RENDERED(DRAW_CALL_SHAPE, DrawLineEx(__VA_ARGS__))
+#define DrawRectangle(...) NULL_RENDERED(DRAW_CALL_SHAPE, DrawRectangle(__VA_ARGS__))
+#define DrawRectangleRec(...) NULL_RENDERED(DRAW_CALL_SHAPE, DrawRectangleRec(__VA_ARGS__))
+#define DrawRectangleLinesEx(...) NULL_RENDERED(DRAW_CALL_SHAPE, DrawRectangleLinesEx(__VA_ARGS__))
+#define DrawTextEx(...) NULL_RENDERED(DRAW_CALL_TEXT, DrawTextEx(__VA_ARGS__))
+
+// Usable before the window exists, Windows has no monotonic clock in its C runtime and uses the wall clock
+double GetMonotonicTime()
+{
+    struct timespec now;
+#if defined(_WIN32)
+    timespec_get(&now, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#endif
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Startup profiling, marks along the way to the first interactive menu frame and the load time of every asset
+// The first iteration is the cold start of the process, the rest reload the assets into the running game
+#define MAX_STARTUP_ITERATIONS 32
+#define MAX_STARTUP_ASSETS 160
+
+typedef enum {
+    STARTUP_MARK_INIT_WINDOW = 0,
+    STARTUP_MARK_INIT_AUDIO,
+    STARTUP_MARK_FONT,
+    STARTUP_MARK_ASSETS,
+    STARTUP_MARK_FIRST_FRAME,
+    STARTUP_MARK_INTERACTIVE,
+    STARTUP_MARK_COUNT
+} StartupMark;
+
+static inline char* StringFromStartupMarkEnum(StartupMark mark)
+{
+    static const char* strings[] = { "InitWindow", "InitAudioDevice", "Font", "LoadGlobalAssets", "First frame", "Interactive" };
+    return strings[mark];
+}
+
+typedef struct {
+    bool enabled;
+    int iterations;
+    int current;
+    double processStart;
+    double iterationStart;
+    double marks[MAX_STARTUP_ITERATIONS][STARTUP_MARK_COUNT];      // Seconds since the iteration started, negative until reached
+    char assetNames[MAX_STARTUP_ASSETS][64];                        // Relative to the assets folder
+    double assetTimes[MAX_STARTUP_ITERATIONS][MAX_STARTUP_ASSETS];  // Seconds, negative when not loaded in that iteration
+    int assetCount;
+    int loadDepth;                                                  // Only the outermost load counts, a hit mask texture loads an image
+    int baseTextureCount;                                           // Live textures before the splash assets, every unload gets back to it
+    const char* jsonFile;
+} StartupProfile;
+
+StartupProfile startupProfile = { 0 };
+
+void MarkStartup(StartupMark mark)
+{
+    if (!startupProfile.enabled || startupProfile.marks[startupProfile.current][mark] >= 0) return;
+    startupProfile.marks[startupProfile.current][mark] = GetMonotonicTime() - startupProfile.iterationStart;
+}
+
+double BeginAssetLoad()
+{
+    if (!startupProfile.enabled) return 0;
+    startupProfile.loadDepth++;
+    return GetMonotonicTime();
+}
+
+void EndAssetLoad(const char* fileName, double startTime)
+{
+    if (!startupProfile.enabled || --startupProfile.loadDepth > 0) return;
+
+    double elapsed = GetMonotonicTime() - startTime;
+    const char* name = strncmp(fileName, ASSETS_PATH, strlen(ASSETS_PATH)) == 0 ? fileName + strlen(ASSETS_PATH) : fileName;
+
+    int index = 0;
+    while (index < startupProfile.assetCount && strcmp(startupProfile.assetNames[index], name) != 0) index++;
+    if (index == startupProfile.assetCount)
+    {
+        if (index >= MAX_STARTUP_ASSETS) return;
+        snprintf(startupProfile.assetNames[index], sizeof(startupProfile.assetNames[index]), "%s", name);
+        startupProfile.assetCount++;
+    }
+
+    // Loading the same file twice in one iteration adds up
+    double* time = &startupProfile.assetTimes[startupProfile.current][index];
+    *time = *time < 0 ? elapsed : *time + elapsed;
+}
+
+// GPU textures alive right now, soak runs watch it for leaks
+int liveTextureCount = 0;
+
+// Heap allocations and file loads made by the game thread, the performance gate counts them per scene
+long long allocationCount = 0;
+
+void* TrackedMalloc(size_t size)
+{
+    allocationCount++;
+    return malloc(size);
+}
+
+void* TrackedCalloc(size_t count, size_t size)
+{
+    allocationCount++;
+    return calloc(count, size);
+}
+
+// Every file load below goes through these, the macro name is not expanded again inside the wrapper
+Texture2D TrackedLoadTexture(const char* fileName)
+{
+    double startTime = BeginAssetLoad();
+    allocationCount++;
+    Texture2D texture = LoadTexture(fileName);
+    EndAssetLoad(fileName, startTime);
+    if (texture.id != 0) liveTextureCount++;
+    return texture;
+}
+
+Texture2D TrackedLoadTextureFromImage(Image image)
+{
+    allocationCount++;
+    Texture2D texture = LoadTextureFromImage(image);
+    if (texture.id != 0) liveTextureCount++;
+    return texture;
+}
+
+void TrackedUnloadTexture(Texture2D texture)
+{
+    if (texture.id != 0) liveTextureCount--;
+    UnloadTexture(texture);
+}
+
+RenderTexture2D TrackedLoadRenderTexture(int width, int height)
+{
+    allocationCount++;
+    RenderTexture2D target = LoadRenderTexture(width, height);
+    if (target.texture.id != 0) liveTextureCount++;
+    return target;
+}
+
+void TrackedUnloadRenderTexture(RenderTexture2D target)
+{
+    if (target.texture.id != 0) liveTextureCount--;
+    UnloadRenderTexture(target);
+}
+
+Image TrackedLoadImage(const char* fileName)
+{
+    double startTime = BeginAssetLoad();
+    allocationCount++;
+    Image image = LoadImage(fileName);
+    EndAssetLoad(fileName, startTime);
+    return image;
+}
+
+Sound TrackedLoadSound(const char* fileName)
+{
+    double startTime = BeginAssetLoad();
+    allocationCount++;
+    Sound sound = LoadSound(fileName);
+    EndAssetLoad(fileName, startTime);
+    return sound;
+}
+
+Music TrackedLoadMusicStream(const char* fileName)
+{
+    double startTime = BeginAssetLoad();
+    allocationCount++;
+    Music music = LoadMusicStream(fileName);
+    EndAssetLoad(fileName, startTime);
+    return music;
+}
+
+// A font owns its glyph atlas texture
+Font TrackedLoadFontEx(const char* fileName, int fontSize, int* codepoints, int codepointCount)
+{
+    double startTime = BeginAssetLoad();
+    allocationCount++;
+    Font font = LoadFontEx(fileName, fontSize, codepoints, codepointCount);
+    EndAssetLoad(fileName, startTime);
+    if (font.texture.id != 0) liveTextureCount++;
+    return font;
+}
+
+void TrackedUnloadFont(Font font)
+{
+    if (font.texture.id != 0) liveTextureCount--;
+    UnloadFont(font);
+}
+
+#define LoadTexture(fileName) TrackedLoadTexture(fileName)
+#define LoadTextureFromImage(image) TrackedLoadTextureFromImage(image)
+#define UnloadTexture(texture) TrackedUnloadTexture(texture)
+#define LoadRenderTexture(width, height) TrackedLoadRenderTexture(width, height)
+#define UnloadRenderTexture(target) TrackedUnloadRenderTexture(target)
+#define LoadImage(fileName) TrackedLoadImage(fileName)
+#define LoadSound(fileName) TrackedLoadSound(fileName)
+#define LoadMusicStream(fileName) TrackedLoadMusicStream(fileName)
+#define LoadFontEx(...) TrackedLoadFontEx(__VA_ARGS__)
+#define UnloadFont(font) TrackedUnloadFont(font)
+
+// Performance gate, the bot tours every scene headless on a fixed step clock and a fixed seed
+// Frame times, draw calls and allocations per scene are held against baselines checked into the repo
+#define MAX_PERF_FRAMES 8192            // Per scene, later frames still count draws and allocations
+#define PERF_SCENE_DWELL_FRAMES 120     // Menus and the score screen stay up this long before the bot clicks on
+#define PERF_GATE_SEED 20240601
+#define PERF_GATE_SKIPPED 77            // CTest reports this exit code as a skip, used when baselines or frame times are missing
+
+typedef enum {
+    PERF_SCENE_SPLASH = 0,
+    PERF_SCENE_MENU,
+    PERF_SCENE_OPTIONS,
+    PERF_SCENE_GAME_EASY,
+    PERF_SCENE_GAME_MEDIUM,
+    PERF_SCENE_GAME_HARD,
+    PERF_SCENE_ENDGAME,
+    PERF_SCENE_COUNT
+} PerfScene;
+
+static inline char* StringFromPerfSceneEnum(PerfScene scene)
+{
+    static const char* strings[] = { "splash", "menu", "options", "game-easy", "game-medium", "game-hard", "endgame" };
+    return strings[scene];
+}
+
+typedef struct {
+    bool enabled;
+    bool update;                                    // Rewrite the baselines from this run instead of checking them
+    const char* baselineFile;
+
+    PerfScene scene;
+    int sceneFrames;                                // Since the scene was last entered
+    bool skipFrame;                                 // The frame a scene is entered in also ran the scene it left
+    bool optionsVisited;
+    int gamesPlayed;
+
+    double frameStart;
+    long long drawCallsAtStart;
+    long long allocationsAtStart;
+
+    float frameTimes[PERF_SCENE_COUNT][MAX_PERF_FRAMES];   // ms
+    int frameCount[PERF_SCENE_COUNT];
+    long long chargedFrames[PERF_SCENE_COUNT];              // Including the skipped ones and those past MAX_PERF_FRAMES
+    long long drawCalls[PERF_SCENE_COUNT];
+    long long allocations[PERF_SCENE_COUNT];
+} PerfGate;
+
+PerfGate perfGate = { 0 };
+
+long long CountDrawCalls()
+{
+    long long total = 0;
+    for (int i = 0; i < DRAW_CALL_KIND_COUNT; i++)
+        total += nullRenderer.calls[i];
+    return total;
+}
+
+void EnterPerfScene(PerfScene scene)
+{
+    if (!perfGate.enabled) return;
+
+    // The scene being left drew the frame it asked for the next scene in, its draws and allocations stay with it
+    if (perfGate.frameStart > 0)
+    {
+        long long drawCalls = CountDrawCalls();
+        perfGate.drawCalls[perfGate.scene] += drawCalls - perfGate.drawCallsAtStart;
+        perfGate.allocations[perfGate.scene] += allocationCount - perfGate.allocationsAtStart;
+        perfGate.drawCallsAtStart = drawCalls;
+        perfGate.allocationsAtStart = allocationCount;
+    }
+
+    perfGate.scene = scene;
+    perfGate.sceneFrames = 0;
+    perfGate.skipFrame = true;
+}
+
+// Called as every frame starts, the frame that just ended is charged to the current scene
+void SamplePerfFrame()
+{
+    if (!perfGate.enabled) return;
+
+    double now = GetMonotonicTime();
+    long long drawCalls = CountDrawCalls();
+    PerfScene scene = perfGate.scene;
+
+    if (perfGate.frameStart > 0)
+    {
+        perfGate.drawCalls[scene] += drawCalls - perfGate.drawCallsAtStart;
+        perfGate.allocations[scene] += allocationCount - perfGate.allocationsAtStart;
+        perfGate.chargedFrames[scene]++;
+
+        if (!perfGate.skipFrame && perfGate.frameCount[scene] < MAX_PERF_FRAMES)
+            perfGate.frameTimes[scene][perfGate.frameCount[scene]++] = (float)((now - perfGate.frameStart) * 1000.0);
+    }
+
+    perfGate.skipFrame = false;
+    perfGate.sceneFrames++;
+    perfGate.frameStart = now;
+    perfGate.drawCallsAtStart = drawCalls;
+    perfGate.allocationsAtStart = allocationCount;
+}
+
+// Keeps the bot from clicking through a scene before it has been measured, always true outside the gate
+bool PerfSceneDwelled()
+{
+    return !perfGate.enabled || perfGate.sceneFrames >= PERF_SCENE_DWELL_FRAMES;
+}
+
 // Render resolution
 #define BASE_SCREEN_WIDTH 1920
 #define BASE_SCREEN_HEIGHT 1080
@@ -18,6 +369,10 @@
 #define DEBUG_MAX_FPS_HISTORY 500
 #define DEBUG_MAX_LOGS_HISTORY 25
 
+// Power saving frame rates
+#define GOVERNOR_IDLE_FPS 15
+#define GOVERNOR_BACKGROUND_FPS 5
+
 // Base values
 const float baseX = -(BASE_SCREEN_WIDTH / 2);
 const float baseY = -(BASE_SCREEN_HEIGHT / 2);
@@ -34,14 +389,69 @@ int DebugFpsHistoryIndex = 0;
 int DebugFrameTimeHistory[DEBUG_MAX_FPS_HISTORY];
 int DebugFrameTimeHistoryIndex = 0;
 
-// Debug logs history
-typedef struct DebugLogEntry {
-	int type;
-	char* text;
-} DebugLogEntry;
+// Debug logs, a fixed ring of preallocated records that any thread writes and one writer drains
+// A record's state is the first position of its lap while free, one more once written, and the next lap's first position
+// once printed, so the zeroed ring is empty. Positions and states wrap together, the capacity has to be a power of two
+#define LOG_RING_CAPACITY 256
+#define LOG_RECORD_TEXT 256
+
+static inline unsigned int LogLapStart(unsigned int position) { return position & ~(unsigned int)(LOG_RING_CAPACITY - 1); }
+
+typedef struct LogRecord {
+    unsigned int state;
+    int type;
+    time_t time;
+    char text[LOG_RECORD_TEXT];
+} LogRecord;
+
+typedef struct LogRing {
+    LogRecord records[LOG_RING_CAPACITY];
+    unsigned int head;      // Next position a producer claims
+    unsigned int tail;      // Next position the writer prints, only the drainer touches it
+    unsigned int dropped;   // Lines lost to a full ring since the last drain
+    unsigned int draining;  // Held by whoever is printing, there is only ever one consumer
+} LogRing;
+
+LogRing logRing;
+
+// Builds without pthreads only log from the main thread, plain loads and stores do there
+#if SIM_THREADS
+static inline unsigned int AtomicLoad(unsigned int* value) { return __atomic_load_n(value, __ATOMIC_ACQUIRE); }
+static inline void AtomicStore(unsigned int* value, unsigned int desired) { __atomic_store_n(value, desired, __ATOMIC_RELEASE); }
+static inline unsigned int AtomicExchange(unsigned int* value, unsigned int desired) { return __atomic_exchange_n(value, desired, __ATOMIC_ACQ_REL); }
+static inline void AtomicIncrement(unsigned int* value) { __atomic_fetch_add(value, 1, __ATOMIC_RELAXED); }
+static inline bool AtomicCompareExchange(unsigned int* value, unsigned int* expected, unsigned int desired) { return __atomic_compare_exchange_n(value, expected, desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED); }
+static inline void AtomicFence() { __atomic_thread_fence(__ATOMIC_ACQUIRE); }
+static inline void AtomicFullFence() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+#else
+static inline unsigned int AtomicLoad(unsigned int* value) { return *value; }
+static inline void AtomicStore(unsigned int* value, unsigned int desired) { *value = desired; }
+static inline unsigned int AtomicExchange(unsigned int* value, unsigned int desired) { unsigned int old = *value; *value = desired; return old; }
+static inline void AtomicIncrement(unsigned int* value) { (*value)++; }
+static inline bool AtomicCompareExchange(unsigned int* value, unsigned int* expected, unsigned int desired) { if (*value != *expected) { *expected = *value; return false; } *value = desired; return true; }
+static inline void AtomicFence() { }
+static inline void AtomicFullFence() { }
+#endif
+
+// Prints the ring to stdout or the --log-file, on its own thread where there are pthreads and once a frame otherwise
+typedef struct LogWriter {
+    FILE* file;
+    bool started;
+    bool threaded;
+    unsigned int stopping;
+#if SIM_THREADS
+    pthread_t thread;
+    // The writer sleeps on wake while the ring is empty, producers only take the lock when asleep is set
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    unsigned int asleep;
+#endif
+    // Records from the same second share one strftime
+    time_t stampTime;
+    char stamp[32];
+} LogWriter;
 
-DebugLogEntry DebugLogs[DEBUG_MAX_LOGS_HISTORY];
-int DebugLogsIndex = 0;
+LogWriter logWriter;
 
 // Debug tool toggles states
 typedef struct DebugToolToggles {
@@ -72,6 +482,34 @@ typedef enum {
     FREEPLAY_HARD
 } Difficulty;
 
+// Quality presets
+typedef enum {
+    QUALITY_LOW,
+    QUALITY_MEDIUM,
+    QUALITY_HIGH
+} QualityPreset;
+
+typedef struct QualitySettings {
+    Resolution resolution;
+    int targetFps;
+    bool msaa;
+    int fallingItemCount;
+    int cloudCount;
+    int textureFilter;
+} QualitySettings;
+
+const QualitySettings qualityPresets[] = {
+    { { 1280, 720 }, 30, false, 8, 3, TEXTURE_FILTER_POINT },         // Low
+    { { 1280, 720 }, 60, false, 14, 5, TEXTURE_FILTER_BILINEAR },     // Medium
+    { { 1920, 1080 }, 120, true, 20, 7, TEXTURE_FILTER_TRILINEAR }    // High
+};
+
+static inline char* StringFromQualityPresetEnum(QualityPreset quality)
+{
+    static const char* strings[] = { "Low", "Medium", "High" };
+    return strings[quality];
+}
+
 // Game options
 typedef struct GameOptions {
     Resolution resolution;
@@ -81,8 +519,24 @@ typedef struct GameOptions {
     bool showDebug;
     bool soundFxEnabled;
     bool musicEnabled;
+    bool powerSaving;
+    float idleTimeout;
+    bool pauseAudioWhenIdle;
+    QualityPreset quality;
+    bool msaa;
+    int fallingItemCount;
+    int cloudCount;
+    int textureFilter;
 } GameOptions;
 
+// Options persistence
+#define SETTINGS_FILE "settings.cfg"
+
+// Hardware probe frame budgets (ms per probe frame)
+#define PROBE_FRAMES 30
+#define PROBE_HIGH_BUDGET 4.0
+#define PROBE_MEDIUM_BUDGET 12.0
+
 // Colors
 Color MAIN_BROWN = { 150, 104, 81, 255 };
 Color MAIN_ORANGE = { 245, 167, 128, 255 };
@@ -186,22 +640,20 @@ Music menuBgm;
 // Menu falling items
 Texture2D menuFallingItemTextures[8];
 
-// Ingredients
-Texture2D teaPowderTexture;
-Texture2D cocoaPowderTexture;
-Texture2D caramelSauceTexture;
-Texture2D chocolateSauceTexture;
-Texture2D condensedMilkTexture;
-Texture2D normalMilkTexture;
-Texture2D marshMellowTexture;
-Texture2D whippedCreamTexture;
-Texture2D hotWaterTexture;
-Texture2D greenChonTexture;
-Texture2D cocoaChonTexture;
+// Alpha hit mask, one bit per pixel packed into 64-bit words per row
+#define HIT_MASK_ALPHA_THRESHOLD 16
 
+typedef struct {
+    int width;
+    int height;
+    int wordsPerRow;
+    uint64_t* bits;
+} HitMask;
 
 // utils
-Texture2D trashCanTexture;
+Texture2D cupsTexture;
+HitMask cupsHitMask;
+HitMask cupHitMask;
 
 static inline char* StringFromDifficultyEnum(Difficulty difficulty)
 {
@@ -209,8 +661,74 @@ static inline char* StringFromDifficultyEnum(Difficulty difficulty)
     return strings[difficulty];
 }
 
+HitMask GenHitMaskFromImage(Image* image)
+{
+    HitMask mask = { 0 };
+
+    ImageFormat(image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    mask.width = image->width;
+    mask.height = image->height;
+    mask.wordsPerRow = (image->width + 63) / 64;
+    mask.bits = (uint64_t*)TrackedCalloc((size_t)mask.wordsPerRow * mask.height, sizeof(uint64_t));
+
+    if (mask.bits == NULL) return (HitMask) { 0 };
+
+    const Color* pixels = (const Color*)image->data;
+    for (int y = 0; y < mask.height; y++) {
+        uint64_t* row = mask.bits + (size_t)y * mask.wordsPerRow;
+        for (int x = 0; x < mask.width; x++) {
+            if (pixels[y * mask.width + x].a > HIT_MASK_ALPHA_THRESHOLD)
+                row[x >> 6] |= (uint64_t)1 << (x & 63);
+        }
+    }
+
+    return mask;
+}
+
+HitMask GenHitMaskFromFile(const char* fileName)
+{
+    Image image = LoadImage(fileName);
+    HitMask mask = GenHitMaskFromImage(&image);
+    UnloadImage(image);
+    return mask;
+}
+
+// Loads the texture and its hit mask from a single decode
+Texture2D LoadTextureWithHitMask(const char* fileName, HitMask* mask)
+{
+    double startTime = BeginAssetLoad();
+    Image image = LoadImage(fileName);
+    *mask = GenHitMaskFromImage(&image);
+    Texture2D texture = LoadTextureFromImage(image);
+    UnloadImage(image);
+    EndAssetLoad(fileName, startTime);
+    return texture;
+}
+
+void UnloadHitMask(HitMask* mask)
+{
+    free(mask->bits);
+    *mask = (HitMask){ 0 };
+}
+
+// AABB test first, then a single bit lookup. source is the texture region drawn into bounds.
+// Textures without a mask fall back to the rectangle.
+bool CheckCollisionPointMask(Vector2 point, Rectangle bounds, const HitMask* mask, Rectangle source)
+{
+    if (!CheckCollisionPointRec(point, bounds)) return false;
+    if (mask == NULL || mask->bits == NULL || bounds.width <= 0 || bounds.height <= 0) return true;
+
+    int x = (int)(source.x + (point.x - bounds.x) * source.width / bounds.width);
+    int y = (int)(source.y + (point.y - bounds.y) * source.height / bounds.height);
+
+    if (x < 0 || y < 0 || x >= mask->width || y >= mask->height) return false;
+
+    return (mask->bits[(size_t)y * mask->wordsPerRow + (x >> 6)] >> (x & 63)) & 1;
+}
+
 // Customer textures
 typedef struct {
+    HitMask hitMask;
     Texture2D happy;
     Texture2D happyEyesClosed;
     Texture2D frustrated;
@@ -245,6 +763,20 @@ typedef enum {
 //     char* fourth;
 // } Order;
 
+// Recipe packed into 9 bits, each slot stores which of its two ingredients was used (0 = none)
+// powder: bits 0-1, water: bit 2, creamer: bits 3-4, topping: bits 5-6, sauce: bits 7-8
+typedef unsigned short Recipe;
+
+#define RECIPE_POWDER_SHIFT 0
+#define RECIPE_WATER_SHIFT 2
+#define RECIPE_CREAMER_SHIFT 3
+#define RECIPE_TOPPING_SHIFT 5
+#define RECIPE_SAUCE_SHIFT 7
+#define RECIPE_EMPTY 0
+#define RECIPE_TABLE_SIZE 512
+#define MAX_RECIPE_TEXTURES 33
+#define MAX_RECIPE_ICONS 4
+
 // Customer
 typedef struct Customer {
     CustomerEmotion emotion;
@@ -255,7 +787,7 @@ typedef struct Customer {
 
     //int patience; //To be removed. 
     bool visible;
-    char order[20];
+    Recipe order;
     double currentTime;
     int orderEnd;
     Vector2 position;
@@ -270,14 +802,90 @@ static inline char* StringFromCustomerEmotionEnum(CustomerEmotion emotion)
     return strings[emotion];
 }
 
-double GetRandomDoubleValue(double min, double max)
+// Random streams, one PCG32 generator per subsystem so e.g. extra audio variation never shifts the orders
+typedef enum {
+    RANDOM_CUSTOMERS = 0,
+    RANDOM_ORDERS,
+    RANDOM_AMBIENT,
+    RANDOM_AUDIO,
+    RANDOM_BOT,
+    RANDOM_STREAM_COUNT
+} RandomStreamId;
+
+typedef struct {
+    uint64_t state;
+    uint64_t increment;     // Odd, selects the stream
+} RandomStream;
+
+RandomStream randomStreams[RANDOM_STREAM_COUNT];
+uint64_t sessionSeed = 0;
+
+uint32_t NextRandom(RandomStream* stream)
+{
+    uint64_t oldState = stream->state;
+    stream->state = oldState * 6364136223846793005ULL + stream->increment;
+
+    uint32_t xorShifted = (uint32_t)(((oldState >> 18) ^ oldState) >> 27);
+    uint32_t rotation = (uint32_t)(oldState >> 59);
+    return (xorShifted >> rotation) | (xorShifted << ((-rotation) & 31));
+}
+
+// Every stream starts from the seed, the stream id keeps their sequences apart
+void SeedRandomStreamSet(RandomStream* streams, uint64_t seed)
+{
+    for (int i = 0; i < RANDOM_STREAM_COUNT; i++)
+    {
+        RandomStream* stream = &streams[i];
+        stream->state = 0;
+        stream->increment = ((uint64_t)i << 1) | 1;
+        NextRandom(stream);
+        stream->state += seed;
+        NextRandom(stream);
+    }
+}
+
+void SeedRandomStreams(uint64_t seed)
+{
+    sessionSeed = seed;
+    SeedRandomStreamSet(randomStreams, seed);
+
+    Log(LOG_INFO, "Session seed %llu", (unsigned long long)seed);
+}
+
+// Inclusive on both ends like GetRandomValue, rejection keeps small ranges unbiased
+int NextRandomInt(RandomStream* stream, int min, int max)
+{
+    if (max <= min) return min;
+
+    uint32_t range = (uint32_t)(max - min) + 1;
+    uint32_t threshold = (0u - range) % range;
+    uint32_t value;
+
+    do {
+        value = NextRandom(stream);
+    } while (value < threshold);
+
+    return min + (int)(value % range);
+}
+
+double NextRandomDouble(RandomStream* stream, double min, double max)
+{
+    return min + (NextRandom(stream) / 4294967296.0) * (max - min);
+}
+
+int GetRandomIntValue(RandomStreamId stream, int min, int max)
+{
+    return NextRandomInt(&randomStreams[stream], min, max);
+}
+
+double GetRandomDoubleValue(RandomStreamId stream, double min, double max)
 {
-    return min + (rand() / (double)RAND_MAX) * (max - min);
+    return NextRandomDouble(&randomStreams[stream], min, max);
 }
 
 void RandomCustomerBlinkTime(Customer* customer) {
-    customer->blinkDuration = GetRandomDoubleValue(0.2, 0.5);
-    customer->normalDuration = GetRandomDoubleValue(2.0, 6.0);
+    customer->blinkDuration = GetRandomDoubleValue(RANDOM_CUSTOMERS, 0.2, 0.5);
+    customer->normalDuration = GetRandomDoubleValue(RANDOM_CUSTOMERS, 2.0, 6.0);
 }
 
 Customer CreateCustomer(CustomerEmotion emotion, double blinkTimer, double normalDuration, double blinkDuration, bool visible, Vector2 position, int textureType, double resetTimer) {
@@ -289,7 +897,7 @@ Customer CreateCustomer(CustomerEmotion emotion, double blinkTimer, double norma
     newCustomer.blinkDuration = blinkDuration;
     newCustomer.eyesClosed = false;
     newCustomer.visible = visible;
-	newCustomer.order[0] = '\0';
+	newCustomer.order = RECIPE_EMPTY;
     newCustomer.currentTime = 0;
     newCustomer.orderEnd = 0;
     newCustomer.position = position;
@@ -300,12 +908,144 @@ Customer CreateCustomer(CustomerEmotion emotion, double blinkTimer, double norma
     return newCustomer;
 }
 
-// Customers
-typedef struct Customers {
-    Customer customer1;
-    Customer customer2;
-    Customer customer3;
-} Customers;
+// Timers, a binary min-heap keyed on simulation time so a frame only pays for the deadlines that expired
+#define MAX_TIMERS 512
+
+typedef enum {
+    TIMER_CUSTOMER_FRUSTRATED = 0,
+    TIMER_CUSTOMER_ANGRY,
+    TIMER_CUSTOMER_TIMEOUT,
+    TIMER_CUSTOMER_BLINK,
+    TIMER_CUSTOMER_ARRIVAL,
+    TIMER_SEAT_RESPAWN,
+    TIMER_BOILER_BUBBLE,
+    TIMER_MENU_BLINK,
+    TIMER_BARISTA_STEP,
+} TimerType;
+
+static inline char* StringFromTimerTypeEnum(TimerType type)
+{
+    static const char* strings[] = { "Customer Frustrated", "Customer Angry", "Customer Timeout", "Customer Blink", "Customer Arrival", "Seat Respawn", "Boiler Bubble", "Menu Blink", "Barista Step" };
+    return strings[type];
+}
+
+// A timer is stale once its target's generation moved on, stale timers are dropped when they expire
+typedef struct {
+    double deadline;
+    TimerType type;
+    int target;
+    unsigned int generation;
+} Timer;
+
+typedef struct {
+    Timer timers[MAX_TIMERS];
+    int count;
+    double time;                            // Simulation time, advanced by the frame delta
+    int dropped;
+    bool silent;                            // Simulated shifts only count drops, the batch reports them once
+} TimerHeap;
+
+TimerHeap menuTimers;
+
+void ClearTimers(TimerHeap* heap)
+{
+    heap->count = 0;
+    heap->time = 0;
+    heap->dropped = 0;
+}
+
+void AdvanceTimers(TimerHeap* heap, double deltaTime)
+{
+    heap->time += deltaTime;
+}
+
+void ScheduleTimer(TimerHeap* heap, TimerType type, int target, unsigned int generation, double delay)
+{
+    if (heap->count >= MAX_TIMERS)
+    {
+        heap->dropped++;
+        if (!heap->silent)
+            Log(LOG_WARNING, "Timer heap full, dropped %s timer", StringFromTimerTypeEnum(type));
+        return;
+    }
+
+    Timer timer = { heap->time + delay, type, target, generation };
+
+    // Sift up
+    int i = heap->count++;
+    while (i > 0)
+    {
+        int parent = (i - 1) / 2;
+        if (heap->timers[parent].deadline <= timer.deadline) break;
+        heap->timers[i] = heap->timers[parent];
+        i = parent;
+    }
+    heap->timers[i] = timer;
+}
+
+// Pops the earliest timer if its deadline has passed
+bool PopExpiredTimer(TimerHeap* heap, Timer* timer)
+{
+    if (heap->count == 0 || heap->timers[0].deadline > heap->time) return false;
+
+    *timer = heap->timers[0];
+    Timer last = heap->timers[--heap->count];
+
+    // Sift down
+    int i = 0;
+    while (true)
+    {
+        int child = i * 2 + 1;
+        if (child >= heap->count) break;
+        if (child + 1 < heap->count && heap->timers[child + 1].deadline < heap->timers[child].deadline) child++;
+        if (last.deadline <= heap->timers[child].deadline) break;
+        heap->timers[i] = heap->timers[child];
+        i = child;
+    }
+    if (heap->count > 0)
+        heap->timers[i] = last;
+
+    return true;
+}
+
+// Customer pool, structure of arrays so update and draw sweep contiguous memory
+#define MAX_CUSTOMERS 64
+#define MAX_SEATS 16
+#define DEFAULT_SEATS 3
+#define NO_CUSTOMER -1
+#define NO_SEAT -1
+
+typedef struct {
+    // Per customer, indexed by customer id
+    CustomerEmotion emotion[MAX_CUSTOMERS];
+    bool eyesClosed[MAX_CUSTOMERS];
+    double normalDuration[MAX_CUSTOMERS];
+    double blinkDuration[MAX_CUSTOMERS];
+    double seatedAt[MAX_CUSTOMERS];
+    double orderEnd[MAX_CUSTOMERS];
+    Recipe order[MAX_CUSTOMERS];
+    Vector2 position[MAX_CUSTOMERS];
+    int textureType[MAX_CUSTOMERS];
+    int seat[MAX_CUSTOMERS];
+    int nextFree[MAX_CUSTOMERS];
+    unsigned int generation[MAX_CUSTOMERS];
+    int freeHead;
+    int liveCount;
+
+    // Per seat, a free seat waits for its respawn timer
+    int seatCount;
+    Vector2 seatPosition[MAX_SEATS];
+    int seatCustomer[MAX_SEATS];
+    unsigned int seatGeneration[MAX_SEATS];
+    double seatFreedAt[MAX_SEATS];
+    double seatResetTimer[MAX_SEATS];
+
+    // Waiting line, first in line takes the next free seat
+    int queue[MAX_CUSTOMERS];
+    int queueHead;
+    int queueCount;
+    double arrivalInterval;                 // 0 disables queued arrivals, rush hour sets it
+} CustomerPool;
 
 // Menu falling items
 typedef struct {
@@ -346,21 +1086,49 @@ typedef enum IngredientType {
     CHOCOLATE
 };
 
+// Registry order is the draw order on the counter, the cup stack is drawn before the powders
+typedef enum {
+    INGREDIENT_TRASH_CAN,
+    INGREDIENT_HOT_WATER,
+    INGREDIENT_CONDENSED_MILK,
+    INGREDIENT_NORMAL_MILK,
+    INGREDIENT_COCOA_POWDER,
+    INGREDIENT_TEA_POWDER,
+    INGREDIENT_CHOCOLATE_SAUCE,
+    INGREDIENT_CARAMEL_SAUCE,
+    INGREDIENT_MARSHMELLOW,
+    INGREDIENT_WHIPPED_CREAM,
+    INGREDIENT_GREEN_CHON,
+    INGREDIENT_COCOA_CHON,
+    INGREDIENT_COUNT
+} IngredientId;
+
+// Which cup slot an ingredient fills, decides the order it can be added in
+typedef enum {
+    CATEGORY_POWDER,
+    CATEGORY_WATER,
+    CATEGORY_CREAMER,
+    CATEGORY_TOPPING,
+    CATEGORY_SAUCE,
+    CATEGORY_DRAGGED,       // Stand-in sprite shown while a station is dragged
+    CATEGORY_UTILITY
+} IngredientCategory;
+
+// Per-frame state, kept small and contiguous; constant data lives in ingredientInfo
 typedef struct {
     Texture2D texture;
     bool canChangeCupTexture;
     Vector2 position;
-    Vector2 originalPosition;
     Rectangle frameRectangle;
-    int totalFrames;
     int currentFrame; // not use right now but later
+    const HitMask* hitMask;
+    IngredientId id;
 } Ingredient;
 
 // Ingredients
-Ingredient teaPowder, cocoaPowder, normalMilk, condensedMilk, marshMellow, whippedCream, caramelSauce, chocolateSauce, hotWater;
-Ingredient greenChon, cocoaChon;
-
-Ingredient trashCan;
+Ingredient ingredients[INGREDIENT_COUNT];
+Texture2D ingredientTextures[INGREDIENT_COUNT];
+HitMask ingredientHitMasks[INGREDIENT_COUNT];
 
 // Cup
 typedef struct {
@@ -375,1735 +1143,4457 @@ typedef struct {
     enum IngredientType toppingType;
     enum IngredientType sauceType;
     bool active;
-    char* order[20];
+    Recipe recipe;
 } Cup;
 
-// Drop area
+// Simulated barista, walks an order slot by slot with the autoplayer's gesture timings
 typedef struct {
-    /* data */
-    Texture2D texture;
-    Vector2 position;
-} DropArea;
+    float speed;
+    float errorRate;
+    int customer;
+    unsigned int generation;
+    int step;                               // 0 fetches a cup, 1-5 are the recipe slots, 6 hands it over
+    Cup cup;                                // Filled and served through the game's own cup and validation code
+} SimBarista;
 
-DropArea plate;
+typedef struct {
+    int served;
+    int wrong;
+    int timeouts;
+} ShiftStats;
 
-// Original position
-const Vector2 oricupPosition = { 351,109 };
-const Vector2 oriwaterPosition = { 600, 210 };
+// Everything a shift mutates, the core steps it without drawing so simulated shifts can run on worker threads
+typedef struct {
+    CustomerPool customers;
+    TimerHeap timers;
+    RandomStream* random;                   // The on-screen shift draws from the session streams
+    RandomStream ownRandom[RANDOM_STREAM_COUNT];
+    Difficulty difficulty;
+    int score;
+    ShiftStats stats;
 
-const Vector2 oricaramelPosition = { -770,108 };
-const Vector2 orichocolatePosition = { -904,138 };
-const Vector2 oriteapowderPosition = { -421,145 };
-const Vector2 oricocoapowderPosition = { -564,177 };
-const Vector2 oriplatePosition = { -175,300 };
-const Vector2 oriplateCupPosition = { -28, 300 };
-const Vector2 oricondensedmilkPosition = { 283,316 };
-const Vector2 orimilkPosition = { 160,342 };
-const Vector2 orimarshmellowPosition = { -481,320 };
-const Vector2 oriwhippedPosition = { -644,320 };
-const Vector2 oricupsPostion = { 390,80 };
-const Vector2 hiddenPosition = { -3000, -3000 };
-Vector2 trashCanPosition = { 0, 0 };
+    // Boiler, heating for 3 seconds makes it ready to pour
+    bool boilerHeating;
+    bool boilerReady;
+    unsigned int boilerGeneration;
 
-static int global_score = 0;
+    bool simulated;                         // No sounds, logs or sprites, the barista plays instead
+    SimBarista barista;
+} Shift;
 
-bool triggerHotWater = false;
-double boilingTime = 2.5;
-double lastBoongBoongBoongTime = 0;
-bool dragAndDropLocked = false;
+Shift gameShift;
 
-void UnloadGlobalAssets();
-void ExitApplication()
+// Every valid recipe has a cup texture, everything else maps to the empty cup
+Texture2D recipeTextures[MAX_RECIPE_TEXTURES];
+int recipeTextureCount = 0;
+unsigned char recipeTextureIndex[RECIPE_TABLE_SIZE];
+char recipeNames[RECIPE_TABLE_SIZE][16];
+
+// Order bubble icons, built once per recipe
+typedef struct {
+    Ingredient* ingredient;
+    Vector2 offset;
+    bool wholeTexture;      // Chon icons are drawn whole at half size, the rest use their current frame
+} RecipeIcon;
+
+typedef struct {
+    int count;
+    RecipeIcon icons[MAX_RECIPE_ICONS];
+} RecipeIconList;
+
+RecipeIconList recipeIcons[RECIPE_TABLE_SIZE];
+
+// Ingredient types come in pairs per slot, e.g. GREEN_TEA/COCOA, CONDENSED_MILK/MILK
+int RecipeSlotFromIngredient(enum IngredientType type)
 {
-    UnloadGlobalAssets();
-    exit(0);
+    return type == NONE ? 0 : ((type - 1) % 2) + 1;
 }
 
-void boilWater(Ingredient* item) {
-    if (!item->canChangeCupTexture) {
-        triggerHotWater = true;
-        boilingTime = GetTime();
-    }
+Recipe MakeRecipe(enum IngredientType powder, bool water, enum IngredientType creamer, enum IngredientType topping, enum IngredientType sauce)
+{
+    return (Recipe)((RecipeSlotFromIngredient(powder) << RECIPE_POWDER_SHIFT) |
+        ((water ? 1 : 0) << RECIPE_WATER_SHIFT) |
+        (RecipeSlotFromIngredient(creamer) << RECIPE_CREAMER_SHIFT) |
+        (RecipeSlotFromIngredient(topping) << RECIPE_TOPPING_SHIFT) |
+        (RecipeSlotFromIngredient(sauce) << RECIPE_SAUCE_SHIFT));
 }
 
-void PlaySoundFx(SoundFxType type);
-void RemoveCustomer(Customer* customer);
-bool validiator(Customer* customer, char* order);
-Texture2D* DragAndDropCup(Cup* cup, const DropArea* dropArea, Camera2D* camera, Customers *customers, Ingredient* trashCan)
+const char* RecipeName(Recipe recipe)
 {
-    static bool isObjectBeingDragged = false;
-    static Texture2D* current_dragging = NULL;
-    static float offsetX = 0;
-    static float offsetY = 0;
+    return recipeNames[recipe % RECIPE_TABLE_SIZE];
+}
 
-    Rectangle objectBounds = { cup->position.x, cup->position.y, (float)cup->frameRectangle.width, (float)cup->frameRectangle.height };
-    Rectangle dropBounds = { dropArea->position.x, dropArea->position.y, (float)dropArea->texture.width, (float)dropArea->texture.height };
+Texture2D RecipeTexture(Recipe recipe)
+{
+    return recipeTextures[recipeTextureIndex[recipe % RECIPE_TABLE_SIZE]];
+}
 
-    if (IsMouseButtonDown(MOUSE_LEFT_BUTTON)) {
-        Vector2 mousePos = GetScreenToWorld2D(GetMousePosition(), *camera);
+void AddRecipeIcon(RecipeIconList* list, Ingredient* ingredient, Vector2 offset, bool wholeTexture)
+{
+    list->icons[list->count++] = (RecipeIcon){ ingredient, offset, wholeTexture };
+}
 
-        Rectangle trashCanBond = { trashCan->position.x, trashCan->position.y, trashCan->frameRectangle.width, trashCan->frameRectangle.height };
-        LogDebug("trashCanPosition.x: %f, trashCanPosition.y: %f, trashCanTexture.width: %d, trashCanTexture.height: %d\n", trashCanPosition.x, trashCanPosition.y, trashCanTexture.width, trashCanTexture.height);
-        Rectangle cupBond = { cup->position.x, cup->position.y, cup->texture.width, cup->texture.height };
-        LogDebug("Cup Positon x: %f, y: %f, cupTexture.width: %d, cupTexture.height: %d\n", cup->position.x, cup->position.y, cup->texture.width, cup->texture.height);
-        LogDebug("CheckCollisionRecs(trashCanBond, cupBond) %d\n", CheckCollisionRecs(trashCanBond, cupBond));
-        if(CheckCollisionRecs(trashCanBond, cupBond)){
-            cup->powderType = NONE;
-            cup->creamerType = NONE;
-            cup->toppingType = NONE;
-            cup->sauceType = NONE;
-            cup->hasWater = false;
-            cup->active = false;
+// Walks every combination the cup can reach, following the {POWDER}{Y/N}{CREAMER}{TOPPING}{SAUCE}.png naming
+// Without textures only the names and indices are built, enough for the simulation
+void LoadRecipeTables(bool loadTextures)
+{
+    static const char* powderCodes[] = { "", "GP", "CP" };
+    static const char* creamerCodes[] = { "", "CM", "MI" };
+    static const char* toppingCodes[] = { "", "MA", "WC" };
+    static const char* sauceCodes[] = { "", "CA", "CH" };
+    Ingredient* powderIcons[] = { NULL, &ingredients[INGREDIENT_GREEN_CHON], &ingredients[INGREDIENT_COCOA_CHON] };
+    Ingredient* creamerIcons[] = { NULL, &ingredients[INGREDIENT_CONDENSED_MILK], &ingredients[INGREDIENT_NORMAL_MILK] };
+    Ingredient* toppingIcons[] = { NULL, &ingredients[INGREDIENT_MARSHMELLOW], &ingredients[INGREDIENT_WHIPPED_CREAM] };
+    Ingredient* sauceIcons[] = { NULL, &ingredients[INGREDIENT_CARAMEL_SAUCE], &ingredients[INGREDIENT_CHOCOLATE_SAUCE] };
+
+    memset(recipeTextureIndex, 0, sizeof(recipeTextureIndex));
+    memset(recipeIcons, 0, sizeof(recipeIcons));
+
+    // Index 0 is the empty cup, every cup combination shares its silhouette for picking
+    if (loadTextures)
+        recipeTextures[0] = LoadTextureWithHitMask(ASSETS_PATH"combination/EMPTY.png", &cupHitMask);
+    recipeTextureCount = 1;
+    for (int i = 0; i < RECIPE_TABLE_SIZE; i++)
+        strcpy(recipeNames[i], "EMPTY");
+
+    for (int powder = 1; powder <= 2; powder++) {
+        for (int water = 0; water <= 1; water++) {
+            for (int creamer = 0; creamer <= (water ? 2 : 0); creamer++) {
+                for (int topping = 0; topping <= (creamer ? 2 : 0); topping++) {
+                    for (int sauce = 0; sauce <= (topping ? 2 : 0); sauce++) {
+                        Recipe recipe = (Recipe)((powder << RECIPE_POWDER_SHIFT) | (water << RECIPE_WATER_SHIFT) |
+                            (creamer << RECIPE_CREAMER_SHIFT) | (topping << RECIPE_TOPPING_SHIFT) | (sauce << RECIPE_SAUCE_SHIFT));
+                        RecipeIconList* icons = &recipeIcons[recipe];
+
+                        snprintf(recipeNames[recipe], sizeof(recipeNames[recipe]), "%s%s%s%s%s", powderCodes[powder], water ? "Y" : "N", creamerCodes[creamer], toppingCodes[topping], sauceCodes[sauce]);
+
+                        recipeTextureIndex[recipe] = (unsigned char)recipeTextureCount;
+                        if (loadTextures)
+                            recipeTextures[recipeTextureCount] = LoadTexture(TextFormat(ASSETS_PATH"combination/%s.png", recipeNames[recipe]));
+                        recipeTextureCount++;
+
+                        AddRecipeIcon(icons, powderIcons[powder], (Vector2) { 375, 100 }, true);
+                        if (creamer) AddRecipeIcon(icons, creamerIcons[creamer], (Vector2) { 425, 100 }, false);
+                        if (topping) AddRecipeIcon(icons, toppingIcons[topping], (Vector2) { 375, 150 }, false);
+                        if (sauce) AddRecipeIcon(icons, sauceIcons[sauce], (Vector2) { 425, 150 }, false);
+                    }
+                }
+            }
         }
-
-        if (cup->active && CheckCollisionPointRec(mousePos, objectBounds) && (current_dragging == NULL || current_dragging == &cup->texture)) {
-            isObjectBeingDragged = true;
-            offsetX = cup->frameRectangle.width / 2;
-            offsetY = cup->frameRectangle.height / 2;
-            float mouseX = mousePos.x;
-            float mouseY = mousePos.y;
-
-            cup->position.x = mouseX - offsetX;
-            cup->position.y = mouseY - offsetY;
-            current_dragging = &cup->texture;
-            return &cup->texture;
-        }
-        // If being drag from cups, then change the cup position to the cursor
-        else if (!cup->active && CheckCollisionPointRec(mousePos, (Rectangle) { oricupsPostion.x, oricupsPostion.y, cup->texture.width, cup->texture.height })) {
-			// Reset cup state            
-            isObjectBeingDragged = true;
-			offsetX = cup->texture.width / 2;
-			offsetY = cup->texture.height / 2;
-			float mouseX = mousePos.x;
-			float mouseY = mousePos.y;
-
-			cup->position.x = mouseX - offsetX;
-			cup->position.y = mouseY - offsetY;
-            cup->texture = LoadTexture(ASSETS_PATH"combination/EMPTY.png");
-			current_dragging = &cup->texture;
-            cup->powderType = NONE;
-            cup->creamerType = NONE;
-            cup->toppingType = NONE;
-            cup->sauceType = NONE;
-            cup->hasWater = false;
-            cup->active = true;
-			return &cup->texture;
-		}
-
     }
+}
 
-    if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
-        isObjectBeingDragged = false;
-        current_dragging = NULL;
-        Vector2 mousePos = GetScreenToWorld2D(GetMousePosition(), *camera);
-
-        Customer* customerToCheck[3] = { &customers->customer1, &customers->customer2, &customers->customer3, };
-
-        
-        Rectangle cupRect = { cup->position.x, cup->position.y, cup->frameRectangle.width, cup->frameRectangle.height };
-
-        // Only check if world mouse position is more than y= 15
-        if (mousePos.y <= 15 && cup->active)
-        {
-            // If cup is being given to customers
-            for (int i = 0; i < 3; i++) {
-                // If customer is visible
-                if (customerToCheck[i]->visible) {
-                    // If cup is being given to customer
-
-                    Rectangle customerRect = { customerToCheck[i]->position.x, customerToCheck[i]->position.y, customersImageData[i].happy.width / 2, customersImageData[i].happy.height / 2 };
-
-                if (cupRect.x >= customerRect.x &&
-                    cupRect.y >= customerRect.y &&
-                    (cupRect.x + cupRect.width) <= (customerRect.x + customerRect.width) &&
-                    (cupRect.y + cupRect.height) <= (customerRect.y + customerRect.height))
-                {
-                        bool correct = validiator(customerToCheck[i], cup->order);
-                        if (correct)
-                        {
-                            global_score += 50;
-                            PlaySoundFx(FX_CORRECT);
-
-                            customerToCheck[i]->visible = false;
-                            RemoveCustomer(customerToCheck[i]);
-                        }
-                        else
-                        {
-                            global_score -= 50;
-                            PlaySoundFx(FX_CONFUSED);
-                        }
-
-                        // Reset cup state
-                        cup->texture = LoadTexture(ASSETS_PATH"combination/EMPTY.png");
-                        cup->powderType = NONE;
-                        cup->creamerType = NONE;
-                        cup->toppingType = NONE;
-                        cup->sauceType = NONE;
-                        cup->hasWater = false;
-                        cup->active = false;
-                        return &cup->texture;
-                    }
-                }
-            }
-        }
-
+void UnloadRecipeTables()
+{
+    for (int i = 0; i < recipeTextureCount; i++)
+        UnloadTexture(recipeTextures[i]);
+    recipeTextureCount = 0;
+}
 
-        // Return cup to the drop area if it is not inside the drop area
-        int offset_x = 10;
-        int offset_y = -40;
+// Recipe catalog, per-difficulty order weights read from a data file
+#define MAX_CATALOG_RECIPES 64
+#define RECIPE_MIX_COUNT 3
+#define RECIPE_CATALOG_FILE ASSETS_PATH"data/recipes.txt"
 
-        cup->position.x = dropArea->position.x + offset_x + dropArea->texture.width / 2 - cup->frameRectangle.width / 2;
-        cup->position.y = dropArea->position.y + offset_y + dropArea->texture.height / 2 - cup->frameRectangle.height / 2;
+// Each mix keeps a Walker alias table, so an order costs one table lookup and one coin flip
+typedef struct {
+    int count;
+    Recipe recipes[MAX_CATALOG_RECIPES];
+    float weights[RECIPE_MIX_COUNT][MAX_CATALOG_RECIPES];
+    float probability[RECIPE_MIX_COUNT][MAX_CATALOG_RECIPES];
+    unsigned char alias[RECIPE_MIX_COUNT][MAX_CATALOG_RECIPES];
+} RecipeCatalog;
 
-        //if (CheckCollisionRecs(objectBounds, dropBounds)) {
-            // center of cup to center of drop area
-       
-       // }
-       //else {
-            //cup->position.x = cup->originalPosition.x;
-            //cup->position.y = cup->originalPosition.y;
-       // }
+RecipeCatalog recipeCatalog;
 
+int RecipeMixFromDifficulty(Difficulty difficulty)
+{
+    switch (difficulty)
+    {
+    case MEDIUM:
+    case FREEPLAY_MEDIUM:
+        return 1;
+    case HARD:
+    case FREEPLAY_HARD:
+        return 2;
+    default:
+        return 0;
     }
+}
 
-    // Apply drag-and-drop with time-dependent positioning
-    if (isObjectBeingDragged) {
-        Vector2 mousePos = GetScreenToWorld2D(GetMousePosition(), *camera);
-        cup->position.x = mousePos.x - offsetX;
-        cup->position.y = mousePos.y - offsetY;
+Recipe RecipeFromName(const char* name)
+{
+    for (int i = 0; i < RECIPE_TABLE_SIZE; i++)
+    {
+        if (recipeTextureIndex[i] != 0 && strcmp(recipeNames[i], name) == 0)
+            return (Recipe)i;
     }
-
-    if(current_dragging)
-        return current_dragging;
-    else
-        return NULL;
-
+    return RECIPE_EMPTY;
 }
 
-void UpdateCupImage(Cup* cup, Ingredient* ingredient) {
-    // Check what type of ingredient it is and update the cup accordingly
-    // if (ingredient == &teaPowder) {
-    //     cup->hasPowder = true;
-    //     cup->texture = LoadTexture(ASSETS_PATH"/combination/milktea.png"); // Change to the tea cup texture
-    // } else if (ingredient == &cocoaPowder) {
-    //     cup->hasPowder = true;
-    //     cup->texture = LoadTexture(ASSETS_PATH"/combination/milkcocoa.png"); // Change to the cocoa cup texture
-    // }
+void BuildRecipeAliasTable(RecipeCatalog* catalog, int mix)
+{
+    int small[MAX_CATALOG_RECIPES], large[MAX_CATALOG_RECIPES];
+    int smallCount = 0, largeCount = 0;
+    float scaled[MAX_CATALOG_RECIPES];
+    float total = 0;
 
-    // this is a naming standard for combination
-    // {POWDER}{CREAMER}{TOPPING}{SAUCE}.png
+    for (int i = 0; i < catalog->count; i++)
+        total += catalog->weights[mix][i];
 
-    // POWDER:
-    // -Cocoa Powder: CP
-    // -Green Tea Powder: GP
+    // A mix with nothing in it orders every recipe equally rather than nothing at all
+    if (total <= 0)
+    {
+        Log(LOG_WARNING, "Recipe mix %d has no weights, using an even mix", mix);
+        for (int i = 0; i < catalog->count; i++)
+            catalog->weights[mix][i] = 1;
+        total = (float)catalog->count;
+    }
 
-    // WATER:
-    // -Yes: Y
-    // -No: N
+    for (int i = 0; i < catalog->count; i++)
+    {
+        scaled[i] = catalog->weights[mix][i] * catalog->count / total;
+        if (scaled[i] < 1.0f) small[smallCount++] = i;
+        else large[largeCount++] = i;
+    }
 
-    // CREAMER:
-    // -Condensed Milk: CM
-    // -Milk: MI
+    while (smallCount > 0 && largeCount > 0)
+    {
+        int less = small[--smallCount];
+        int more = large[--largeCount];
 
-    // TOPPING:
-    // -Marshmallow: MA
-    // -Whipped Cream: WC
+        catalog->probability[mix][less] = scaled[less];
+        catalog->alias[mix][less] = (unsigned char)more;
 
-    // SAUCE:
-    // -Caramel: CA
-    // -Chocolate: CH
+        scaled[more] = (scaled[more] + scaled[less]) - 1.0f;
+        if (scaled[more] < 1.0f) small[smallCount++] = more;
+        else large[largeCount++] = more;
+    }
 
-    LogDebug("update CUP IMAGE \n");
-    char filename[100];
+    // Whatever is left is full up to rounding
+    while (largeCount > 0)
+        catalog->probability[mix][large[--largeCount]] = 1.0f;
+    while (smallCount > 0)
+        catalog->probability[mix][small[--smallCount]] = 1.0f;
+}
 
-    // Initialize filename to empty string
-    strcpy(filename, "");
+// Without a data file every finished drink is ordered equally often
+void LoadDefaultRecipeCatalog(RecipeCatalog* catalog)
+{
+    memset(catalog, 0, sizeof(RecipeCatalog));
 
-    switch (cup->powderType)
+    for (int i = 0; i < RECIPE_TABLE_SIZE && catalog->count < MAX_CATALOG_RECIPES; i++)
     {
-    case GREEN_TEA:
-        // cup->texture = LoadTexture(ASSETS_PATH"/combination/milktea.png"); // Change to the tea cup texture
-        strcat(filename, "GP");
-        break;
-    case COCOA:
-        // cup->texture = LoadTexture(ASSETS_PATH"/combination/milkcocoa.png"); // Change to the cocoa cup texture
-        strcat(filename, "CP");
-        break;
-    default:
-        break;
+        if (recipeTextureIndex[i] != 0 && (i & (1 << RECIPE_WATER_SHIFT)))
+            catalog->recipes[catalog->count++] = (Recipe)i;
     }
 
-    if (cup->powderType != NONE) {
-        switch (cup->hasWater)
-        {
-        case true:
-            strcat(filename, "Y");
-            break;
-        case false:
-            strcat(filename, "N");
-            break;
-        default:
-            break;
-        }
-    }
-    if (cup->hasWater == true) {
-        switch (cup->creamerType)
-        {
-        case CONDENSED_MILK:
-            strcat(filename, "CM");
-            break;
-        case MILK:
-            strcat(filename, "MI");
-            break;
-        default:
-            break;
-        }
-    }
+    for (int mix = 0; mix < RECIPE_MIX_COUNT; mix++)
+        BuildRecipeAliasTable(catalog, mix);
+}
 
-    if (cup->creamerType != NONE) {
-        switch (cup->toppingType)
-        {
-        case MARSHMELLOW:
-            strcat(filename, "MA");
-            break;
-        case WHIPPED_CREAM:
-            strcat(filename, "WC");
-            break;
-        default:
-            break;
-        }
+// Lines are NAME EASY MEDIUM HARD, # starts a comment
+bool LoadRecipeCatalog(RecipeCatalog* catalog, const char* fileName)
+{
+    char* text = LoadFileText(fileName);
+    if (text == NULL)
+    {
+        Log(LOG_WARNING, "Could not read recipe catalog %s", fileName);
+        return false;
     }
 
-    if (cup->toppingType != NONE) {
-        switch (cup->sauceType)
-        {
-        case CARAMEL:
-            strcat(filename, "CA");
-            break;
-        case CHOCOLATE:
-            strcat(filename, "CH");
-            break;
-        default:
-            break;
-        }
-    }
-    // if empty then set filename to EMPTY
-    if (strcmp(filename, "") == 0) {
-        strcat(filename, "EMPTY");
-    }
+    RecipeCatalog loaded = { 0 };
+    int lineNumber = 0;
 
-    // Save filename to cup->order
-    strcpy(cup->order, filename);
+    for (char* line = text; line != NULL && *line != '\0'; )
+    {
+        char* next = strchr(line, '\n');
+        if (next != NULL) *next++ = '\0';
+        lineNumber++;
 
-    strcat(filename, ".png");
-    char path[1000];
-    strcpy(path, ASSETS_PATH"combination/");
-    strcat(path, filename);
-    // set cup texture to the filename
-    LogDebug("Powder type: %d, Water: %d, Creamer: %d, Topping: %d, Sauce: %d\n", cup->powderType, cup->hasWater, cup->creamerType, cup->toppingType, cup->sauceType);
-    LogDebug("NEW CUP IMAGE IS %s\n", path);
+        char name[16];
+        float easy, medium, hard;
 
-    cup->texture = LoadTexture(path);
-}
+        if (line[0] != '#' && sscanf(line, " %15s %f %f %f", name, &easy, &medium, &hard) == 4)
+        {
+            Recipe recipe = RecipeFromName(name);
 
-void UpdateCup(Cup* cup, Ingredient* ingredient) {
-    // If cup is not active, return
-    if (!cup->active) return;
+            if (recipe == RECIPE_EMPTY)
+                Log(LOG_WARNING, "Unknown recipe %s on line %d of %s", name, lineNumber, fileName);
+            else if (loaded.count >= MAX_CATALOG_RECIPES)
+                Log(LOG_WARNING, "Recipe catalog %s is full, ignoring %s", fileName, name);
+            else
+            {
+                loaded.recipes[loaded.count] = recipe;
+                loaded.weights[0][loaded.count] = easy > 0 ? easy : 0;
+                loaded.weights[1][loaded.count] = medium > 0 ? medium : 0;
+                loaded.weights[2][loaded.count] = hard > 0 ? hard : 0;
+                loaded.count++;
+            }
+        }
 
-    // Check what type of ingredient it is and update the cup accordingly
-    if (ingredient == &teaPowder && cup->powderType == NONE) {
-        cup->powderType = GREEN_TEA;
-    }
-    else if (ingredient == &cocoaPowder && cup->powderType == NONE) {
-        cup->powderType = COCOA;
+        line = next;
     }
-    else if (ingredient == &hotWater && cup->powderType != NONE) {
-        cup->hasWater = true;
 
-        PlaySoundFx(FX_POUR);
-        PlaySoundFx(FX_STIR);
-    }
-    else if (ingredient == &condensedMilk && cup->hasWater == true && cup->creamerType == NONE) {
-        cup->creamerType = CONDENSED_MILK;
-    }
-    else if (ingredient == &normalMilk && cup->hasWater == true && cup->creamerType == NONE) {
-        cup->creamerType = MILK;
-        PlaySoundFx(FX_POUR);
-    }
-    else if (ingredient == &marshMellow && cup->creamerType != NONE && cup->toppingType == NONE) {
-        cup->toppingType = MARSHMELLOW;
-    }
-    else if (ingredient == &whippedCream && cup->creamerType != NONE && cup->toppingType == NONE) {
-        cup->toppingType = WHIPPED_CREAM;
-    }
-    else if (ingredient == &caramelSauce && cup->toppingType != NONE && cup->sauceType == NONE) {
-        cup->sauceType = CARAMEL;
-        PlaySoundFx(FX_BOTTLE);
-    }
-    else if (ingredient == &chocolateSauce && cup->toppingType != NONE && cup->sauceType == NONE) {
-        cup->sauceType = CHOCOLATE;
-        PlaySoundFx(FX_BOTTLE);
+    UnloadFileText(text);
+
+    if (loaded.count == 0)
+    {
+        Log(LOG_WARNING, "Recipe catalog %s has no recipes", fileName);
+        return false;
     }
-    UpdateCupImage(cup, ingredient);
 
+    for (int mix = 0; mix < RECIPE_MIX_COUNT; mix++)
+        BuildRecipeAliasTable(&loaded, mix);
+
+    *catalog = loaded;
+    Log(LOG_INFO, "Loaded %d recipes from %s", catalog->count, fileName);
+    return true;
 }
 
-Texture2D* DragAndDropIngredient(Ingredient* object, Cup* cup, Camera2D* camera) {
-    static bool isObjectBeingDragged = false;
-    static Texture2D* current_dragging = NULL;
-    static float offsetX = 0;
-    static float offsetY = 0;
+Recipe SampleRecipeCatalog(const RecipeCatalog* catalog, int mix, RandomStream* random)
+{
+    if (catalog->count == 0) return RECIPE_EMPTY;
+
+    int column = NextRandomInt(random, 0, catalog->count - 1);
+    if (NextRandomDouble(random, 0.0, 1.0) < catalog->probability[mix][column])
+        return catalog->recipes[column];
+    return catalog->recipes[catalog->alias[mix][column]];
+}
 
-    Rectangle objectBounds = { object->position.x, object->position.y, (float)object->frameRectangle.width, (float)object->frameRectangle.height };
-    Rectangle cupBounds = { cup->position.x, cup->position.y, (float)cup->texture.width, (float)cup->texture.height };
+// Drop area
+typedef struct {
+    /* data */
+    Texture2D texture;
+    Vector2 position;
+} DropArea;
 
-    if (IsMouseButtonDown(MOUSE_LEFT_BUTTON)) {
-        Vector2 mousePos = GetScreenToWorld2D(GetMousePosition(), *camera);
-        if (CheckCollisionPointRec(mousePos, objectBounds) && (current_dragging == NULL || current_dragging == &object->texture)) {
+DropArea plate;
 
-            if (object == &hotWater && object->canChangeCupTexture == false) {
-                object->canChangeCupTexture = false;
-                PlaySoundFx(FX_FLICK);
-                boilWater(object);
-            }
+// Drag and drop
+#define MAX_DRAG_POINTERS 8
 
-            else
-            {
-                isObjectBeingDragged = true;
-                offsetX = object->frameRectangle.width / 2;
-                offsetY = object->frameRectangle.height / 2;
-                float mouseX = mousePos.x;
-                float mouseY = mousePos.y;
-
-                object->position.x = mouseX - offsetX;
-                object->position.y = mouseY - offsetY;
-                current_dragging = &object->texture;
-                return &object->texture;
-            }
-        }
-    }
+typedef enum {
+    DRAG_NONE,
+    DRAG_INGREDIENT,
+    DRAG_CUP,
+    DRAG_BLOCKED
+} DragKind;
 
-    if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
-        isObjectBeingDragged = false;
-        current_dragging = NULL;
+// Dragable ingredient, popObject is what follows the pointer when the ingredient itself stays put
+typedef struct {
+    Ingredient* ingredient;
+    Ingredient* popObject;
+    int z;
+} DragSource;
 
-        if (CheckCollisionRecs(objectBounds, cupBounds)) {
-            if (object->canChangeCupTexture) {
+// Drag state of a single mouse or touch pointer
+typedef struct {
+    bool active;
+    int id;
+    Vector2 position;
+    DragKind kind;
+    Ingredient* source;
+    Ingredient* dragged;
+    Cup* cup;
+    Vector2 offset;
+} DragPointer;
 
-                if (object == &hotWater && cup->powderType != NONE) {
-                    triggerHotWater = false;
-                    object->canChangeCupTexture = false;
-                    object->currentFrame = 1;
-                }
+typedef struct {
+    DragPointer pointers[MAX_DRAG_POINTERS];
+    const DragSource* sources;
+    int sourceCount;
+    Cup* cups;
+    int cupCount;
+} DragController;
+
+// Pointer that is currently down, in screen space
+typedef struct {
+    int id;
+    Vector2 position;
+} PointerSample;
 
-                UpdateCup(cup,object);
+// Input sampled once per frame for hover and UI, world positions use a single inverted camera matrix
+typedef struct {
+    Vector2 mouseScreen;
+    Vector2 mouseWorld;
+    bool mouseDown;
+} InputSnapshot;
 
-                object->position.x = object->originalPosition.x;
-                object->position.y = object->originalPosition.y;
-            }
-        }
-        else {
-            // Object is not inside the drop area, return it to the original position
-            object->position.x = object->originalPosition.x;
-            object->position.y = object->originalPosition.y;
-        }
-    }
+// Timestamped pointer events, recorded as the OS delivers them and consumed in order by gameplay
+#define INPUT_QUEUE_CAPACITY 512
 
-    // Apply drag-and-drop with time-dependent positioning
-    if (isObjectBeingDragged) {
-        Vector2 mousePos = GetScreenToWorld2D(GetMousePosition(), *camera);
-        object->position.x = mousePos.x - offsetX;
-        object->position.y = mousePos.y - offsetY;
-    }
+typedef enum {
+    INPUT_EVENT_POINTER_DOWN,
+    INPUT_EVENT_POINTER_MOVE,
+    INPUT_EVENT_POINTER_UP
+} InputEventType;
 
-    if(current_dragging)
-        return current_dragging;
-	else
-        return NULL;
+static inline char* StringFromInputEventTypeEnum(InputEventType type)
+{
+    static const char* strings[] = { "Down", "Move", "Up" };
+    return strings[type];
 }
 
-Texture2D* DragAndDropIngredientPop(Ingredient* object, Ingredient* popObject, Cup* cup, Camera2D* camera) {
-    static bool isObjectBeingDragged = false;
-    static Texture2D* current_dragging = NULL;
-    static float offsetX = 0;
-    static float offsetY = 0;
+typedef struct {
+    InputEventType type;
+    int pointerId;
+    Vector2 position;       // Screen space
+    double time;
+    bool synthetic;
+} InputEvent;
+
+// Ring buffer, the oldest event is overwritten when gameplay falls behind
+typedef struct {
+    InputEvent events[INPUT_QUEUE_CAPACITY];
+    int head;
+    int count;
+    int dropped;
+    int consumedLastFrame;
+} InputQueue;
 
+InputQueue inputQueue = { 0 };
 
-    Rectangle objectBounds = { object->position.x, object->position.y, (float)object->frameRectangle.width, (float)object->frameRectangle.height };
-    Rectangle popObjectBounds = { popObject->position.x, popObject->position.y, (float)popObject->frameRectangle.width, (float)popObject->frameRectangle.height };
-    Rectangle cupBounds = { cup->position.x, cup->position.y, (float)cup->texture.width, (float)cup->texture.height };
+// Pointers seen by the last poll, used to turn polled state into events when callbacks are unavailable
+PointerSample polledPointers[MAX_DRAG_POINTERS];
+int polledPointerCount = 0;
 
-    if (IsMouseButtonDown(MOUSE_LEFT_BUTTON)) {
-        Vector2 mousePos = GetScreenToWorld2D(GetMousePosition(), *camera);
-        if ((CheckCollisionPointRec(mousePos, objectBounds) || CheckCollisionPointRec(mousePos, popObjectBounds)) && (current_dragging == NULL || current_dragging == &object->texture)) {
-            isObjectBeingDragged = true;
-            offsetX = popObject->frameRectangle.width / 2;
-            offsetY = popObject->frameRectangle.height / 2;
-            float mouseX = mousePos.x;
-            float mouseY = mousePos.y;
+// Input-to-frame-end latency probe, rolling average over the frames a dragged object was moved by a queued event
+// The end point is EndDrawing returning, which is after the buffer swap but also after raylib's frame pacing sleep,
+// raylib keeps both inside EndDrawing. Both samples share that sleep, so the gap between them is what late latching saves
+#define LATENCY_PROBE_SAMPLES 120
 
-            popObject->position.x = mouseX - offsetX;
-            popObject->position.y = mouseY - offsetY;
-            current_dragging = &object->texture;
-            return &object->texture;
-        }
-    }
+typedef struct {
+    double eventTime;       // Time stamp of the newest queued event that moved a dragged object this frame, 0 if none
+    double latchedTime;     // Late pointer sample used for the dragged objects
+    bool latched;
+    double early[LATENCY_PROBE_SAMPLES];
+    double late[LATENCY_PROBE_SAMPLES];
+    int count;
+    int next;
+    double earlyAverage;
+    double lateAverage;
+} LatencyProbe;
+
+LatencyProbe latencyProbe = { 0 };
+
+// Spatial hit-test index, a uniform grid over the render area
+#define HIT_GRID_CELL_SIZE 120
+#define HIT_GRID_COLUMNS (BASE_SCREEN_WIDTH / HIT_GRID_CELL_SIZE)
+#define HIT_GRID_ROWS (BASE_SCREEN_HEIGHT / HIT_GRID_CELL_SIZE)
+#define HIT_CELL_CAPACITY 16
+#define MAX_HIT_ENTRIES 64
 
-    if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
-        isObjectBeingDragged = false;
-        current_dragging = NULL;
+typedef enum {
+    HIT_NONE,
+    HIT_INGREDIENT,
+    HIT_CUP,
+    HIT_CUP_STACK,
+    HIT_TRASH
+} HitKind;
 
-        if (CheckCollisionRecs(popObjectBounds, cupBounds)) {
-            if (object->canChangeCupTexture) {
-                UpdateCup(cup,object);
-                popObject->position.x = popObject->originalPosition.x;
-                popObject->position.y = popObject->originalPosition.y;
-            }
-        }
-        else {
-            // Object is not inside the drop area, return it to the original position
-            popObject->position.x = popObject->originalPosition.x;
-            popObject->position.y = popObject->originalPosition.y;
-        }
-    }
+typedef struct {
+    HitKind kind;
+    int z;
+    Rectangle bounds;
+    const HitMask* mask;
+    Rectangle source;
+    Ingredient* ingredient;
+    Ingredient* popObject;
+    Cup* cup;
+} HitEntry;
 
-    // Apply drag-and-drop with time-dependent positioning
-    if (isObjectBeingDragged) {
-        Vector2 mousePos = GetScreenToWorld2D(GetMousePosition(), *camera);
-        popObject->position.x = mousePos.x - offsetX;
-        popObject->position.y = mousePos.y - offsetY;
-    }
+typedef struct {
+    HitEntry entries[MAX_HIT_ENTRIES];
+    int entryCount;
+    unsigned char cells[HIT_GRID_ROWS][HIT_GRID_COLUMNS][HIT_CELL_CAPACITY];
+    unsigned char cellCounts[HIT_GRID_ROWS][HIT_GRID_COLUMNS];
+} HitIndex;
 
-    if(current_dragging)
-	    return current_dragging;
-    else
-        return NULL;
-}
+// Original position
+const Vector2 oricupPosition = { 351,109 };
+const Vector2 oriplatePosition = { -175,300 };
+const Vector2 oriplateCupPosition = { -28, 300 };
+const Vector2 oricupsPostion = { 390,80 };
+const Vector2 hiddenPosition = { -3000, -3000 };
+// Resting spots around the plate, one cup each. The counter has as many cups as there are spots, add one here for another cup
+const Vector2 cupPlateOffsets[] = { { 10, -40 }, { -160, -40 } };
+#define MAX_CUPS (int)(sizeof(cupPlateOffsets) / sizeof(cupPlateOffsets[0]))
+Vector2 trashCanPosition = { 0, 0 };
 
-Rectangle frameRect(Ingredient i, int frameNum, int frameToShow) {
-    int frameWidth = i.texture.width / frameNum;
-    Rectangle frameRect = { frameWidth * (frameToShow - 1), 0, frameWidth, i.texture.height };
-    return frameRect;
+// Constant ingredient data, read on setup and when something is dropped into a cup
+#define MAX_INGREDIENT_FX 2
+#define INGREDIENT_NO_POP -1
+
+typedef struct {
+    const char* name;
+    const char* spritePath;
+    IngredientCategory category;
+    enum IngredientType type;       // Value written into the cup slot
+    int totalFrames;
+    Vector2 originalPosition;
+    bool draggable;
+    bool startsReady;               // Hot water has to boil before it can be poured
+    int popObject;                  // Sprite that follows the pointer instead of the station
+    int z;                          // Pick order, matches the draw order
+    int fxCount;
+    SoundFxType fx[MAX_INGREDIENT_FX];
+} IngredientInfo;
+
+// Adding an ingredient: an id above, an entry here and its combination textures
+const IngredientInfo ingredientInfo[INGREDIENT_COUNT] = {
+    [INGREDIENT_TRASH_CAN] = { "Trash can", ASSETS_PATH"spritesheets/TRASHCAN.png", CATEGORY_UTILITY, NONE, 2, { 0, 0 }, false, false, INGREDIENT_NO_POP, 0, 0, { 0 } },
+    [INGREDIENT_HOT_WATER] = { "Hot water", ASSETS_PATH"spritesheets/GAR.png", CATEGORY_WATER, NONE, 17, { 600, 210 }, true, false, INGREDIENT_NO_POP, 1, 2, { FX_POUR, FX_STIR } },
+    [INGREDIENT_CONDENSED_MILK] = { "Condensed milk", ASSETS_PATH"spritesheets/CM.png", CATEGORY_CREAMER, CONDENSED_MILK, 2, { 283, 316 }, true, true, INGREDIENT_NO_POP, 2, 0, { 0 } },
+    [INGREDIENT_NORMAL_MILK] = { "Milk", ASSETS_PATH"spritesheets/MI.png", CATEGORY_CREAMER, MILK, 2, { 160, 342 }, true, true, INGREDIENT_NO_POP, 3, 1, { FX_POUR } },
+    [INGREDIENT_COCOA_POWDER] = { "Cocoa powder", ASSETS_PATH"spritesheets/CP.png", CATEGORY_POWDER, COCOA, 3, { -564, 177 }, true, true, INGREDIENT_COCOA_CHON, 5, 0, { 0 } },
+    [INGREDIENT_TEA_POWDER] = { "Green tea powder", ASSETS_PATH"spritesheets/GP.png", CATEGORY_POWDER, GREEN_TEA, 3, { -421, 145 }, true, true, INGREDIENT_GREEN_CHON, 6, 0, { 0 } },
+    [INGREDIENT_CHOCOLATE_SAUCE] = { "Chocolate sauce", ASSETS_PATH"spritesheets/CH.png", CATEGORY_SAUCE, CHOCOLATE, 3, { -904, 138 }, true, true, INGREDIENT_NO_POP, 7, 1, { FX_BOTTLE } },
+    [INGREDIENT_CARAMEL_SAUCE] = { "Caramel sauce", ASSETS_PATH"spritesheets/CA.png", CATEGORY_SAUCE, CARAMEL, 3, { -770, 108 }, true, true, INGREDIENT_NO_POP, 8, 1, { FX_BOTTLE } },
+    [INGREDIENT_MARSHMELLOW] = { "Marshmallow", ASSETS_PATH"spritesheets/MA.png", CATEGORY_TOPPING, MARSHMELLOW, 2, { -481, 320 }, true, true, INGREDIENT_NO_POP, 9, 0, { 0 } },
+    [INGREDIENT_WHIPPED_CREAM] = { "Whipped cream", ASSETS_PATH"spritesheets/WC.png", CATEGORY_TOPPING, WHIPPED_CREAM, 2, { -644, 320 }, true, true, INGREDIENT_NO_POP, 10, 0, { 0 } },
+    [INGREDIENT_GREEN_CHON] = { "Green tea scoop", ASSETS_PATH"spritesheets/greenchon.png", CATEGORY_DRAGGED, NONE, 1, { -3000, -3000 }, false, false, INGREDIENT_NO_POP, 11, 0, { 0 } },
+    [INGREDIENT_COCOA_CHON] = { "Cocoa scoop", ASSETS_PATH"spritesheets/cocoachon.png", CATEGORY_DRAGGED, NONE, 1, { -3000, -3000 }, false, false, INGREDIENT_NO_POP, 12, 0, { 0 } },
+};
+
+// Where a station sits while nothing holds it, the trash can follows the runtime base position
+Vector2 IngredientRestPosition(IngredientId id)
+{
+    return id == INGREDIENT_TRASH_CAN ? trashCanPosition : ingredientInfo[id].originalPosition;
 }
 
-Rectangle frameRectCup(Cup i, int frameNum, int frameToShow) {
-    int frameWidth = i.texture.width / frameNum;
-    Rectangle frameRect = { frameWidth * (frameToShow - 1), 0, frameWidth, i.texture.height };
-    return frameRect;
+// Scenes never call each other, they ask for the next one and RunScenes switches once the frame is presented
+typedef enum {
+    SCENE_NONE = 0,
+    SCENE_SPLASH,
+    SCENE_MENU,
+    SCENE_OPTIONS,
+    SCENE_GAME,
+    SCENE_ENDGAME,
+    SCENE_STRESS,
+    SCENE_COUNT
+} SceneId;
+
+static inline char* StringFromSceneIdEnum(SceneId scene)
+{
+    static const char* strings[] = { "None", "Splash", "Menu", "Options", "Game", "Endgame", "Stress" };
+    return strings[scene];
 }
 
-void tickBoil(Ingredient* boiler) {
+// Every hook but draw may be NULL, the splash only runs a task
+typedef struct {
+    void (*enter)(Camera2D* camera);
+    void (*update)(Camera2D* camera, double deltaTime);
+    void (*draw)(Camera2D* camera, double deltaTime);
+    void (*presented)(Camera2D* camera, double deltaTime);     // After EndDrawing, for work that has to see the frame on screen
+    void (*exit)();
+} Scene;
 
-    if (triggerHotWater) {
-        if (boilingTime + 3 > GetTime()) {
-            boiler->currentFrame = boiler->totalFrames;
-            return;
-        }
-        if (lastBoongBoongBoongTime + 0.5 < GetTime()) {
-            StopSound(boongFx);
-            PlaySoundFx(FX_BOONG);
-            boiler->canChangeCupTexture = true;
-            lastBoongBoongBoongTime = GetTime();
-            int nextFrame = boiler->currentFrame + 2;
-            if (nextFrame > boiler->totalFrames) {
-                nextFrame = 1;
-            }
-            boiler->currentFrame = nextFrame;
-        }
-    }
-}
+typedef struct {
+    SceneId current;
+    SceneId previous;
+    SceneId next;
+    double lastFrameTime;
+    bool quit;
+} SceneManager;
 
+SceneManager scenes = { SCENE_NONE, SCENE_NONE, SCENE_NONE, 0, false };
 
-bool highlightItem(Ingredient* item, Camera2D* camera) {
-    Vector2 mousePos = GetScreenToWorld2D(GetMousePosition(), *camera);
-    static bool isHovering;
-    if (CheckCollisionPointRec(mousePos, (Rectangle) { item->position.x, item->position.y, item->frameRectangle.width, item->frameRectangle.height }) && item->totalFrames > item->currentFrame) {
-        item->frameRectangle = frameRect(*item, item->totalFrames, item->currentFrame + 1);
-        return true;
-    }
-    else {
-        item->frameRectangle = frameRect(*item, item->totalFrames, item->currentFrame);
-        return false;
-    }
+// Takes effect after the current frame, the running hook finishes first
+void ChangeScene(SceneId next)
+{
+    scenes.next = next;
 }
 
-// Function prototype
-void MainMenuUpdate(Camera2D* camera, bool playFade);
-void OptionsUpdate(Camera2D* camera);
-void endgameUpdate(Camera2D* camera);
+// Ends the frame loop once the running hook returned, harness runs that finish inside an enter hook use
+// this so the scene is fully entered before teardown exits it
+void QuitScenes()
+{
+    scenes.quit = true;
+}
 
-// Menu customers
-Customer menuCustomer1;
-Customer menuCustomer2;
+// Tasks, stackless coroutines resumed once per frame by RunTasks before the scene update
+// A task function jumps back to its last wait through a switch on task->line, so anything that has to
+// survive a wait lives in task->data, never in a local. Only one TASK_ wait per source line
+#define MAX_TASKS 64
+#define TASK_TIME_SLACK 1e-6            // The clock is a sum of frame deltas, rounding must not hold a wait for one more frame
 
-// Menu falling items
-#define menuFallingItemsNumber 8
-MenuFallingItem menuFallingItems[20];
-GameOptions *options;
+typedef struct Task Task;
+typedef bool (*TaskFunction)(Task* task);       // True once the task is finished
 
-// Moving clouds
-MovingCloud movingClouds[7];
+// Stale once the slot was reused, the same as timers
+typedef struct {
+    int slot;
+    unsigned int generation;
+} TaskHandle;
+
+struct Task {
+    TaskFunction function;                      // NULL for a free slot
+    void* data;
+    int line;                                   // Resume point, 0 starts from the top
+    double wakeTime;
+    unsigned int generation;
+    SceneId owner;                              // Cancelled when this scene exits
+    TaskHandle waitingOn;                       // Resumed in the same frame once this task finishes
+    bool started;                               // Took its first step
+    unsigned int lastPass;                      // The frame this task last ran in
+
+    // Tweens only
+    float* value;
+    float from;
+    float to;
+    double startTime;
+    double duration;
+};
 
-// Moving stars
-MovingStar movingStars[2];
+typedef struct {
+    Task tasks[MAX_TASKS];
+    int highWater;                              // Slots past this were never used, the pass stops there
+    double time;                                // Advanced by the frame delta
+    unsigned int generation;
+    unsigned int pass;                          // Frames run so far
+    int dropped;
+} TaskScheduler;
+
+TaskScheduler taskScheduler;
+
+#define TASK_BEGIN(task) switch ((task)->line) { case 0:
+#define TASK_END(task) } return true
+#define TASK_YIELD(task) do { (task)->line = __LINE__; return false; case __LINE__:; } while (0)
+#define TASK_WAIT_SECONDS(task, seconds) do { (task)->wakeTime = taskScheduler.time + (seconds); (task)->line = __LINE__; case __LINE__: if (taskScheduler.time + TASK_TIME_SLACK < (task)->wakeTime) return false; } while (0)
+#define TASK_WAIT_UNTIL(task, condition) do { (task)->line = __LINE__; case __LINE__: if (!(condition)) return false; } while (0)
+// The loader is called once per frame until it reports everything loaded
+#define TASK_WAIT_LOAD(task, loader) TASK_WAIT_UNTIL(task, (loader)())
+#define TASK_WAIT_TASK(task, handle) do { (task)->waitingOn = (handle); (task)->line = __LINE__; case __LINE__: if (IsTaskRunning((task)->waitingOn)) return false; (task)->waitingOn = (TaskHandle){ 0 }; } while (0)
+
+bool IsTaskRunning(TaskHandle handle)
+{
+    if (handle.slot < 0 || handle.slot >= MAX_TASKS) return false;
+    const Task* task = &taskScheduler.tasks[handle.slot];
+    return task->function != NULL && task->generation == handle.generation;
+}
 
-// Current BGM
-Music* currentBgm = NULL;
-bool isCurrentBgmPaused = false;
+TaskHandle StartTask(TaskFunction function, void* data)
+{
+    for (int i = 0; i < MAX_TASKS; i++)
+    {
+        Task* task = &taskScheduler.tasks[i];
+        if (task->function != NULL) continue;
 
-// Load duration timer
-double loadDurationTimer = 0.0;
-bool isGlobalAssetsLoadFinished = false;
+        // Generation 0 is never handed out, so a zeroed handle is never running
+        if (++taskScheduler.generation == 0) taskScheduler.generation = 1;
 
-// Start from night
-int currentColorIndex = 3;
-float dayNightCycleDuration = 120.0f;
-// Skip to 1/2 of the night, so that the first transition is from night to morning
-float colorTransitionTime = 0.5f;
+        *task = (Task){ .function = function, .data = data, .generation = taskScheduler.generation, .owner = scenes.current };
+        if (i >= taskScheduler.highWater) taskScheduler.highWater = i + 1;
+        return (TaskHandle){ i, task->generation };
+    }
 
+    taskScheduler.dropped++;
+    Log(LOG_WARNING, "Task pool full, dropped a task");
+    return (TaskHandle){ -1, 0 };
+}
 
-void CustomLogger(int msgType, const char* text, va_list args)
+void CancelTask(TaskHandle handle)
 {
-    char timeStr[64] = { 0 };
-    time_t now = time(NULL);
-    struct tm* tm_info = localtime(&now);
-
-    strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", tm_info);
-    printf("[%s] ", timeStr);
-
-    // Calculate the size needed for the formatted log message
-    int logMessageSize = vsnprintf(NULL, 0, text, args) + 1;
-    char* logMessage = (char*)malloc(logMessageSize);
+    if (IsTaskRunning(handle))
+        taskScheduler.tasks[handle.slot].function = NULL;
+}
 
-    switch (msgType)
+void CancelSceneTasks(SceneId owner)
+{
+    for (int i = 0; i < taskScheduler.highWater; i++)
     {
-        case LOG_DEBUG: printf("[DEBUG]: "); break;
-        case LOG_INFO: printf("[INFO] : "); break;
-        case LOG_WARNING: printf("[WARN] : "); break;
-        case LOG_ERROR: printf("[ERROR]: "); break;
-        case LOG_FATAL: printf("[FATAL]: "); break;
-        default: break;
+        if (taskScheduler.tasks[i].owner == owner)
+            taskScheduler.tasks[i].function = NULL;
     }
+}
 
-    // Format the log message and store it in logMessage
-    vsnprintf(logMessage, logMessageSize, text, args);
+bool RunTween(Task* task)
+{
+    double elapsed = taskScheduler.time - task->startTime + TASK_TIME_SLACK;
+    float t = task->duration > 0 ? (float)fmin(elapsed / task->duration, 1.0) : 1.0f;
+    *task->value = task->from + (task->to - task->from) * t;
+    return t >= 1.0f;
+}
 
-    // Add message to the log array, with shifting logic
-    if (DebugLogsIndex == DEBUG_MAX_LOGS_HISTORY) {
-        // If the array is full, shift the previous messages to make space
-        for (int i = 0; i < DEBUG_MAX_LOGS_HISTORY - 1; i++) {
-            DebugLogs[i] = DebugLogs[i + 1];
-        }
-        DebugLogsIndex = DEBUG_MAX_LOGS_HISTORY - 1;
+// Moves value linearly to the target, a dropped tween snaps there so nothing waits on it forever
+TaskHandle TweenFloat(float* value, float to, double duration)
+{
+    TaskHandle handle = StartTask(RunTween, NULL);
+    if (!IsTaskRunning(handle))
+    {
+        *value = to;
+        return handle;
     }
 
-    DebugLogs[DebugLogsIndex].type = msgType;
-    DebugLogs[DebugLogsIndex].text = logMessage;
-    DebugLogsIndex++;
+    Task* task = &taskScheduler.tasks[handle.slot];
+    task->value = value;
+    task->from = *value;
+    task->to = to;
+    task->startTime = taskScheduler.time;
+    task->duration = duration;
+    return handle;
+}
 
-    printf("%s\n", logMessage);
+// A task runs once per frame, again in the same frame when the task it waits on finishes after it ran
+static inline bool IsTaskReady(const Task* task, bool firstStepsOnly)
+{
+    if (task->function == NULL) return false;
+    if (!task->started) return true;
+    if (firstStepsOnly) return false;
+    if (task->lastPass != taskScheduler.pass) return true;
+    return task->waitingOn.generation != 0 && !IsTaskRunning(task->waitingOn);
 }
 
-void LogDebug(const char* text, ...)
+// Sweeps the slots until nothing is left to run, so neither slot order nor a task started from another
+// task delays anything by a frame. Every sweep after the first only picks up tasks that started or got
+// unblocked, and a wait that passes clears itself, so the sweeps end
+void RunTaskSweeps(bool firstStepsOnly)
 {
-    va_list args;
-    va_start(args, text);
-    CustomLogger(LOG_DEBUG, text, args);
-    va_end(args);
-}
-
-void Log(int msgType, const char* text, ...)
-{
-    va_list args;
-    va_start(args, text);
-    CustomLogger(msgType, text, args);
-    va_end(args);
-}
-
-Color GetTextColorFromLogType(TraceLogLevel level)
-{
-	switch (level)
-	{
-    case LOG_DEBUG: return DARKGRAY;
-	case LOG_INFO: return WHITE;
-	case LOG_WARNING: return YELLOW;
-	case LOG_ERROR: return RED;
-    case LOG_FATAL: return ORANGE;
-	default: return WHITE;
-	}
-}
-
-void DrawDragableItemFrame(Ingredient i) {
-    DrawTextureRec(i.texture, i.frameRectangle, i.position, RAYWHITE);
-    if (options->showDebug && debugToolToggles.showObjects)
+    bool ran = true;
+    while (ran)
     {
-        DrawRectangleLinesEx((Rectangle) { i.position.x, i.position.y, i.frameRectangle.width, i.frameRectangle.height }, 1, RED);
-        DrawRectangle(i.position.x, i.position.y - 20, 300, 20, Fade(GRAY, 0.7));
-        DrawTextEx(meowFont, TextFormat("%s | XY %.2f,%.2f", "Ingredient", i.position.x, i.position.y), (Vector2) { i.position.x, i.position.y - 20 }, 20, 1, WHITE);
+        ran = false;
+        for (int i = 0; i < taskScheduler.highWater; i++)
+        {
+            Task* task = &taskScheduler.tasks[i];
+            if (!IsTaskReady(task, firstStepsOnly)) continue;
+
+            task->started = true;
+            task->lastPass = taskScheduler.pass;
+            ran = true;
+            if (task->function(task))
+                task->function = NULL;
+        }
     }
 }
 
-
-void DrawMenuFallingItems(double deltaTime, bool behide)
+void RunTasks(double deltaTime)
 {
-    int startIndex = behide ? 0 : 11;
-    int endIndex = behide ? 11 : 20;
-
-    for (int i = startIndex; i < endIndex; i++) {
-        MenuFallingItem* item = &menuFallingItems[i];
-
-        item->position.y += item->fallingSpeed * deltaTime;
-        item->rotation += item->rotationSpeed * deltaTime;
-
-        Vector2 origin = { (float)menuFallingItemTextures[item->textureIndex].width / 2, (float)menuFallingItemTextures[item->textureIndex].height / 2 };
-        DrawTexturePro(menuFallingItemTextures[item->textureIndex], (Rectangle) { 0, 0, menuFallingItemTextures[item->textureIndex].width, menuFallingItemTextures[item->textureIndex].height },
-            (Rectangle) {
-            item->position.x, item->position.y, menuFallingItemTextures[item->textureIndex].width, menuFallingItemTextures[item->textureIndex].height
-        },
-            origin, item->rotation, WHITE);
-
-        if (options->showDebug && debugToolToggles.showObjects) {
-            Vector2 corners[4];
-            corners[0] = (Vector2){ -origin.x, -origin.y };
-            corners[1] = (Vector2){ -origin.x, origin.y };
-            corners[2] = (Vector2){ origin.x, origin.y };
-            corners[3] = (Vector2){ origin.x, -origin.y };
-
-            for (int j = 0; j < 4; j++) {
-                float tempX = corners[j].x * cos(DEG2RAD * item->rotation) - corners[j].y * sin(DEG2RAD * item->rotation);
-                float tempY = corners[j].x * sin(DEG2RAD * item->rotation) + corners[j].y * cos(DEG2RAD * item->rotation);
-                corners[j].x = tempX + item->position.x;
-                corners[j].y = tempY + item->position.y;
-            }
+    // Tasks started by a scene since the last frame take their first step at the time they were started,
+    // the same as a phase timer that starts counting on the frame it was reset
+    RunTaskSweeps(true);
 
-            DrawLineEx(corners[0], corners[1], 1, RED);
-            DrawLineEx(corners[1], corners[2], 1, RED);
-            DrawLineEx(corners[2], corners[3], 1, RED);
-            DrawLineEx(corners[3], corners[0], 1, RED);
+    taskScheduler.time += deltaTime;
+    taskScheduler.pass++;
+    RunTaskSweeps(false);
 
-            DrawRectangle(item->position.x, item->position.y, 550, 20, Fade(GRAY, 0.7));
-            DrawTextEx(meowFont, TextFormat("%d | XY %.2f,%.2f | R %.2f | G %.2f | Behide %s", i, item->position.x, item->position.y, item->rotation, item->fallingSpeed, behide ? "[Yes]" : "[No]"), (Vector2) { item->position.x, item->position.y }, 20, 1, WHITE);
-        }
-
-        if (item->position.y > baseY + BASE_SCREEN_HEIGHT + 1000) {
-            item->position = (Vector2){ GetRandomDoubleValue(baseX, baseX + BASE_SCREEN_WIDTH - 20), baseY - GetRandomDoubleValue(200, 1000) };
-            item->textureIndex = GetRandomValue(0, menuFallingItemsNumber - 1);
-            item->fallingSpeed = GetRandomDoubleValue(1, 3);
-            item->fallingSpeed *= 100;
-            item->rotation = GetRandomDoubleValue(-360, 360);
-            item->rotationSpeed = GetRandomValue(-3, 3);
-            item->rotationSpeed *= 100;
-            if (abs(item->rotationSpeed) > item->fallingSpeed)
-                item->rotationSpeed = item->fallingSpeed;
-            if (item->rotationSpeed == 0)
-                item->rotationSpeed = 1 * 100;
-        }
-    }
+    while (taskScheduler.highWater > 0 && taskScheduler.tasks[taskScheduler.highWater - 1].function == NULL)
+        taskScheduler.highWater--;
 }
 
-bool IsNight()
+void ExitCurrentScene();
+void UnloadGlobalAssets();
+void CloseSession();
+void LogNullRendererStats();
+void StopLogWriter();
+// Harness modes report failure through the exit code
+int applicationExitCode = 0;
+
+// Teardown in reverse order of startup, runs once whether the window closed or a harness finished
+void ShutdownApplication()
 {
-    return currentColorIndex == 3 && colorTransitionTime < 0.4;
+    ExitCurrentScene();
+    CloseSession();
+    LogNullRendererStats();
+    UnloadGlobalAssets();
+    CloseWindow();
+    StopLogWriter();
 }
 
-void DrawMovingCloudAndStar(double deltaTime)
+void ExitApplication()
 {
-    int cloudCount = sizeof(movingClouds) / sizeof(movingClouds[0]);
-    int starCount = sizeof(movingStars) / sizeof(movingStars[0]);
-
-    if (IsNight())
-    {
+    ShutdownApplication();
+    exit(applicationExitCode);
+}
 
-        for (int i = 0; i < starCount; i++) {
+// Heating takes 3 seconds, pressing again restarts it
+void StartBoiler(Shift* shift)
+{
+    shift->boilerHeating = true;
+    ScheduleTimer(&shift->timers, TIMER_BOILER_BUBBLE, 0, ++shift->boilerGeneration, 3.0);
+}
 
-            MovingStar* cloud = &movingStars[i];
+void boilWater(Ingredient* item) {
+    if (!item->canChangeCupTexture) {
+        item->currentFrame = ingredientInfo[item->id].totalFrames;
+        StartBoiler(&gameShift);
+    }
+}
 
-            bool fromRight = false;
-            bool isInView = cloud->position.x >= baseX && cloud->position.x <= baseX + BASE_SCREEN_WIDTH && cloud->position.y >= baseY && cloud->position.y <= baseY + BASE_SCREEN_HEIGHT;
+void PlaySoundFx(SoundFxType type);
+void RemoveCustomer(Shift* shift, int seat);
+bool validiator(CustomerPool* pool, int customer, Recipe order);
+void UpdateCupImage(Cup* cup, Ingredient* ingredient) {
+    // Check what type of ingredient it is and update the cup accordingly
+    // if (ingredient == &teaPowder) {
+    //     cup->hasPowder = true;
+    //     cup->texture = LoadTexture(ASSETS_PATH"/combination/milktea.png"); // Change to the tea cup texture
+    // } else if (ingredient == &cocoaPowder) {
+    //     cup->hasPowder = true;
+    //     cup->texture = LoadTexture(ASSETS_PATH"/combination/milkcocoa.png"); // Change to the cocoa cup texture
+    // }
 
-            // Calculate the X position based on time and direction
-            if (fromRight) {
-                cloud->position.x -= cloud->speed * deltaTime;
-                // Check if the cloud has moved off the screen
-                if ((float)cloud->position.x + ((float)(cloud->texture.width) * (float)(cloud->scale)) <= baseX) {
-                    cloud->position.x = baseX + BASE_SCREEN_WIDTH + (cloud->texture.width * cloud->scale) + GetRandomDoubleValue(100, 500);
-                }
-            }
-            else {
-                cloud->position.x += cloud->speed * deltaTime;
-                // Check if the cloud has moved off the screen
-                if (cloud->position.x > baseX + BASE_SCREEN_WIDTH) {
-                    cloud->position.x = baseX - (cloud->texture.width * cloud->scale) - GetRandomDoubleValue(100, 500);
-                }
-            }
+    // this is a naming standard for combination
+    // {POWDER}{CREAMER}{TOPPING}{SAUCE}.png
 
-            // Draw the cloud
-            DrawTexture(cloud->texture, cloud->position.x, cloud->position.y, WHITE);
+    // POWDER:
+    // -Cocoa Powder: CP
+    // -Green Tea Powder: GP
 
-            // Debug
-            if (options->showDebug && debugToolToggles.showObjects)
-            {
-                DrawRectangleLinesEx((Rectangle) { cloud->position.x, cloud->position.y, cloud->texture.width* cloud->scale, cloud->texture.height* cloud->scale }, 1, RED);
-                DrawRectangle(cloud->position.x, cloud->position.y - 20, 300, 20, Fade(GRAY, 0.7));
-                DrawTextEx(meowFont, TextFormat("%s | XY %.2f,%.2f | Speed %.2f | Scale %.2f", "Stars", cloud->position.x, cloud->position.y, cloud->speed, cloud->scale), (Vector2) { cloud->position.x, cloud->position.y - 20 }, 20, 1, WHITE);
-            }
-        }
-    }
-    else
-    {
-        for (int i = 0; i < cloudCount; i++) {
-            MovingCloud* cloud = &movingClouds[i];
+    // WATER:
+    // -Yes: Y
+    // -No: N
 
-            bool fromRight = cloud->fromRight;
-            bool isInView = cloud->position.x >= baseX && cloud->position.x <= baseX + BASE_SCREEN_WIDTH && cloud->position.y >= baseY && cloud->position.y <= baseY + BASE_SCREEN_HEIGHT;
+    // CREAMER:
+    // -Condensed Milk: CM
+    // -Milk: MI
 
-            // Calculate the X position based on time and direction
-            if (fromRight) {
-                cloud->position.x -= cloud->speed * deltaTime;
-                // Check if the cloud has moved off the screen
-                if ((float)cloud->position.x + ((float)(cloud->texture.width) * (float)(cloud->scale)) <= baseX) {
-                    cloud->position.x = baseX + BASE_SCREEN_WIDTH + (cloud->texture.width * cloud->scale) + GetRandomDoubleValue(100, 500);
-                    cloud->position.y = GetRandomDoubleValue(baseY, 0);
-                }
-            }
-            else {
-                cloud->position.x += cloud->speed * deltaTime;
-                // Check if the cloud has moved off the screen
-                if (cloud->position.x > baseX + BASE_SCREEN_WIDTH) {
-                    cloud->position.x = baseX - (cloud->texture.width * cloud->scale) - GetRandomDoubleValue(100, 500);
-                    cloud->position.y = GetRandomDoubleValue(baseY, 0);
-                }
-            }
+    // TOPPING:
+    // -Marshmallow: MA
+    // -Whipped Cream: WC
 
-            // Draw the cloud
-            DrawTexture(cloud->texture, cloud->position.x, cloud->position.y, WHITE);
+    // SAUCE:
+    // -Caramel: CA
+    // -Chocolate: CH
 
-            // Debug
-            if (options->showDebug && debugToolToggles.showObjects)
-            {
-                DrawRectangleLinesEx((Rectangle) { cloud->position.x, cloud->position.y, cloud->texture.width* cloud->scale, cloud->texture.height* cloud->scale }, 1, RED);
-                DrawRectangle(cloud->position.x, cloud->position.y - 20, 300, 20, Fade(GRAY, 0.7));
-                DrawTextEx(meowFont, TextFormat("%s | XY %.2f,%.2f | Speed %.2f | Scale %.2f", "Cloud", cloud->position.x, cloud->position.y, cloud->speed, cloud->scale), (Vector2) { cloud->position.x, cloud->position.y - 20 }, 20, 1, WHITE);
-            }
-        }
+    // set cup texture from the preloaded combination
+    LogDebug("Powder type: %d, Water: %d, Creamer: %d, Topping: %d, Sauce: %d", cup->powderType, cup->hasWater, cup->creamerType, cup->toppingType, cup->sauceType);
+    LogDebug("NEW CUP IMAGE IS %s", RecipeName(cup->recipe));
 
-    }
-   
+    cup->texture = RecipeTexture(cup->recipe);
 }
 
-double RandomCustomerTimeoutBasedOnDifficulty()
+// The cup state machine without sounds or sprites, simulated shifts call it from worker threads
+bool AddIngredientToCup(Cup* cup, IngredientId id)
 {
-    switch (options->difficulty)
+    const IngredientInfo* info = &ingredientInfo[id];
+    bool isAdded = false;
+
+    // Each slot can only be filled once the previous one is
+    switch (info->category)
     {
-    case FREEPLAY_EASY:
-    case EASY:
-        return GetRandomDoubleValue(80, 150);
+    case CATEGORY_POWDER:
+        isAdded = cup->powderType == NONE;
+        if (isAdded) cup->powderType = info->type;
         break;
-    case FREEPLAY_MEDIUM:
-    case MEDIUM:
-        return GetRandomDoubleValue(40, 60);
+    case CATEGORY_WATER:
+        isAdded = cup->powderType != NONE;
+        if (isAdded) cup->hasWater = true;
         break;
-    case FREEPLAY_HARD:
-    case HARD:
-        return GetRandomDoubleValue(20, 40);
+    case CATEGORY_CREAMER:
+        isAdded = cup->hasWater == true && cup->creamerType == NONE;
+        if (isAdded) cup->creamerType = info->type;
+        break;
+    case CATEGORY_TOPPING:
+        isAdded = cup->creamerType != NONE && cup->toppingType == NONE;
+        if (isAdded) cup->toppingType = info->type;
+        break;
+    case CATEGORY_SAUCE:
+        isAdded = cup->toppingType != NONE && cup->sauceType == NONE;
+        if (isAdded) cup->sauceType = info->type;
         break;
     default:
-        return GetRandomDoubleValue(80, 150);
         break;
     }
+
+    cup->recipe = MakeRecipe(cup->powderType, cup->hasWater, cup->creamerType, cup->toppingType, cup->sauceType);
+    return isAdded;
 }
 
-void RandomCustomerInitialResetBasedOnDifficulty(double *values) {
+void UpdateCup(Cup* cup, Ingredient* ingredient) {
+    // If cup is not active, return
+    if (!cup->active) return;
 
-    switch (options->difficulty)
-	{
-        case FREEPLAY_EASY:
-        case EASY:
-        	values[0] = GetRandomDoubleValue(4, 6);
-        	values[1] = GetRandomDoubleValue(5, 15);
-        	values[2] = GetRandomDoubleValue(10, 25);
-        	break;
-        case FREEPLAY_MEDIUM:
-        case MEDIUM:
-        	values[0] = GetRandomDoubleValue(2, 6);
-        	values[1] = GetRandomDoubleValue(4, 10);
-        	values[2] = GetRandomDoubleValue(12, 20);
-        	break;
-        case FREEPLAY_HARD:
-        case HARD:
-        	values[0] = GetRandomDoubleValue(2, 4);
-        	values[1] = GetRandomDoubleValue(3, 6);
-        	values[2] = GetRandomDoubleValue(6, 10);
-        	break;
-        default:
-            values[0] = GetRandomDoubleValue(4, 6);
-            values[1] = GetRandomDoubleValue(5, 15);
-            values[2] = GetRandomDoubleValue(10, 25);
-        	break;
+    if (AddIngredientToCup(cup, ingredient->id)) {
+        const IngredientInfo* info = &ingredientInfo[ingredient->id];
+        for (int i = 0; i < info->fxCount; i++)
+            PlaySoundFx(info->fx[i]);
     }
 
+    UpdateCupImage(cup, ingredient);
 
 }
 
+Rectangle frameRect(const Ingredient* i, int frameNum, int frameToShow) {
+    int frameWidth = i->texture.width / frameNum;
+    Rectangle frameRect = { frameWidth * (frameToShow - 1), 0, frameWidth, i->texture.height };
+    return frameRect;
+}
 
-double RandomCustomerResetBasedOnDifficulty()
-{
-    switch (options->difficulty)
-    {
-    case FREEPLAY_EASY:
-    case EASY:
-        return GetRandomDoubleValue(30, 50);
-        break;
-    case FREEPLAY_MEDIUM:
-    case MEDIUM:
-        return GetRandomDoubleValue(15, 30);
-        break;
-    case FREEPLAY_HARD:
-    case HARD:
-        return GetRandomDoubleValue(1, 10);
-        break;
-    default:
-        return GetRandomDoubleValue(30, 50);
-        break;
-    }
+Rectangle frameRectCup(const Cup* i, int frameNum, int frameToShow) {
+    int frameWidth = i->texture.width / frameNum;
+    Rectangle frameRect = { frameWidth * (frameToShow - 1), 0, frameWidth, i->texture.height };
+    return frameRect;
 }
 
-void RandomGenerateOrder(char *order)
+DragController CreateDragController(const DragSource* sources, int sourceCount, Cup* cups, int cupCount)
 {
-    int random = GetRandomValue(0, 2);
-    order[0] = '\0'; // Initialize the string
-
-    //base case, either CP or GP
-    if (GetRandomValue(0, 1))
-        strcat(order, "CP");
-    else
-        strcat(order, "GP");
+    DragController controller = { 0 };
 
-    strcat(order, "Y");
+    controller.sources = sources;
+    controller.sourceCount = sourceCount;
+    controller.cups = cups;
+    controller.cupCount = cupCount;
 
-    // Very very small chance just to order tea without any creamer lol
-    if (GetRandomValue(0, 100) == 0)
-		return;
+    return controller;
+}
 
-    // another base case, either CM or MI
-    if (GetRandomValue(0, 1))
-        strcat(order, "CM");
-    else
-        strcat(order, "MI");
+bool IsDragging(const DragController* controller)
+{
+    for (int i = 0; i < MAX_DRAG_POINTERS; i++) {
+        if (controller->pointers[i].active && controller->pointers[i].kind != DRAG_BLOCKED)
+            return true;
+    }
+    return false;
+}
 
-    bool hasTopping = false;
-    if (random >= 1)
-    {
-        if (GetRandomValue(0, 1))
-        {
-            hasTopping = true;
-            if (GetRandomValue(0, 1))
-                strcat(order, "MA");
-            else
-                strcat(order, "WC");
-        }
+bool IsIngredientHeld(const DragController* controller, const Ingredient* ingredient)
+{
+    for (int i = 0; i < MAX_DRAG_POINTERS; i++) {
+        const DragPointer* pointer = &controller->pointers[i];
+        if (pointer->active && pointer->kind == DRAG_INGREDIENT && pointer->source == ingredient)
+            return true;
     }
-    if (hasTopping && random >= 2)
-    {
-        if (GetRandomValue(0, 1))
-        {
-            if (GetRandomValue(0, 1))
-                strcat(order, "CA");
-            else
-                strcat(order, "CH");
-        }
+    return false;
+}
+
+bool IsCupHeld(const DragController* controller, const Cup* cup)
+{
+    for (int i = 0; i < MAX_DRAG_POINTERS; i++) {
+        const DragPointer* pointer = &controller->pointers[i];
+        if (pointer->active && pointer->kind == DRAG_CUP && pointer->cup == cup)
+            return true;
     }
-    // Log the order
-    LogDebug(TextFormat("New order: %s", order));
+    return false;
 }
 
+// Session record and replay. Every frame is sampled once at its start, the loops read the sample
+// instead of raylib so a replay sees exactly the time, mouse, keys and pointer events of the recording
+#define SESSION_MAGIC 0x524D4D53        // "SMMR"
+#define SESSION_VERSION 1
 
-void DrawCustomer(Customer* customer)
+typedef enum {
+    SESSION_LIVE = 0,
+    SESSION_RECORDING,
+    SESSION_REPLAYING
+} SessionMode;
+
+static inline char* StringFromSessionModeEnum(SessionMode mode)
 {
-    Vector2 pos = customer->position;
-    int frame = customer->textureType;
+    static const char* strings[] = { "Live", "Recording", "Replaying" };
+    return strings[mode];
+}
 
-    if (customer == NULL) return;
+// Keys the game loops poll, a bit each in FrameRecord
+static const int sessionKeys[] = { KEY_F1, KEY_F2, KEY_F3, KEY_F4, KEY_ESCAPE, KEY_ENTER, KEY_LEFT_ALT, KEY_RIGHT_ALT };
+#define SESSION_KEY_COUNT (int)(sizeof(sessionKeys) / sizeof(sessionKeys[0]))
 
-    if (customer->visible)
-    {
+#define FRAME_MOUSE_DOWN        0x01
+#define FRAME_MOUSE_PRESSED     0x02
+#define FRAME_WINDOW_RESIZED    0x04
 
-        switch (customer->emotion)
-        {
-        case EMOTION_HAPPY:
-            DrawTextureEx(!customer->eyesClosed ? customersImageData[frame].happy : customersImageData[frame].happyEyesClosed, pos, 0.0f, 1.0f / 2.0f, WHITE);
-            break;
-        case EMOTION_FRUSTRATED:
-            DrawTextureEx(!customer->eyesClosed ? customersImageData[frame].frustrated : customersImageData[frame].frustratedEyesClosed, pos, 0.0f, 1.0f / 2.0f, WHITE);
-            break;
-        case EMOTION_ANGRY:
-            DrawTextureEx(!customer->eyesClosed ? customersImageData[frame].angry : customersImageData[frame].angryEyesClosed, pos, 0.0f, 1.0f / 2.0f, WHITE);
-            break;
-        default:
-            break;
-        }
+typedef struct {
+    double time;                // Session time at the start of the frame
+    Vector2 mouse;              // Screen space
+    unsigned short flags;
+    unsigned short keysDown;
+    unsigned short keysPressed;
+    unsigned short eventCount;  // Pointer events that follow this record
+    short screenWidth;
+    short screenHeight;
+} FrameRecord;
 
-    }
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    uint64_t seed;
+    double startTime;
+    GameOptions options;
+} SessionHeader;
 
-    if (customer->visible && !customer->isDummy)
+typedef struct {
+    SessionMode mode;
+    FILE* file;
+    FrameRecord frame;
+    double deltaTime;
+    long long frameCount;
+    double realStartTime;
+    InputEvent pending[INPUT_QUEUE_CAPACITY];   // Events pushed since the last frame started
+    int pendingCount;
+    double fixedStep;                           // Seconds per frame regardless of the wall clock, 0 follows the clock
+} Session;
+
+Session session = { 0 };
+
+void EnqueueInputEvent(InputEvent event);
+void ApplyAutoplayerClick(FrameRecord* frame);
+
+void StartSession(SessionMode mode)
+{
+    session.mode = mode;
+    session.frame.time = GetTime();
+    session.frame.screenWidth = (short)GetScreenWidth();
+    session.frame.screenHeight = (short)GetScreenHeight();
+    session.realStartTime = GetTime();
+}
+
+bool OpenSessionRecording(const char* fileName, const GameOptions* gameOptions, uint64_t seed)
+{
+    session.file = fopen(fileName, "wb");
+    if (session.file == NULL)
     {
-        DrawTextureEx(bubbles, (Vector2) { pos.x + 350, pos.y + 100 }, 0.0f, 1.0f / 2.0f, WHITE);
+        Log(LOG_WARNING, "Could not record session to %s", fileName);
+        return false;
+    }
 
-        if (strstr(customer->order, "CPY") != NULL)
-            DrawTextureEx(cocoaChon.texture, (Vector2) { pos.x + 375, pos.y + 100 }, 0.0f, 1.0f / 2.0f, WHITE);
-        else if (strstr(customer->order, "GPY") != NULL)
-            DrawTextureEx(greenChon.texture, (Vector2) { pos.x + 375, pos.y + 100 }, 0.0f, 1.0f / 2.0f, WHITE);
+    // Frames are tiny, a large buffer keeps the writes off the frame
+    setvbuf(session.file, NULL, _IOFBF, 1 << 16);
 
-        if (strstr(customer->order, "CM") != NULL)
-            // DrawTextureEx(condensedMilk.texture, (Vector2) {pos.x + 425, pos.y + 100}, 0.0f, 1.0f / 2.0f, WHITE);
-            DrawTextureRec(condensedMilk.texture, condensedMilk.frameRectangle, (Vector2) { pos.x + 425, pos.y + 100 }, RAYWHITE);
-        else if (strstr(customer->order, "MI") != NULL)
-            // DrawTextureEx(normalMilk.texture, (Vector2) {pos.x + 425, pos.y + 100}, 0.0f, 1.0f / 2.0f, WHITE);
-            DrawTextureRec(normalMilk.texture, normalMilk.frameRectangle, (Vector2) { pos.x + 425, pos.y + 100 }, RAYWHITE);
+    StartSession(SESSION_RECORDING);
+    SessionHeader header = { SESSION_MAGIC, SESSION_VERSION, seed, session.frame.time, *gameOptions };
+    fwrite(&header, sizeof(header), 1, session.file);
 
-        if (strstr(customer->order, "MA") != NULL)
-            // DrawTextureEx(marshMellow.texture, (Vector2) {pos.x + 375, pos.y + 150}, 0.0f, 1.0f / 2.0f, WHITE);
-            DrawTextureRec(marshMellow.texture, marshMellow.frameRectangle, (Vector2) { pos.x + 375, pos.y + 150 }, RAYWHITE);
-        else if (strstr(customer->order, "WC") != NULL)
-            // DrawTextureEx(whippedCream.texture, (Vector2) {pos.x + 375, pos.y + 150}, 0.0f, 1.0f / 2.0f, WHITE);
-            DrawTextureRec(whippedCream.texture, whippedCream.frameRectangle, (Vector2) { pos.x + 375, pos.y + 150 }, RAYWHITE);
+    Log(LOG_INFO, "Recording session to %s", fileName);
+    return true;
+}
 
-        if (strstr(customer->order, "CA") != NULL)
-            // DrawTextureEx(caramelSauce.texture, (Vector2) {pos.x + 425, pos.y + 150}, 0.0f, 1.0f / 2.0f, WHITE);
-            DrawTextureRec(caramelSauce.texture, caramelSauce.frameRectangle, (Vector2) { pos.x + 425, pos.y + 150 }, RAYWHITE);
-        else if (strstr(customer->order, "CH") != NULL)
-            // DrawTextureEx(chocolateSauce.texture, (Vector2) {pos.x + 425, pos.y + 150}, 0.0f, 1.0f / 2.0f, WHITE);
-            DrawTextureRec(chocolateSauce.texture, chocolateSauce.frameRectangle, (Vector2) { pos.x + 425, pos.y + 150 }, RAYWHITE);
-    }
+// Replays start from the recorded seed and options, the clock continues from the recorded start
+bool OpenSessionReplay(const char* fileName, GameOptions* gameOptions, uint64_t* seed)
+{
+    SessionHeader header;
 
-    if (options->showDebug && debugToolToggles.showObjects)
+    session.file = fopen(fileName, "rb");
+    if (session.file == NULL || fread(&header, sizeof(header), 1, session.file) != 1 ||
+        header.magic != SESSION_MAGIC || header.version != SESSION_VERSION)
     {
-        DrawRectangleLinesEx((Rectangle) { pos.x, pos.y, customersImageData[frame].happy.width / 2, customersImageData[frame].happy.height / 2 }, 1, RED);
-        DrawRectangle(pos.x, pos.y - 20, 500, 60, Fade(GRAY, 0.7));
-        DrawTextEx(meowFont, TextFormat("%s | Blink %s (%.2f) %.2f/%.2f", StringFromCustomerEmotionEnum(customer->emotion), customer->eyesClosed ? "[Yes]" : "[No]", customer->blinkDuration, customer->blinkTimer, customer->normalDuration), (Vector2) { pos.x, pos.y - 20 }, 20, 1, WHITE);
-        if (customer->visible)
-            DrawTextEx(meowFont, TextFormat("Timeout %.2f/%.2f", (float)customer->currentTime, (float)customer->orderEnd), (Vector2) { pos.x, pos.y }, 20, 1, WHITE);
-        else
-            DrawTextEx(meowFont, TextFormat("Reset %.2f/%.2f", (float)customer->currentTime, (float)customer->resetTimer), (Vector2) { pos.x, pos.y }, 20, 1, WHITE);
-        DrawTextEx(meowFont, TextFormat("Visible %s | Order %s", customer->visible ? "[Yes]" : "[No]", customer->order), (Vector2) { pos.x, pos.y + 20 }, 20, 1, WHITE);
+        Log(LOG_WARNING, "Could not replay session from %s", fileName);
+        if (session.file != NULL) fclose(session.file);
+        session.file = NULL;
+        return false;
     }
 
+    *seed = header.seed;
+    *gameOptions = header.options;
+    gameOptions->powerSaving = false;   // Throttling would skew a replay used as a benchmark
+
+    StartSession(SESSION_REPLAYING);
+    session.frame.time = header.startTime;
+
+    Log(LOG_INFO, "Replaying session from %s", fileName);
+    return true;
 }
 
-void UpdateMenuCustomerBlink(Customer* customer, double deltaTime) {
-    customer->blinkTimer += deltaTime;
+void CloseSession()
+{
+    if (session.file == NULL) return;
+
+    double realDuration = GetTime() - session.realStartTime;
+    Log(LOG_INFO, "%s session ended after %lld frames, %.2fs (%.3f ms/frame)", StringFromSessionModeEnum(session.mode),
+        session.frameCount, realDuration, session.frameCount > 0 ? realDuration * 1000.0 / session.frameCount : 0.0);
 
-    if (!customer->eyesClosed && customer->blinkTimer > customer->normalDuration) {
-        customer->blinkTimer = 0.0;
-        customer->eyesClosed = true;
-    }
-    else if (customer->eyesClosed && customer->blinkTimer > customer->blinkDuration) {
-        customer->blinkTimer = 0.0;
-        customer->eyesClosed = false;
+    fclose(session.file);
+    session.file = NULL;
+    session.mode = SESSION_LIVE;
+}
+
+void SampleSessionFrame(FrameRecord* frame)
+{
+    frame->time = session.fixedStep > 0 ? frame->time + session.fixedStep : GetTime();
+    frame->mouse = GetMousePosition();
+    frame->flags = 0;
+    if (IsMouseButtonDown(MOUSE_LEFT_BUTTON)) frame->flags |= FRAME_MOUSE_DOWN;
+    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) frame->flags |= FRAME_MOUSE_PRESSED;
+    if (IsWindowResized()) frame->flags |= FRAME_WINDOW_RESIZED;
+
+    frame->keysDown = 0;
+    frame->keysPressed = 0;
+    for (int i = 0; i < SESSION_KEY_COUNT; i++)
+    {
+        if (IsKeyDown(sessionKeys[i])) frame->keysDown |= 1 << i;
+        if (IsKeyPressed(sessionKeys[i])) frame->keysPressed |= 1 << i;
     }
+
+    frame->screenWidth = (short)GetScreenWidth();
+    frame->screenHeight = (short)GetScreenHeight();
+    frame->eventCount = 0;
 }
 
-void DrawCustomerInMenu(double deltaTime) {
-    UpdateMenuCustomerBlink(&menuCustomer1, deltaTime);
-    UpdateMenuCustomerBlink(&menuCustomer2, deltaTime);
+// Called at the start of every loop iteration through WindowUpdate
+void BeginSessionFrame()
+{
+    double previousTime = session.frame.time;
 
-    // Update customer emotions according to difficulty
-    switch (options->difficulty)
+    SamplePerfFrame();
+
+    if (session.mode == SESSION_REPLAYING)
     {
-        case FREEPLAY_EASY:
-        case EASY:
-            menuCustomer1.emotion = EMOTION_HAPPY;
-            menuCustomer2.emotion = EMOTION_HAPPY;
-            break;
-        case FREEPLAY_MEDIUM:
-        case MEDIUM:
-            menuCustomer1.emotion = EMOTION_FRUSTRATED;
-            menuCustomer2.emotion = EMOTION_FRUSTRATED;
-            break;
-        case FREEPLAY_HARD:
-        case HARD:
-            menuCustomer1.emotion = EMOTION_ANGRY;
-            menuCustomer2.emotion = EMOTION_ANGRY;
-            break;
-            break;
-        default:
-            menuCustomer1.emotion = EMOTION_HAPPY;
-            menuCustomer2.emotion = EMOTION_HAPPY;
-            break;
+        FrameRecord frame;
+        if (fread(&frame, sizeof(frame), 1, session.file) != 1)
+        {
+            CloseSession();
+            ExitApplication();
+        }
+
+        // Live events never reach the queue during a replay, the recorded ones take their place
+        for (int i = 0; i < frame.eventCount; i++)
+        {
+            InputEvent event;
+            if (fread(&event, sizeof(event), 1, session.file) != 1) break;
+            EnqueueInputEvent(event);
+        }
+
+        if (frame.screenWidth != session.frame.screenWidth || frame.screenHeight != session.frame.screenHeight)
+            SetWindowSize(frame.screenWidth, frame.screenHeight);
+
+        session.frame = frame;
     }
-    DrawCustomer(&menuCustomer1);
-    DrawCustomer(&menuCustomer2);
+    else
+    {
+        SampleSessionFrame(&session.frame);
+        ApplyAutoplayerClick(&session.frame);
+
+        if (session.mode == SESSION_RECORDING)
+        {
+            session.frame.eventCount = (unsigned short)session.pendingCount;
+            fwrite(&session.frame, sizeof(FrameRecord), 1, session.file);
+            fwrite(session.pending, sizeof(InputEvent), session.pendingCount, session.file);
+        }
+    }
+
+    session.pendingCount = 0;
+    session.deltaTime = session.frame.time - previousTime;
+    session.frameCount++;
 }
 
-void DrawOuterWorld()
+void LogNullRendererStats()
 {
-    // Draw area outside the view
-    DrawRectangle(baseX, baseY - 2000, BASE_SCREEN_WIDTH, 2000, BLACK);
-    DrawRectangle(baseX, baseY + BASE_SCREEN_HEIGHT, BASE_SCREEN_WIDTH, 2000, BLACK);
-    DrawRectangle(baseX - 2000, baseY, 2000, BASE_SCREEN_HEIGHT, BLACK);
-    DrawRectangle(baseX + BASE_SCREEN_WIDTH, baseY, 2000, BASE_SCREEN_HEIGHT, BLACK);
+    if (!nullRenderer.enabled) return;
+
+    static const char* kinds[] = { "clear", "texture", "shape", "text" };
+    long long frames = session.frameCount > 0 ? session.frameCount : 1;
+
+    for (int i = 0; i < DRAW_CALL_KIND_COUNT; i++)
+        Log(LOG_INFO, "Headless %s draws: %lld (%.1f per frame)", kinds[i], nullRenderer.calls[i], (double)nullRenderer.calls[i] / frames);
 }
 
-void SetRuntimeResolution(Camera2D *camera, int screenWidth, int screenHeight)
+double GetSessionTime()
 {
-    SetWindowSize(screenWidth, screenHeight);
-    float currentAspectRatio = (float)screenWidth / (float)screenHeight;
-    float scale = (currentAspectRatio > targetAspectRatio) ? (float)screenHeight / BASE_SCREEN_HEIGHT : (float)screenWidth / BASE_SCREEN_WIDTH;
+    return session.frame.time;
+}
 
-    camera->zoom = scale;
-    camera->offset.x = screenWidth / 2.0f;
-    camera->offset.y = screenHeight / 2.0f;
+float GetSessionFrameTime()
+{
+    return (float)session.deltaTime;
+}
 
-    options->resolution.x = screenWidth;
-    options->resolution.y = screenHeight;
+Vector2 GetSessionMousePosition()
+{
+    return session.frame.mouse;
 }
 
-bool IsMousePositionInGameWindow(Camera2D * camera)
+bool IsSessionMouseDown()
 {
-    Vector2 mouseWorldPos = GetScreenToWorld2D(GetMousePosition(), *camera);
-    return mouseWorldPos.x >= baseX && mouseWorldPos.x <= baseX + BASE_SCREEN_WIDTH && mouseWorldPos.y >= baseY && mouseWorldPos.y <= baseY + BASE_SCREEN_HEIGHT;
+    return (session.frame.flags & FRAME_MOUSE_DOWN) != 0;
+}
 
+bool IsSessionMousePressed()
+{
+    return (session.frame.flags & FRAME_MOUSE_PRESSED) != 0;
 }
 
-void DrawDebugLogs(Camera2D* camera)
+bool IsSessionWindowResized()
 {
-    DrawRectangle(baseX, baseY + BASE_SCREEN_HEIGHT - 20 - (DEBUG_MAX_LOGS_HISTORY * 20), BASE_SCREEN_WIDTH, DEBUG_MAX_LOGS_HISTORY * 20 + 20, Fade(GRAY, 0.7));
+    return (session.frame.flags & FRAME_WINDOW_RESIZED) != 0;
+}
 
-    for (int i = 0; i < DEBUG_MAX_LOGS_HISTORY; i++) {
-        int index = DEBUG_MAX_LOGS_HISTORY - i - 1;
-		if (DebugLogs[index].text != NULL) {
-			DrawTextEx(meowFont, DebugLogs[index].text, (Vector2) { baseX + 10, baseY + BASE_SCREEN_HEIGHT - 20 - (i * 20) }, 16, 1, GetTextColorFromLogType(DebugLogs[index].type));
-		}
-        else {
-			break;
-		}
-	}
+int SessionKeyBit(int key)
+{
+    for (int i = 0; i < SESSION_KEY_COUNT; i++)
+    {
+        if (sessionKeys[i] == key) return 1 << i;
+    }
+    return 0;
 }
 
-void DrawFpsGraph(Camera2D* camera)
+bool IsSessionKeyDown(int key)
 {
-    int graphWidth = DEBUG_MAX_FPS_HISTORY;
-    int graphHeight = 200;
-    int graphX = baseX + BASE_SCREEN_WIDTH - 15 - graphWidth;
-    int graphY = baseY + 25;
+    return (session.frame.keysDown & SessionKeyBit(key)) != 0;
+}
 
-    // Calculate the maximum value in the FPS history
-    float maxFpsValue = 0.0f;
-    for (int i = 0; i < DEBUG_MAX_FPS_HISTORY; i++) {
-        if (DebugFpsHistory[i] > maxFpsValue) {
-            maxFpsValue = (float)DebugFpsHistory[i];
-        }
-    }
+bool IsSessionKeyPressed(int key)
+{
+    return (session.frame.keysPressed & SessionKeyBit(key)) != 0;
+}
 
-    // Adjust the scale based on the maximum value or target FPS
-    float fpsScale;
-    if ((float)options->targetFps > maxFpsValue) {
-        fpsScale = (float)graphHeight / (float)options->targetFps;
+InputSnapshot TakeInputSnapshot(Camera2D* camera)
+{
+    InputSnapshot snapshot = { 0 };
+    Matrix invCamera = MatrixInvert(GetCameraMatrix2D(*camera));
+
+    snapshot.mouseScreen = GetSessionMousePosition();
+    snapshot.mouseWorld = Vector2Transform(snapshot.mouseScreen, invCamera);
+    snapshot.mouseDown = IsSessionMouseDown();
+
+    return snapshot;
+}
+
+void EnqueueInputEvent(InputEvent event)
+{
+    int tail = (inputQueue.head + inputQueue.count) % INPUT_QUEUE_CAPACITY;
+    inputQueue.events[tail] = event;
+
+    if (inputQueue.count < INPUT_QUEUE_CAPACITY) {
+        inputQueue.count++;
     }
     else {
-        fpsScale = (float)graphHeight / maxFpsValue;
+        inputQueue.head = (inputQueue.head + 1) % INPUT_QUEUE_CAPACITY;
+        inputQueue.dropped++;
     }
+}
 
-    DrawRectangle(graphX, graphY, graphWidth, graphHeight, Fade(GRAY, 0.7));
+// Recorded along with the next frame, ignored while a replay owns the queue
+void PushInputEvent(InputEvent event)
+{
+    if (session.mode == SESSION_REPLAYING) return;
 
-    // Draw the FPS history graph with color based on target FPS
-    for (int i = 1; i < DEBUG_MAX_FPS_HISTORY; i++) {
-        int x1 = graphX + i - 1;
-        int x2 = graphX + i;
-        int y1 = graphY + graphHeight - (DebugFpsHistory[(DebugFpsHistoryIndex + i - 1) % DEBUG_MAX_FPS_HISTORY] * fpsScale);
-        int y2 = graphY + graphHeight - (DebugFpsHistory[(DebugFpsHistoryIndex + i) % DEBUG_MAX_FPS_HISTORY] * fpsScale);
+    if (session.mode == SESSION_RECORDING && session.pendingCount < INPUT_QUEUE_CAPACITY)
+        session.pending[session.pendingCount++] = event;
 
-        // Calculate the ratio of actual FPS to target FPS
-        float fpsRatio = (float)DebugFpsHistory[(DebugFpsHistoryIndex + i) % DEBUG_MAX_FPS_HISTORY] / (float)options->targetFps;
+    EnqueueInputEvent(event);
+}
 
-        // Set color based on the ratio to target FPS
-        Color lineColor;
-        if (fpsRatio >= 0.9f) {
-            lineColor = GREEN; // FPS close to or exceeding target
-        }
-        else if (fpsRatio >= 0.7f) {
-            lineColor = YELLOW; // FPS above 70% of target
-        }
-        else {
-            lineColor = RED; // FPS below 70% of target
-        }
+bool PopInputEvent(InputEvent* event)
+{
+    if (inputQueue.count == 0) return false;
 
-        DrawLine(x1, y1, x2, y2, lineColor);
-    }
+    *event = inputQueue.events[inputQueue.head];
+    inputQueue.head = (inputQueue.head + 1) % INPUT_QUEUE_CAPACITY;
+    inputQueue.count--;
+    return true;
+}
 
-    DrawTextEx(meowFont, "FPS", (Vector2) { baseX + BASE_SCREEN_WIDTH - 50, baseY + 5 }, 20, 2, GRAY);
-    DrawTextEx(meowFont, TextFormat("%.2f", maxFpsValue > options->targetFps ? maxFpsValue : options->targetFps), (Vector2) { graphX + 10, graphY + 10 }, 15, 2, WHITE);
-    DrawTextEx(meowFont, "0", (Vector2) { graphX + 10, graphY + graphHeight - 30 }, 15, 2, WHITE);
+void ClearInputEvents()
+{
+    inputQueue.head = 0;
+    inputQueue.count = 0;
 }
 
+// Synthetic events go through the same queue as real ones, use pointer ids above MAX_DRAG_POINTERS
+// so they never collide with the mouse or touch points
+void InjectPointerEvent(InputEventType type, int pointerId, Vector2 screenPosition)
+{
+    PushInputEvent((InputEvent) { type, pointerId, screenPosition, GetTime(), true });
+}
 
-void DrawFrameTime(Camera2D* camera) {
-    int graphWidth = DEBUG_MAX_FPS_HISTORY;
-    int graphHeight = 200;
-    int graphX = baseX + BASE_SCREEN_WIDTH - 15 - graphWidth;
-    int graphY = baseY + 255;
+// Pointers that are down according to the last poll, desktop raylib mirrors the pressed mouse as touch point 0
+int GetPolledPointers(PointerSample* pointers)
+{
+    int touchCount = GetTouchPointCount();
+    int count = 0;
 
-    float targetFrameTime = 1000.0f / options->targetFps;
+    if (session.mode == SESSION_REPLAYING) touchCount = 0;
 
-    // Find the maximum value in the DebugFrameTimeHistory array
-    float maxFrameTime = 0.0f;
-    for (int i = 0; i < DEBUG_MAX_FPS_HISTORY; i++) {
-        if (DebugFrameTimeHistory[i] > maxFrameTime) {
-            maxFrameTime = DebugFrameTimeHistory[i];
+    if (touchCount > 0) {
+        for (int i = 0; i < touchCount && count < MAX_DRAG_POINTERS; i++) {
+            pointers[count].id = GetTouchPointId(i);
+            pointers[count].position = GetTouchPosition(i);
+            count++;
         }
     }
+    else if (IsSessionMouseDown()) {
+        pointers[0].id = 0;
+        pointers[0].position = GetSessionMousePosition();
+        count = 1;
+    }
 
-    // Calculate the expected value based on the target FPS
-    float expectedFrameTime = 1000.0f / options->targetFps;
-
-    // Adjust the frameTimeScale based on the maximum value
-    float frameTimeScale = (maxFrameTime > 0) ? (float)graphHeight / maxFrameTime : 1.0f;
+    return count;
+}
 
-    DrawRectangle(graphX, graphY, graphWidth, graphHeight, Fade(GRAY, 0.7));
+#if defined(USE_GLFW_INPUT)
+GLFWmousebuttonfun previousMouseButtonCallback = NULL;
+GLFWcursorposfun previousCursorPosCallback = NULL;
+Vector2 lastCursorPosition = { 0 };
 
-    // Draw the frame time history graph with color based on expected value
-    for (int i = 1; i < DEBUG_MAX_FPS_HISTORY; i++) {
-        int x1 = graphX + i - 1;
-        int x2 = graphX + i;
-        int y1 = graphY + graphHeight - (DebugFrameTimeHistory[(DebugFrameTimeHistoryIndex + i - 1) % DEBUG_MAX_FPS_HISTORY] * frameTimeScale);
-        int y2 = graphY + graphHeight - (DebugFrameTimeHistory[(DebugFrameTimeHistoryIndex + i) % DEBUG_MAX_FPS_HISTORY] * frameTimeScale);
+// raylib keeps receiving every event, the queue only listens in
+void InputMouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+{
+    if (previousMouseButtonCallback != NULL)
+        previousMouseButtonCallback(window, button, action, mods);
 
-        // Calculate the ratio of the frame time to the expected frame time
-        float ratioToExpected = DebugFrameTimeHistory[(DebugFrameTimeHistoryIndex + i) % DEBUG_MAX_FPS_HISTORY] / expectedFrameTime;
+    if (button != GLFW_MOUSE_BUTTON_LEFT) return;
 
-        // Set color based on the ratio to expected value
-        Color lineColor;
-        if (ratioToExpected <= 1.0f) {
-            lineColor = GREEN;
-        }
-        else if (ratioToExpected <= 1.5f) {
-            lineColor = YELLOW;
-        }
-        else {
-            lineColor = RED;
-        }
+    InputEventType type = (action == GLFW_PRESS) ? INPUT_EVENT_POINTER_DOWN : INPUT_EVENT_POINTER_UP;
+    PushInputEvent((InputEvent) { type, 0, lastCursorPosition, GetTime(), false });
+}
 
-        DrawLine(x1, y1, x2, y2, lineColor);
-    }
+void InputCursorPosCallback(GLFWwindow* window, double x, double y)
+{
+    if (previousCursorPosCallback != NULL)
+        previousCursorPosCallback(window, x, y);
 
-    DrawTextEx(meowFont, "Frame Time (ms)", (Vector2) { baseX - 135 + BASE_SCREEN_WIDTH - 50, graphY - 25 }, 20, 2, GRAY);
-    DrawTextEx(meowFont, TextFormat("%.2f", maxFrameTime > expectedFrameTime ? maxFrameTime : expectedFrameTime), (Vector2) { graphX + 10, graphY + 10 }, 15, 2, WHITE);
-    DrawTextEx(meowFont, "0", (Vector2) { graphX + 10, graphY + graphHeight - 30 }, 15, 2, WHITE);
+    lastCursorPosition = (Vector2){ (float)x, (float)y };
+    PushInputEvent((InputEvent) { INPUT_EVENT_POINTER_MOVE, 0, lastCursorPosition, GetTime(), false });
 }
+#endif
 
+// Call once after InitWindow
+void InstallInputEventHooks()
+{
+#if defined(USE_GLFW_INPUT)
+    GLFWwindow* window = (GLFWwindow*)GetWindowHandle();
+    double x = 0, y = 0;
 
-void UpdateDebugFpsHistory() {
-    DebugFpsHistory[DebugFpsHistoryIndex] = GetFPS();
-    DebugFpsHistoryIndex = (DebugFpsHistoryIndex + 1) % DEBUG_MAX_FPS_HISTORY;
-}
+    glfwGetCursorPos(window, &x, &y);
+    lastCursorPosition = (Vector2){ (float)x, (float)y };
 
-void UpdateDebugFrameTimeHistory() {
-	DebugFrameTimeHistory[DebugFrameTimeHistoryIndex] = GetFrameTime() * 1000;
-	DebugFrameTimeHistoryIndex = (DebugFrameTimeHistoryIndex + 1) % DEBUG_MAX_FPS_HISTORY;
+    previousMouseButtonCallback = glfwSetMouseButtonCallback(window, InputMouseButtonCallback);
+    previousCursorPosCallback = glfwSetCursorPosCallback(window, InputCursorPosCallback);
+    Log(LOG_INFO, "Input events recorded from GLFW callbacks");
+#else
+    Log(LOG_INFO, "Input events derived from polled state");
+#endif
 }
 
-void DrawDebugStats(Camera2D* camera)
+// Without callbacks, events are diffed from the polled pointers once per frame. GLFW has no touch callbacks,
+// so with the hooks only the mouse, pointer 0, comes from them and any other touch point is still diffed here
+void PumpInputEvents()
 {
-    DrawRectangle(baseX, baseY, 1100, 70, Fade(GRAY, 0.7));
+    PointerSample current[MAX_DRAG_POINTERS];
+    int currentCount = GetPolledPointers(current);
+    double now = GetTime();
+
+#if defined(USE_GLFW_INPUT)
+    int touchCount = 0;
+    for (int i = 0; i < currentCount; i++) {
+        if (current[i].id != 0)
+            current[touchCount++] = current[i];
+    }
+    currentCount = touchCount;
+#endif
 
-    Color color = GREEN;
-    int fps = GetFPS();
+    for (int i = 0; i < polledPointerCount; i++) {
+        bool stillDown = false;
+        for (int j = 0; j < currentCount; j++) {
+            if (current[j].id == polledPointers[i].id) {
+                stillDown = true;
+                break;
+            }
+        }
 
-    if (fps < options->targetFps * 0.7f) {
-		color = RED;
-	}
-	else if (fps < options->targetFps * 0.9f) {
-		color = YELLOW;
-	}
+        if (!stillDown)
+            PushInputEvent((InputEvent) { INPUT_EVENT_POINTER_UP, polledPointers[i].id, polledPointers[i].position, now, false });
+    }
 
-    Vector2 mousePosition = GetMousePosition();
-    Vector2 mouseWorldPos = GetScreenToWorld2D(mousePosition, *camera);
+    for (int j = 0; j < currentCount; j++) {
+        const PointerSample* previous = NULL;
+        for (int i = 0; i < polledPointerCount; i++) {
+            if (polledPointers[i].id == current[j].id) {
+                previous = &polledPointers[i];
+                break;
+            }
+        }
 
-    DrawTextEx(meowFont, TextFormat("%d FPS | Target FPS %d | Window (%dx%d) | Render (%dx%d) | Fullscreen ", fps, options->targetFps, options->resolution.x, options->resolution.y, BASE_SCREEN_WIDTH, BASE_SCREEN_HEIGHT, options->fullscreen ? "[Yes]" : "[No]"), (Vector2) { baseX + 10, baseY + 5 }, 20, 2, color);
-    DrawTextEx(meowFont, TextFormat("Cursor %.2f,%.2f (%dx%d) | World %.2f,%.2f (%dx%d) | R Base World %.2f,%.2f", mousePosition.x, mousePosition.y, options->resolution.x, options->resolution.y, mouseWorldPos.x, mouseWorldPos.y, BASE_SCREEN_WIDTH, BASE_SCREEN_HEIGHT, mouseWorldPos.x - baseX, mouseWorldPos.y - baseY), (Vector2) { baseX + 10, baseY + 25 }, 20, 2, WHITE);
-    DrawTextEx(meowFont, TextFormat("Zoom %.2f | In View %s", camera->zoom, IsMousePositionInGameWindow(camera) ? "[Yes]" : "[No]"), (Vector2) { baseX + 10, baseY + 45 }, 20, 2, WHITE);
+        if (previous == NULL)
+            PushInputEvent((InputEvent) { INPUT_EVENT_POINTER_DOWN, current[j].id, current[j].position, now, false });
+        else if (!Vector2Equals(previous->position, current[j].position))
+            PushInputEvent((InputEvent) { INPUT_EVENT_POINTER_MOVE, current[j].id, current[j].position, now, false });
+    }
+
+    memcpy(polledPointers, current, sizeof(PointerSample) * currentCount);
+    polledPointerCount = currentCount;
 }
 
-void DrawDebugOverlay(Camera2D *camera)
+void ClearHitIndex(HitIndex* index)
 {
-    if (options->showDebug)
-    {
-        // F1 - Toggle debug logs
-        if (IsKeyPressed(KEY_F1))
-        {
-            debugToolToggles.showDebugLogs = !debugToolToggles.showDebugLogs;
-        }
-        // F2 - Toggle debug stats
-        else if (IsKeyPressed(KEY_F2))
-        {
-            debugToolToggles.showStats = !debugToolToggles.showStats;
-        }
-        // F3 - Toggle debug graph
-        else if (IsKeyPressed(KEY_F3))
-        {
-            debugToolToggles.showGraph = !debugToolToggles.showGraph;
-        }
-        //  F4 - Toggle debug objects
-        else if (IsKeyPressed(KEY_F4))
-        {
-            debugToolToggles.showObjects = !debugToolToggles.showObjects;
+    index->entryCount = 0;
+    memset(index->cellCounts, 0, sizeof(index->cellCounts));
+}
+
+void InsertHitEntry(HitIndex* index, HitEntry entry)
+{
+    if (index->entryCount >= MAX_HIT_ENTRIES) return;
+
+    int entryIndex = index->entryCount++;
+    index->entries[entryIndex] = entry;
+
+    // Entries outside the render area are clamped to the border cells
+    int firstColumn = (int)Clamp((entry.bounds.x - baseX) / HIT_GRID_CELL_SIZE, 0, HIT_GRID_COLUMNS - 1);
+    int lastColumn = (int)Clamp((entry.bounds.x + entry.bounds.width - baseX) / HIT_GRID_CELL_SIZE, 0, HIT_GRID_COLUMNS - 1);
+    int firstRow = (int)Clamp((entry.bounds.y - baseY) / HIT_GRID_CELL_SIZE, 0, HIT_GRID_ROWS - 1);
+    int lastRow = (int)Clamp((entry.bounds.y + entry.bounds.height - baseY) / HIT_GRID_CELL_SIZE, 0, HIT_GRID_ROWS - 1);
+
+    for (int row = firstRow; row <= lastRow; row++) {
+        for (int column = firstColumn; column <= lastColumn; column++) {
+            if (index->cellCounts[row][column] < HIT_CELL_CAPACITY)
+                index->cells[row][column][index->cellCounts[row][column]++] = (unsigned char)entryIndex;
         }
     }
+}
 
-    UpdateDebugFpsHistory();
-    UpdateDebugFrameTimeHistory();
+const HitEntry* QueryHitIndex(const HitIndex* index, Vector2 point)
+{
+    int column = (int)((point.x - baseX) / HIT_GRID_CELL_SIZE);
+    int row = (int)((point.y - baseY) / HIT_GRID_CELL_SIZE);
 
-    DrawRectangle(baseX + BASE_SCREEN_WIDTH - 15 - 300, baseY + BASE_SCREEN_HEIGHT - 15 - 110, 300, 140, Fade(GRAY, 0.7));
-    DrawTextEx(meowFont, "Debug Tools", (Vector2) { baseX + BASE_SCREEN_WIDTH - 15 - 290, baseY + BASE_SCREEN_HEIGHT - 15 - 100 }, 20, 2, WHITE);
-    DrawTextEx(meowFont, TextFormat("Logs | %s | F1", debugToolToggles.showDebugLogs ? "[On]" : "[Off]"), (Vector2) { baseX + BASE_SCREEN_WIDTH - 15 - 290, baseY + BASE_SCREEN_HEIGHT - 15 - 80 }, 20, 2, debugToolToggles.showDebugLogs ? GREEN : WHITE);
-    DrawTextEx(meowFont, TextFormat("Stats | %s | F2", debugToolToggles.showStats ? "[On]" : "[Off]"), (Vector2) { baseX + BASE_SCREEN_WIDTH - 15 - 290, baseY + BASE_SCREEN_HEIGHT - 15 - 60 }, 20, 2, debugToolToggles.showStats ? GREEN : WHITE);
-    DrawTextEx(meowFont, TextFormat("Graph | %s | F3", debugToolToggles.showGraph ? "[On]" : "[Off]"), (Vector2) { baseX + BASE_SCREEN_WIDTH - 15 - 290, baseY + BASE_SCREEN_HEIGHT - 15 - 40 }, 20, 2, debugToolToggles.showGraph ? GREEN : WHITE);
-    DrawTextEx(meowFont, TextFormat("Objects | %s | F4", debugToolToggles.showObjects ? "[On]" : "[Off]"), (Vector2) { baseX + BASE_SCREEN_WIDTH - 15 - 290, baseY + BASE_SCREEN_HEIGHT - 15 - 20 }, 20, 2, debugToolToggles.showObjects ? GREEN : WHITE);
-    
-    if (debugToolToggles.showDebugLogs)
-        DrawDebugLogs(camera);
-    if(debugToolToggles.showStats)
-        DrawDebugStats(camera);
-    if (debugToolToggles.showGraph)
-    {
-        DrawFpsGraph(camera);
-        DrawFrameTime(camera);
+    if (point.x < baseX || point.y < baseY || column >= HIT_GRID_COLUMNS || row >= HIT_GRID_ROWS) return NULL;
+
+    // Topmost entry wins
+    const HitEntry* hit = NULL;
+    for (int i = 0; i < index->cellCounts[row][column]; i++) {
+        const HitEntry* entry = &index->entries[index->cells[row][column][i]];
+        if ((hit == NULL || entry->z > hit->z) && CheckCollisionPointMask(point, entry->bounds, entry->mask, entry->source))
+            hit = entry;
     }
 
+    return hit;
 }
 
-Customer CreateCustomerWithOrder(int patience, double currentTime, int orderEnd, Vector2 pos, int textureType, double resetTimer) {
-    Customer newCustomer = CreateCustomer(EMOTION_HAPPY, 0, 0, 0.25, true, pos, textureType, resetTimer);
-    RandomCustomerBlinkTime(&newCustomer);
-
-    newCustomer.currentTime = currentTime;
-    newCustomer.orderEnd = orderEnd * patience;
-	strcpy(newCustomer.order, "");
-	RandomGenerateOrder(newCustomer.order);
-    return newCustomer;
+void ResetCup(Cup* cup)
+{
+    cup->powderType = NONE;
+    cup->creamerType = NONE;
+    cup->toppingType = NONE;
+    cup->sauceType = NONE;
+    cup->hasWater = false;
+    cup->recipe = RECIPE_EMPTY;
 }
 
-// void create_order(Order *order, char *first, char *second, char *third, char *fourth) {
-// 	order->first = first;
-// 	order->second = second;
-// 	order->third = third;
-// 	order->fourth = fourth;
-// }
+// Hands the cup to a seated customer and empties it, a right drink scores and frees the seat. Sound and sprites are left to the caller
+bool ServeCup(Shift* shift, Cup* cup, int customer)
+{
+    bool correct = validiator(&shift->customers, customer, cup->recipe);
+    if (correct)
+    {
+        shift->score += 50;
+        shift->stats.served++;
+        RemoveCustomer(shift, shift->customers.seat[customer]);
+    }
+    else
+    {
+        shift->score -= 50;
+        shift->stats.wrong++;
+    }
 
-// void distribute_points(Order* order, char* first, char* second, char* third, char* fourth)
-// {
-//     if (first)
-//     {
-//         global_score += 50;
-//     }
-//     if (second)
-//     {
-//         global_score += 50;
-//     }
-//     if (third)
-//     {
-//         global_score += 50;
-//     }
-//     if (fourth)
-//     {
-//         global_score += 50;
-//     }
-// }
+    ResetCup(cup);
+    cup->active = false;
+    return correct;
+}
 
-bool validiator(Customer *customer, char *order)
+Cup* FindCupAt(DragController* controller, Vector2 point)
 {
-    LogDebug("Validating order: %s against %s", order, customer->order);
-	if (strcmp(customer->order, order) == 0)
-	{
-        return true;
-	}
-	else
-	{
-        return false;
-	}
+    for (int i = 0; i < controller->cupCount; i++) {
+        Cup* cup = &controller->cups[i];
+        Rectangle cupBounds = { cup->position.x, cup->position.y, cup->frameRectangle.width, cup->frameRectangle.height };
+        if (cup->active && CheckCollisionPointMask(point, cupBounds, &cupHitMask, cup->frameRectangle))
+            return cup;
+    }
+    return NULL;
+}
+
+void PressDragPointer(DragController* controller, DragPointer* pointer, const HitIndex* index)
+{
+    const HitEntry* hit = QueryHitIndex(index, pointer->position);
+    pointer->kind = DRAG_BLOCKED;
+
+    if (hit == NULL) return;
+
+    if (hit->kind == HIT_INGREDIENT && !IsIngredientHeld(controller, hit->ingredient)) {
+        Ingredient* object = hit->ingredient;
+
+        // Boiler has to be switched on before hot water can be dragged
+        if (ingredientInfo[object->id].category == CATEGORY_WATER && object->canChangeCupTexture == false) {
+            PlaySoundFx(FX_FLICK);
+            boilWater(object);
+            return;
+        }
+
+        Ingredient* dragged = hit->popObject != NULL ? hit->popObject : object;
+        pointer->kind = DRAG_INGREDIENT;
+        pointer->source = object;
+        pointer->dragged = dragged;
+        pointer->offset = (Vector2){ dragged->frameRectangle.width / 2, dragged->frameRectangle.height / 2 };
+        PlaySoundFx(FX_PICKUP);
+    }
+    else if (hit->kind == HIT_CUP && !IsCupHeld(controller, hit->cup)) {
+        Cup* cup = hit->cup;
+        pointer->kind = DRAG_CUP;
+        pointer->cup = cup;
+        pointer->offset = (Vector2){ cup->frameRectangle.width / 2, cup->frameRectangle.height / 2 };
+        PlaySoundFx(FX_PICKUP);
+    }
+    else if (hit->kind == HIT_CUP_STACK) {
+        // Take a new cup from the stack if there is a free one
+        for (int i = 0; i < controller->cupCount; i++) {
+            Cup* cup = &controller->cups[i];
+            if (cup->active) continue;
+
+            ResetCup(cup);
+            cup->texture = RecipeTexture(RECIPE_EMPTY);
+            cup->frameRectangle = frameRectCup(cup, 2, 1);
+            cup->active = true;
+
+            pointer->kind = DRAG_CUP;
+            pointer->cup = cup;
+            pointer->offset = (Vector2){ cup->frameRectangle.width / 2, cup->frameRectangle.height / 2 };
+            PlaySoundFx(FX_PICKUP);
+            return;
+        }
+    }
 }
 
-//create customer image at either position 1 2 or 3
-void render_customers(Customers *customers)
+void BuildHitIndex(HitIndex* index, const DragController* controller, Ingredient* trashCan)
 {
-    if(&customers->customer1 != NULL)
-        DrawCustomer(&customers->customer1);
-	if (&customers->customer2 != NULL)
-		DrawCustomer(&customers->customer2);
-	if (&customers->customer3 != NULL)
-		DrawCustomer(&customers->customer3);
+    // z follows the draw order in GameDraw
+    static const int cupStackZ = 4;
+    static const int cupZ = 100;
+
+    ClearHitIndex(index);
+
+    Rectangle trashCanBounds = { trashCan->position.x, trashCan->position.y, trashCan->frameRectangle.width, trashCan->frameRectangle.height };
+    Rectangle cupsBounds = { oricupsPostion.x, oricupsPostion.y, cupsTexture.width, cupsTexture.height };
+    Rectangle cupsSource = { 0, 0, cupsTexture.width, cupsTexture.height };
+
+    InsertHitEntry(index, (HitEntry) { HIT_TRASH, 0, trashCanBounds, trashCan->hitMask, trashCan->frameRectangle, trashCan, NULL, NULL });
+    InsertHitEntry(index, (HitEntry) { HIT_CUP_STACK, cupStackZ, cupsBounds, &cupsHitMask, cupsSource, NULL, NULL, NULL });
+
+    for (int i = 0; i < controller->sourceCount; i++) {
+        const DragSource* source = &controller->sources[i];
+        Ingredient* object = source->ingredient;
+        Rectangle bounds = { object->position.x, object->position.y, object->frameRectangle.width, object->frameRectangle.height };
+        InsertHitEntry(index, (HitEntry) { HIT_INGREDIENT, source->z, bounds, object->hitMask, object->frameRectangle, object, source->popObject, NULL });
+    }
+
+    for (int i = 0; i < controller->cupCount; i++) {
+        Cup* cup = &controller->cups[i];
+        if (!cup->active) continue;
+        Rectangle bounds = { cup->position.x, cup->position.y, cup->frameRectangle.width, cup->frameRectangle.height };
+        InsertHitEntry(index, (HitEntry) { HIT_CUP, cupZ + i, bounds, &cupHitMask, cup->frameRectangle, NULL, NULL, cup });
+    }
 }
 
-//Yandere dev inspired programming.
+void MoveDragPointer(DragController* controller, DragPointer* pointer, Ingredient* trashCan)
+{
+    if (pointer->kind == DRAG_INGREDIENT) {
+        pointer->dragged->position.x = pointer->position.x - pointer->offset.x;
+        pointer->dragged->position.y = pointer->position.y - pointer->offset.y;
+    }
+    else if (pointer->kind == DRAG_CUP) {
+        Cup* cup = pointer->cup;
+        cup->position.x = pointer->position.x - pointer->offset.x;
+        cup->position.y = pointer->position.y - pointer->offset.y;
+
+        // Dragging a cup over the trash can throws it away
+        Rectangle trashCanBond = { trashCan->position.x, trashCan->position.y, trashCan->frameRectangle.width, trashCan->frameRectangle.height };
+        if (CheckCollisionPointMask(pointer->position, trashCanBond, trashCan->hitMask, trashCan->frameRectangle)) {
+            ResetCup(cup);
+            cup->active = false;
+            cup->position = cup->originalPosition;
+            pointer->kind = DRAG_BLOCKED;
+            PlaySoundFx(FX_DROP);
+        }
+    }
+}
+
+void CountAutoplayerServe(int pointerId);
+
+void ReleaseDragPointer(DragController* controller, DragPointer* pointer, Shift* shift)
+{
+    CustomerPool* customers = &shift->customers;
+    Vector2 mousePos = pointer->position;
+
+    if (pointer->kind == DRAG_INGREDIENT) {
+        Ingredient* object = pointer->source;
+        Ingredient* dragged = pointer->dragged;
+        Cup* cup = FindCupAt(controller, mousePos);
+
+        if (cup != NULL && object->canChangeCupTexture) {
+            if (ingredientInfo[object->id].category == CATEGORY_WATER && cup->powderType != NONE) {
+                shift->boilerHeating = false;
+                shift->boilerReady = false;
+                object->canChangeCupTexture = false;
+                object->currentFrame = 1;
+            }
+
+            UpdateCup(cup, object);
+        }
+
+        // Ingredient always goes back to its station
+        dragged->position = IngredientRestPosition(dragged->id);
+        PlaySoundFx(FX_DROP);
+    }
+    else if (pointer->kind == DRAG_CUP) {
+        Cup* cup = pointer->cup;
 
-void RemoveCustomer(Customer *customer)
+        // Only check if world mouse position is more than y= 15
+        if (mousePos.y <= 15 && cup->active)
+        {
+            // If cup is being given to customers
+            for (int seat = 0; seat < customers->seatCount; seat++) {
+                int customer = customers->seatCustomer[seat];
+                if (customer == NO_CUSTOMER) continue;
+
+                // Customers are drawn at half size, the cup goes to whoever is under the pointer
+                const CustomerImageData* image = &customersImageData[customers->textureType[customer]];
+                Rectangle customerRect = { customers->position[customer].x, customers->position[customer].y, image->happy.width / 2, image->happy.height / 2 };
+                Rectangle customerSource = { 0, 0, image->happy.width, image->happy.height };
+
+                if (CheckCollisionPointMask(mousePos, customerRect, &image->hitMask, customerSource))
+                {
+                    LogDebug("Validating order: %s against %s", RecipeName(cup->recipe), RecipeName(customers->order[customer]));
+                    bool correct = ServeCup(shift, cup, customer);
+                    if (correct)
+                        CountAutoplayerServe(pointer->id);
+                    PlaySoundFx(correct ? FX_CORRECT : FX_CONFUSED);
+                    cup->texture = RecipeTexture(RECIPE_EMPTY);
+                    break;
+                }
+            }
+        }
+
+        // Return cup to its spot on the plate
+        cup->position = cup->originalPosition;
+        PlaySoundFx(FX_DROP);
+    }
+
+    pointer->active = false;
+    pointer->kind = DRAG_NONE;
+    pointer->source = NULL;
+    pointer->dragged = NULL;
+    pointer->cup = NULL;
+}
+
+DragPointer* FindDragPointer(DragController* controller, int id)
 {
-	customer->visible = false;
-    customer->currentTime = 0;
-    customer->orderEnd = 0;
-    customer->resetTimer = RandomCustomerResetBasedOnDifficulty();
+    for (int i = 0; i < MAX_DRAG_POINTERS; i++) {
+        DragPointer* pointer = &controller->pointers[i];
+        if (pointer->active && pointer->id == id)
+            return pointer;
+    }
+    return NULL;
 }
 
-void UpdateCustomerState(Customer* customer, float deltaTime) {
+// Consumes the queued pointer events in order, so quick presses and releases between frames are not lost
+void UpdateDragController(DragController* controller, Camera2D* camera, HitIndex* index, Shift* shift, Ingredient* trashCan)
+{
+    Matrix invCamera = MatrixInvert(GetCameraMatrix2D(*camera));
+    InputEvent event;
+
+    inputQueue.consumedLastFrame = 0;
 
-    customer->currentTime += deltaTime;
+    while (PopInputEvent(&event)) {
+        Vector2 position = Vector2Transform(event.position, invCamera);
+        DragPointer* pointer = FindDragPointer(controller, event.pointerId);
 
-    if (customer->visible == true) {
+        inputQueue.consumedLastFrame++;
 
-        if ((float)customer->currentTime < (float)customer->orderEnd) {
-            // Calculate a ratio of how close to the orderEnd the currentTime is
-            float ratio = (float)customer->currentTime / (float)customer->orderEnd;
+        if (event.type == INPUT_EVENT_POINTER_DOWN) {
+            if (pointer != NULL) continue;
 
-            if (ratio > 0.75) {
-                customer->emotion = EMOTION_ANGRY;
+            for (int i = 0; i < MAX_DRAG_POINTERS; i++) {
+                if (controller->pointers[i].active) continue;
+
+                pointer = &controller->pointers[i];
+                *pointer = (DragPointer){ 0 };
+                pointer->active = true;
+                pointer->id = event.pointerId;
+                pointer->position = position;
+                PressDragPointer(controller, pointer, index);
+                MoveDragPointer(controller, pointer, trashCan);
+                break;
             }
-            else if (ratio > 0.5) {
-                customer->emotion = EMOTION_FRUSTRATED;
+        }
+        else if (pointer != NULL) {
+            pointer->position = position;
+
+            if (event.type == INPUT_EVENT_POINTER_MOVE) {
+                MoveDragPointer(controller, pointer, trashCan);
+
+                // Replayed events carry the recording's clock
+                if ((pointer->kind == DRAG_INGREDIENT || pointer->kind == DRAG_CUP) && session.mode != SESSION_REPLAYING)
+                    latencyProbe.eventTime = fmax(latencyProbe.eventTime, event.time);
             }
             else {
-                customer->emotion = EMOTION_HAPPY;
+                // Dropped where the release happened, the index is rebuilt for any press later in the queue
+                ReleaseDragPointer(controller, pointer, shift);
+                BuildHitIndex(index, controller, trashCan);
             }
         }
-        else {
-            PlaySoundFx(FX_ANGRY);
-            RemoveCustomer(customer);
-            global_score -= 50;
-        }
     }
-    else {
+}
 
-        if ((float)customer->currentTime > customer->resetTimer) {
-            customer->currentTime = 0;
-            customer->orderEnd = RandomCustomerTimeoutBasedOnDifficulty();
-            customer->visible = true;
-            strcpy(customer->order, "");
-            RandomGenerateOrder(customer->order);
-        }
-    }
+// Autoplayer, makes drinks through synthetic pointer events so soak and profiling runs have a steady workload.
+// It replans from what is on the counter after every gesture, so its own mistakes are handled like anyone else's
+#define AUTOPLAYER_POINTER_ID (MAX_DRAG_POINTERS + 1)
+
+typedef struct {
+    bool enabled;
+    float speed;                // 1 is a quick human, higher is faster
+    float errorRate;            // Chance to grab the wrong variant of an ingredient
+    float aimJitter;            // World units a drop may land off its target
+
+    bool gestureActive;
+    Vector2 from;               // World space
+    Vector2 to;
+    float gestureTime;
+    float gestureDuration;
+    float thinkTimer;
+
+    int targetCustomer;
+    unsigned int targetGeneration;
+
+    bool clickPending;          // Menu buttons read the frame sample, not the event queue
+    Vector2 clickPosition;
+
+    long long gestureCount;
+    long long servedCount;      // Drinks a customer accepted, counted when the drop is validated
+} Autoplayer;
+
+Autoplayer autoplayer = { .speed = 1.0f, .errorRate = 0.05f, .aimJitter = 10.0f, .targetCustomer = NO_CUSTOMER };
+
+// Called for every right drink, only the autoplayer's own pointer counts
+void CountAutoplayerServe(int pointerId)
+{
+    if (pointerId == AUTOPLAYER_POINTER_ID)
+        autoplayer.servedCount++;
 }
 
+Vector2 RectangleCenter(Vector2 position, float width, float height)
+{
+    return (Vector2){ position.x + width / 2, position.y + height / 2 };
+}
 
+Vector2 IngredientCenter(const Ingredient* ingredient)
+{
+    return RectangleCenter(ingredient->position, ingredient->frameRectangle.width, ingredient->frameRectangle.height);
+}
 
-void Tick(Customers *customers, float deltaTime) {
-    UpdateCustomerState(&customers->customer1, deltaTime);
-    UpdateCustomerState(&customers->customer2, deltaTime);
-    UpdateCustomerState(&customers->customer3, deltaTime);
+// Station for a recipe slot, e.g. CATEGORY_CREAMER slot 2 is the normal milk. INGREDIENT_COUNT when there is none
+IngredientId FindIngredientIdForSlot(IngredientCategory category, int slot)
+{
+    for (int i = 0; i < INGREDIENT_COUNT; i++)
+    {
+        const IngredientInfo* info = &ingredientInfo[i];
+        if (info->category != category || !info->draggable) continue;
+        if (category == CATEGORY_WATER || RecipeSlotFromIngredient(info->type) == slot)
+            return (IngredientId)i;
+    }
+    return INGREDIENT_COUNT;
 }
 
-/* Definitions terminates*/
+Ingredient* FindIngredientForSlot(IngredientCategory category, int slot)
+{
+    IngredientId id = FindIngredientIdForSlot(category, slot);
+    return id != INGREDIENT_COUNT ? &ingredients[id] : NULL;
+}
 
+void StartAutoplayerGesture(Autoplayer* bot, Vector2 from, Vector2 to, float duration, Camera2D* camera)
+{
+    bot->gestureActive = true;
+    bot->from = from;
+    bot->to = (Vector2){ to.x + GetRandomDoubleValue(RANDOM_BOT, -bot->aimJitter, bot->aimJitter), to.y + GetRandomDoubleValue(RANDOM_BOT, -bot->aimJitter, bot->aimJitter) };
+    bot->gestureTime = 0;
+    bot->gestureDuration = duration / bot->speed * GetRandomDoubleValue(RANDOM_BOT, 0.8, 1.2);
+    bot->gestureCount++;
+
+    InjectPointerEvent(INPUT_EVENT_POINTER_DOWN, AUTOPLAYER_POINTER_ID, GetWorldToScreen2D(bot->from, *camera));
+}
 
-void PlaySoundFx(SoundFxType type) {
-    int randomIndex = 0;
+void AutoplayerThink(Autoplayer* bot, float seconds)
+{
+    bot->thinkTimer = seconds / bot->speed * GetRandomDoubleValue(RANDOM_BOT, 0.8, 1.2);
+}
 
-    if (!options->soundFxEnabled) return;
+// Longest waiting customer, the pool keeps a seat per customer so this is a short sweep
+int PickAutoplayerCustomer(const CustomerPool* pool)
+{
+    int best = NO_CUSTOMER;
 
-    switch (type) {
-    case FX_ANGRY: {
-        Sound angrySounds[] = { angry1Fx, angry2Fx, angry3Fx, angry4Fx };
-        randomIndex = rand() % (sizeof(angrySounds) / sizeof(angrySounds[0]));
-        PlaySound(angrySounds[randomIndex]);
-        break;
-    }
-    case FX_BOTTLE: {
-        Sound bottleSounds[] = { bottle1Fx, bottle2Fx, bottle3Fx };
-        randomIndex = rand() % (sizeof(bottleSounds) / sizeof(bottleSounds[0]));
-        PlaySound(bottleSounds[randomIndex]);
-        break;
-    }
-    case FX_CONFUSED: {
-        Sound confusedSounds[] = { confused1Fx, confused2Fx, confused3Fx, confused4Fx };
-        randomIndex = rand() % (sizeof(confusedSounds) / sizeof(confusedSounds[0]));
-        PlaySound(confusedSounds[randomIndex]);
-        break;
+    for (int seat = 0; seat < pool->seatCount; seat++)
+    {
+        int customer = pool->seatCustomer[seat];
+        if (customer == NO_CUSTOMER) continue;
+        if (best == NO_CUSTOMER || pool->seatedAt[customer] < pool->seatedAt[best])
+            best = customer;
     }
-    case FX_CORRECT:
-        PlaySound(correctFx);
-        break;
-    case FX_DROP: {
-        Sound dropSounds[] = { drop1Fx, drop2Fx, drop3Fx };
-        randomIndex = rand() % (sizeof(dropSounds) / sizeof(dropSounds[0]));
-        PlaySound(dropSounds[randomIndex]);
-        break;
+    return best;
+}
+
+void PlanAutoplayerGesture(Autoplayer* bot, DragController* controller, Shift* shift, Ingredient* trashCan, Camera2D* camera)
+{
+    CustomerPool* pool = &shift->customers;
+    Cup* cup = NULL;
+    for (int i = 0; i < controller->cupCount && cup == NULL; i++)
+    {
+        if (controller->cups[i].active) cup = &controller->cups[i];
     }
-    case FX_PICKUP: {
-        Sound pickupSounds[] = { pickup1Fx, pickup2Fx, pickup3Fx };
-        randomIndex = rand() % (sizeof(pickupSounds) / sizeof(pickupSounds[0]));
-        PlaySound(pickupSounds[randomIndex]);
-        break;
+
+    // Keep working for the same customer until they leave
+    if (bot->targetCustomer == NO_CUSTOMER || pool->generation[bot->targetCustomer] != bot->targetGeneration || pool->seat[bot->targetCustomer] == NO_SEAT)
+    {
+        bot->targetCustomer = PickAutoplayerCustomer(pool);
+        if (bot->targetCustomer != NO_CUSTOMER)
+            bot->targetGeneration = pool->generation[bot->targetCustomer];
+        else if (cup == NULL || cup->recipe == RECIPE_EMPTY)
+        {
+            AutoplayerThink(bot, 0.5f);
+            return;
+        }
     }
-    case FX_POUR: {
-        Sound pourSounds[] = { pour1Fx, pour2Fx, pour3Fx };
-        randomIndex = rand() % (sizeof(pourSounds) / sizeof(pourSounds[0]));
-        PlaySound(pourSounds[randomIndex]);
-        break;
+
+    // A half made drink nobody is waiting for goes in the trash
+    if (bot->targetCustomer == NO_CUSTOMER)
+    {
+        Vector2 cupCenter = RectangleCenter(cup->position, cup->frameRectangle.width, cup->frameRectangle.height);
+        StartAutoplayerGesture(bot, cupCenter, IngredientCenter(trashCan), 0.4f, camera);
+        return;
     }
-    case FX_STIR: {
-        Sound stirSounds[] = { stir1Fx, stir2Fx, stir3Fx };
-        randomIndex = rand() % (sizeof(stirSounds) / sizeof(stirSounds[0]));
-        PlaySound(stirSounds[randomIndex]);
-        break;
+
+    if (cup == NULL)
+    {
+        Vector2 stack = RectangleCenter(oricupsPostion, cupsTexture.width, cupsTexture.height);
+        StartAutoplayerGesture(bot, stack, RectangleCenter(plate.position, plate.texture.width, plate.texture.height), 0.4f, camera);
+        return;
     }
-    case FX_BOONG:
-        PlaySound(boongFx);
-        break;
-    case FX_HOVER:
-        PlaySound(hoverFx);
-        break;
-    case FX_SELECT:
-        PlaySound(selectFx);
-        break;
-    case FX_FLICK:
-        PlaySound(flickFx);
+
+    Recipe order = pool->order[bot->targetCustomer];
+    Vector2 cupCenter = RectangleCenter(cup->position, cup->frameRectangle.width, cup->frameRectangle.height);
+
+    // Slots in the order UpdateCup accepts them
+    static const IngredientCategory steps[] = { CATEGORY_POWDER, CATEGORY_WATER, CATEGORY_CREAMER, CATEGORY_TOPPING, CATEGORY_SAUCE };
+    int wanted[] = {
+        (order >> RECIPE_POWDER_SHIFT) & 3, (order >> RECIPE_WATER_SHIFT) & 1, (order >> RECIPE_CREAMER_SHIFT) & 3,
+        (order >> RECIPE_TOPPING_SHIFT) & 3, (order >> RECIPE_SAUCE_SHIFT) & 3,
+    };
+    bool filled[] = { cup->powderType != NONE, cup->hasWater, cup->creamerType != NONE, cup->toppingType != NONE, cup->sauceType != NONE };
+
+    for (int i = 0; i < 5; i++)
+    {
+        if (wanted[i] == 0 || filled[i]) continue;
+
+        int slot = wanted[i];
+        if (steps[i] != CATEGORY_WATER && GetRandomDoubleValue(RANDOM_BOT, 0.0, 1.0) < bot->errorRate)
+            slot = 3 - slot;
+
+        Ingredient* station = FindIngredientForSlot(steps[i], slot);
+        if (station == NULL) break;
+
+        // The boiler has to be switched on and heated before it pours
+        if (steps[i] == CATEGORY_WATER && !station->canChangeCupTexture)
+        {
+            if (!shift->boilerHeating)
+                StartAutoplayerGesture(bot, IngredientCenter(station), IngredientCenter(station), 0.1f, camera);
+            else
+                AutoplayerThink(bot, 0.2f);
+            return;
+        }
+
+        StartAutoplayerGesture(bot, IngredientCenter(station), cupCenter, 0.35f, camera);
+        return;
     }
+
+    // Everything is in, hand it over
+    const CustomerImageData* image = &customersImageData[pool->textureType[bot->targetCustomer]];
+    StartAutoplayerGesture(bot, cupCenter, RectangleCenter(pool->position[bot->targetCustomer], image->happy.width / 2, image->happy.height / 2), 0.5f, camera);
 }
-void WindowUpdate(Camera2D* camera)
+
+// Runs from the game scene's presented hook, so its events are consumed next frame like polled input
+void UpdateAutoplayer(Autoplayer* bot, DragController* controller, Shift* shift, Ingredient* trashCan, Camera2D* camera, float deltaTime)
 {
-    if (IsWindowResized())
+    if (!bot->enabled) return;
+
+    if (bot->gestureActive)
     {
-        int screenWidth = GetScreenWidth();
-        int screenHeight = GetScreenHeight();
+        bot->gestureTime += deltaTime;
+        float t = fminf(bot->gestureTime / bot->gestureDuration, 1.0f);
+        Vector2 position = GetWorldToScreen2D(Vector2Lerp(bot->from, bot->to, t), *camera);
 
+        InjectPointerEvent(INPUT_EVENT_POINTER_MOVE, AUTOPLAYER_POINTER_ID, position);
+        if (t >= 1.0f)
+        {
+            InjectPointerEvent(INPUT_EVENT_POINTER_UP, AUTOPLAYER_POINTER_ID, position);
+            bot->gestureActive = false;
+            AutoplayerThink(bot, 0.25f);
+        }
+        return;
+    }
 
-        float currentAspectRatio = (float)screenWidth / (float)screenHeight;
-        float scale = (currentAspectRatio > targetAspectRatio) ? (float)screenHeight / BASE_SCREEN_HEIGHT : (float)screenWidth / BASE_SCREEN_WIDTH;
+    bot->thinkTimer -= deltaTime;
+    if (bot->thinkTimer > 0) return;
 
-        camera->zoom = scale;
-        camera->offset.x = screenWidth / 2.0f;
-        camera->offset.y = screenHeight / 2.0f;
+    PlanAutoplayerGesture(bot, controller, shift, trashCan, camera);
+}
 
-        options->resolution.x = screenWidth;
-        options->resolution.y = screenHeight;
+// Menus only look at the sampled mouse, the click lands in the next frame sample
+void AutoplayerClick(Autoplayer* bot, Rectangle button, Camera2D* camera)
+{
+    if (!bot->enabled || bot->clickPending) return;
+
+    bot->clickPending = true;
+    bot->clickPosition = GetWorldToScreen2D(RectangleCenter((Vector2) { button.x, button.y }, button.width, button.height), *camera);
+}
+
+void ApplyAutoplayerClick(FrameRecord* frame)
+{
+    if (!autoplayer.clickPending) return;
+
+    frame->mouse = autoplayer.clickPosition;
+    frame->flags |= FRAME_MOUSE_DOWN | FRAME_MOUSE_PRESSED;
+    autoplayer.clickPending = false;
+}
+
+// Latest cursor position in screen space, bypassing the positions raylib polled last frame
+Vector2 SampleLatestMousePosition()
+{
+    if (session.mode == SESSION_REPLAYING) return GetSessionMousePosition();
+
+#if defined(USE_GLFW_INPUT)
+    double x = 0, y = 0;
+    glfwGetCursorPos((GLFWwindow*)GetWindowHandle(), &x, &y);
+    return (Vector2){ (float)x, (float)y };
+#else
+    return GetMousePosition();
+#endif
+}
+
+// Moves dragged objects to a fresh pointer sample right before they are drawn
+void LateLatchDragPointers(DragController* controller, Camera2D* camera)
+{
+    // Real touch points can only be read from the last poll
+    if (GetTouchPointCount() > 1) return;
+
+    for (int i = 0; i < MAX_DRAG_POINTERS; i++) {
+        DragPointer* pointer = &controller->pointers[i];
+        if (!pointer->active || pointer->id != 0) continue;
+        if (pointer->kind != DRAG_INGREDIENT && pointer->kind != DRAG_CUP) continue;
+
+        pointer->position = GetScreenToWorld2D(SampleLatestMousePosition(), *camera);
+
+        if (pointer->kind == DRAG_INGREDIENT) {
+            pointer->dragged->position.x = pointer->position.x - pointer->offset.x;
+            pointer->dragged->position.y = pointer->position.y - pointer->offset.y;
+        }
+        else {
+            pointer->cup->position.x = pointer->position.x - pointer->offset.x;
+            pointer->cup->position.y = pointer->position.y - pointer->offset.y;
+        }
+
+        latencyProbe.latchedTime = GetTime();
+        latencyProbe.latched = true;
     }
+}
 
-    // Alt - Enter fullscreen
-    if (IsKeyDown(KEY_LEFT_ALT) && IsKeyPressed(KEY_ENTER) || IsKeyDown(KEY_RIGHT_ALT) && IsKeyPressed(KEY_ENTER))
-    {
-        SetRuntimeResolution(camera, BASE_SCREEN_WIDTH, BASE_SCREEN_HEIGHT);
-        ToggleFullscreen();
+// Call right after EndDrawing, compares the queued event and the late sample against the end of the frame
+void RecordFrameEnd()
+{
+    double frameEndTime = GetTime();
+
+    if (latencyProbe.latched && latencyProbe.eventTime > 0) {
+        latencyProbe.early[latencyProbe.next] = frameEndTime - latencyProbe.eventTime;
+        latencyProbe.late[latencyProbe.next] = frameEndTime - latencyProbe.latchedTime;
+        latencyProbe.next = (latencyProbe.next + 1) % LATENCY_PROBE_SAMPLES;
+        if (latencyProbe.count < LATENCY_PROBE_SAMPLES)
+            latencyProbe.count++;
+
+        double earlySum = 0, lateSum = 0;
+        for (int i = 0; i < latencyProbe.count; i++) {
+            earlySum += latencyProbe.early[i];
+            lateSum += latencyProbe.late[i];
+        }
+        latencyProbe.earlyAverage = earlySum / latencyProbe.count;
+        latencyProbe.lateAverage = lateSum / latencyProbe.count;
+    }
+
+    latencyProbe.eventTime = 0;
+    latencyProbe.latched = false;
+}
+
+// Runs on each bubble timer of the on-screen shift, the boiler keeps bubbling every half second once hot
+void tickBoil(Shift* shift, Ingredient* boiler) {
+    StopSound(boongFx);
+    PlaySoundFx(FX_BOONG);
+    boiler->canChangeCupTexture = true;
+    int nextFrame = boiler->currentFrame + 2;
+    if (nextFrame > ingredientInfo[boiler->id].totalFrames) {
+        nextFrame = 1;
+    }
+    boiler->currentFrame = nextFrame;
+
+    ScheduleTimer(&shift->timers, TIMER_BOILER_BUBBLE, 0, shift->boilerGeneration, 0.5);
+}
+
+
+bool highlightItem(Ingredient* item, const HitEntry* hovered) {
+    bool isHovered = hovered != NULL && hovered->ingredient == item;
+    int totalFrames = ingredientInfo[item->id].totalFrames;
+    if (isHovered && totalFrames > item->currentFrame) {
+        item->frameRectangle = frameRect(item, totalFrames, item->currentFrame + 1);
+        return true;
+    }
+    else {
+        item->frameRectangle = frameRect(item, totalFrames, item->currentFrame);
+        return false;
+    }
+}
+
+// Function prototype
+void ApplyTextureQuality();
+
+// Menu customers
+Customer menuCustomer1;
+Customer menuCustomer2;
+
+// Menu falling items
+#define menuFallingItemsNumber 8
+#define MAX_MENU_FALLING_ITEMS 20
+MenuFallingItem menuFallingItems[MAX_MENU_FALLING_ITEMS];
+GameOptions *options;
+
+// Moving clouds
+#define MAX_MOVING_CLOUDS 7
+MovingCloud movingClouds[MAX_MOVING_CLOUDS];
+
+// Moving stars
+MovingStar movingStars[2];
+
+// Current BGM
+Music* currentBgm = NULL;
+bool isCurrentBgmPaused = false;
+
+// Frame governor
+typedef enum {
+    GOVERNOR_ACTIVE,
+    GOVERNOR_IDLE,
+    GOVERNOR_UNFOCUSED,
+    GOVERNOR_HIDDEN
+} FrameGovernorState;
+
+typedef struct FrameGovernor {
+    FrameGovernorState state;
+    double lastInputTime;
+    int appliedFps;
+    bool audioPaused;
+} FrameGovernor;
+
+FrameGovernor frameGovernor = { GOVERNOR_ACTIVE, 0.0, 0, false };
+
+static inline char* StringFromFrameGovernorStateEnum(FrameGovernorState state)
+{
+    static const char* strings[] = { "Active", "Idle", "Unfocused", "Hidden" };
+    return strings[state];
+}
+
+// Load duration timer
+double loadDurationTimer = 0.0;
+bool isGlobalAssetsLoadFinished = false;
+
+// Start from night
+int currentColorIndex = 3;
+float dayNightCycleDuration = 120.0f;
+// Skip to 1/2 of the night, so that the first transition is from night to morning
+float colorTransitionTime = 0.5f;
+
+
+static inline const char* LogTypePrefix(int type)
+{
+    switch (type)
+    {
+        case LOG_DEBUG: return "[DEBUG]: ";
+        case LOG_INFO: return "[INFO] : ";
+        case LOG_WARNING: return "[WARN] : ";
+        case LOG_ERROR: return "[ERROR]: ";
+        case LOG_FATAL: return "[FATAL]: ";
+        default: return "";
+    }
+}
+
+// Claims the next free record and formats into it, fails without blocking when the writer is a full lap behind
+bool PushLogRecord(int type, const char* text, va_list args)
+{
+    unsigned int position = AtomicLoad(&logRing.head);
+    LogRecord* record;
+    unsigned int free;
+    for (;;)
+    {
+        record = &logRing.records[position % LOG_RING_CAPACITY];
+        free = LogLapStart(position);
+        int lag = (int)(AtomicLoad(&record->state) - free);
+        if (lag == 0)
+        {
+            // On failure another producer took it, position now holds the new head
+            if (AtomicCompareExchange(&logRing.head, &position, position + 1))
+                break;
+        }
+        else if (lag < 0)
+            return false;
+        else
+            position = AtomicLoad(&logRing.head);
+    }
+
+    record->type = type;
+    record->time = time(NULL);
+    vsnprintf(record->text, LOG_RECORD_TEXT, text, args);
+    AtomicStore(&record->state, free + 1);
+    return true;
+}
+
+void WriteLogRecord(FILE* out, const LogRecord* record)
+{
+    if (record->time != logWriter.stampTime || logWriter.stamp[0] == '\0')
+    {
+        logWriter.stampTime = record->time;
+        struct tm* tm_info = localtime(&record->time);
+        strftime(logWriter.stamp, sizeof(logWriter.stamp), "%Y-%m-%d %H:%M:%S", tm_info);
+    }
+
+    fprintf(out, "[%s] %s%s\n", logWriter.stamp, LogTypePrefix(record->type), record->text);
+}
+
+// Prints every record written so far in order, returns how many. Safe to call from any thread
+int DrainLogRing()
+{
+    if (AtomicExchange(&logRing.draining, 1) != 0)
+        return 0;
+
+    FILE* out = logWriter.file != NULL ? logWriter.file : stdout;
+    int written = 0;
+    for (;;)
+    {
+        unsigned int position = logRing.tail;
+        LogRecord* record = &logRing.records[position % LOG_RING_CAPACITY];
+        unsigned int lap = LogLapStart(position);
+        if (AtomicLoad(&record->state) != lap + 1)
+            break;
+
+        WriteLogRecord(out, record);
+        AtomicStore(&record->state, lap + LOG_RING_CAPACITY);
+        logRing.tail = position + 1;
+        written++;
+    }
+
+    unsigned int dropped = AtomicExchange(&logRing.dropped, 0);
+    if (dropped > 0)
+    {
+        char stamp[32];
+        time_t now = time(NULL);
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
+        fprintf(out, "[%s] %s%u log lines dropped, the ring was full\n", stamp, LogTypePrefix(LOG_WARNING), dropped);
+    }
+
+    if (written > 0 || dropped > 0)
+        fflush(out);
+
+    AtomicStore(&logRing.draining, 0);
+    return written;
+}
+
+// Whether the next record to print is written, or lines were dropped that still need reporting
+bool LogRingHasWork()
+{
+    unsigned int position = logRing.tail;
+    LogRecord* record = &logRing.records[position % LOG_RING_CAPACITY];
+    return AtomicLoad(&record->state) == LogLapStart(position) + 1 || AtomicLoad(&logRing.dropped) != 0;
+}
+
+#if SIM_THREADS
+// Sleeps until a producer finds the ring empty and the writer asleep, so an idle game never wakes it
+void* LogWriterThread(void* arg)
+{
+    for (;;)
+    {
+        if (DrainLogRing() > 0)
+            continue;
+
+        pthread_mutex_lock(&logWriter.lock);
+        AtomicStore(&logWriter.asleep, 1);
+        // Pairs with the fence in WakeLogWriter: either the producer sees asleep, or this sees its record
+        AtomicFullFence();
+        bool stopping = AtomicLoad(&logWriter.stopping) != 0;
+        if (!stopping && !LogRingHasWork())
+            pthread_cond_wait(&logWriter.wake, &logWriter.lock);
+        AtomicStore(&logWriter.asleep, 0);
+        pthread_mutex_unlock(&logWriter.lock);
+
+        if (stopping)
+            break;
+    }
+    return NULL;
+}
+#endif
+
+// Called after a record is written or dropped, costs a fence unless the writer is asleep
+void WakeLogWriter()
+{
+#if SIM_THREADS
+    if (!logWriter.threaded)
+        return;
+
+    AtomicFullFence();
+    if (AtomicLoad(&logWriter.asleep) != 0)
+    {
+        pthread_mutex_lock(&logWriter.lock);
+        pthread_cond_signal(&logWriter.wake);
+        pthread_mutex_unlock(&logWriter.lock);
+    }
+#endif
+}
+
+// Lines go to the given file, or stdout when it is NULL or cannot be opened
+void StartLogWriter(const char* path)
+{
+    if (logWriter.started) return;
+
+    if (path != NULL)
+        logWriter.file = fopen(path, "w");
+
+    logWriter.started = true;
+#if SIM_THREADS
+    AtomicStore(&logWriter.stopping, 0);
+    AtomicStore(&logWriter.asleep, 0);
+    pthread_mutex_init(&logWriter.lock, NULL);
+    pthread_cond_init(&logWriter.wake, NULL);
+    logWriter.threaded = pthread_create(&logWriter.thread, NULL, LogWriterThread, NULL) == 0;
+#endif
+
+    if (path != NULL && logWriter.file == NULL)
+        Log(LOG_WARNING, "Could not open log file %s, logging to stdout", path);
+}
+
+// Prints whatever is left, lines logged after this are printed straight away
+void StopLogWriter()
+{
+    if (!logWriter.started) return;
+
+#if SIM_THREADS
+    if (logWriter.threaded)
+    {
+        AtomicStore(&logWriter.stopping, 1);
+        pthread_mutex_lock(&logWriter.lock);
+        pthread_cond_signal(&logWriter.wake);
+        pthread_mutex_unlock(&logWriter.lock);
+        pthread_join(logWriter.thread, NULL);
+        logWriter.threaded = false;
+    }
+    pthread_mutex_destroy(&logWriter.lock);
+    pthread_cond_destroy(&logWriter.wake);
+#endif
+    logWriter.started = false;
+
+    DrainLogRing();
+    if (logWriter.file != NULL)
+    {
+        fclose(logWriter.file);
+        logWriter.file = NULL;
+    }
+}
+
+// Without a writer thread the frame loop prints the ring once a frame
+void PumpLogWriter()
+{
+    if (logWriter.started && !logWriter.threaded)
+        DrainLogRing();
+}
+
+// Logging only formats into the ring, the time stamp and the printing happen on the writer
+void CustomLogger(int msgType, const char* text, va_list args)
+{
+    va_list retryArgs;
+    va_copy(retryArgs, args);
+
+    bool pushed = PushLogRecord(msgType, text, args);
+
+    // With nobody else draining, the logging thread makes room itself
+    if (!pushed && !logWriter.threaded)
+    {
+        DrainLogRing();
+        pushed = PushLogRecord(msgType, text, retryArgs);
+    }
+    va_end(retryArgs);
+
+    if (!pushed)
+        AtomicIncrement(&logRing.dropped);
+
+    WakeLogWriter();
+
+    // Before the writer starts and after it stops, lines print as they come
+    if (!logWriter.started)
+        DrainLogRing();
+}
+
+void LogDebug(const char* text, ...)
+{
+    va_list args;
+    va_start(args, text);
+    CustomLogger(LOG_DEBUG, text, args);
+    va_end(args);
+}
+
+void Log(int msgType, const char* text, ...)
+{
+    va_list args;
+    va_start(args, text);
+    CustomLogger(msgType, text, args);
+    va_end(args);
+}
+
+Color GetTextColorFromLogType(TraceLogLevel level)
+{
+	switch (level)
+	{
+    case LOG_DEBUG: return DARKGRAY;
+	case LOG_INFO: return WHITE;
+	case LOG_WARNING: return YELLOW;
+	case LOG_ERROR: return RED;
+    case LOG_FATAL: return ORANGE;
+	default: return WHITE;
+	}
+}
+
+void DrawDragableItemFrame(const Ingredient* i) {
+    DrawTextureRec(i->texture, i->frameRectangle, i->position, RAYWHITE);
+    if (options->showDebug && debugToolToggles.showObjects)
+    {
+        DrawRectangleLinesEx((Rectangle) { i->position.x, i->position.y, i->frameRectangle.width, i->frameRectangle.height }, 1, RED);
+        DrawRectangle(i->position.x, i->position.y - 20, 300, 20, Fade(GRAY, 0.7));
+        DrawTextEx(meowFont, TextFormat("%s | XY %.2f,%.2f", ingredientInfo[i->id].name, i->position.x, i->position.y), (Vector2) { i->position.x, i->position.y - 20 }, 20, 1, WHITE);
+    }
+}
+
+
+void RespawnMenuFallingItem(MenuFallingItem* item)
+{
+    item->position = (Vector2){ GetRandomDoubleValue(RANDOM_AMBIENT, baseX, baseX + BASE_SCREEN_WIDTH - 20), baseY - GetRandomDoubleValue(RANDOM_AMBIENT, 200, 1000) };
+    item->textureIndex = GetRandomIntValue(RANDOM_AMBIENT, 0, menuFallingItemsNumber - 1);
+    item->fallingSpeed = GetRandomDoubleValue(RANDOM_AMBIENT, 1, 3);
+    item->fallingSpeed *= 100;
+    item->rotation = GetRandomDoubleValue(RANDOM_AMBIENT, -360, 360);
+    item->rotationSpeed = GetRandomIntValue(RANDOM_AMBIENT, -3, 3);
+    item->rotationSpeed *= 100;
+    if (abs(item->rotationSpeed) > item->fallingSpeed)
+        item->rotationSpeed = item->fallingSpeed;
+    if (item->rotationSpeed == 0)
+        item->rotationSpeed = 1 * 100;
+}
+
+// Moves and draws one item, the stress scene calls it for far more items than the menu has
+void UpdateMenuFallingItem(MenuFallingItem* item, int index, double deltaTime, bool behide, bool showObjects)
+{
+    item->position.y += item->fallingSpeed * deltaTime;
+    item->rotation += item->rotationSpeed * deltaTime;
+
+    Vector2 origin = { (float)menuFallingItemTextures[item->textureIndex].width / 2, (float)menuFallingItemTextures[item->textureIndex].height / 2 };
+    DrawTexturePro(menuFallingItemTextures[item->textureIndex], (Rectangle) { 0, 0, menuFallingItemTextures[item->textureIndex].width, menuFallingItemTextures[item->textureIndex].height },
+        (Rectangle) {
+        item->position.x, item->position.y, menuFallingItemTextures[item->textureIndex].width, menuFallingItemTextures[item->textureIndex].height
+    },
+        origin, item->rotation, WHITE);
+
+    if (showObjects) {
+        Vector2 corners[4];
+        corners[0] = (Vector2){ -origin.x, -origin.y };
+        corners[1] = (Vector2){ -origin.x, origin.y };
+        corners[2] = (Vector2){ origin.x, origin.y };
+        corners[3] = (Vector2){ origin.x, -origin.y };
+
+        for (int j = 0; j < 4; j++) {
+            float tempX = corners[j].x * cos(DEG2RAD * item->rotation) - corners[j].y * sin(DEG2RAD * item->rotation);
+            float tempY = corners[j].x * sin(DEG2RAD * item->rotation) + corners[j].y * cos(DEG2RAD * item->rotation);
+            corners[j].x = tempX + item->position.x;
+            corners[j].y = tempY + item->position.y;
+        }
+
+        DrawLineEx(corners[0], corners[1], 1, RED);
+        DrawLineEx(corners[1], corners[2], 1, RED);
+        DrawLineEx(corners[2], corners[3], 1, RED);
+        DrawLineEx(corners[3], corners[0], 1, RED);
+
+        DrawRectangle(item->position.x, item->position.y, 550, 20, Fade(GRAY, 0.7));
+        DrawTextEx(meowFont, TextFormat("%d | XY %.2f,%.2f | R %.2f | G %.2f | Behide %s", index, item->position.x, item->position.y, item->rotation, item->fallingSpeed, behide ? "[Yes]" : "[No]"), (Vector2) { item->position.x, item->position.y }, 20, 1, WHITE);
+    }
+
+    if (item->position.y > baseY + BASE_SCREEN_HEIGHT + 1000)
+        RespawnMenuFallingItem(item);
+}
+
+void DrawMenuFallingItems(double deltaTime, bool behide)
+{
+    // Roughly half of the items fall behind the menu overlay
+    int itemCount = options->fallingItemCount;
+    int splitIndex = itemCount * 11 / MAX_MENU_FALLING_ITEMS;
+    int startIndex = behide ? 0 : splitIndex;
+    int endIndex = behide ? splitIndex : itemCount;
+
+    for (int i = startIndex; i < endIndex; i++)
+        UpdateMenuFallingItem(&menuFallingItems[i], i, deltaTime, behide, options->showDebug && debugToolToggles.showObjects);
+}
+
+bool IsNight()
+{
+    return currentColorIndex == 3 && colorTransitionTime < 0.4;
+}
+
+// Moves and draws one cloud, wrapping around to the side it came from
+void UpdateMovingCloud(MovingCloud* cloud, double deltaTime, bool showObjects)
+{
+    bool fromRight = cloud->fromRight;
+
+    // Calculate the X position based on time and direction
+    if (fromRight) {
+        cloud->position.x -= cloud->speed * deltaTime;
+        // Check if the cloud has moved off the screen
+        if ((float)cloud->position.x + ((float)(cloud->texture.width) * (float)(cloud->scale)) <= baseX) {
+            cloud->position.x = baseX + BASE_SCREEN_WIDTH + (cloud->texture.width * cloud->scale) + GetRandomDoubleValue(RANDOM_AMBIENT, 100, 500);
+            cloud->position.y = GetRandomDoubleValue(RANDOM_AMBIENT, baseY, 0);
+        }
+    }
+    else {
+        cloud->position.x += cloud->speed * deltaTime;
+        // Check if the cloud has moved off the screen
+        if (cloud->position.x > baseX + BASE_SCREEN_WIDTH) {
+            cloud->position.x = baseX - (cloud->texture.width * cloud->scale) - GetRandomDoubleValue(RANDOM_AMBIENT, 100, 500);
+            cloud->position.y = GetRandomDoubleValue(RANDOM_AMBIENT, baseY, 0);
+        }
+    }
+
+    // Draw the cloud
+    DrawTexture(cloud->texture, cloud->position.x, cloud->position.y, WHITE);
+
+    // Debug
+    if (showObjects)
+    {
+        DrawRectangleLinesEx((Rectangle) { cloud->position.x, cloud->position.y, cloud->texture.width* cloud->scale, cloud->texture.height* cloud->scale }, 1, RED);
+        DrawRectangle(cloud->position.x, cloud->position.y - 20, 300, 20, Fade(GRAY, 0.7));
+        DrawTextEx(meowFont, TextFormat("%s | XY %.2f,%.2f | Speed %.2f | Scale %.2f", "Cloud", cloud->position.x, cloud->position.y, cloud->speed, cloud->scale), (Vector2) { cloud->position.x, cloud->position.y - 20 }, 20, 1, WHITE);
+    }
+}
+
+void DrawMovingCloudAndStar(double deltaTime)
+{
+    int cloudCount = options->cloudCount;
+    int starCount = sizeof(movingStars) / sizeof(movingStars[0]);
+
+    if (IsNight())
+    {
+
+        for (int i = 0; i < starCount; i++) {
+
+            MovingStar* cloud = &movingStars[i];
+
+            bool fromRight = false;
+            bool isInView = cloud->position.x >= baseX && cloud->position.x <= baseX + BASE_SCREEN_WIDTH && cloud->position.y >= baseY && cloud->position.y <= baseY + BASE_SCREEN_HEIGHT;
+
+            // Calculate the X position based on time and direction
+            if (fromRight) {
+                cloud->position.x -= cloud->speed * deltaTime;
+                // Check if the cloud has moved off the screen
+                if ((float)cloud->position.x + ((float)(cloud->texture.width) * (float)(cloud->scale)) <= baseX) {
+                    cloud->position.x = baseX + BASE_SCREEN_WIDTH + (cloud->texture.width * cloud->scale) + GetRandomDoubleValue(RANDOM_AMBIENT, 100, 500);
+                }
+            }
+            else {
+                cloud->position.x += cloud->speed * deltaTime;
+                // Check if the cloud has moved off the screen
+                if (cloud->position.x > baseX + BASE_SCREEN_WIDTH) {
+                    cloud->position.x = baseX - (cloud->texture.width * cloud->scale) - GetRandomDoubleValue(RANDOM_AMBIENT, 100, 500);
+                }
+            }
+
+            // Draw the cloud
+            DrawTexture(cloud->texture, cloud->position.x, cloud->position.y, WHITE);
+
+            // Debug
+            if (options->showDebug && debugToolToggles.showObjects)
+            {
+                DrawRectangleLinesEx((Rectangle) { cloud->position.x, cloud->position.y, cloud->texture.width* cloud->scale, cloud->texture.height* cloud->scale }, 1, RED);
+                DrawRectangle(cloud->position.x, cloud->position.y - 20, 300, 20, Fade(GRAY, 0.7));
+                DrawTextEx(meowFont, TextFormat("%s | XY %.2f,%.2f | Speed %.2f | Scale %.2f", "Stars", cloud->position.x, cloud->position.y, cloud->speed, cloud->scale), (Vector2) { cloud->position.x, cloud->position.y - 20 }, 20, 1, WHITE);
+            }
+        }
+    }
+    else
+    {
+        for (int i = 0; i < cloudCount; i++)
+            UpdateMovingCloud(&movingClouds[i], deltaTime, options->showDebug && debugToolToggles.showObjects);
+    }
+   
+}
+
+double RandomCustomerTimeoutBasedOnDifficulty(Shift* shift)
+{
+    switch (shift->difficulty)
+    {
+    case FREEPLAY_EASY:
+    case EASY:
+        return NextRandomDouble(&shift->random[RANDOM_CUSTOMERS], 80, 150);
+        break;
+    case FREEPLAY_MEDIUM:
+    case MEDIUM:
+        return NextRandomDouble(&shift->random[RANDOM_CUSTOMERS], 40, 60);
+        break;
+    case FREEPLAY_HARD:
+    case HARD:
+        return NextRandomDouble(&shift->random[RANDOM_CUSTOMERS], 20, 40);
+        break;
+    default:
+        return NextRandomDouble(&shift->random[RANDOM_CUSTOMERS], 80, 150);
+        break;
+    }
+}
+
+void RandomCustomerInitialResetBasedOnDifficulty(Shift* shift, double *values, int count) {
+    // Seats open one after another, extra seats share the range of the last one
+    static const double easyRanges[3][2] = { { 4, 6 }, { 5, 15 }, { 10, 25 } };
+    static const double mediumRanges[3][2] = { { 2, 6 }, { 4, 10 }, { 12, 20 } };
+    static const double hardRanges[3][2] = { { 2, 4 }, { 3, 6 }, { 6, 10 } };
+    const double (*ranges)[2] = easyRanges;
+
+    switch (shift->difficulty)
+	{
+        case FREEPLAY_MEDIUM:
+        case MEDIUM:
+            ranges = mediumRanges;
+        	break;
+        case FREEPLAY_HARD:
+        case HARD:
+            ranges = hardRanges;
+        	break;
+        default:
+        	break;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        int range = i < 3 ? i : 2;
+        values[i] = NextRandomDouble(&shift->random[RANDOM_CUSTOMERS], ranges[range][0], ranges[range][1]);
+    }
+}
+
+
+double RandomCustomerResetBasedOnDifficulty(Shift* shift)
+{
+    switch (shift->difficulty)
+    {
+    case FREEPLAY_EASY:
+    case EASY:
+        return NextRandomDouble(&shift->random[RANDOM_CUSTOMERS], 30, 50);
+        break;
+    case FREEPLAY_MEDIUM:
+    case MEDIUM:
+        return NextRandomDouble(&shift->random[RANDOM_CUSTOMERS], 15, 30);
+        break;
+    case FREEPLAY_HARD:
+    case HARD:
+        return NextRandomDouble(&shift->random[RANDOM_CUSTOMERS], 1, 10);
+        break;
+    default:
+        return NextRandomDouble(&shift->random[RANDOM_CUSTOMERS], 30, 50);
+        break;
+    }
+}
+
+// Orders follow the recipe catalog mix for the shift's difficulty
+Recipe RandomGenerateOrder(Shift* shift)
+{
+    Recipe order = SampleRecipeCatalog(&recipeCatalog, RecipeMixFromDifficulty(shift->difficulty), &shift->random[RANDOM_ORDERS]);
+
+    // A simulated batch would push a line per order for thousands of shifts and crowd everything else out of the ring
+    if (!shift->simulated)
+        LogDebug("New order: %s", RecipeName(order));
+    return order;
+}
+
+
+void DrawCustomerSprite(int textureType, CustomerEmotion emotion, bool eyesClosed, Vector2 pos)
+{
+    const CustomerImageData* image = &customersImageData[textureType];
+
+    switch (emotion)
+    {
+    case EMOTION_HAPPY:
+        DrawTextureEx(!eyesClosed ? image->happy : image->happyEyesClosed, pos, 0.0f, 1.0f / 2.0f, WHITE);
+        break;
+    case EMOTION_FRUSTRATED:
+        DrawTextureEx(!eyesClosed ? image->frustrated : image->frustratedEyesClosed, pos, 0.0f, 1.0f / 2.0f, WHITE);
+        break;
+    case EMOTION_ANGRY:
+        DrawTextureEx(!eyesClosed ? image->angry : image->angryEyesClosed, pos, 0.0f, 1.0f / 2.0f, WHITE);
+        break;
+    default:
+        break;
+    }
+}
+
+void DrawOrderBubble(Recipe order, Vector2 pos)
+{
+    DrawTextureEx(bubbles, (Vector2) { pos.x + 350, pos.y + 100 }, 0.0f, 1.0f / 2.0f, WHITE);
+
+    const RecipeIconList* icons = &recipeIcons[order];
+    for (int i = 0; i < icons->count; i++)
+    {
+        const RecipeIcon* icon = &icons->icons[i];
+        Vector2 iconPos = { pos.x + icon->offset.x, pos.y + icon->offset.y };
+
+        if (icon->wholeTexture)
+            DrawTextureEx(icon->ingredient->texture, iconPos, 0.0f, 1.0f / 2.0f, WHITE);
+        else
+            DrawTextureRec(icon->ingredient->texture, icon->ingredient->frameRectangle, iconPos, RAYWHITE);
+    }
+}
+
+void DrawCustomer(Customer* customer)
+{
+    if (customer == NULL) return;
+
+    Vector2 pos = customer->position;
+    int frame = customer->textureType;
+
+    if (customer->visible)
+        DrawCustomerSprite(frame, customer->emotion, customer->eyesClosed, pos);
+
+    if (customer->visible && !customer->isDummy)
+        DrawOrderBubble(customer->order, pos);
+
+    if (options->showDebug && debugToolToggles.showObjects)
+    {
+        DrawRectangleLinesEx((Rectangle) { pos.x, pos.y, customersImageData[frame].happy.width / 2, customersImageData[frame].happy.height / 2 }, 1, RED);
+        DrawRectangle(pos.x, pos.y - 20, 500, 60, Fade(GRAY, 0.7));
+        DrawTextEx(meowFont, TextFormat("%s | Blink %s (%.2f/%.2f)", StringFromCustomerEmotionEnum(customer->emotion), customer->eyesClosed ? "[Yes]" : "[No]", customer->blinkDuration, customer->normalDuration), (Vector2) { pos.x, pos.y - 20 }, 20, 1, WHITE);
+        if (customer->visible)
+            DrawTextEx(meowFont, TextFormat("Timeout %.2f/%.2f", (float)customer->currentTime, (float)customer->orderEnd), (Vector2) { pos.x, pos.y }, 20, 1, WHITE);
+        else
+            DrawTextEx(meowFont, TextFormat("Reset %.2f/%.2f", (float)customer->currentTime, (float)customer->resetTimer), (Vector2) { pos.x, pos.y }, 20, 1, WHITE);
+        DrawTextEx(meowFont, TextFormat("Visible %s | Order %s", customer->visible ? "[Yes]" : "[No]", RecipeName(customer->order)), (Vector2) { pos.x, pos.y + 20 }, 20, 1, WHITE);
+    }
+
+}
+
+// Toggles the eyes and schedules the next toggle, target is the menu customer index
+void UpdateMenuCustomerBlink(Customer* customer, int target) {
+    customer->eyesClosed = !customer->eyesClosed;
+    customer->blinkTimer = 0.0;
+    ScheduleTimer(&menuTimers, TIMER_MENU_BLINK, target, 0, customer->eyesClosed ? customer->blinkDuration : customer->normalDuration);
+}
+
+void ScheduleMenuCustomerBlinks() {
+    ClearTimers(&menuTimers);
+    ScheduleTimer(&menuTimers, TIMER_MENU_BLINK, 0, 0, menuCustomer1.normalDuration - menuCustomer1.blinkTimer);
+    ScheduleTimer(&menuTimers, TIMER_MENU_BLINK, 1, 0, menuCustomer2.normalDuration - menuCustomer2.blinkTimer);
+}
+
+void DrawCustomerInMenu(double deltaTime) {
+    AdvanceTimers(&menuTimers, deltaTime);
+
+    Timer timer;
+    while (PopExpiredTimer(&menuTimers, &timer))
+        UpdateMenuCustomerBlink(timer.target == 0 ? &menuCustomer1 : &menuCustomer2, timer.target);
+
+    // Update customer emotions according to difficulty
+    switch (options->difficulty)
+    {
+        case FREEPLAY_EASY:
+        case EASY:
+            menuCustomer1.emotion = EMOTION_HAPPY;
+            menuCustomer2.emotion = EMOTION_HAPPY;
+            break;
+        case FREEPLAY_MEDIUM:
+        case MEDIUM:
+            menuCustomer1.emotion = EMOTION_FRUSTRATED;
+            menuCustomer2.emotion = EMOTION_FRUSTRATED;
+            break;
+        case FREEPLAY_HARD:
+        case HARD:
+            menuCustomer1.emotion = EMOTION_ANGRY;
+            menuCustomer2.emotion = EMOTION_ANGRY;
+            break;
+            break;
+        default:
+            menuCustomer1.emotion = EMOTION_HAPPY;
+            menuCustomer2.emotion = EMOTION_HAPPY;
+            break;
+    }
+    DrawCustomer(&menuCustomer1);
+    DrawCustomer(&menuCustomer2);
+}
+
+void DrawOuterWorld()
+{
+    // Draw area outside the view
+    DrawRectangle(baseX, baseY - 2000, BASE_SCREEN_WIDTH, 2000, BLACK);
+    DrawRectangle(baseX, baseY + BASE_SCREEN_HEIGHT, BASE_SCREEN_WIDTH, 2000, BLACK);
+    DrawRectangle(baseX - 2000, baseY, 2000, BASE_SCREEN_HEIGHT, BLACK);
+    DrawRectangle(baseX + BASE_SCREEN_WIDTH, baseY, 2000, BASE_SCREEN_HEIGHT, BLACK);
+}
+
+void SetRuntimeResolution(Camera2D *camera, int screenWidth, int screenHeight)
+{
+    SetWindowSize(screenWidth, screenHeight);
+    float currentAspectRatio = (float)screenWidth / (float)screenHeight;
+    float scale = (currentAspectRatio > targetAspectRatio) ? (float)screenHeight / BASE_SCREEN_HEIGHT : (float)screenWidth / BASE_SCREEN_WIDTH;
+
+    camera->zoom = scale;
+    camera->offset.x = screenWidth / 2.0f;
+    camera->offset.y = screenHeight / 2.0f;
+
+    options->resolution.x = screenWidth;
+    options->resolution.y = screenHeight;
+}
+
+bool IsMousePositionInGameWindow(Camera2D * camera)
+{
+    Vector2 mouseWorldPos = GetScreenToWorld2D(GetSessionMousePosition(), *camera);
+    return mouseWorldPos.x >= baseX && mouseWorldPos.x <= baseX + BASE_SCREEN_WIDTH && mouseWorldPos.y >= baseY && mouseWorldPos.y <= baseY + BASE_SCREEN_HEIGHT;
+
+}
+
+void DrawDebugLogs(Camera2D* camera)
+{
+    DrawRectangle(baseX, baseY + BASE_SCREEN_HEIGHT - 20 - (DEBUG_MAX_LOGS_HISTORY * 20), BASE_SCREEN_WIDTH, DEBUG_MAX_LOGS_HISTORY * 20 + 20, Fade(GRAY, 0.7));
+
+    // Newest at the bottom, copied out of the ring and kept only if no producer reclaimed the record meanwhile
+    // Records claimed but not yet written are skipped without leaving a gap, so look back further than one screen
+    unsigned int head = AtomicLoad(&logRing.head);
+    int row = 0;
+    // Positions before the first record never match a written state, so the scan needs no bound but the ring
+    for (unsigned int back = 0; row < DEBUG_MAX_LOGS_HISTORY && back < LOG_RING_CAPACITY; back++) {
+        unsigned int position = head - back - 1;
+        LogRecord* record = &logRing.records[position % LOG_RING_CAPACITY];
+        unsigned int lap = LogLapStart(position);
+        unsigned int state = AtomicLoad(&record->state);
+        if (state != lap + 1 && state != lap + LOG_RING_CAPACITY)
+            continue;
+
+        int type = record->type;
+        char text[LOG_RECORD_TEXT];
+        memcpy(text, record->text, sizeof(text));
+        text[LOG_RECORD_TEXT - 1] = '\0';
+
+        AtomicFence();
+        if (AtomicLoad(&logRing.head) - position > LOG_RING_CAPACITY)
+            break;
+
+        DrawTextEx(meowFont, text, (Vector2) { baseX + 10, baseY + BASE_SCREEN_HEIGHT - 20 - (row * 20) }, 16, 1, GetTextColorFromLogType(type));
+        row++;
+	}
+}
+
+void DrawFpsGraph(Camera2D* camera)
+{
+    int graphWidth = DEBUG_MAX_FPS_HISTORY;
+    int graphHeight = 200;
+    int graphX = baseX + BASE_SCREEN_WIDTH - 15 - graphWidth;
+    int graphY = baseY + 25;
+
+    // Calculate the maximum value in the FPS history
+    float maxFpsValue = 0.0f;
+    for (int i = 0; i < DEBUG_MAX_FPS_HISTORY; i++) {
+        if (DebugFpsHistory[i] > maxFpsValue) {
+            maxFpsValue = (float)DebugFpsHistory[i];
+        }
+    }
+
+    // Adjust the scale based on the maximum value or target FPS
+    float fpsScale;
+    if ((float)options->targetFps > maxFpsValue) {
+        fpsScale = (float)graphHeight / (float)options->targetFps;
+    }
+    else {
+        fpsScale = (float)graphHeight / maxFpsValue;
+    }
+
+    DrawRectangle(graphX, graphY, graphWidth, graphHeight, Fade(GRAY, 0.7));
+
+    // Draw the FPS history graph with color based on target FPS
+    for (int i = 1; i < DEBUG_MAX_FPS_HISTORY; i++) {
+        int x1 = graphX + i - 1;
+        int x2 = graphX + i;
+        int y1 = graphY + graphHeight - (DebugFpsHistory[(DebugFpsHistoryIndex + i - 1) % DEBUG_MAX_FPS_HISTORY] * fpsScale);
+        int y2 = graphY + graphHeight - (DebugFpsHistory[(DebugFpsHistoryIndex + i) % DEBUG_MAX_FPS_HISTORY] * fpsScale);
+
+        // Calculate the ratio of actual FPS to target FPS
+        float fpsRatio = (float)DebugFpsHistory[(DebugFpsHistoryIndex + i) % DEBUG_MAX_FPS_HISTORY] / (float)options->targetFps;
+
+        // Set color based on the ratio to target FPS
+        Color lineColor;
+        if (fpsRatio >= 0.9f) {
+            lineColor = GREEN; // FPS close to or exceeding target
+        }
+        else if (fpsRatio >= 0.7f) {
+            lineColor = YELLOW; // FPS above 70% of target
+        }
+        else {
+            lineColor = RED; // FPS below 70% of target
+        }
+
+        DrawLine(x1, y1, x2, y2, lineColor);
+    }
+
+    DrawTextEx(meowFont, "FPS", (Vector2) { baseX + BASE_SCREEN_WIDTH - 50, baseY + 5 }, 20, 2, GRAY);
+    DrawTextEx(meowFont, TextFormat("%.2f", maxFpsValue > options->targetFps ? maxFpsValue : options->targetFps), (Vector2) { graphX + 10, graphY + 10 }, 15, 2, WHITE);
+    DrawTextEx(meowFont, "0", (Vector2) { graphX + 10, graphY + graphHeight - 30 }, 15, 2, WHITE);
+}
+
+
+void DrawFrameTime(Camera2D* camera) {
+    int graphWidth = DEBUG_MAX_FPS_HISTORY;
+    int graphHeight = 200;
+    int graphX = baseX + BASE_SCREEN_WIDTH - 15 - graphWidth;
+    int graphY = baseY + 255;
+
+    float targetFrameTime = 1000.0f / options->targetFps;
+
+    // Find the maximum value in the DebugFrameTimeHistory array
+    float maxFrameTime = 0.0f;
+    for (int i = 0; i < DEBUG_MAX_FPS_HISTORY; i++) {
+        if (DebugFrameTimeHistory[i] > maxFrameTime) {
+            maxFrameTime = DebugFrameTimeHistory[i];
+        }
+    }
+
+    // Calculate the expected value based on the target FPS
+    float expectedFrameTime = 1000.0f / options->targetFps;
+
+    // Adjust the frameTimeScale based on the maximum value
+    float frameTimeScale = (maxFrameTime > 0) ? (float)graphHeight / maxFrameTime : 1.0f;
+
+    DrawRectangle(graphX, graphY, graphWidth, graphHeight, Fade(GRAY, 0.7));
+
+    // Draw the frame time history graph with color based on expected value
+    for (int i = 1; i < DEBUG_MAX_FPS_HISTORY; i++) {
+        int x1 = graphX + i - 1;
+        int x2 = graphX + i;
+        int y1 = graphY + graphHeight - (DebugFrameTimeHistory[(DebugFrameTimeHistoryIndex + i - 1) % DEBUG_MAX_FPS_HISTORY] * frameTimeScale);
+        int y2 = graphY + graphHeight - (DebugFrameTimeHistory[(DebugFrameTimeHistoryIndex + i) % DEBUG_MAX_FPS_HISTORY] * frameTimeScale);
+
+        // Calculate the ratio of the frame time to the expected frame time
+        float ratioToExpected = DebugFrameTimeHistory[(DebugFrameTimeHistoryIndex + i) % DEBUG_MAX_FPS_HISTORY] / expectedFrameTime;
+
+        // Set color based on the ratio to expected value
+        Color lineColor;
+        if (ratioToExpected <= 1.0f) {
+            lineColor = GREEN;
+        }
+        else if (ratioToExpected <= 1.5f) {
+            lineColor = YELLOW;
+        }
+        else {
+            lineColor = RED;
+        }
+
+        DrawLine(x1, y1, x2, y2, lineColor);
+    }
+
+    DrawTextEx(meowFont, "Frame Time (ms)", (Vector2) { baseX - 135 + BASE_SCREEN_WIDTH - 50, graphY - 25 }, 20, 2, GRAY);
+    DrawTextEx(meowFont, TextFormat("%.2f", maxFrameTime > expectedFrameTime ? maxFrameTime : expectedFrameTime), (Vector2) { graphX + 10, graphY + 10 }, 15, 2, WHITE);
+    DrawTextEx(meowFont, "0", (Vector2) { graphX + 10, graphY + graphHeight - 30 }, 15, 2, WHITE);
+}
+
+
+void UpdateDebugFpsHistory() {
+    DebugFpsHistory[DebugFpsHistoryIndex] = GetFPS();
+    DebugFpsHistoryIndex = (DebugFpsHistoryIndex + 1) % DEBUG_MAX_FPS_HISTORY;
+}
+
+void UpdateDebugFrameTimeHistory() {
+	DebugFrameTimeHistory[DebugFrameTimeHistoryIndex] = GetFrameTime() * 1000;
+	DebugFrameTimeHistoryIndex = (DebugFrameTimeHistoryIndex + 1) % DEBUG_MAX_FPS_HISTORY;
+}
+
+void DrawDebugStats(Camera2D* camera)
+{
+    DrawRectangle(baseX, baseY, 1100, 110, Fade(GRAY, 0.7));
+
+    Color color = GREEN;
+    int fps = GetFPS();
+
+    // Compare against the governed rate so throttled frames are not flagged
+    if (fps < frameGovernor.appliedFps * 0.7f) {
+		color = RED;
+	}
+	else if (fps < frameGovernor.appliedFps * 0.9f) {
+		color = YELLOW;
+	}
+
+    Vector2 mousePosition = GetSessionMousePosition();
+    Vector2 mouseWorldPos = GetScreenToWorld2D(mousePosition, *camera);
+
+    DrawTextEx(meowFont, TextFormat("%d FPS | Target FPS %d | Window (%dx%d) | Render (%dx%d) | Fullscreen ", fps, options->targetFps, options->resolution.x, options->resolution.y, BASE_SCREEN_WIDTH, BASE_SCREEN_HEIGHT, options->fullscreen ? "[Yes]" : "[No]"), (Vector2) { baseX + 10, baseY + 5 }, 20, 2, color);
+    DrawTextEx(meowFont, TextFormat("Cursor %.2f,%.2f (%dx%d) | World %.2f,%.2f (%dx%d) | R Base World %.2f,%.2f", mousePosition.x, mousePosition.y, options->resolution.x, options->resolution.y, mouseWorldPos.x, mouseWorldPos.y, BASE_SCREEN_WIDTH, BASE_SCREEN_HEIGHT, mouseWorldPos.x - baseX, mouseWorldPos.y - baseY), (Vector2) { baseX + 10, baseY + 25 }, 20, 2, WHITE);
+    DrawTextEx(meowFont, TextFormat("Zoom %.2f | In View %s | Governor %s (%d FPS) | Idle %.1fs%s", camera->zoom, IsMousePositionInGameWindow(camera) ? "[Yes]" : "[No]", StringFromFrameGovernorStateEnum(frameGovernor.state), frameGovernor.appliedFps, GetTime() - frameGovernor.lastInputTime, frameGovernor.audioPaused ? " | Audio [Paused]" : ""), (Vector2) { baseX + 10, baseY + 45 }, 20, 2, WHITE);
+    DrawTextEx(meowFont, TextFormat("Drag input to frame end | Event %.1f ms | Late latched %.1f ms | Samples %d", latencyProbe.earlyAverage * 1000.0, latencyProbe.lateAverage * 1000.0, latencyProbe.count), (Vector2) { baseX + 10, baseY + 65 }, 20, 2, WHITE);
+    DrawTextEx(meowFont, TextFormat("Input events | Queued %d | Consumed %d | Dropped %d", inputQueue.count, inputQueue.consumedLastFrame, inputQueue.dropped), (Vector2) { baseX + 10, baseY + 85 }, 20, 2, WHITE);
+}
+
+void DrawDebugOverlay(Camera2D *camera)
+{
+    if (options->showDebug)
+    {
+        // F1 - Toggle debug logs
+        if (IsSessionKeyPressed(KEY_F1))
+        {
+            debugToolToggles.showDebugLogs = !debugToolToggles.showDebugLogs;
+        }
+        // F2 - Toggle debug stats
+        else if (IsSessionKeyPressed(KEY_F2))
+        {
+            debugToolToggles.showStats = !debugToolToggles.showStats;
+        }
+        // F3 - Toggle debug graph
+        else if (IsSessionKeyPressed(KEY_F3))
+        {
+            debugToolToggles.showGraph = !debugToolToggles.showGraph;
+        }
+        //  F4 - Toggle debug objects
+        else if (IsSessionKeyPressed(KEY_F4))
+        {
+            debugToolToggles.showObjects = !debugToolToggles.showObjects;
+        }
+    }
+
+    UpdateDebugFpsHistory();
+    UpdateDebugFrameTimeHistory();
+
+    DrawRectangle(baseX + BASE_SCREEN_WIDTH - 15 - 300, baseY + BASE_SCREEN_HEIGHT - 15 - 110, 300, 140, Fade(GRAY, 0.7));
+    DrawTextEx(meowFont, "Debug Tools", (Vector2) { baseX + BASE_SCREEN_WIDTH - 15 - 290, baseY + BASE_SCREEN_HEIGHT - 15 - 100 }, 20, 2, WHITE);
+    DrawTextEx(meowFont, TextFormat("Logs | %s | F1", debugToolToggles.showDebugLogs ? "[On]" : "[Off]"), (Vector2) { baseX + BASE_SCREEN_WIDTH - 15 - 290, baseY + BASE_SCREEN_HEIGHT - 15 - 80 }, 20, 2, debugToolToggles.showDebugLogs ? GREEN : WHITE);
+    DrawTextEx(meowFont, TextFormat("Stats | %s | F2", debugToolToggles.showStats ? "[On]" : "[Off]"), (Vector2) { baseX + BASE_SCREEN_WIDTH - 15 - 290, baseY + BASE_SCREEN_HEIGHT - 15 - 60 }, 20, 2, debugToolToggles.showStats ? GREEN : WHITE);
+    DrawTextEx(meowFont, TextFormat("Graph | %s | F3", debugToolToggles.showGraph ? "[On]" : "[Off]"), (Vector2) { baseX + BASE_SCREEN_WIDTH - 15 - 290, baseY + BASE_SCREEN_HEIGHT - 15 - 40 }, 20, 2, debugToolToggles.showGraph ? GREEN : WHITE);
+    DrawTextEx(meowFont, TextFormat("Objects | %s | F4", debugToolToggles.showObjects ? "[On]" : "[Off]"), (Vector2) { baseX + BASE_SCREEN_WIDTH - 15 - 290, baseY + BASE_SCREEN_HEIGHT - 15 - 20 }, 20, 2, debugToolToggles.showObjects ? GREEN : WHITE);
+    
+    if (debugToolToggles.showDebugLogs)
+        DrawDebugLogs(camera);
+    if(debugToolToggles.showStats)
+        DrawDebugStats(camera);
+    if (debugToolToggles.showGraph)
+    {
+        DrawFpsGraph(camera);
+        DrawFrameTime(camera);
+    }
+
+}
+
+// void create_order(Order *order, char *first, char *second, char *third, char *fourth) {
+// 	order->first = first;
+// 	order->second = second;
+// 	order->third = third;
+// 	order->fourth = fourth;
+// }
+
+// void distribute_points(Order* order, char* first, char* second, char* third, char* fourth)
+// {
+//     if (first)
+//     {
+//         global_score += 50;
+//     }
+//     if (second)
+//     {
+//         global_score += 50;
+//     }
+//     if (third)
+//     {
+//         global_score += 50;
+//     }
+//     if (fourth)
+//     {
+//         global_score += 50;
+//     }
+// }
+
+int RandomCustomerTexture(Shift* shift);
+void tickBoil(Shift* shift, Ingredient* boiler);
+void StepSimBarista(Shift* shift);
+
+// Seats are spread evenly along the counter, three seats keep the original spots
+void InitCustomerPool(Shift* shift, int seatCount, double arrivalInterval)
+{
+    CustomerPool* pool = &shift->customers;
+    memset(pool, 0, sizeof(CustomerPool));
+
+    pool->seatCount = seatCount < MAX_SEATS ? seatCount : MAX_SEATS;
+    pool->arrivalInterval = arrivalInterval;
+
+    for (int i = 0; i < MAX_CUSTOMERS; i++)
+    {
+        pool->nextFree[i] = i + 1 < MAX_CUSTOMERS ? i + 1 : NO_CUSTOMER;
+        pool->seat[i] = NO_SEAT;
+    }
+    pool->freeHead = 0;
+
+    RandomCustomerInitialResetBasedOnDifficulty(shift, pool->seatResetTimer, pool->seatCount);
+
+    float spacing = pool->seatCount > 1 ? 1200.0f / (pool->seatCount - 1) : 0;
+    for (int i = 0; i < pool->seatCount; i++)
+    {
+        pool->seatPosition[i] = (Vector2){ baseX + 50 + spacing * i, baseY + 100 };
+        pool->seatCustomer[i] = NO_CUSTOMER;
+        pool->seatFreedAt[i] = shift->timers.time;
+        ScheduleTimer(&shift->timers, TIMER_SEAT_RESPAWN, i, pool->seatGeneration[i], pool->seatResetTimer[i]);
+    }
+
+    if (pool->arrivalInterval > 0)
+        ScheduleTimer(&shift->timers, TIMER_CUSTOMER_ARRIVAL, 0, 0, pool->arrivalInterval);
+}
+
+// Takes a customer from the free list with a fresh order, NO_CUSTOMER when the pool is full
+int AcquireCustomer(Shift* shift)
+{
+    CustomerPool* pool = &shift->customers;
+    int customer = pool->freeHead;
+    if (customer == NO_CUSTOMER) return NO_CUSTOMER;
+
+    pool->freeHead = pool->nextFree[customer];
+    pool->liveCount++;
+
+    pool->emotion[customer] = EMOTION_HAPPY;
+    pool->eyesClosed[customer] = false;
+    pool->blinkDuration[customer] = NextRandomDouble(&shift->random[RANDOM_CUSTOMERS], 0.2, 0.5);
+    pool->normalDuration[customer] = NextRandomDouble(&shift->random[RANDOM_CUSTOMERS], 2.0, 6.0);
+    pool->orderEnd[customer] = RandomCustomerTimeoutBasedOnDifficulty(shift);
+    pool->order[customer] = RandomGenerateOrder(shift);
+    pool->textureType[customer] = RandomCustomerTexture(shift);
+    pool->seat[customer] = NO_SEAT;
+
+    return customer;
+}
+
+// Seating fixes every mood change and the timeout as absolute deadlines
+void SeatCustomer(Shift* shift, int customer, int seat)
+{
+    CustomerPool* pool = &shift->customers;
+    unsigned int generation = pool->generation[customer];
+
+    pool->seat[customer] = seat;
+    pool->position[customer] = pool->seatPosition[seat];
+    pool->seatedAt[customer] = shift->timers.time;
+    pool->seatCustomer[seat] = customer;
+    pool->seatGeneration[seat]++;
+
+    ScheduleTimer(&shift->timers, TIMER_CUSTOMER_FRUSTRATED, customer, generation, pool->orderEnd[customer] * 0.5);
+    ScheduleTimer(&shift->timers, TIMER_CUSTOMER_ANGRY, customer, generation, pool->orderEnd[customer] * 0.75);
+    ScheduleTimer(&shift->timers, TIMER_CUSTOMER_TIMEOUT, customer, generation, pool->orderEnd[customer]);
+    ScheduleTimer(&shift->timers, TIMER_CUSTOMER_BLINK, customer, generation, pool->normalDuration[customer]);
+}
+
+// First in line takes the seat, returns false when nobody is waiting
+bool SeatNextInQueue(Shift* shift, int seat)
+{
+    CustomerPool* pool = &shift->customers;
+    if (pool->queueCount == 0) return false;
+
+    SeatCustomer(shift, pool->queue[pool->queueHead], seat);
+    pool->queueHead = (pool->queueHead + 1) % MAX_CUSTOMERS;
+    pool->queueCount--;
+    return true;
+}
+
+bool validiator(CustomerPool* pool, int customer, Recipe order)
+{
+	if (pool->order[customer] == order)
+	{
+        return true;
+	}
+	else
+	{
+        return false;
+	}
+}
+
+// Linear sweep over the seats
+void render_customers(const Shift* shift)
+{
+    const CustomerPool* pool = &shift->customers;
+    for (int seat = 0; seat < pool->seatCount; seat++)
+    {
+        int customer = pool->seatCustomer[seat];
+        if (customer == NO_CUSTOMER) continue;
+
+        DrawCustomerSprite(pool->textureType[customer], pool->emotion[customer], pool->eyesClosed[customer], pool->position[customer]);
+        DrawOrderBubble(pool->order[customer], pool->position[customer]);
+    }
+
+    if (options->showDebug && debugToolToggles.showObjects)
+    {
+        for (int seat = 0; seat < pool->seatCount; seat++)
+        {
+            int customer = pool->seatCustomer[seat];
+            Vector2 pos = pool->seatPosition[seat];
+
+            DrawRectangle(pos.x, pos.y - 20, 500, 60, Fade(GRAY, 0.7));
+            if (customer == NO_CUSTOMER)
+            {
+                DrawTextEx(meowFont, TextFormat("Seat %d | Reset %.2f/%.2f", seat, (float)(shift->timers.time - pool->seatFreedAt[seat]), (float)pool->seatResetTimer[seat]), (Vector2) { pos.x, pos.y - 20 }, 20, 1, WHITE);
+                DrawTextEx(meowFont, TextFormat("Queue %d | Live %d/%d | Timers %d", pool->queueCount, pool->liveCount, MAX_CUSTOMERS, shift->timers.count), (Vector2) { pos.x, pos.y }, 20, 1, WHITE);
+                continue;
+            }
+
+            const CustomerImageData* image = &customersImageData[pool->textureType[customer]];
+            DrawRectangleLinesEx((Rectangle) { pos.x, pos.y, image->happy.width / 2, image->happy.height / 2 }, 1, RED);
+            DrawTextEx(meowFont, TextFormat("%s | Blink %s (%.2f/%.2f)", StringFromCustomerEmotionEnum(pool->emotion[customer]), pool->eyesClosed[customer] ? "[Yes]" : "[No]", pool->blinkDuration[customer], pool->normalDuration[customer]), (Vector2) { pos.x, pos.y - 20 }, 20, 1, WHITE);
+            DrawTextEx(meowFont, TextFormat("Timeout %.2f/%.2f", (float)(shift->timers.time - pool->seatedAt[customer]), (float)pool->orderEnd[customer]), (Vector2) { pos.x, pos.y }, 20, 1, WHITE);
+            DrawTextEx(meowFont, TextFormat("Seat %d | Customer %d | Order %s", seat, customer, RecipeName(pool->order[customer])), (Vector2) { pos.x, pos.y + 20 }, 20, 1, WHITE);
+        }
+    }
+}
+
+//Yandere dev inspired programming.
+
+// Frees the seat and returns its customer to the free list, pending timers of the customer go stale
+void RemoveCustomer(Shift* shift, int seat)
+{
+    CustomerPool* pool = &shift->customers;
+    int customer = pool->seatCustomer[seat];
+
+    if (customer != NO_CUSTOMER)
+    {
+        pool->seat[customer] = NO_SEAT;
+        pool->generation[customer]++;
+        pool->nextFree[customer] = pool->freeHead;
+        pool->freeHead = customer;
+        pool->liveCount--;
+    }
+
+    pool->seatCustomer[seat] = NO_CUSTOMER;
+    pool->seatGeneration[seat]++;
+
+    if (SeatNextInQueue(shift, seat)) return;
+
+    pool->seatFreedAt[seat] = shift->timers.time;
+    pool->seatResetTimer[seat] = RandomCustomerResetBasedOnDifficulty(shift);
+    ScheduleTimer(&shift->timers, TIMER_SEAT_RESPAWN, seat, pool->seatGeneration[seat], pool->seatResetTimer[seat]);
+}
+
+// Advances simulation time and handles only the timers that expired
+void Tick(Shift* shift, float deltaTime) {
+    CustomerPool* pool = &shift->customers;
+    AdvanceTimers(&shift->timers, deltaTime);
+
+    Timer timer;
+    while (PopExpiredTimer(&shift->timers, &timer)) {
+        int customer = timer.target;
+
+        switch (timer.type)
+        {
+        case TIMER_CUSTOMER_FRUSTRATED:
+        case TIMER_CUSTOMER_ANGRY:
+        case TIMER_CUSTOMER_TIMEOUT:
+        case TIMER_CUSTOMER_BLINK:
+            if (pool->generation[customer] != timer.generation) break;
+
+            if (timer.type == TIMER_CUSTOMER_FRUSTRATED) {
+                pool->emotion[customer] = EMOTION_FRUSTRATED;
+            }
+            else if (timer.type == TIMER_CUSTOMER_ANGRY) {
+                pool->emotion[customer] = EMOTION_ANGRY;
+            }
+            else if (timer.type == TIMER_CUSTOMER_TIMEOUT) {
+                if (!shift->simulated)
+                    PlaySoundFx(FX_ANGRY);
+                RemoveCustomer(shift, pool->seat[customer]);
+                shift->score -= 50;
+                shift->stats.timeouts++;
+            }
+            else {
+                pool->eyesClosed[customer] = !pool->eyesClosed[customer];
+                ScheduleTimer(&shift->timers, TIMER_CUSTOMER_BLINK, customer, timer.generation, pool->eyesClosed[customer] ? pool->blinkDuration[customer] : pool->normalDuration[customer]);
+            }
+            break;
+        case TIMER_SEAT_RESPAWN:
+            if (pool->seatGeneration[timer.target] != timer.generation || pool->seatCustomer[timer.target] != NO_CUSTOMER) break;
+
+            customer = AcquireCustomer(shift);
+            if (customer != NO_CUSTOMER)
+                SeatCustomer(shift, customer, timer.target);
+            break;
+        case TIMER_CUSTOMER_ARRIVAL:
+            // Rush hour arrivals take a free seat or wait in line
+            customer = AcquireCustomer(shift);
+            if (customer != NO_CUSTOMER) {
+                int seat = 0;
+                while (seat < pool->seatCount && pool->seatCustomer[seat] != NO_CUSTOMER) seat++;
+
+                if (seat < pool->seatCount) {
+                    SeatCustomer(shift, customer, seat);
+                }
+                else {
+                    pool->queue[(pool->queueHead + pool->queueCount) % MAX_CUSTOMERS] = customer;
+                    pool->queueCount++;
+                }
+            }
+            ScheduleTimer(&shift->timers, TIMER_CUSTOMER_ARRIVAL, 0, 0, pool->arrivalInterval);
+            break;
+        case TIMER_BOILER_BUBBLE:
+            if (timer.generation != shift->boilerGeneration || !shift->boilerHeating) break;
+
+            shift->boilerReady = true;
+            if (!shift->simulated)
+                tickBoil(shift, &ingredients[INGREDIENT_HOT_WATER]);
+            break;
+        case TIMER_BARISTA_STEP:
+            StepSimBarista(shift);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// A fresh shift, the game passes the session streams, simulated shifts their own
+void BeginShift(Shift* shift, Difficulty difficulty, RandomStream* random, bool simulated)
+{
+    shift->random = random;
+    shift->difficulty = difficulty;
+    shift->score = 0;
+    shift->stats = (ShiftStats){ 0 };
+    shift->boilerHeating = false;
+    shift->boilerReady = false;
+    shift->boilerGeneration++;
+    shift->simulated = simulated;
+
+    ClearTimers(&shift->timers);
+    shift->timers.silent = simulated;
+    InitCustomerPool(shift, DEFAULT_SEATS, 0);
+}
+
+// Gesture timings match the autoplayer's, including its pause after every gesture
+void ScheduleBaristaStep(Shift* shift, float seconds)
+{
+    double delay = (seconds + 0.25f) / shift->barista.speed * NextRandomDouble(&shift->random[RANDOM_BOT], 0.8, 1.2);
+    ScheduleTimer(&shift->timers, TIMER_BARISTA_STEP, 0, 0, delay);
+}
+
+// Serves the longest waiting customer one gesture per step, the same way the autoplayer plays
+void StepSimBarista(Shift* shift)
+{
+    SimBarista* barista = &shift->barista;
+    CustomerPool* pool = &shift->customers;
+
+    // A drink for a customer who already left goes in the trash
+    if (barista->customer != NO_CUSTOMER && (pool->generation[barista->customer] != barista->generation || pool->seat[barista->customer] == NO_SEAT))
+    {
+        barista->customer = NO_CUSTOMER;
+        if (barista->step > 1)
+        {
+            ResetCup(&barista->cup);
+            barista->cup.active = false;
+            ScheduleBaristaStep(shift, 0.4f);
+            return;
+        }
+    }
+
+    if (barista->customer == NO_CUSTOMER)
+    {
+        barista->customer = PickAutoplayerCustomer(pool);
+        if (barista->customer == NO_CUSTOMER)
+        {
+            ScheduleTimer(&shift->timers, TIMER_BARISTA_STEP, 0, 0, 0.5f / barista->speed);
+            return;
+        }
+        barista->generation = pool->generation[barista->customer];
+        barista->step = 0;
+    }
+
+    // Fetch a cup
+    if (barista->step == 0)
+    {
+        ResetCup(&barista->cup);
+        barista->cup.active = true;
+        barista->step = 1;
+        ScheduleBaristaStep(shift, 0.4f);
+        return;
+    }
+
+    // Slots in the order UpdateCup accepts them
+    static const IngredientCategory steps[] = { CATEGORY_POWDER, CATEGORY_WATER, CATEGORY_CREAMER, CATEGORY_TOPPING, CATEGORY_SAUCE };
+    Recipe order = pool->order[barista->customer];
+    int wanted[] = {
+        (order >> RECIPE_POWDER_SHIFT) & 3, (order >> RECIPE_WATER_SHIFT) & 1, (order >> RECIPE_CREAMER_SHIFT) & 3,
+        (order >> RECIPE_TOPPING_SHIFT) & 3, (order >> RECIPE_SAUCE_SHIFT) & 3,
+    };
+    while (barista->step <= 5 && wanted[barista->step - 1] == 0) barista->step++;
+
+    if (barista->step <= 5)
+    {
+        int slot = wanted[barista->step - 1];
+
+        // The boiler has to be switched on and heated before it pours
+        if (barista->step == 2)
+        {
+            if (!shift->boilerReady)
+            {
+                if (!shift->boilerHeating)
+                {
+                    StartBoiler(shift);
+                    ScheduleBaristaStep(shift, 0.1f);
+                }
+                else
+                    ScheduleTimer(&shift->timers, TIMER_BARISTA_STEP, 0, 0, 0.2f / barista->speed);
+                return;
+            }
+            shift->boilerHeating = false;
+            shift->boilerReady = false;
+        }
+        else if (NextRandomDouble(&shift->random[RANDOM_BOT], 0.0, 1.0) < barista->errorRate)
+            slot = 3 - slot;
+
+        AddIngredientToCup(&barista->cup, FindIngredientIdForSlot(steps[barista->step - 1], slot));
+        barista->step++;
+        ScheduleBaristaStep(shift, 0.35f);
+        return;
+    }
+
+    // Hand it over, a wrong drink is remade for the same customer
+    if (ServeCup(shift, &barista->cup, barista->customer))
+        barista->customer = NO_CUSTOMER;
+    barista->step = 0;
+    ScheduleBaristaStep(shift, 0.5f);
+}
+
+// Batched simulation, shifts are stepped at the game's frame rate as fast as the CPU allows
+#define SIM_STEP (1.0f / 60.0f)
+
+typedef struct {
+    Difficulty difficulty;
+    uint64_t seed;
+    int score;
+    ShiftStats stats;
+    int droppedTimers;
+} SimJob;
+
+typedef struct {
+    SimJob* jobs;
+    int jobCount;
+    int nextJob;
+    float baristaSpeed;
+    float baristaErrorRate;
+#if SIM_THREADS
+    pthread_mutex_t lock;
+#endif
+} SimBatch;
+
+void RunSimulatedShift(Shift* shift, SimJob* job, float speed, float errorRate)
+{
+    SeedRandomStreamSet(shift->ownRandom, job->seed);
+    BeginShift(shift, job->difficulty, shift->ownRandom, true);
+
+    shift->barista = (SimBarista){ .speed = speed, .errorRate = errorRate, .customer = NO_CUSTOMER };
+    ScheduleTimer(&shift->timers, TIMER_BARISTA_STEP, 0, 0, 0);
+
+    while (shift->timers.time < gameDuration)
+        Tick(shift, SIM_STEP);
+
+    job->score = shift->score;
+    job->stats = shift->stats;
+    job->droppedTimers = shift->timers.dropped;
+}
+
+int TakeSimJob(SimBatch* batch)
+{
+#if SIM_THREADS
+    pthread_mutex_lock(&batch->lock);
+#endif
+    int job = batch->nextJob < batch->jobCount ? batch->nextJob++ : -1;
+#if SIM_THREADS
+    pthread_mutex_unlock(&batch->lock);
+#endif
+    return job;
+}
+
+// Workers pull jobs until the batch is drained, every job writes only its own result
+void* SimWorker(void* arg)
+{
+    SimBatch* batch = (SimBatch*)arg;
+    Shift* shift = (Shift*)calloc(1, sizeof(Shift));
+
+    int job;
+    while ((job = TakeSimJob(batch)) >= 0)
+        RunSimulatedShift(shift, &batch->jobs[job], batch->baristaSpeed, batch->baristaErrorRate);
+
+    free(shift);
+    return NULL;
+}
+
+int CompareInts(const void* a, const void* b)
+{
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// Runs the given number of shifts per difficulty and prints one row of aggregate stats for each
+// Job seeds only depend on the seed and the job index, so the numbers do not change with the thread count
+int RunSimulation(int shiftsPerDifficulty, int threadCount, float speed, float errorRate, uint64_t seed)
+{
+    static const Difficulty difficulties[] = { EASY, MEDIUM, HARD };
+    const int difficultyCount = sizeof(difficulties) / sizeof(difficulties[0]);
+
+    SimBatch batch = { 0 };
+    batch.jobCount = shiftsPerDifficulty * difficultyCount;
+    batch.jobs = (SimJob*)calloc(batch.jobCount, sizeof(SimJob));
+    batch.baristaSpeed = speed;
+    batch.baristaErrorRate = errorRate;
+    for (int i = 0; i < batch.jobCount; i++)
+    {
+        batch.jobs[i].difficulty = difficulties[i / shiftsPerDifficulty];
+        batch.jobs[i].seed = seed + (uint64_t)i * 0x9E3779B97F4A7C15ULL;
+    }
+
+    double startTime = GetMonotonicTime();
+
+#if SIM_THREADS
+    if (threadCount <= 0)
+        threadCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threadCount < 1) threadCount = 1;
+    if (threadCount > batch.jobCount) threadCount = batch.jobCount;
+
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_t* threads = (pthread_t*)malloc(threadCount * sizeof(pthread_t));
+    int started = 0;
+    for (int i = 0; i < threadCount; i++)
+    {
+        if (pthread_create(&threads[started], NULL, SimWorker, &batch) == 0) started++;
+    }
+    // Whatever could not get a thread runs here
+    if (started == 0) SimWorker(&batch);
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    pthread_mutex_destroy(&batch.lock);
+#else
+    threadCount = 1;
+    SimWorker(&batch);
+#endif
+
+    double elapsed = GetMonotonicTime() - startTime;
+
+    // Worker shifts keep quiet for the same reason as their orders, dropped timers are reported once for the whole batch
+    int droppedTimers = 0;
+    for (int i = 0; i < batch.jobCount; i++)
+        droppedTimers += batch.jobs[i].droppedTimers;
+    if (droppedTimers > 0)
+        Log(LOG_WARNING, "Timer heaps were full, dropped %d timers across the batch", droppedTimers);
+
+    printf("Simulated %d shifts of %.0fs on %d threads in %.2fs (%.0fx real time)\n", batch.jobCount, gameDuration, threadCount, elapsed,
+        elapsed > 0 ? batch.jobCount * gameDuration / elapsed : 0.0);
+    printf("Barista speed %.2f, error rate %.2f, seed %llu\n\n", speed, errorRate, (unsigned long long)seed);
+    printf("%-10s %8s %8s %8s %8s | %8s %8s %6s %6s %6s %6s %6s\n", "Difficulty", "Shifts", "Served", "Wrong", "Timeouts", "Score", "StdDev", "Min", "P10", "P50", "P90", "Max");
+
+    int* scores = (int*)malloc(shiftsPerDifficulty * sizeof(int));
+    for (int d = 0; d < difficultyCount; d++)
+    {
+        SimJob* jobs = &batch.jobs[d * shiftsPerDifficulty];
+        double served = 0, wrong = 0, timeouts = 0, sum = 0, sumSquares = 0;
+
+        for (int i = 0; i < shiftsPerDifficulty; i++)
+        {
+            served += jobs[i].stats.served;
+            wrong += jobs[i].stats.wrong;
+            timeouts += jobs[i].stats.timeouts;
+            sum += jobs[i].score;
+            sumSquares += (double)jobs[i].score * jobs[i].score;
+            scores[i] = jobs[i].score;
+        }
+        qsort(scores, shiftsPerDifficulty, sizeof(int), CompareInts);
+
+        double count = shiftsPerDifficulty;
+        double mean = sum / count;
+        double variance = fmax(sumSquares / count - mean * mean, 0.0);
+        printf("%-10s %8d %8.2f %8.2f %8.2f | %8.1f %8.1f %6d %6d %6d %6d %6d\n", StringFromDifficultyEnum(difficulties[d]), shiftsPerDifficulty,
+            served / count, wrong / count, timeouts / count, mean, sqrt(variance), scores[0], scores[shiftsPerDifficulty / 10],
+            scores[shiftsPerDifficulty / 2], scores[shiftsPerDifficulty * 9 / 10], scores[shiftsPerDifficulty - 1]);
+    }
+
+    free(scores);
+    free(batch.jobs);
+    return 0;
+}
+
+/* Definitions terminates*/
+
+
+void PlaySoundFx(SoundFxType type) {
+    int randomIndex = 0;
+
+    if (!options->soundFxEnabled) return;
+
+    switch (type) {
+    case FX_ANGRY: {
+        Sound angrySounds[] = { angry1Fx, angry2Fx, angry3Fx, angry4Fx };
+        randomIndex = GetRandomIntValue(RANDOM_AUDIO, 0, (sizeof(angrySounds) / sizeof(angrySounds[0])) - 1);
+        PlaySound(angrySounds[randomIndex]);
+        break;
+    }
+    case FX_BOTTLE: {
+        Sound bottleSounds[] = { bottle1Fx, bottle2Fx, bottle3Fx };
+        randomIndex = GetRandomIntValue(RANDOM_AUDIO, 0, (sizeof(bottleSounds) / sizeof(bottleSounds[0])) - 1);
+        PlaySound(bottleSounds[randomIndex]);
+        break;
+    }
+    case FX_CONFUSED: {
+        Sound confusedSounds[] = { confused1Fx, confused2Fx, confused3Fx, confused4Fx };
+        randomIndex = GetRandomIntValue(RANDOM_AUDIO, 0, (sizeof(confusedSounds) / sizeof(confusedSounds[0])) - 1);
+        PlaySound(confusedSounds[randomIndex]);
+        break;
+    }
+    case FX_CORRECT:
+        PlaySound(correctFx);
+        break;
+    case FX_DROP: {
+        Sound dropSounds[] = { drop1Fx, drop2Fx, drop3Fx };
+        randomIndex = GetRandomIntValue(RANDOM_AUDIO, 0, (sizeof(dropSounds) / sizeof(dropSounds[0])) - 1);
+        PlaySound(dropSounds[randomIndex]);
+        break;
+    }
+    case FX_PICKUP: {
+        Sound pickupSounds[] = { pickup1Fx, pickup2Fx, pickup3Fx };
+        randomIndex = GetRandomIntValue(RANDOM_AUDIO, 0, (sizeof(pickupSounds) / sizeof(pickupSounds[0])) - 1);
+        PlaySound(pickupSounds[randomIndex]);
+        break;
+    }
+    case FX_POUR: {
+        Sound pourSounds[] = { pour1Fx, pour2Fx, pour3Fx };
+        randomIndex = GetRandomIntValue(RANDOM_AUDIO, 0, (sizeof(pourSounds) / sizeof(pourSounds[0])) - 1);
+        PlaySound(pourSounds[randomIndex]);
+        break;
+    }
+    case FX_STIR: {
+        Sound stirSounds[] = { stir1Fx, stir2Fx, stir3Fx };
+        randomIndex = GetRandomIntValue(RANDOM_AUDIO, 0, (sizeof(stirSounds) / sizeof(stirSounds[0])) - 1);
+        PlaySound(stirSounds[randomIndex]);
+        break;
+    }
+    case FX_BOONG:
+        PlaySound(boongFx);
+        break;
+    case FX_HOVER:
+        PlaySound(hoverFx);
+        break;
+    case FX_SELECT:
+        PlaySound(selectFx);
+        break;
+    case FX_FLICK:
+        PlaySound(flickFx);
+    }
+}
+bool HasUserInput()
+{
+    // GetKeyPressed only drains the key queue, IsKeyPressed/IsKeyDown are not affected
+    if (GetKeyPressed() != 0) return true;
+    if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) || IsMouseButtonDown(MOUSE_BUTTON_RIGHT) || IsMouseButtonDown(MOUSE_BUTTON_MIDDLE)) return true;
+    if (GetMouseWheelMove() != 0.0f) return true;
+    if (GetTouchPointCount() > 0) return true;
+
+    Vector2 mouseDelta = GetMouseDelta();
+    return mouseDelta.x != 0.0f || mouseDelta.y != 0.0f;
+}
+
+void UpdateFrameGovernor()
+{
+    double now = GetTime();
+
+    if (HasUserInput() || frameGovernor.lastInputTime == 0.0)
+        frameGovernor.lastInputTime = now;
+
+    // Hidden and unfocused windows take priority over idle
+    if (!options->powerSaving)
+        frameGovernor.state = GOVERNOR_ACTIVE;
+    else if (IsWindowHidden() || IsWindowMinimized())
+        frameGovernor.state = GOVERNOR_HIDDEN;
+    else if (!IsWindowFocused())
+        frameGovernor.state = GOVERNOR_UNFOCUSED;
+    else if (now - frameGovernor.lastInputTime > options->idleTimeout)
+        frameGovernor.state = GOVERNOR_IDLE;
+    else
+        frameGovernor.state = GOVERNOR_ACTIVE;
+
+    int fps = options->targetFps;
+    if (frameGovernor.state == GOVERNOR_IDLE)
+        fps = GOVERNOR_IDLE_FPS;
+    else if (frameGovernor.state == GOVERNOR_UNFOCUSED || frameGovernor.state == GOVERNOR_HIDDEN)
+        fps = GOVERNOR_BACKGROUND_FPS;
+
+    if (fps != frameGovernor.appliedFps)
+    {
+        SetTargetFPS(fps);
+        frameGovernor.appliedFps = fps;
+        LogDebug("Frame governor %s, target FPS %d", StringFromFrameGovernorStateEnum(frameGovernor.state), fps);
+    }
+
+    // Pause the current BGM while the governor is throttling, resume it on wake
+    bool shouldPauseAudio = options->pauseAudioWhenIdle && frameGovernor.state != GOVERNOR_ACTIVE;
+    if (shouldPauseAudio && !frameGovernor.audioPaused)
+    {
+        if (currentBgm != NULL && !isCurrentBgmPaused)
+            PauseMusicStream(*currentBgm);
+        frameGovernor.audioPaused = true;
+    }
+    else if (!shouldPauseAudio && frameGovernor.audioPaused)
+    {
+        if (currentBgm != NULL && !isCurrentBgmPaused)
+            ResumeMusicStream(*currentBgm);
+        frameGovernor.audioPaused = false;
+    }
+}
+
+void WindowUpdate(Camera2D* camera)
+{
+    BeginSessionFrame();
+
+    if (IsSessionWindowResized())
+    {
+        int screenWidth = session.frame.screenWidth;
+        int screenHeight = session.frame.screenHeight;
+
+
+        float currentAspectRatio = (float)screenWidth / (float)screenHeight;
+        float scale = (currentAspectRatio > targetAspectRatio) ? (float)screenHeight / BASE_SCREEN_HEIGHT : (float)screenWidth / BASE_SCREEN_WIDTH;
+
+        camera->zoom = scale;
+        camera->offset.x = screenWidth / 2.0f;
+        camera->offset.y = screenHeight / 2.0f;
+
+        options->resolution.x = screenWidth;
+        options->resolution.y = screenHeight;
+    }
+
+    // Alt - Enter fullscreen
+    if (IsSessionKeyDown(KEY_LEFT_ALT) && IsSessionKeyPressed(KEY_ENTER) || IsSessionKeyDown(KEY_RIGHT_ALT) && IsSessionKeyPressed(KEY_ENTER))
+    {
+        SetRuntimeResolution(camera, BASE_SCREEN_WIDTH, BASE_SCREEN_HEIGHT);
+        ToggleFullscreen();
+    }
+
+    // ESC - Exit application
+    if (IsSessionKeyPressed(KEY_ESCAPE))
+	{
+        ExitApplication();
+	}
+
+    UpdateFrameGovernor();
+
+    if(currentBgm != NULL && !frameGovernor.audioPaused)
+        UpdateMusicStream(*currentBgm);
+}
+
+// The splash loads the global assets one batch a frame so its fades keep playing, the batches are about even
+typedef enum {
+    GLOBAL_LOAD_INTERFACE = 0,
+    GLOBAL_LOAD_SOUNDS,
+    GLOBAL_LOAD_INGREDIENTS,
+    GLOBAL_LOAD_RECIPES,
+    GLOBAL_LOAD_CUSTOMERS,
+    GLOBAL_LOAD_MENU,
+    GLOBAL_LOAD_STEP_COUNT
+} GlobalLoadStep;
+
+GlobalLoadStep globalLoadStep = GLOBAL_LOAD_INTERFACE;
+double globalLoadTime = 0.0;            // Spent inside the steps, the frames between them do not count
+
+// Loads the next batch, true once everything is loaded. The call after that starts over
+bool LoadGlobalAssetsStep()
+{
+    double startTime = GetTime();
+
+    switch (globalLoadStep)
+    {
+    case GLOBAL_LOAD_INTERFACE:
+        isGlobalAssetsLoadFinished = false;
+        globalLoadTime = 0.0;
+        backgroundTexture = LoadTexture(ASSETS_PATH"image/backgrounds/main.png");
+        backgroundOverlayTexture = LoadTexture(ASSETS_PATH"image/backgrounds/main_overlay_1.png");
+        backgroundOverlaySidebarTexture = LoadTexture(ASSETS_PATH"image/backgrounds/main_overlay_2.png");
+        pawTexture = LoadTexture(ASSETS_PATH"image/elements/paw.png");
+
+        checkbox = LoadTexture(ASSETS_PATH"image/elements/checkbox.png");
+        checkboxChecked = LoadTexture(ASSETS_PATH"image/elements/checkbox_checked.png");
+        left_arrow = LoadTexture(ASSETS_PATH"image/elements/left_arrow.png");
+        right_arrow = LoadTexture(ASSETS_PATH"image/elements/right_arrow.png");
+
+        customerTexture_first_happy = LoadTexture(ASSETS_PATH"image/sprite/customer_happy.png");
+        customerTexture_second_happy = LoadTexture(ASSETS_PATH"image/sprite/customer_happy.png");
+        customerTexture_third_happy = LoadTexture(ASSETS_PATH"image/sprite/customer_happy.png");
+        customerTexture_first_normal = LoadTexture(ASSETS_PATH"image/sprite/customer_normal.png");
+        customerTexture_second_normal = LoadTexture(ASSETS_PATH"image/sprite/customer_normal.png");
+        customerTexture_third_normal = LoadTexture(ASSETS_PATH"image/sprite/customer_normal.png");
+        customerTexture_first_angry = LoadTexture(ASSETS_PATH"image/sprite/customer_angry.png");
+        customerTexture_second_angry = LoadTexture(ASSETS_PATH"image/sprite/customer_angry.png");
+        customerTexture_third_angry = LoadTexture(ASSETS_PATH"image/sprite/customer_angry.png");
+        break;
+
+    case GLOBAL_LOAD_SOUNDS:
+        hoverFx = LoadSound(ASSETS_PATH"audio/hover.wav");
+        selectFx = LoadSound(ASSETS_PATH"audio/select.wav");
+        boongFx = LoadSound(ASSETS_PATH"audio/boong.wav");
+
+        angry1Fx = LoadSound(ASSETS_PATH"audio/angry_1.wav");
+        angry2Fx = LoadSound(ASSETS_PATH"audio/angry_2.wav");
+        angry3Fx = LoadSound(ASSETS_PATH"audio/angry_3.wav");
+        angry4Fx = LoadSound(ASSETS_PATH"audio/angry_4.wav");
+
+        bottle1Fx = LoadSound(ASSETS_PATH"audio/bottle_1.wav");
+        bottle2Fx = LoadSound(ASSETS_PATH"audio/bottle_2.wav");
+        bottle3Fx = LoadSound(ASSETS_PATH"audio/bottle_3.wav");
+
+        confused1Fx = LoadSound(ASSETS_PATH"audio/confused_1.wav");
+        confused2Fx = LoadSound(ASSETS_PATH"audio/confused_2.wav");
+        confused3Fx = LoadSound(ASSETS_PATH"audio/confused_3.wav");
+        confused4Fx = LoadSound(ASSETS_PATH"audio/confused_4.wav");
+
+        correctFx = LoadSound(ASSETS_PATH"audio/correct.wav");
+
+        drop1Fx = LoadSound(ASSETS_PATH"audio/drop_1.wav");
+        drop2Fx = LoadSound(ASSETS_PATH"audio/drop_2.wav");
+        drop3Fx = LoadSound(ASSETS_PATH"audio/drop_3.wav");
+
+        pickup1Fx = LoadSound(ASSETS_PATH"audio/pickup_1.wav");
+        pickup2Fx = LoadSound(ASSETS_PATH"audio/pickup_2.wav");
+        pickup3Fx = LoadSound(ASSETS_PATH"audio/pickup_3.wav");
+
+        pour1Fx = LoadSound(ASSETS_PATH"audio/pour_1.wav");
+        pour2Fx = LoadSound(ASSETS_PATH"audio/pour_2.wav");
+        pour3Fx = LoadSound(ASSETS_PATH"audio/pour_3.wav");
+
+        stir1Fx = LoadSound(ASSETS_PATH"audio/stir_1.wav");
+        stir2Fx = LoadSound(ASSETS_PATH"audio/stir_2.wav");
+        stir3Fx = LoadSound(ASSETS_PATH"audio/stir_3.wav");
+
+        flickFx = LoadSound(ASSETS_PATH"audio/flick.wav");
+        break;
+
+    case GLOBAL_LOAD_INGREDIENTS:
+        menuFallingItemTextures[0] = LoadTexture(ASSETS_PATH"image/falling_items/cara.png");
+        menuFallingItemTextures[1] = LoadTexture(ASSETS_PATH"image/falling_items/cmilk.png");
+        menuFallingItemTextures[2] = LoadTexture(ASSETS_PATH"image/falling_items/cocoa.png");
+        menuFallingItemTextures[3] = LoadTexture(ASSETS_PATH"image/falling_items/gar.png");
+        menuFallingItemTextures[4] = LoadTexture(ASSETS_PATH"image/falling_items/marshmello.png");
+        menuFallingItemTextures[5] = LoadTexture(ASSETS_PATH"image/falling_items/matcha.png");
+        menuFallingItemTextures[6] = LoadTexture(ASSETS_PATH"image/falling_items/milk.png");
+        menuFallingItemTextures[7] = LoadTexture(ASSETS_PATH"image/falling_items/wcream.png");
+
+        for (int i = 0; i < INGREDIENT_COUNT; i++)
+            ingredientTextures[i] = LoadTextureWithHitMask(ingredientInfo[i].spritePath, &ingredientHitMasks[i]);
+
+        cupsTexture = LoadTextureWithHitMask(ASSETS_PATH"/spritesheets/CUPS.png", &cupsHitMask);
+        break;
+
+    case GLOBAL_LOAD_RECIPES:
+        LoadRecipeTables(true);
+        if (!LoadRecipeCatalog(&recipeCatalog, RECIPE_CATALOG_FILE))
+            LoadDefaultRecipeCatalog(&recipeCatalog);
+        break;
+
+    case GLOBAL_LOAD_CUSTOMERS:
+        for (int i = 0; i < 3; i++)
+        {
+            customersImageData[i].happy = LoadTextureWithHitMask(TextFormat(ASSETS_PATH"image/sprite/customer_%d/happy.png", i + 1), &customersImageData[i].hitMask);
+            customersImageData[i].happyEyesClosed = LoadTexture(TextFormat(ASSETS_PATH"image/sprite/customer_%d/happy_eyes_closed.png", i + 1));
+            customersImageData[i].frustrated = LoadTexture(TextFormat(ASSETS_PATH"image/sprite/customer_%d/frustrated.png", i + 1));
+            customersImageData[i].frustratedEyesClosed = LoadTexture(TextFormat(ASSETS_PATH"image/sprite/customer_%d/frustrated_eyes_closed.png", i + 1));
+            customersImageData[i].angry = LoadTexture(TextFormat(ASSETS_PATH"image/sprite/customer_%d/angry.png", i + 1));
+            customersImageData[i].angryEyesClosed = LoadTexture(TextFormat(ASSETS_PATH"image/sprite/customer_%d/angry_eyes_closed.png", i + 1));
+        }
+
+        cloud1Texture = LoadTexture(ASSETS_PATH"image/sprite/cloud_1.png");
+        cloud2Texture = LoadTexture(ASSETS_PATH"image/sprite/cloud_2.png");
+        cloud3Texture = LoadTexture(ASSETS_PATH"image/sprite/cloud_3.png");
+
+        star1Texture = LoadTexture(ASSETS_PATH"image/sprite/star_1.png");
+        star2Texture = LoadTexture(ASSETS_PATH"image/sprite/star_2.png");
+        //orders
+        bubbles = LoadTexture(ASSETS_PATH"image/elements/bubbles.png");
+        break;
+
+    case GLOBAL_LOAD_MENU:
+        menuBgm = LoadMusicStream(ASSETS_PATH"audio/bgm/Yojo_Summer_My_Heart.wav");
+
+        menuCustomer1 = CreateCustomer(EMOTION_HAPPY, 2.0, 4.0, 0.25, true, (Vector2) { baseX + 650, baseY + 55 }, 1, 0);
+        menuCustomer2 = CreateCustomer(EMOTION_HAPPY, 0.4, 5.2, 0.3, true, (Vector2) { baseX + 1200, baseY + 52 }, 2, 0);
+        RandomCustomerBlinkTime(&menuCustomer1);
+        RandomCustomerBlinkTime(&menuCustomer2);
+        menuCustomer1.isDummy = true;
+        menuCustomer2.isDummy = true;
+        ScheduleMenuCustomerBlinks();
+        break;
+
+    default:
+        break;
+    }
+
+    globalLoadTime += GetTime() - startTime;
+    if (++globalLoadStep < GLOBAL_LOAD_STEP_COUNT)
+        return false;
+
+    globalLoadStep = GLOBAL_LOAD_INTERFACE;
+    loadDurationTimer = globalLoadTime;
+    isGlobalAssetsLoadFinished = true;
+
+    ApplyTextureQuality();
+    MarkStartup(STARTUP_MARK_ASSETS);
+    return true;
+}
+
+// Everything in one go, for the fast load, the stress scene and the startup benchmark
+void LoadGlobalAssets()
+{
+    globalLoadStep = GLOBAL_LOAD_INTERFACE;
+    while (!LoadGlobalAssetsStep()) {}
+}
+
+void UnloadGlobalAssets()
+{
+    UnloadTexture(backgroundTexture);
+    UnloadTexture(backgroundOverlayTexture);
+    UnloadTexture(backgroundOverlaySidebarTexture);
+    UnloadTexture(pawTexture);
+    UnloadFont(meowFont);
+
+    UnloadTexture(checkbox);
+	UnloadTexture(checkboxChecked);
+    UnloadTexture(left_arrow);
+    UnloadTexture(right_arrow);
+
+    UnloadTexture(customerTexture_first_happy);
+    UnloadTexture(customerTexture_second_happy);
+    UnloadTexture(customerTexture_third_happy);
+    UnloadTexture(customerTexture_first_normal);
+    UnloadTexture(customerTexture_second_normal);
+    UnloadTexture(customerTexture_third_normal);
+    UnloadTexture(customerTexture_first_angry);
+    UnloadTexture(customerTexture_second_angry);
+    UnloadTexture(customerTexture_third_angry);
+
+    UnloadSound(hoverFx);
+    UnloadSound(selectFx);
+    UnloadSound(boongFx);
+
+    UnloadSound(angry1Fx);
+    UnloadSound(angry2Fx);
+    UnloadSound(angry3Fx);
+    UnloadSound(angry4Fx);
+
+    UnloadSound(bottle1Fx);
+    UnloadSound(bottle2Fx);
+    UnloadSound(bottle3Fx);
+
+    UnloadSound(confused1Fx);
+    UnloadSound(confused2Fx);
+    UnloadSound(confused3Fx);
+    UnloadSound(confused4Fx);
+
+    UnloadSound(correctFx);
+
+    UnloadSound(drop1Fx);
+    UnloadSound(drop2Fx);
+    UnloadSound(drop3Fx);
+
+    UnloadSound(pickup1Fx);
+    UnloadSound(pickup2Fx);
+    UnloadSound(pickup3Fx);
+
+    UnloadSound(pour1Fx);
+    UnloadSound(pour2Fx);
+    UnloadSound(pour3Fx);
+
+    UnloadSound(stir1Fx);
+    UnloadSound(stir2Fx);
+    UnloadSound(stir3Fx);
+
+    UnloadSound(flickFx);
+
+    for (int i = 0; i < INGREDIENT_COUNT; i++)
+    {
+        UnloadTexture(ingredientTextures[i]);
+        UnloadHitMask(&ingredientHitMasks[i]);
+    }
+    UnloadTexture(cupsTexture);
+    UnloadRecipeTables();
+
+    UnloadHitMask(&cupsHitMask);
+    UnloadHitMask(&cupHitMask);
+
+    for(int i = 0; i < 8; i++)
+		UnloadTexture(menuFallingItemTextures[i]);
+
+    UnloadTexture(logoTexture);
+    UnloadTexture(splashBackgroundTexture);
+    UnloadTexture(splashOverlayTexture);
+
+    for (int i = 0; i < 3; i++)
+    {
+        UnloadTexture(customersImageData[i].happy);
+        UnloadHitMask(&customersImageData[i].hitMask);
+		UnloadTexture(customersImageData[i].happyEyesClosed);
+		UnloadTexture(customersImageData[i].frustrated);
+		UnloadTexture(customersImageData[i].frustratedEyesClosed);
+		UnloadTexture(customersImageData[i].angry);
+		UnloadTexture(customersImageData[i].angryEyesClosed);
+    }
+
+    UnloadTexture(cloud1Texture);
+    UnloadTexture(cloud2Texture);
+    UnloadTexture(cloud3Texture);
+    UnloadTexture(star1Texture);
+    UnloadTexture(star2Texture);
+    UnloadTexture(bubbles);
+
+    UnloadMusicStream(menuBgm);
+}
+
+
+void PlayBgm(Music *bgm)
+{
+    if (bgm == currentBgm)
+    {
+        if (isCurrentBgmPaused && options->musicEnabled)
+        {
+            PlayMusicStream(*bgm);
+            bgm->looping = true;
+            isCurrentBgmPaused = false;
+        }
+        return;
+    }
+
+    currentBgm = bgm;
+	StopMusicStream(*currentBgm);
+	PlayMusicStream(*currentBgm);
+    SetMusicVolume(*currentBgm, bgmVolume);
+    bgm->looping = true;
+    isCurrentBgmPaused = false;
+}
+
+void PlayBgmIfStopped(Music* bgm)
+{
+    if (bgm == currentBgm)
+    {
+        if (isCurrentBgmPaused && options->musicEnabled)
+        {
+            PlayMusicStream(*bgm);
+            SetMusicVolume(*bgm, bgmVolume);
+            bgm->looping = true;
+            isCurrentBgmPaused = false;
+        }
+        return;
+    }
+
+    currentBgm = bgm;
+    PlayMusicStream(*currentBgm);
+    SetMusicVolume(*currentBgm, bgmVolume);
+    bgm->looping = true;
+    isCurrentBgmPaused = false;
+}
+
+void PauseBgm(Music *bgm)
+{
+	if (bgm != currentBgm) return;
+	if (isCurrentBgmPaused) return;
+
+	PauseMusicStream(*bgm);
+	isCurrentBgmPaused = true;
+}
+
+void StopBgm(Music *bgm)
+{
+	StopMusicStream(*bgm);
+    isCurrentBgmPaused = false;
+    currentBgm = NULL;
+}
+
+// Loaded before the splash, everything else comes with LoadGlobalAssets
+void LoadSplashAssets()
+{
+    meowFont = LoadFontEx(ASSETS_PATH"font/SantJoanDespi-Regular.otf", 256, 0, 250);
+    SetTextureFilter(meowFont.texture, TEXTURE_FILTER_ANISOTROPIC_4X);
+    MarkStartup(STARTUP_MARK_FONT);
+
+    logoTexture = LoadTexture(ASSETS_PATH"image/elements/studio_logo.png");
+    splashBackgroundTexture = LoadTexture(ASSETS_PATH"image/backgrounds/splash.png");
+    splashOverlayTexture = LoadTexture(ASSETS_PATH"image/backgrounds/splash_overlay.png");
+}
+
+void StartStartupProfile(int iterations, double processStart, const char* jsonFile)
+{
+    startupProfile.enabled = true;
+    startupProfile.iterations = iterations < 1 ? 1 : (iterations > MAX_STARTUP_ITERATIONS ? MAX_STARTUP_ITERATIONS : iterations);
+    startupProfile.processStart = processStart;
+    startupProfile.iterationStart = processStart;
+    startupProfile.jsonFile = jsonFile;
+
+    for (int i = 0; i < MAX_STARTUP_ITERATIONS; i++)
+    {
+        for (int j = 0; j < STARTUP_MARK_COUNT; j++)
+            startupProfile.marks[i][j] = -1;
+        for (int j = 0; j < MAX_STARTUP_ASSETS; j++)
+            startupProfile.assetTimes[i][j] = -1;
+    }
+}
+
+void ReportStartupProfile()
+{
+    const StartupProfile* profile = &startupProfile;
+    int warmCount = profile->iterations - 1;
+
+    printf("\nStartup, %d cold and %d warm iterations, ms since the iteration started\n", 1, warmCount);
+    printf("%-10s", "Iteration");
+    for (int j = 0; j < STARTUP_MARK_COUNT; j++)
+        printf(" %17s", StringFromStartupMarkEnum(j));
+    printf("\n");
+
+    for (int i = 0; i < profile->iterations; i++)
+    {
+        printf("%-4d %-5s", i, i == 0 ? "cold" : "warm");
+        for (int j = 0; j < STARTUP_MARK_COUNT; j++)
+        {
+            if (profile->marks[i][j] < 0) printf(" %17s", "-");
+            else printf(" %17.2f", profile->marks[i][j] * 1000.0);
+        }
+        printf("\n");
+    }
+
+    printf("\n%-56s %10s %10s %10s %10s\n", "Asset", "Cold", "Warm mean", "Warm min", "Warm max");
+    for (int a = 0; a < profile->assetCount; a++)
+    {
+        double sum = 0, min = 1e300, max = 0;
+        int count = 0;
+        for (int i = 1; i < profile->iterations; i++)
+        {
+            double time = profile->assetTimes[i][a];
+            if (time < 0) continue;
+            sum += time;
+            min = fmin(min, time);
+            max = fmax(max, time);
+            count++;
+        }
+
+        printf("%-56s", profile->assetNames[a]);
+        if (profile->assetTimes[0][a] < 0) printf(" %10s", "-");
+        else printf(" %10.3f", profile->assetTimes[0][a] * 1000.0);
+        if (count == 0) printf(" %10s %10s %10s\n", "-", "-", "-");
+        else printf(" %10.3f %10.3f %10.3f\n", sum / count * 1000.0, min * 1000.0, max * 1000.0);
+    }
+
+    FILE* file = fopen(profile->jsonFile, "w");
+    if (file == NULL)
+    {
+        Log(LOG_WARNING, "Could not write %s", profile->jsonFile);
+        return;
+    }
+
+    fprintf(file, "{\n  \"unit\": \"ms\",\n  \"iterations\": [\n");
+    for (int i = 0; i < profile->iterations; i++)
+    {
+        fprintf(file, "    {\n      \"kind\": \"%s\",\n      \"marks\": {", i == 0 ? "cold" : "warm");
+        for (int j = 0; j < STARTUP_MARK_COUNT; j++)
+        {
+            fprintf(file, "%s \"%s\": ", j > 0 ? "," : "", StringFromStartupMarkEnum(j));
+            if (profile->marks[i][j] < 0) fprintf(file, "null");
+            else fprintf(file, "%.3f", profile->marks[i][j] * 1000.0);
+        }
+        fprintf(file, " },\n      \"assets\": {");
+
+        bool first = true;
+        for (int a = 0; a < profile->assetCount; a++)
+        {
+            if (profile->assetTimes[i][a] < 0) continue;
+            fprintf(file, "%s\n        \"%s\": %.3f", first ? "" : ",", profile->assetNames[a], profile->assetTimes[i][a] * 1000.0);
+            first = false;
+        }
+        fprintf(file, "\n      }\n    }%s\n", i + 1 < profile->iterations ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+
+    printf("\nResults written to %s\n", profile->jsonFile);
+}
+
+// Soak runs, the bot plays round after round on a fixed step clock while resources are sampled at every round start
+// Anything that keeps growing once the first rounds have warmed the caches fails the run
+#define MAX_SOAK_ROUNDS 1000
+
+typedef enum {
+    SOAK_RSS = 0,
+    SOAK_TEXTURES,
+    SOAK_STACK,
+    SOAK_HANDLES,
+    SOAK_METRIC_COUNT
+} SoakMetric;
+
+static inline char* StringFromSoakMetricEnum(SoakMetric metric)
+{
+    static const char* strings[] = { "RSS (KiB)", "Textures", "Stack (B)", "Handles" };
+    return strings[metric];
+}
+
+typedef struct {
+    bool enabled;
+    int rounds;
+    int warmupRounds;
+    int round;
+    uintptr_t stackBase;                                        // Address of a local in main
+    double samples[MAX_SOAK_ROUNDS + 1][SOAK_METRIC_COUNT];     // Negative when the platform cannot tell
+} Soak;
+
+Soak soak = { 0 };
+
+// Growth allowed over the measured rounds before the run fails
+static const double soakTolerance[SOAK_METRIC_COUNT] = { 4096, 0.5, 256, 0.5 };
+
+// Linux exposes both through procfs, elsewhere they are reported as unknown
+double SampleResidentKiB()
+{
+#if defined(__linux__)
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file == NULL) return -1;
+
+    long size = 0, resident = 0;
+    int read = fscanf(file, "%ld %ld", &size, &resident);
+    fclose(file);
+    return read == 2 ? resident * (sysconf(_SC_PAGESIZE) / 1024.0) : -1;
+#else
+    return -1;
+#endif
+}
+
+double SampleOpenHandles()
+{
+#if defined(__linux__)
+    DIR* directory = opendir("/proc/self/fd");
+    if (directory == NULL) return -1;
+
+    // The directory stream itself holds one, as do . and ..
+    int count = -3;
+    while (readdir(directory) != NULL) count++;
+    closedir(directory);
+    return count;
+#else
+    return -1;
+#endif
+}
+
+// Least squares slope in units per round
+double SoakTrend(int metric, int first, int last)
+{
+    double count = 0, sumX = 0, sumY = 0, sumXY = 0, sumXX = 0;
+    for (int i = first; i <= last; i++)
+    {
+        double y = soak.samples[i][metric];
+        if (y < 0) return 0;
+        count++;
+        sumX += i;
+        sumY += y;
+        sumXY += i * y;
+        sumXX += (double)i * i;
+    }
+
+    double denominator = count * sumXX - sumX * sumX;
+    return denominator != 0 ? (count * sumXY - sumX * sumY) / denominator : 0;
+}
+
+void ReportSoak()
+{
+    printf("\nSoak, %d rounds, trends fitted from round %d\n", soak.rounds, soak.warmupRounds);
+    printf("%-6s", "Round");
+    for (int m = 0; m < SOAK_METRIC_COUNT; m++)
+        printf(" %12s", StringFromSoakMetricEnum(m));
+    printf("\n");
+
+    for (int i = 0; i <= soak.rounds; i++)
+    {
+        printf("%-6d", i);
+        for (int m = 0; m < SOAK_METRIC_COUNT; m++)
+        {
+            if (soak.samples[i][m] < 0) printf(" %12s", "-");
+            else printf(" %12.0f", soak.samples[i][m]);
+        }
+        printf("\n");
+    }
+
+    int first = soak.warmupRounds < soak.rounds ? soak.warmupRounds : 0;
+    bool failed = false;
+    printf("\n");
+    for (int m = 0; m < SOAK_METRIC_COUNT; m++)
+    {
+        double growth = SoakTrend(m, first, soak.rounds) * (soak.rounds - first);
+        bool grows = growth > soakTolerance[m];
+        failed = failed || grows;
+        printf("%-12s %+12.1f over %d rounds, %s\n", StringFromSoakMetricEnum(m), growth, soak.rounds - first, grows ? "GROWING" : "ok");
+    }
+    printf("Soak %s\n", failed ? "FAILED" : "passed");
+
+    if (failed) applicationExitCode = 1;
+}
+
+// Called as every round starts, the sample after the last round ends the run
+void SampleSoakRound()
+{
+    if (!soak.enabled) return;
+
+    char stackMarker;
+    double* sample = soak.samples[soak.round];
+    sample[SOAK_RSS] = SampleResidentKiB();
+    sample[SOAK_TEXTURES] = liveTextureCount;
+    sample[SOAK_STACK] = (double)(soak.stackBase - (uintptr_t)&stackMarker);
+    sample[SOAK_HANDLES] = SampleOpenHandles();
+
+    Log(LOG_INFO, "Soak round %d/%d, %.0f KiB, %d textures", soak.round, soak.rounds, sample[SOAK_RSS], liveTextureCount);
+
+    if (soak.round++ == soak.rounds)
+    {
+        ReportSoak();
+        QuitScenes();
+    }
+}
+
+// Performance gate results, one line per scene in the baseline file
+typedef enum {
+    PERF_METRIC_P50 = 0,
+    PERF_METRIC_P95,
+    PERF_METRIC_P99,
+    PERF_METRIC_DRAWS,
+    PERF_METRIC_ALLOCATIONS,
+    PERF_METRIC_COUNT
+} PerfMetric;
+
+static inline char* StringFromPerfMetricEnum(PerfMetric metric)
+{
+    static const char* strings[] = { "p50 ms", "p95 ms", "p99 ms", "Draws/frame", "Allocations" };
+    return strings[metric];
+}
+
+// Allowed regression over the baseline, relative, and an absolute floor for timings close to the clock resolution
+// Draws and allocations do not depend on the machine, the tour plays the same frames every run
+static const double perfTolerance[PERF_METRIC_COUNT] = { 0.10, 0.15, 0.25, 0.02, 0.0 };
+static const double perfToleranceFloor[PERF_METRIC_COUNT] = { 0.02, 0.03, 0.05, 0.0, 0.0 };
+
+typedef struct {
+    bool present;
+    long long frames;
+    double metrics[PERF_METRIC_COUNT];
+} PerfResult;
+
+int CompareFloats(const void* a, const void* b)
+{
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank percentiles over the sampled frame times
+void MeasurePerfScene(PerfScene scene, PerfResult* result)
+{
+    static float sorted[MAX_PERF_FRAMES];
+    int count = perfGate.frameCount[scene];
+
+    memcpy(sorted, perfGate.frameTimes[scene], count * sizeof(float));
+    qsort(sorted, count, sizeof(float), CompareFloats);
+
+    static const double ranks[] = { 0.50, 0.95, 0.99 };
+    for (int i = 0; i < 3; i++)
+        result->metrics[PERF_METRIC_P50 + i] = count > 0 ? sorted[(int)ceil(ranks[i] * count) - 1] : 0;
+
+    long long frames = perfGate.chargedFrames[scene];
+    result->present = true;
+    result->frames = frames;
+    result->metrics[PERF_METRIC_DRAWS] = frames > 0 ? (double)perfGate.drawCalls[scene] / frames : 0;
+    result->metrics[PERF_METRIC_ALLOCATIONS] = (double)perfGate.allocations[scene];
+}
+
+bool LoadPerfBaselines(const char* fileName, PerfResult* baselines)
+{
+    FILE* file = fopen(fileName, "r");
+    if (file == NULL) return false;
+
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        if (line[0] == '#') continue;
+
+        char name[32];
+        PerfResult result = { true };
+        if (sscanf(line, "%31s %lld %lf %lf %lf %lf %lf", name, &result.frames, &result.metrics[0], &result.metrics[1],
+            &result.metrics[2], &result.metrics[3], &result.metrics[4]) != 2 + PERF_METRIC_COUNT) continue;
+
+        for (int i = 0; i < PERF_SCENE_COUNT; i++)
+        {
+            if (strcmp(name, StringFromPerfSceneEnum(i)) == 0)
+                baselines[i] = result;
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+bool SavePerfBaselines(const char* fileName, const PerfResult* results)
+{
+    FILE* file = fopen(fileName, "w");
+    if (file == NULL)
+    {
+        Log(LOG_WARNING, "Could not write performance baselines to %s", fileName);
+        return false;
     }
 
-    // ESC - Exit application
-    if (IsKeyPressed(KEY_ESCAPE))
-	{
-        ExitApplication();
-	}
+    fprintf(file, "# Performance gate baselines, written by --perf-gate-update on the reference machine\n");
+    fprintf(file, "# scene frames p50_ms p95_ms p99_ms draws_per_frame allocations\n");
+    fprintf(file, "# Frame times of 0 were never recorded, the gate checks the counts and then reports a skip\n");
+    for (int i = 0; i < PERF_SCENE_COUNT; i++)
+    {
+        const PerfResult* result = &results[i];
+        fprintf(file, "%s %lld %.4f %.4f %.4f %.2f %.0f\n", StringFromPerfSceneEnum(i), result->frames,
+            result->metrics[PERF_METRIC_P50], result->metrics[PERF_METRIC_P95], result->metrics[PERF_METRIC_P99],
+            result->metrics[PERF_METRIC_DRAWS], result->metrics[PERF_METRIC_ALLOCATIONS]);
+    }
 
-    if(currentBgm != NULL)
-        UpdateMusicStream(*currentBgm);
+    fclose(file);
+    return true;
 }
 
-void LoadGlobalAssets()
+// Returns the number of regressions, every one of them is printed
+// Scenes that played timed frames against a baseline without frame times are counted in untimed
+int CheckPerfBaselines(const PerfResult* results, const PerfResult* baselines, int* untimed)
 {
-    double startTime = GetTime();
-    backgroundTexture = LoadTexture(ASSETS_PATH"image/backgrounds/main.png");
-    backgroundOverlayTexture = LoadTexture(ASSETS_PATH"image/backgrounds/main_overlay_1.png");
-    backgroundOverlaySidebarTexture = LoadTexture(ASSETS_PATH"image/backgrounds/main_overlay_2.png");
-    pawTexture = LoadTexture(ASSETS_PATH"image/elements/paw.png");
-
-    checkbox = LoadTexture(ASSETS_PATH"image/elements/checkbox.png");
-    checkboxChecked = LoadTexture(ASSETS_PATH"image/elements/checkbox_checked.png");
-    left_arrow = LoadTexture(ASSETS_PATH"image/elements/left_arrow.png");
-    right_arrow = LoadTexture(ASSETS_PATH"image/elements/right_arrow.png");
-
-	customerTexture_first_happy = LoadTexture(ASSETS_PATH"image/sprite/customer_happy.png");
-	customerTexture_second_happy = LoadTexture(ASSETS_PATH"image/sprite/customer_happy.png");
-	customerTexture_third_happy = LoadTexture(ASSETS_PATH"image/sprite/customer_happy.png");
-	customerTexture_first_normal = LoadTexture(ASSETS_PATH"image/sprite/customer_normal.png");
-	customerTexture_second_normal = LoadTexture(ASSETS_PATH"image/sprite/customer_normal.png");
-	customerTexture_third_normal = LoadTexture(ASSETS_PATH"image/sprite/customer_normal.png");
-	customerTexture_first_angry = LoadTexture(ASSETS_PATH"image/sprite/customer_angry.png");
-	customerTexture_second_angry = LoadTexture(ASSETS_PATH"image/sprite/customer_angry.png");
-	customerTexture_third_angry = LoadTexture(ASSETS_PATH"image/sprite/customer_angry.png");
-
-    hoverFx = LoadSound(ASSETS_PATH"audio/hover.wav");
-    selectFx = LoadSound(ASSETS_PATH"audio/select.wav");
-    boongFx = LoadSound(ASSETS_PATH"audio/boong.wav");
-
-    angry1Fx = LoadSound(ASSETS_PATH"audio/angry_1.wav");
-    angry2Fx = LoadSound(ASSETS_PATH"audio/angry_2.wav");
-    angry3Fx = LoadSound(ASSETS_PATH"audio/angry_3.wav");
-    angry4Fx = LoadSound(ASSETS_PATH"audio/angry_4.wav");
-
-    bottle1Fx = LoadSound(ASSETS_PATH"audio/bottle_1.wav");
-    bottle2Fx = LoadSound(ASSETS_PATH"audio/bottle_2.wav");
-    bottle3Fx = LoadSound(ASSETS_PATH"audio/bottle_3.wav");
-
-    confused1Fx = LoadSound(ASSETS_PATH"audio/confused_1.wav");
-    confused2Fx = LoadSound(ASSETS_PATH"audio/confused_2.wav");
-    confused3Fx = LoadSound(ASSETS_PATH"audio/confused_3.wav");
-    confused4Fx = LoadSound(ASSETS_PATH"audio/confused_4.wav");
-
-    correctFx = LoadSound(ASSETS_PATH"audio/correct.wav");
-
-    drop1Fx = LoadSound(ASSETS_PATH"audio/drop_1.wav");
-    drop2Fx = LoadSound(ASSETS_PATH"audio/drop_2.wav");
-    drop3Fx = LoadSound(ASSETS_PATH"audio/drop_3.wav");
-
-    pickup1Fx = LoadSound(ASSETS_PATH"audio/pickup_1.wav");
-    pickup2Fx = LoadSound(ASSETS_PATH"audio/pickup_2.wav");
-    pickup3Fx = LoadSound(ASSETS_PATH"audio/pickup_3.wav");
-
-    pour1Fx = LoadSound(ASSETS_PATH"audio/pour_1.wav");
-    pour2Fx = LoadSound(ASSETS_PATH"audio/pour_2.wav");
-    pour3Fx = LoadSound(ASSETS_PATH"audio/pour_3.wav");
-
-    stir1Fx = LoadSound(ASSETS_PATH"audio/stir_1.wav");
-    stir2Fx = LoadSound(ASSETS_PATH"audio/stir_2.wav");
-    stir3Fx = LoadSound(ASSETS_PATH"audio/stir_3.wav");
-
-    flickFx = LoadSound(ASSETS_PATH"audio/flick.wav");
-
-    menuFallingItemTextures[0] = LoadTexture(ASSETS_PATH"image/falling_items/cara.png");
-    menuFallingItemTextures[1] = LoadTexture(ASSETS_PATH"image/falling_items/cmilk.png");
-    menuFallingItemTextures[2] = LoadTexture(ASSETS_PATH"image/falling_items/cocoa.png");
-    menuFallingItemTextures[3] = LoadTexture(ASSETS_PATH"image/falling_items/gar.png");
-    menuFallingItemTextures[4] = LoadTexture(ASSETS_PATH"image/falling_items/marshmello.png");
-    menuFallingItemTextures[5] = LoadTexture(ASSETS_PATH"image/falling_items/matcha.png");
-    menuFallingItemTextures[6] = LoadTexture(ASSETS_PATH"image/falling_items/milk.png");
-    menuFallingItemTextures[7] = LoadTexture(ASSETS_PATH"image/falling_items/wcream.png");
-
-    teaPowderTexture = LoadTexture(ASSETS_PATH"/spritesheets/GP.png");
-    cocoaPowderTexture = LoadTexture(ASSETS_PATH"/spritesheets/CP.png");
-    caramelSauceTexture = LoadTexture(ASSETS_PATH"/spritesheets/CA.png");
-    chocolateSauceTexture = LoadTexture(ASSETS_PATH"/spritesheets/CH.png");
-    condensedMilkTexture = LoadTexture(ASSETS_PATH"/spritesheets/CM.png");
-    normalMilkTexture = LoadTexture(ASSETS_PATH"/spritesheets/MI.png");
-    marshMellowTexture = LoadTexture(ASSETS_PATH"/spritesheets/MA.png");
-    whippedCreamTexture = LoadTexture(ASSETS_PATH"/spritesheets/WC.png");
-    hotWaterTexture = LoadTexture(ASSETS_PATH"/spritesheets/GAR.png");
-    greenChonTexture = LoadTexture(ASSETS_PATH"/spritesheets/greenchon.png");
-    cocoaChonTexture = LoadTexture(ASSETS_PATH"/spritesheets/cocoachon.png");
-
-    trashCanTexture = LoadTexture(ASSETS_PATH"spritesheets/TRASHCAN.png");
+    int regressions = 0;
+    *untimed = 0;
 
-    for (int i = 0; i < 3; i++)
+    for (int i = 0; i < PERF_SCENE_COUNT; i++)
     {
-        customersImageData[i].happy = LoadTexture(TextFormat(ASSETS_PATH"image/sprite/customer_%d/happy.png", i + 1));
-		customersImageData[i].happyEyesClosed = LoadTexture(TextFormat(ASSETS_PATH"image/sprite/customer_%d/happy_eyes_closed.png", i + 1));
-        customersImageData[i].frustrated = LoadTexture(TextFormat(ASSETS_PATH"image/sprite/customer_%d/frustrated.png", i + 1));
-        customersImageData[i].frustratedEyesClosed = LoadTexture(TextFormat(ASSETS_PATH"image/sprite/customer_%d/frustrated_eyes_closed.png", i + 1));
-        customersImageData[i].angry = LoadTexture(TextFormat(ASSETS_PATH"image/sprite/customer_%d/angry.png", i + 1));
-        customersImageData[i].angryEyesClosed = LoadTexture(TextFormat(ASSETS_PATH"image/sprite/customer_%d/angry_eyes_closed.png", i + 1));
-	}
+        const PerfResult* result = &results[i];
+        const PerfResult* baseline = &baselines[i];
 
-    cloud1Texture = LoadTexture(ASSETS_PATH"image/sprite/cloud_1.png");
-    cloud2Texture = LoadTexture(ASSETS_PATH"image/sprite/cloud_2.png");
-    cloud3Texture = LoadTexture(ASSETS_PATH"image/sprite/cloud_3.png");
+        if (!baseline->present)
+        {
+            printf("FAIL %-12s no baseline, record one with --perf-gate-update\n", StringFromPerfSceneEnum(i));
+            regressions++;
+            continue;
+        }
 
-    star1Texture = LoadTexture(ASSETS_PATH"image/sprite/star_1.png");
-    star2Texture = LoadTexture(ASSETS_PATH"image/sprite/star_2.png");
-	//orders
-	bubbles = LoadTexture(ASSETS_PATH"image/elements/bubbles.png");
+        // Same seed and step, a different frame count means the tour itself changed
+        if (result->frames != baseline->frames)
+            printf("WARN %-12s played %lld frames, the baseline played %lld\n", StringFromPerfSceneEnum(i), result->frames, baseline->frames);
 
-	//
+        // A scene that was never timed, like a fast loading splash, has nothing to hold its frame times against
+        // A timed scene without frame times in its baseline is not a pass, the gate reports it as skipped
+        bool timed = baseline->metrics[PERF_METRIC_P50] > 0;
+        if (!timed && result->metrics[PERF_METRIC_P50] > 0)
+        {
+            printf("SKIP %-12s no frame time baseline, record one on the reference machine with --perf-gate-update\n", StringFromPerfSceneEnum(i));
+            (*untimed)++;
+        }
 
-    menuBgm = LoadMusicStream(ASSETS_PATH"audio/bgm/Yojo_Summer_My_Heart.wav");
+        for (int m = 0; m < PERF_METRIC_COUNT; m++)
+        {
+            if (m <= PERF_METRIC_P99 && !timed) continue;
 
-    menuCustomer1 = CreateCustomer(EMOTION_HAPPY, 2.0, 4.0, 0.25, true, (Vector2) { baseX + 650, baseY + 55 }, 1, 0);
-    menuCustomer2 = CreateCustomer(EMOTION_HAPPY, 0.4, 5.2, 0.3, true, (Vector2) { baseX + 1200, baseY + 52 }, 2, 0);
-    RandomCustomerBlinkTime(&menuCustomer1);
-    RandomCustomerBlinkTime(&menuCustomer2);
-    menuCustomer1.isDummy = true;
-    menuCustomer2.isDummy = true;
+            double limit = baseline->metrics[m] + fmax(baseline->metrics[m] * perfTolerance[m], perfToleranceFloor[m]);
+            double change = baseline->metrics[m] > 0 ? (result->metrics[m] / baseline->metrics[m] - 1.0) * 100.0 : 0;
+            if (result->metrics[m] > limit)
+            {
+                printf("FAIL %-12s %-12s %10.3f vs %10.3f baseline (%+.1f%%, allowed %+.1f%%)\n", StringFromPerfSceneEnum(i),
+                    StringFromPerfMetricEnum(m), result->metrics[m], baseline->metrics[m], change, perfTolerance[m] * 100.0);
+                regressions++;
+            }
+            else if (result->metrics[m] < baseline->metrics[m] - fmax(baseline->metrics[m] * perfTolerance[m], perfToleranceFloor[m]))
+            {
+                printf("NOTE %-12s %-12s %10.3f vs %10.3f baseline (%+.1f%%), consider --perf-gate-update\n", StringFromPerfSceneEnum(i),
+                    StringFromPerfMetricEnum(m), result->metrics[m], baseline->metrics[m], change);
+            }
+        }
+    }
 
-    loadDurationTimer = GetTime() - startTime;
-    isGlobalAssetsLoadFinished = true;
+    return regressions;
 }
 
-void UnloadGlobalAssets()
+// CI runners often have no display, InitWindow fails there instead of letting the gate report a skip
+bool CanCreateWindow()
 {
-    UnloadTexture(backgroundTexture);
-    UnloadTexture(backgroundOverlayTexture);
-    UnloadTexture(backgroundOverlaySidebarTexture);
-    UnloadTexture(pawTexture);
-    UnloadFont(meowFont);
-
-    UnloadTexture(checkbox);
-	UnloadTexture(checkboxChecked);
-    UnloadTexture(left_arrow);
-    UnloadTexture(right_arrow);
-
-    UnloadSound(hoverFx);
-    UnloadSound(selectFx);
+#if defined(__linux__)
+    if (getenv("DISPLAY") == NULL && getenv("WAYLAND_DISPLAY") == NULL)
+        return false;
+#endif
+#if defined(USE_GLFW_INPUT)
+    // raylib initializes GLFW again in InitWindow
+    if (glfwInit() == GLFW_FALSE)
+        return false;
+    glfwTerminate();
+#endif
+    return true;
+}
 
-    for(int i = 0; i < 8; i++)
-		UnloadTexture(menuFallingItemTextures[i]);
+// Called from the menu once the tour has played every scene, the frame loop ends after the menu entered
+void FinishPerfGate()
+{
+    PerfResult results[PERF_SCENE_COUNT] = { 0 };
+    PerfResult baselines[PERF_SCENE_COUNT] = { 0 };
 
-    UnloadTexture(logoTexture);
-    UnloadTexture(splashBackgroundTexture);
-    UnloadTexture(splashOverlayTexture);
+    printf("\nPerformance gate\n%-12s %8s", "Scene", "Frames");
+    for (int m = 0; m < PERF_METRIC_COUNT; m++)
+        printf(" %12s", StringFromPerfMetricEnum(m));
+    printf("\n");
 
-    for (int i = 0; i < 3; i++)
+    for (int i = 0; i < PERF_SCENE_COUNT; i++)
     {
-        UnloadTexture(customersImageData[i].happy);
-		UnloadTexture(customersImageData[i].happyEyesClosed);
-		UnloadTexture(customersImageData[i].frustrated);
-		UnloadTexture(customersImageData[i].frustratedEyesClosed);
-		UnloadTexture(customersImageData[i].angry);
-		UnloadTexture(customersImageData[i].angryEyesClosed);
+        MeasurePerfScene(i, &results[i]);
+        printf("%-12s %8lld", StringFromPerfSceneEnum(i), results[i].frames);
+        for (int m = 0; m < PERF_METRIC_COUNT; m++)
+            printf(m == PERF_METRIC_ALLOCATIONS ? " %12.0f" : " %12.3f", results[i].metrics[m]);
+        printf("\n");
     }
+    printf("\n");
 
-    UnloadMusicStream(menuBgm);
-}
-
-
-void PlayBgm(Music *bgm)
-{
-    if (bgm == currentBgm)
+    if (perfGate.update)
     {
-        if (isCurrentBgmPaused && options->musicEnabled)
+        if (SavePerfBaselines(perfGate.baselineFile, results))
+            printf("Baselines written to %s\n", perfGate.baselineFile);
+        else
+            applicationExitCode = 1;
+    }
+    else if (!LoadPerfBaselines(perfGate.baselineFile, baselines))
+    {
+        printf("No baselines at %s, record them with --perf-gate-update\n", perfGate.baselineFile);
+        applicationExitCode = PERF_GATE_SKIPPED;
+    }
+    else
+    {
+        int untimed;
+        int regressions = CheckPerfBaselines(results, baselines, &untimed);
+        if (regressions > 0)
         {
-            PlayMusicStream(*bgm);
-            bgm->looping = true;
-            isCurrentBgmPaused = false;
+            printf("Performance gate FAILED, %d regression%s\n", regressions, regressions == 1 ? "" : "s");
+            applicationExitCode = 1;
         }
-        return;
+        else if (untimed > 0)
+        {
+            // Counts alone would let any slowdown through
+            printf("Performance gate skipped, counts passed but frame times were not checked in %d scene%s\n", untimed, untimed == 1 ? "" : "s");
+            applicationExitCode = PERF_GATE_SKIPPED;
+        }
+        else
+            printf("Performance gate passed, 0 regressions\n");
     }
 
-    currentBgm = bgm;
-	StopMusicStream(*currentBgm);
-	PlayMusicStream(*currentBgm);
-    SetMusicVolume(*currentBgm, bgmVolume);
-    bgm->looping = true;
-    isCurrentBgmPaused = false;
+    QuitScenes();
 }
 
-void PlayBgmIfStopped(Music* bgm)
+// Warm iterations reload every asset into the running window with the files already in the OS cache
+void NextStartupIteration()
 {
-    if (bgm == currentBgm)
+    if (++startupProfile.current >= startupProfile.iterations)
     {
-        if (isCurrentBgmPaused && options->musicEnabled)
-        {
-            PlayMusicStream(*bgm);
-            SetMusicVolume(*bgm, bgmVolume);
-            bgm->looping = true;
-            isCurrentBgmPaused = false;
-        }
-        return;
+        startupProfile.current = startupProfile.iterations - 1;
+        ReportStartupProfile();
+        ExitApplication();
     }
 
-    currentBgm = bgm;
-    PlayMusicStream(*currentBgm);
-    SetMusicVolume(*currentBgm, bgmVolume);
-    bgm->looping = true;
-    isCurrentBgmPaused = false;
-}
-
-void PauseBgm(Music *bgm)
-{
-	if (bgm != currentBgm) return;
-	if (isCurrentBgmPaused) return;
+    if (currentBgm != NULL)
+        StopBgm(currentBgm);
+    UnloadGlobalAssets();
 
-	PauseMusicStream(*bgm);
-	isCurrentBgmPaused = true;
-}
+    // A texture the unload missed would pile up and slow every later iteration
+    if (liveTextureCount != startupProfile.baseTextureCount)
+    {
+        Log(LOG_ERROR, "%d textures still alive after unloading the global assets, expected %d", liveTextureCount, startupProfile.baseTextureCount);
+        applicationExitCode = 1;
+    }
 
-void StopBgm(Music *bgm)
-{
-	StopMusicStream(*bgm);
-    isCurrentBgmPaused = false;
-    currentBgm = NULL;
+    startupProfile.iterationStart = GetMonotonicTime();
+    LoadSplashAssets();
+    LoadGlobalAssets();
 }
 
 Color ColorAlphaOverride(Color color, float alpha)
@@ -2171,481 +5661,734 @@ void DrawDayNightCycle(double deltaTime)
     }
     else
     {
-        colorTransitionTime += GetFrameTime() * colorTransitionSpeed;
+        colorTransitionTime += GetSessionFrameTime() * colorTransitionSpeed;
     }
 }
 
-void OptionsUpdate(Camera2D* camera)
+void ApplyQualityPreset(GameOptions* gameOptions, QualityPreset quality)
 {
-    Rectangle difficultyRect = { baseX + 780, baseY + 595, 340, 70 };
-    Rectangle difficultyDecrementRect = { difficultyRect.x, difficultyRect.y, 60, 70 };
-    Rectangle difficultyIncrementRect = { difficultyRect.x + 280, difficultyRect.y, 60, 70 };
-    
-    Rectangle resolutionRect = { baseX + 780, baseY + 675, 340, 70 };
-    Rectangle resolutionDecrementRect = { resolutionRect.x, resolutionRect.y, 60, 70 };
-    Rectangle resolutionIncrementRect = { resolutionRect.x + 280, resolutionRect.y, 60, 70 };
+    const QualitySettings* preset = &qualityPresets[quality];
+
+    gameOptions->quality = quality;
+    gameOptions->resolution = preset->resolution;
+    gameOptions->targetFps = preset->targetFps;
+    gameOptions->msaa = preset->msaa;
+    gameOptions->fallingItemCount = preset->fallingItemCount;
+    gameOptions->cloudCount = preset->cloudCount;
+    gameOptions->textureFilter = preset->textureFilter;
+}
+
+void ApplyTextureQualityTo(Texture2D* texture)
+{
+    // Trilinear filtering needs a mipmap chain, generate it once on demand
+    if (options->textureFilter == TEXTURE_FILTER_TRILINEAR && texture->mipmaps <= 1)
+        GenTextureMipmaps(texture);
+
+    SetTextureFilter(*texture, options->textureFilter);
+}
+
+void ApplyTextureQuality()
+{
+    // Only textures that are drawn scaled benefit from filtering
+    ApplyTextureQualityTo(&logoTexture);
+    ApplyTextureQualityTo(&splashBackgroundTexture);
+    ApplyTextureQualityTo(&splashOverlayTexture);
+
+    if (!isGlobalAssetsLoadFinished) return;
+
+    ApplyTextureQualityTo(&backgroundOverlayTexture);
+    ApplyTextureQualityTo(&backgroundOverlaySidebarTexture);
+    ApplyTextureQualityTo(&checkbox);
+    ApplyTextureQualityTo(&checkboxChecked);
+    ApplyTextureQualityTo(&left_arrow);
+    ApplyTextureQualityTo(&right_arrow);
+    ApplyTextureQualityTo(&bubbles);
+
+    for (int i = 0; i < 8; i++)
+        ApplyTextureQualityTo(&menuFallingItemTextures[i]);
 
-    Rectangle fpsRect = { baseX + 1200, baseY + 595, 340, 70 };
-    Rectangle fpsDecrementRect = { fpsRect.x, fpsRect.y, 60, 70 };
-    Rectangle fpsIncrementRect = { fpsRect.x + 280, fpsRect.y, 60, 70 };
+    for (int i = 0; i < 3; i++)
+    {
+        ApplyTextureQualityTo(&customersImageData[i].happy);
+        ApplyTextureQualityTo(&customersImageData[i].happyEyesClosed);
+        ApplyTextureQualityTo(&customersImageData[i].frustrated);
+        ApplyTextureQualityTo(&customersImageData[i].frustratedEyesClosed);
+        ApplyTextureQualityTo(&customersImageData[i].angry);
+        ApplyTextureQualityTo(&customersImageData[i].angryEyesClosed);
+    }
+}
+
+bool LoadGameOptions(GameOptions* gameOptions)
+{
+    FILE* file = fopen(SETTINGS_FILE, "r");
+    if (file == NULL) return false;
+
+    char key[64];
+    int value;
+
+    while (fscanf(file, " %63[^=]=%d", key, &value) == 2)
+    {
+        if (strcmp(key, "quality") == 0 && value >= QUALITY_LOW && value <= QUALITY_HIGH) gameOptions->quality = value;
+        else if (strcmp(key, "resolutionX") == 0 && value > 0) gameOptions->resolution.x = value;
+        else if (strcmp(key, "resolutionY") == 0 && value > 0) gameOptions->resolution.y = value;
+        else if (strcmp(key, "targetFps") == 0 && value > 0) gameOptions->targetFps = value;
+        else if (strcmp(key, "msaa") == 0) gameOptions->msaa = value != 0;
+        else if (strcmp(key, "fallingItemCount") == 0) gameOptions->fallingItemCount = (int)Clamp(value, 0, MAX_MENU_FALLING_ITEMS);
+        else if (strcmp(key, "cloudCount") == 0) gameOptions->cloudCount = (int)Clamp(value, 0, MAX_MOVING_CLOUDS);
+        else if (strcmp(key, "textureFilter") == 0 && value >= TEXTURE_FILTER_POINT && value <= TEXTURE_FILTER_TRILINEAR) gameOptions->textureFilter = value;
+        else if (strcmp(key, "difficulty") == 0 && value >= EASY && value <= FREEPLAY_HARD) gameOptions->difficulty = value;
+        else if (strcmp(key, "musicEnabled") == 0) gameOptions->musicEnabled = value != 0;
+        else if (strcmp(key, "soundFxEnabled") == 0) gameOptions->soundFxEnabled = value != 0;
+        else if (strcmp(key, "powerSaving") == 0) gameOptions->powerSaving = value != 0;
+        else if (strcmp(key, "idleTimeout") == 0 && value > 0) gameOptions->idleTimeout = (float)value;
+        else if (strcmp(key, "pauseAudioWhenIdle") == 0) gameOptions->pauseAudioWhenIdle = value != 0;
+        else Log(LOG_WARNING, "Unknown setting %s in %s", key, SETTINGS_FILE);
+    }
+
+    fclose(file);
+    Log(LOG_INFO, "Loaded settings from %s (quality %s)", SETTINGS_FILE, StringFromQualityPresetEnum(gameOptions->quality));
+    return true;
+}
+
+void SaveGameOptions(const GameOptions* gameOptions)
+{
+    // The gate plays on its own options, they must not end up in the player's settings
+    if (perfGate.enabled) return;
+
+    FILE* file = fopen(SETTINGS_FILE, "w");
+    if (file == NULL)
+    {
+        Log(LOG_WARNING, "Could not write settings to %s", SETTINGS_FILE);
+        return;
+    }
+
+    fprintf(file, "quality=%d\n", gameOptions->quality);
+    fprintf(file, "resolutionX=%d\n", gameOptions->resolution.x);
+    fprintf(file, "resolutionY=%d\n", gameOptions->resolution.y);
+    fprintf(file, "targetFps=%d\n", gameOptions->targetFps);
+    fprintf(file, "msaa=%d\n", gameOptions->msaa);
+    fprintf(file, "fallingItemCount=%d\n", gameOptions->fallingItemCount);
+    fprintf(file, "cloudCount=%d\n", gameOptions->cloudCount);
+    fprintf(file, "textureFilter=%d\n", gameOptions->textureFilter);
+    fprintf(file, "difficulty=%d\n", gameOptions->difficulty);
+    fprintf(file, "musicEnabled=%d\n", gameOptions->musicEnabled);
+    fprintf(file, "soundFxEnabled=%d\n", gameOptions->soundFxEnabled);
+    fprintf(file, "powerSaving=%d\n", gameOptions->powerSaving);
+    fprintf(file, "idleTimeout=%d\n", (int)gameOptions->idleTimeout);
+    fprintf(file, "pauseAudioWhenIdle=%d\n", gameOptions->pauseAudioWhenIdle);
+
+    fclose(file);
+}
+
+QualityPreset RunHardwareProbe()
+{
+    // Render menu-like content offscreen at the base resolution and time it.
+    // Reading the target back forces the GPU to finish before the clock stops.
+    RenderTexture2D target = LoadRenderTexture(BASE_SCREEN_WIDTH, BASE_SCREEN_HEIGHT);
+    Texture2D overlay = LoadTexture(ASSETS_PATH"image/backgrounds/main_overlay_1.png");
+    Texture2D cloud = LoadTexture(ASSETS_PATH"image/sprite/cloud_3.png");
+    Texture2D item = LoadTexture(ASSETS_PATH"image/falling_items/matcha.png");
+    Texture2D customer = LoadTexture(ASSETS_PATH"image/sprite/customer_1/happy.png");
+
+    double startTime = GetTime();
+
+    for (int frame = 0; frame < PROBE_FRAMES; frame++)
+    {
+        BeginTextureMode(target);
+        ClearBackground(BLACK);
+        DrawRectangle(0, 0, BASE_SCREEN_WIDTH, BASE_SCREEN_HEIGHT, (Color) { 0, 0, 102, 255 });
+
+        for (int i = 0; i < MAX_MOVING_CLOUDS; i++)
+            DrawTextureEx(cloud, (Vector2) { (float)(i * 250 + frame), (float)(i * 40) }, 0.0f, 2.0f, WHITE);
+
+        for (int i = 0; i < 3; i++)
+            DrawTextureEx(customer, (Vector2) { 50.0f + i * 600, 100.0f }, 0.0f, 1.0f / 2.0f, WHITE);
+
+        for (int i = 0; i < MAX_MENU_FALLING_ITEMS; i++)
+            DrawTexturePro(item, (Rectangle) { 0, 0, item.width, item.height }, (Rectangle) { (float)(i * 90), (float)(frame * 20 + i * 30), item.width, item.height },
+                (Vector2) { item.width / 2.0f, item.height / 2.0f }, (float)(frame * 12 + i * 18), WHITE);
+
+        DrawTextureEx(overlay, (Vector2) { 0, 0 }, 0.0f, (float)BASE_SCREEN_WIDTH / overlay.width, WHITE);
+        DrawTextEx(meowFont, "Super Meow Meow", (Vector2) { 60, 700 }, 60, 2, MAIN_BROWN);
+        EndTextureMode();
+    }
 
-    Rectangle musicRect = { baseX + 100, baseY + 595, 200, 70 };
-    Rectangle soundFxRect = { baseX + 100, baseY + 675, 250, 70 };
+    Image readback = LoadImageFromTexture(target.texture);
+    double frameTime = (GetTime() - startTime) * 1000.0 / PROBE_FRAMES;
+
+    UnloadImage(readback);
+    UnloadTexture(customer);
+    UnloadTexture(item);
+    UnloadTexture(cloud);
+    UnloadTexture(overlay);
+    UnloadRenderTexture(target);
+
+    QualityPreset quality = QUALITY_LOW;
+    if (frameTime < PROBE_HIGH_BUDGET)
+        quality = QUALITY_HIGH;
+    else if (frameTime < PROBE_MEDIUM_BUDGET)
+        quality = QUALITY_MEDIUM;
+
+#if defined(__arm__) || defined(__aarch64__)
+    // ARM boards tend to throttle under sustained load, never start them on High
+    if (quality == QUALITY_HIGH)
+        quality = QUALITY_MEDIUM;
+#endif
+
+    Log(LOG_INFO, "Hardware probe %.2f ms/frame, selected %s quality", frameTime, StringFromQualityPresetEnum(quality));
+    return quality;
+}
+
+// Menu scenes remember the last hovered button so its sound plays once
+#define NO_HOVERED_BUTTON -1
+
+typedef struct {
+    Rectangle difficultyRect;
+    Rectangle difficultyDecrementRect;
+    Rectangle difficultyIncrementRect;
+    Rectangle resolutionRect;
+    Rectangle resolutionDecrementRect;
+    Rectangle resolutionIncrementRect;
+    Rectangle fpsRect;
+    Rectangle fpsDecrementRect;
+    Rectangle fpsIncrementRect;
+    Rectangle qualityRect;
+    Rectangle qualityDecrementRect;
+    Rectangle qualityIncrementRect;
+    Rectangle musicRect;
+    Rectangle soundFxRect;
+    Rectangle fullscreenRect;
+    Rectangle debugRect;
+    Rectangle backRect;
+
+    bool isDifficultyIncrementHovered;
+    bool isDifficultyDecrementHovered;
+    bool isResolutionIncrementHovered;
+    bool isResolutionDecrementHovered;
+    bool isFpsIncrementHovered;
+    bool isFpsDecrementHovered;
+    bool isQualityIncrementHovered;
+    bool isQualityDecrementHovered;
+    bool isMusicHovered;
+    bool isSoundFxHovered;
+    bool isFullscreenHovered;
+    bool isDebugHovered;
+    bool isBackHovered;
+
+    bool firstRender;
+    bool isHovering;
+    int currentHoveredButton;
+
+    float alpha;
+    TaskHandle fadeIn;
+    TaskHandle fadeOut;
+    bool isFadingOut;                       // Set on Back and never cleared, the menu takes over once the fade ends
+} OptionsScene;
+
+#define OPTIONS_FADE_DURATION 0.35
+
+OptionsScene optionsScene;
+
+bool OptionsFadeOutTask(Task* task)
+{
+    OptionsScene* scene = task->data;
+
+    TASK_BEGIN(task);
+    scene->fadeOut = TweenFloat(&scene->alpha, 0.0f, OPTIONS_FADE_DURATION);
+    TASK_WAIT_TASK(task, scene->fadeOut);
+    ChangeScene(SCENE_MENU);
+    TASK_END(task);
+}
+
+void OptionsEnter(Camera2D* camera)
+{
+    OptionsScene* scene = &optionsScene;
+    *scene = (OptionsScene){ 0 };
+
+    scene->difficultyRect = (Rectangle){ baseX + 780, baseY + 595, 340, 70 };
+    scene->difficultyDecrementRect = (Rectangle){ scene->difficultyRect.x, scene->difficultyRect.y, 60, 70 };
+    scene->difficultyIncrementRect = (Rectangle){ scene->difficultyRect.x + 280, scene->difficultyRect.y, 60, 70 };
+
+    scene->resolutionRect = (Rectangle){ baseX + 780, baseY + 675, 340, 70 };
+    scene->resolutionDecrementRect = (Rectangle){ scene->resolutionRect.x, scene->resolutionRect.y, 60, 70 };
+    scene->resolutionIncrementRect = (Rectangle){ scene->resolutionRect.x + 280, scene->resolutionRect.y, 60, 70 };
+
+    scene->fpsRect = (Rectangle){ baseX + 1200, baseY + 595, 340, 70 };
+    scene->fpsDecrementRect = (Rectangle){ scene->fpsRect.x, scene->fpsRect.y, 60, 70 };
+    scene->fpsIncrementRect = (Rectangle){ scene->fpsRect.x + 280, scene->fpsRect.y, 60, 70 };
+
+    scene->qualityRect = (Rectangle){ baseX + 1200, baseY + 675, 340, 70 };
+    scene->qualityDecrementRect = (Rectangle){ scene->qualityRect.x, scene->qualityRect.y, 60, 70 };
+    scene->qualityIncrementRect = (Rectangle){ scene->qualityRect.x + 280, scene->qualityRect.y, 60, 70 };
+
+    scene->musicRect = (Rectangle){ baseX + 100, baseY + 595, 200, 70 };
+    scene->soundFxRect = (Rectangle){ baseX + 100, baseY + 675, 250, 70 };
 
-    Rectangle fullscreenRect = { baseX + 400, baseY + 595, 300, 70 };
-    Rectangle debugRect = { baseX + 400, baseY + 675, 200, 70 };
+    scene->fullscreenRect = (Rectangle){ baseX + 400, baseY + 595, 300, 70 };
+    scene->debugRect = (Rectangle){ baseX + 400, baseY + 675, 200, 70 };
 
-    Rectangle backRect = { baseX + 100, baseY + 840, 200, 70 };
+    scene->backRect = (Rectangle){ baseX + 100, baseY + 840, 200, 70 };
 
-    bool firstRender = true;
-    double lastFrameTime = GetTime();
+    scene->firstRender = true;
+    scene->currentHoveredButton = NO_HOVERED_BUTTON;
 
-    bool isHovering = false;
-    int currentHoveredButton = NULL;
+    scene->alpha = 0.0f;
+    scene->fadeIn = TweenFloat(&scene->alpha, 1.0f, OPTIONS_FADE_DURATION);
 
-    float alpha = 0.0f;
-    double fadeInDuration = 0.35;
-    double fadeOutDuration = 0.35;
-    bool isFadingIn = true;
-    bool isFadingOut = false;
+    EnterPerfScene(PERF_SCENE_OPTIONS);
+    perfGate.optionsVisited = true;
 
     PlayBgmIfStopped(&menuBgm);
+}
 
-    while (!WindowShouldClose())
+// Plays the hover sound once per button, button ids only need to differ from each other
+void HoverOptionsButton(OptionsScene* scene, int button)
+{
+    if (!scene->isHovering || scene->currentHoveredButton != button)
     {
-        // Calculate delta time
-        double deltaTime = GetTime() - lastFrameTime;
-        lastFrameTime = GetTime();
+        PlaySoundFx(FX_HOVER);
+        scene->isHovering = true;
+    }
+    scene->currentHoveredButton = button;
+}
 
-        WindowUpdate(camera);
+void OptionsUpdate(Camera2D* camera, double deltaTime)
+{
+    OptionsScene* scene = &optionsScene;
+    bool isFading = scene->isFadingOut || IsTaskRunning(scene->fadeIn);
 
-        if (isFadingIn)
-		{
-			alpha += deltaTime / fadeInDuration;
-			if (alpha >= 1.0f)
-			{
-				alpha = 1.0f;
-				isFadingIn = false;
-			}
-		}
-
-	    if (isFadingOut)
-        {
-            alpha -= deltaTime / fadeOutDuration;
-            if (alpha <= 0.0f)
-            {
-                alpha = 0.0f;
-                isFadingOut = false;
-                MainMenuUpdate(camera, false);
+    if (perfGate.enabled && !isFading && PerfSceneDwelled())
+        AutoplayerClick(&autoplayer, scene->backRect, camera);
+
+    Vector2 mouseWorldPos = GetScreenToWorld2D(GetSessionMousePosition(), *camera);
+
+    scene->isDifficultyIncrementHovered = CheckCollisionPointRec(mouseWorldPos, scene->difficultyIncrementRect);
+    scene->isDifficultyDecrementHovered = CheckCollisionPointRec(mouseWorldPos, scene->difficultyDecrementRect);
+
+    scene->isResolutionIncrementHovered = CheckCollisionPointRec(mouseWorldPos, scene->resolutionIncrementRect);
+    scene->isResolutionDecrementHovered = CheckCollisionPointRec(mouseWorldPos, scene->resolutionDecrementRect);
+
+    scene->isFpsIncrementHovered = CheckCollisionPointRec(mouseWorldPos, scene->fpsIncrementRect);
+    scene->isFpsDecrementHovered = CheckCollisionPointRec(mouseWorldPos, scene->fpsDecrementRect);
+
+    scene->isQualityIncrementHovered = CheckCollisionPointRec(mouseWorldPos, scene->qualityIncrementRect);
+    scene->isQualityDecrementHovered = CheckCollisionPointRec(mouseWorldPos, scene->qualityDecrementRect);
+
+    scene->isMusicHovered = CheckCollisionPointRec(mouseWorldPos, scene->musicRect);
+    scene->isSoundFxHovered = CheckCollisionPointRec(mouseWorldPos, scene->soundFxRect);
+    scene->isFullscreenHovered = CheckCollisionPointRec(mouseWorldPos, scene->fullscreenRect);
+    scene->isDebugHovered = CheckCollisionPointRec(mouseWorldPos, scene->debugRect);
+
+    scene->isBackHovered = CheckCollisionPointRec(mouseWorldPos, scene->backRect);
+
+    // Handle user input
+    if (!scene->firstRender && IsSessionMousePressed() && !isFading) {
+        if (scene->isDifficultyIncrementHovered) {
+            if (options->difficulty == EASY) {
+                options->difficulty = FREEPLAY_EASY;
+            }
+            else if (options->difficulty == FREEPLAY_EASY) {
+                options->difficulty = MEDIUM;
+            }
+            else if (options->difficulty == MEDIUM) {
+                options->difficulty = FREEPLAY_MEDIUM;
+            }
+            else if (options->difficulty == FREEPLAY_MEDIUM) {
+                options->difficulty = HARD;
             }
+            else if (options->difficulty == HARD) {
+                options->difficulty = FREEPLAY_HARD;
+            }
+            PlaySoundFx(FX_SELECT);
         }
-
-        Vector2 mouseWorldPos = GetScreenToWorld2D(GetMousePosition(), *camera);
-
-        bool isDifficultyIncrementHovered = CheckCollisionPointRec(mouseWorldPos, difficultyIncrementRect);
-        bool isDifficultyDecrementHovered = CheckCollisionPointRec(mouseWorldPos, difficultyDecrementRect);
-        
-        bool isResolutionIncrementHovered = CheckCollisionPointRec(mouseWorldPos, resolutionIncrementRect);
-        bool isResolutionDecrementHovered = CheckCollisionPointRec(mouseWorldPos, resolutionDecrementRect);
-
-        bool isFpsIncrementHovered = CheckCollisionPointRec(mouseWorldPos, fpsIncrementRect);
-        bool isFpsDecrementHovered = CheckCollisionPointRec(mouseWorldPos, fpsDecrementRect);
-        
-        bool isMusicHovered = CheckCollisionPointRec(mouseWorldPos, musicRect);
-        bool isSoundFxHovered = CheckCollisionPointRec(mouseWorldPos, soundFxRect);
-        bool isFullscreenHovered = CheckCollisionPointRec(mouseWorldPos, fullscreenRect);
-        bool isDebugHovered = CheckCollisionPointRec(mouseWorldPos, debugRect);
-
-        bool isBackHovered = CheckCollisionPointRec(mouseWorldPos, backRect);
-
-        // Handle user input
-        if (!firstRender && IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && !isFadingIn && !isFadingOut) {
-            if (isDifficultyIncrementHovered) {
-                if (options->difficulty == EASY) {
-					options->difficulty = FREEPLAY_EASY;
-				}
-                else if (options->difficulty == FREEPLAY_EASY) {
-                    options->difficulty = MEDIUM;
-                }
-                else if (options->difficulty == MEDIUM) {
-                    options->difficulty = FREEPLAY_MEDIUM;
-                }
-                else if (options->difficulty == FREEPLAY_MEDIUM) {
-                    options->difficulty = HARD;
-                }
-                else if (options->difficulty == HARD) {
-                    options->difficulty = FREEPLAY_HARD;
-                }
-                PlaySoundFx(FX_SELECT);
+        else if (scene->isDifficultyDecrementHovered) {
+            if (options->difficulty == FREEPLAY_HARD) {
+                options->difficulty = HARD;
             }
-            else if (isDifficultyDecrementHovered) {
-                if (options->difficulty == FREEPLAY_HARD) {
-                    options->difficulty = HARD;
-                }
-                else if (options->difficulty == HARD) {
-                    options->difficulty = FREEPLAY_MEDIUM;
-                }
-                else if (options->difficulty == FREEPLAY_MEDIUM) {
-                    options->difficulty = MEDIUM;
-                }
-				else if (options->difficulty == MEDIUM) {
-                    options->difficulty = FREEPLAY_EASY;
-				}
-                else if (options->difficulty == FREEPLAY_EASY) {
-                    options->difficulty = EASY;
-				}
-                PlaySoundFx(FX_SELECT);
-			}
-            else if (isResolutionIncrementHovered) {
-                // 720p -> 1080p
-                if (options->resolution.x == 1280) {
-                    options->resolution.x = 1920;
-                    options->resolution.y = 1080;
-                }
-                // Custom resize resolution
-				else
-				{
-                    // If current resolution is less than 720p, set it to 720p
-                    if (options->resolution.x < 1280 || options->resolution.y < 720) {
-						options->resolution.x = 1280;
-						options->resolution.y = 720;
-					}
-				}
-                SetRuntimeResolution(camera, options->resolution.x, options->resolution.y);
-                PlaySoundFx(FX_SELECT);
+            else if (options->difficulty == HARD) {
+                options->difficulty = FREEPLAY_MEDIUM;
             }
-            else if (isResolutionDecrementHovered) {
-                // 1080p -> 720p
-                if (options->resolution.x == 1920) {
-					options->resolution.x = 1280;
-					options->resolution.y = 720;
-				}
-                // Custom resize resolution
-                else {
-                    // If current resolution is more than 1080p, set it to 1080p
-                    if (options->resolution.x > 1920 || options->resolution.y > 1080) {
-                        options->resolution.x = 1920;
-                        options->resolution.y = 1080;
-                    }
-                }
-                SetRuntimeResolution(camera, options->resolution.x, options->resolution.y);
-                PlaySoundFx(FX_SELECT);
+            else if (options->difficulty == FREEPLAY_MEDIUM) {
+                options->difficulty = MEDIUM;
             }
-            else if (isFpsIncrementHovered) {
-                // Change target FPS 30, 60, 120, 144, 240, Basically Unlimited (1000)
-                if (options->targetFps == 30) {
-                    options->targetFps = 60;
-                }
-                else if (options->targetFps == 60) {
-                    options->targetFps = 120;
-                }
-                else if (options->targetFps == 120) {
-                    options->targetFps = 144;
-                }
-                else if (options->targetFps == 144) {
-                    options->targetFps = 240;
-                }
-                else if (options->targetFps == 240) {
-                    options->targetFps = 1000;
-                }
-
-                SetTargetFPS(options->targetFps);
-                PlaySoundFx(FX_SELECT);
+            else if (options->difficulty == MEDIUM) {
+                options->difficulty = FREEPLAY_EASY;
             }
-            else if (isFpsDecrementHovered) {
-                // Change target FPS 30, 60, 120, 144, 240, Basically Unlimited (1000)
-                if (options->targetFps == 60) {
-                    options->targetFps = 30;
-                }
-                else if (options->targetFps == 120) {
-                    options->targetFps = 60;
-                }
-                else if (options->targetFps == 144) {
-                    options->targetFps = 120;
-                }
-                else if (options->targetFps == 240) {
-                    options->targetFps = 144;
-                }
-                else if (options->targetFps == 1000) {
-					options->targetFps = 240;
-				}
-
-                SetTargetFPS(options->targetFps);
-                PlaySoundFx(FX_SELECT);
+            else if (options->difficulty == FREEPLAY_EASY) {
+                options->difficulty = EASY;
             }
-            else if (isFullscreenHovered) {
-                // Toggle fullscreen
-                options->fullscreen = !options->fullscreen;
-                SetRuntimeResolution(camera, options->resolution.x, options->resolution.y);
-                ToggleFullscreen();
-                PlaySoundFx(FX_SELECT);
+            PlaySoundFx(FX_SELECT);
+        }
+        else if (scene->isResolutionIncrementHovered) {
+            // 720p -> 1080p
+            if (options->resolution.x == 1280) {
+                options->resolution.x = 1920;
+                options->resolution.y = 1080;
             }
-            else if (isDebugHovered) {
-				// Toggle debug
-				options->showDebug = !options->showDebug;
-                PlaySoundFx(FX_SELECT);
-			}
-			else if (isBackHovered) {
-				// Go back to main menu
-                isFadingOut = true;
-                PlaySoundFx(FX_SELECT);
-			}
-		    else if (isMusicHovered) {
-				// Toggle music
-				options->musicEnabled = !options->musicEnabled;
-                PlaySoundFx(FX_SELECT);
-                if (options->musicEnabled)
-                    PlayBgm(&menuBgm);
-				else
-                    PauseBgm(&menuBgm);
-			}
-			else if (isSoundFxHovered) {
-				// Toggle sound fx
-				options->soundFxEnabled = !options->soundFxEnabled;
-                PlaySoundFx(FX_SELECT);
-			}
-        }
-
-        // Play sound when hovering over a button, but only once
-        if (!isFadingIn && !isFadingOut)
-        {
-            if (isDifficultyIncrementHovered)
+            // Custom resize resolution
+            else
             {
-                if (!isHovering || currentHoveredButton != 0)
-                {
-                    PlaySoundFx(FX_HOVER);
-                    isHovering = true;
+                // If current resolution is less than 720p, set it to 720p
+                if (options->resolution.x < 1280 || options->resolution.y < 720) {
+                    options->resolution.x = 1280;
+                    options->resolution.y = 720;
                 }
-                currentHoveredButton = 0;
             }
-            else if (isDifficultyDecrementHovered)
-            {
-                if (!isHovering || currentHoveredButton != 1)
-                {
-                    PlaySoundFx(FX_HOVER);
-                    isHovering = true;
-                }
-                currentHoveredButton = 1;
+            SetRuntimeResolution(camera, options->resolution.x, options->resolution.y);
+            PlaySoundFx(FX_SELECT);
+        }
+        else if (scene->isResolutionDecrementHovered) {
+            // 1080p -> 720p
+            if (options->resolution.x == 1920) {
+                options->resolution.x = 1280;
+                options->resolution.y = 720;
             }
-            else if (isResolutionIncrementHovered)
-            {
-                if (!isHovering || currentHoveredButton != 2)
-                {
-                    PlaySoundFx(FX_HOVER);
-                    isHovering = true;
+            // Custom resize resolution
+            else {
+                // If current resolution is more than 1080p, set it to 1080p
+                if (options->resolution.x > 1920 || options->resolution.y > 1080) {
+                    options->resolution.x = 1920;
+                    options->resolution.y = 1080;
                 }
-                currentHoveredButton = 2;
             }
-            else if (isResolutionDecrementHovered)
-            {
-                if (!isHovering || currentHoveredButton != 3)
-                {
-                    PlaySoundFx(FX_HOVER);
-                    isHovering = true;
-                }
-                currentHoveredButton = 3;
+            SetRuntimeResolution(camera, options->resolution.x, options->resolution.y);
+            PlaySoundFx(FX_SELECT);
+        }
+        else if (scene->isFpsIncrementHovered) {
+            // Change target FPS 30, 60, 120, 144, 240, Basically Unlimited (1000)
+            if (options->targetFps == 30) {
+                options->targetFps = 60;
             }
-            else if (isFpsIncrementHovered)
-            {
-                if (!isHovering || currentHoveredButton != 4)
-                {
-                    PlaySoundFx(FX_HOVER);
-                    isHovering = true;
-                }
-                currentHoveredButton = 4;
+            else if (options->targetFps == 60) {
+                options->targetFps = 120;
             }
-            else if (isFpsDecrementHovered)
-            {
-                if (!isHovering || currentHoveredButton != 5)
-                {
-                    PlaySoundFx(FX_HOVER);
-                    isHovering = true;
-                }
-                currentHoveredButton = 5;
+            else if (options->targetFps == 120) {
+                options->targetFps = 144;
             }
-            else if (isFullscreenHovered)
-            {
-                if (!isHovering || currentHoveredButton != 6)
-                {
-                    PlaySoundFx(FX_HOVER);
-                    isHovering = true;
-                }
-                currentHoveredButton = 6;
+            else if (options->targetFps == 144) {
+                options->targetFps = 240;
             }
-            else if (isDebugHovered)
-            {
-                if (!isHovering || currentHoveredButton != 7)
-                {
-                    PlaySoundFx(FX_HOVER);
-                    isHovering = true;
-                }
-                currentHoveredButton = 7;
+            else if (options->targetFps == 240) {
+                options->targetFps = 1000;
             }
-            else if (isBackHovered)
-            {
-                if (!isHovering || currentHoveredButton != 8)
-                {
-                    PlaySoundFx(FX_HOVER);
-                    isHovering = true;
-                }
-                currentHoveredButton = 8;
+
+            SetTargetFPS(options->targetFps);
+            PlaySoundFx(FX_SELECT);
+        }
+        else if (scene->isFpsDecrementHovered) {
+            // Change target FPS 30, 60, 120, 144, 240, Basically Unlimited (1000)
+            if (options->targetFps == 60) {
+                options->targetFps = 30;
             }
-            else if (isMusicHovered)
-            {
-                if (!isHovering || currentHoveredButton != 9)
-                {
-                    PlaySoundFx(FX_HOVER);
-                    isHovering = true;
-                }
-                currentHoveredButton = 9;
+            else if (options->targetFps == 120) {
+                options->targetFps = 60;
             }
-            else if (isSoundFxHovered)
-            {
-                if (!isHovering || currentHoveredButton != 10)
-                {
-                    PlaySoundFx(FX_HOVER);
-                    isHovering = true;
-                }
-                currentHoveredButton = 10;
+            else if (options->targetFps == 144) {
+                options->targetFps = 120;
             }
-            else
-            {
-                currentHoveredButton = NULL;
-                isHovering = false;
+            else if (options->targetFps == 240) {
+                options->targetFps = 144;
             }
+            else if (options->targetFps == 1000) {
+                options->targetFps = 240;
+            }
+
+            SetTargetFPS(options->targetFps);
+            PlaySoundFx(FX_SELECT);
+        }
+        else if (scene->isQualityIncrementHovered || scene->isQualityDecrementHovered) {
+            // Low <-> Medium <-> High, MSAA only takes effect on the next launch
+            QualityPreset quality = options->quality;
+            if (scene->isQualityIncrementHovered && quality < QUALITY_HIGH)
+                quality++;
+            else if (scene->isQualityDecrementHovered && quality > QUALITY_LOW)
+                quality--;
+
+            ApplyQualityPreset(options, quality);
+            SetRuntimeResolution(camera, options->resolution.x, options->resolution.y);
+            SetTargetFPS(options->targetFps);
+            ApplyTextureQuality();
+            PlaySoundFx(FX_SELECT);
+        }
+        else if (scene->isFullscreenHovered) {
+            // Toggle fullscreen
+            options->fullscreen = !options->fullscreen;
+            SetRuntimeResolution(camera, options->resolution.x, options->resolution.y);
+            ToggleFullscreen();
+            PlaySoundFx(FX_SELECT);
+        }
+        else if (scene->isDebugHovered) {
+            // Toggle debug
+            options->showDebug = !options->showDebug;
+            PlaySoundFx(FX_SELECT);
+        }
+        else if (scene->isBackHovered) {
+            // Go back to main menu
+            scene->isFadingOut = true;
+            StartTask(OptionsFadeOutTask, scene);
+            SaveGameOptions(options);
+            PlaySoundFx(FX_SELECT);
+        }
+        else if (scene->isMusicHovered) {
+            // Toggle music
+            options->musicEnabled = !options->musicEnabled;
+            PlaySoundFx(FX_SELECT);
+            if (options->musicEnabled)
+                PlayBgm(&menuBgm);
+            else
+                PauseBgm(&menuBgm);
         }
+        else if (scene->isSoundFxHovered) {
+            // Toggle sound fx
+            options->soundFxEnabled = !options->soundFxEnabled;
+            PlaySoundFx(FX_SELECT);
+        }
+    }
+
+    // Play sound when hovering over a button, but only once
+    // Back may have started the fade out just now
+    if (!isFading && !scene->isFadingOut)
+    {
+        if (scene->isDifficultyIncrementHovered)
+            HoverOptionsButton(scene, 0);
+        else if (scene->isDifficultyDecrementHovered)
+            HoverOptionsButton(scene, 1);
+        else if (scene->isResolutionIncrementHovered)
+            HoverOptionsButton(scene, 2);
+        else if (scene->isResolutionDecrementHovered)
+            HoverOptionsButton(scene, 3);
+        else if (scene->isFpsIncrementHovered)
+            HoverOptionsButton(scene, 4);
+        else if (scene->isFpsDecrementHovered)
+            HoverOptionsButton(scene, 5);
+        else if (scene->isQualityIncrementHovered)
+            HoverOptionsButton(scene, 11);
+        else if (scene->isQualityDecrementHovered)
+            HoverOptionsButton(scene, 12);
+        else if (scene->isFullscreenHovered)
+            HoverOptionsButton(scene, 6);
+        else if (scene->isDebugHovered)
+            HoverOptionsButton(scene, 7);
+        else if (scene->isBackHovered)
+            HoverOptionsButton(scene, 8);
+        else if (scene->isMusicHovered)
+            HoverOptionsButton(scene, 9);
+        else if (scene->isSoundFxHovered)
+            HoverOptionsButton(scene, 10);
         else
         {
-            isDifficultyIncrementHovered = false;
-            isDifficultyDecrementHovered = false;
-            isResolutionIncrementHovered = false;
-            isResolutionDecrementHovered = false;
-            isFpsIncrementHovered = false;
-            isFpsDecrementHovered = false;
-            isMusicHovered = false;
-            isSoundFxHovered = false;
-            isFullscreenHovered = false;
-            isDebugHovered = false;
-            isBackHovered = false;
-        }
-        if (firstRender)
-            firstRender = false;
-
-        // Draw
-
-        BeginDrawing();
-        ClearBackground(BLACK);
+            scene->currentHoveredButton = NO_HOVERED_BUTTON;
+            scene->isHovering = false;
+        }
+    }
+    else
+    {
+        scene->isDifficultyIncrementHovered = false;
+        scene->isDifficultyDecrementHovered = false;
+        scene->isResolutionIncrementHovered = false;
+        scene->isResolutionDecrementHovered = false;
+        scene->isFpsIncrementHovered = false;
+        scene->isFpsDecrementHovered = false;
+        scene->isQualityIncrementHovered = false;
+        scene->isQualityDecrementHovered = false;
+        scene->isMusicHovered = false;
+        scene->isSoundFxHovered = false;
+        scene->isFullscreenHovered = false;
+        scene->isDebugHovered = false;
+        scene->isBackHovered = false;
+    }
+    if (scene->firstRender)
+        scene->firstRender = false;
+}
 
+void OptionsDraw(Camera2D* camera, double deltaTime)
+{
+    const OptionsScene* scene = &optionsScene;
+    float alpha = scene->alpha;
 
-        BeginMode2D(*camera);
+    ClearBackground(BLACK);
 
-        int imageWidth = backgroundTexture.width;
-        int imageHeight = backgroundTexture.height;
+    int imageWidth = backgroundTexture.width;
+    int imageHeight = backgroundTexture.height;
 
-        float scaleX = (float)BASE_SCREEN_WIDTH / imageWidth;
-        float scaleY = (float)BASE_SCREEN_HEIGHT / imageHeight;
+    float scaleX = (float)BASE_SCREEN_WIDTH / imageWidth;
+    float scaleY = (float)BASE_SCREEN_HEIGHT / imageHeight;
 
-        // Draw the background with the scaled dimensions
-        //DrawTextureEx(backgroundTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
+    // Draw the background with the scaled dimensions
+    //DrawTextureEx(backgroundTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
 
-        DrawDayNightCycle(deltaTime);
+    DrawDayNightCycle(deltaTime);
 
-        // Draw falling items behind the menu
-        DrawMenuFallingItems(deltaTime, true);
+    // Draw falling items behind the menu
+    DrawMenuFallingItems(deltaTime, true);
 
-        DrawCustomerInMenu(deltaTime);
+    DrawCustomerInMenu(deltaTime);
 
-        DrawTextureEx(backgroundOverlayTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
+    DrawTextureEx(backgroundOverlayTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
 
-        // Draw falling items in front of the menu
-        DrawMenuFallingItems(deltaTime, false);
+    // Draw falling items in front of the menu
+    DrawMenuFallingItems(deltaTime, false);
 
-        // Music
-        DrawTextureEx(options->musicEnabled ? checkboxChecked : checkbox, (Vector2) { musicRect.x + 10, musicRect.y + 10 }, 0.0f, 1.0f / 6.0f, ColorAlphaOverride(WHITE, isMusicHovered ? 0.75 : alpha));
-		DrawTextEx(meowFont, "Music", (Vector2) { musicRect.x + 80, musicRect.y + 22 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, isMusicHovered ? 0.75 : alpha));
+    // Music
+    DrawTextureEx(options->musicEnabled ? checkboxChecked : checkbox, (Vector2) { scene->musicRect.x + 10, scene->musicRect.y + 10 }, 0.0f, 1.0f / 6.0f, ColorAlphaOverride(WHITE, scene->isMusicHovered ? 0.75 : alpha));
+    DrawTextEx(meowFont, "Music", (Vector2) { scene->musicRect.x + 80, scene->musicRect.y + 22 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, scene->isMusicHovered ? 0.75 : alpha));
 
-        // Sound FX
-        DrawTextureEx(options->soundFxEnabled ? checkboxChecked : checkbox, (Vector2) { soundFxRect.x + 10, soundFxRect.y + 10 }, 0.0f, 1.0f / 6.0f, ColorAlphaOverride(WHITE, isSoundFxHovered ? 0.75 : alpha));
-        DrawTextEx(meowFont, "Sound FX", (Vector2) { soundFxRect.x + 80, soundFxRect.y + 22 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, isSoundFxHovered ? 0.75 : alpha));
+    // Sound FX
+    DrawTextureEx(options->soundFxEnabled ? checkboxChecked : checkbox, (Vector2) { scene->soundFxRect.x + 10, scene->soundFxRect.y + 10 }, 0.0f, 1.0f / 6.0f, ColorAlphaOverride(WHITE, scene->isSoundFxHovered ? 0.75 : alpha));
+    DrawTextEx(meowFont, "Sound FX", (Vector2) { scene->soundFxRect.x + 80, scene->soundFxRect.y + 22 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, scene->isSoundFxHovered ? 0.75 : alpha));
 
-        // Fullscreen
-        DrawTextureEx(options->fullscreen ? checkboxChecked : checkbox, (Vector2) { fullscreenRect.x + 10, fullscreenRect.y + 10 }, 0.0f, 1.0f / 6.0f, ColorAlphaOverride(WHITE, isFullscreenHovered ? 0.75 : alpha));
-        DrawTextEx(meowFont, "Fullscreen", (Vector2) { fullscreenRect.x + 80, fullscreenRect.y + 22 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, isFullscreenHovered ? 0.75 : alpha));
+    // Fullscreen
+    DrawTextureEx(options->fullscreen ? checkboxChecked : checkbox, (Vector2) { scene->fullscreenRect.x + 10, scene->fullscreenRect.y + 10 }, 0.0f, 1.0f / 6.0f, ColorAlphaOverride(WHITE, scene->isFullscreenHovered ? 0.75 : alpha));
+    DrawTextEx(meowFont, "Fullscreen", (Vector2) { scene->fullscreenRect.x + 80, scene->fullscreenRect.y + 22 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, scene->isFullscreenHovered ? 0.75 : alpha));
 
-        // Debug
-        DrawTextureEx(options->showDebug ? checkboxChecked : checkbox, (Vector2) { debugRect.x + 10, debugRect.y + 10 }, 0.0f, 1.0f / 6.0f, ColorAlphaOverride(WHITE, isDebugHovered ? 0.75 : alpha));
-		DrawTextEx(meowFont, "Debug", (Vector2) { debugRect.x + 80, debugRect.y + 22 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, isDebugHovered ? 0.75 : alpha));
+    // Debug
+    DrawTextureEx(options->showDebug ? checkboxChecked : checkbox, (Vector2) { scene->debugRect.x + 10, scene->debugRect.y + 10 }, 0.0f, 1.0f / 6.0f, ColorAlphaOverride(WHITE, scene->isDebugHovered ? 0.75 : alpha));
+    DrawTextEx(meowFont, "Debug", (Vector2) { scene->debugRect.x + 80, scene->debugRect.y + 22 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, scene->isDebugHovered ? 0.75 : alpha));
 
-        // Difficulty
-        DrawTextureEx(left_arrow, (Vector2) { difficultyDecrementRect.x , difficultyDecrementRect.y}, 0.0f, 1.0f / 5.0f, ColorAlphaOverride(WHITE, isDifficultyDecrementHovered ? 0.75 : alpha));
-        DrawTextureEx(right_arrow, (Vector2) { difficultyIncrementRect.x, difficultyIncrementRect.y }, 0.0f, 1.0f / 5.0f, ColorAlphaOverride(WHITE, isDifficultyIncrementHovered ? 0.75 : alpha));
-        DrawTextEx(meowFont, "Difficulty", (Vector2) { difficultyRect.x + 80, difficultyRect.y + 10 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, alpha));
-        DrawTextEx(meowFont, StringFromDifficultyEnum(options->difficulty), (Vector2) { difficultyRect.x + 80, difficultyRect.y + 42 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, alpha));
+    // Difficulty
+    DrawTextureEx(left_arrow, (Vector2) { scene->difficultyDecrementRect.x , scene->difficultyDecrementRect.y}, 0.0f, 1.0f / 5.0f, ColorAlphaOverride(WHITE, scene->isDifficultyDecrementHovered ? 0.75 : alpha));
+    DrawTextureEx(right_arrow, (Vector2) { scene->difficultyIncrementRect.x, scene->difficultyIncrementRect.y }, 0.0f, 1.0f / 5.0f, ColorAlphaOverride(WHITE, scene->isDifficultyIncrementHovered ? 0.75 : alpha));
+    DrawTextEx(meowFont, "Difficulty", (Vector2) { scene->difficultyRect.x + 80, scene->difficultyRect.y + 10 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, alpha));
+    DrawTextEx(meowFont, StringFromDifficultyEnum(options->difficulty), (Vector2) { scene->difficultyRect.x + 80, scene->difficultyRect.y + 42 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, alpha));
 
-        // Resolution
-        DrawTextureEx(left_arrow, (Vector2) { resolutionDecrementRect.x, resolutionDecrementRect.y }, 0.0f, 1.0f / 5.0f, ColorAlphaOverride(WHITE, isResolutionDecrementHovered ? 0.75 : alpha));
-        DrawTextureEx(right_arrow, (Vector2) { resolutionIncrementRect.x, resolutionDecrementRect.y }, 0.0f, 1.0f / 5.0f, ColorAlphaOverride(WHITE, isResolutionIncrementHovered ? 0.75 : alpha));
-        DrawTextEx(meowFont, "Resolution", (Vector2) { resolutionRect.x + 80, resolutionRect.y + 10 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, alpha));
-        DrawTextEx(meowFont, TextFormat("%dx%d", options->resolution.x, options->resolution.y), (Vector2) { resolutionRect.x + 80, resolutionRect.y + 42 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, alpha));
+    // Resolution
+    DrawTextureEx(left_arrow, (Vector2) { scene->resolutionDecrementRect.x, scene->resolutionDecrementRect.y }, 0.0f, 1.0f / 5.0f, ColorAlphaOverride(WHITE, scene->isResolutionDecrementHovered ? 0.75 : alpha));
+    DrawTextureEx(right_arrow, (Vector2) { scene->resolutionIncrementRect.x, scene->resolutionDecrementRect.y }, 0.0f, 1.0f / 5.0f, ColorAlphaOverride(WHITE, scene->isResolutionIncrementHovered ? 0.75 : alpha));
+    DrawTextEx(meowFont, "Resolution", (Vector2) { scene->resolutionRect.x + 80, scene->resolutionRect.y + 10 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, alpha));
+    DrawTextEx(meowFont, TextFormat("%dx%d", options->resolution.x, options->resolution.y), (Vector2) { scene->resolutionRect.x + 80, scene->resolutionRect.y + 42 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, alpha));
 
-        // FPS
-        DrawTextureEx(left_arrow, (Vector2) { fpsDecrementRect.x, fpsDecrementRect.y }, 0.0f, 1.0f / 5.0f, ColorAlphaOverride(WHITE, isFpsDecrementHovered ? 0.75 : alpha));
-        DrawTextureEx(right_arrow, (Vector2) { fpsIncrementRect.x, fpsDecrementRect.y }, 0.0f, 1.0f / 5.0f, ColorAlphaOverride(WHITE, isFpsIncrementHovered ? 0.75 : alpha));
-		DrawTextEx(meowFont, "Target FPS", (Vector2) { fpsRect.x + 80, fpsRect.y + 10 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, alpha));
-        DrawTextEx(meowFont, TextFormat("%d FPS", options->targetFps), (Vector2) { fpsRect.x + 80, fpsRect.y + 42 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, alpha));
+    // FPS
+    DrawTextureEx(left_arrow, (Vector2) { scene->fpsDecrementRect.x, scene->fpsDecrementRect.y }, 0.0f, 1.0f / 5.0f, ColorAlphaOverride(WHITE, scene->isFpsDecrementHovered ? 0.75 : alpha));
+    DrawTextureEx(right_arrow, (Vector2) { scene->fpsIncrementRect.x, scene->fpsDecrementRect.y }, 0.0f, 1.0f / 5.0f, ColorAlphaOverride(WHITE, scene->isFpsIncrementHovered ? 0.75 : alpha));
+    DrawTextEx(meowFont, "Target FPS", (Vector2) { scene->fpsRect.x + 80, scene->fpsRect.y + 10 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, alpha));
+    DrawTextEx(meowFont, TextFormat("%d FPS", options->targetFps), (Vector2) { scene->fpsRect.x + 80, scene->fpsRect.y + 42 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, alpha));
 
+    // Quality
+    DrawTextureEx(left_arrow, (Vector2) { scene->qualityDecrementRect.x, scene->qualityDecrementRect.y }, 0.0f, 1.0f / 5.0f, ColorAlphaOverride(WHITE, scene->isQualityDecrementHovered ? 0.75 : alpha));
+    DrawTextureEx(right_arrow, (Vector2) { scene->qualityIncrementRect.x, scene->qualityIncrementRect.y }, 0.0f, 1.0f / 5.0f, ColorAlphaOverride(WHITE, scene->isQualityIncrementHovered ? 0.75 : alpha));
+    DrawTextEx(meowFont, "Quality", (Vector2) { scene->qualityRect.x + 80, scene->qualityRect.y + 10 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, alpha));
+    DrawTextEx(meowFont, StringFromQualityPresetEnum(options->quality), (Vector2) { scene->qualityRect.x + 80, scene->qualityRect.y + 42 }, 32, 2, ColorAlphaOverride(MAIN_BROWN, alpha));
 
-        // Back
-        DrawRectangleRec(backRect, isBackHovered ? ColorAlphaOverride(MAIN_ORANGE, alpha) : ColorAlphaOverride(MAIN_BROWN, alpha));
-        DrawTextEx(meowFont, "Back", (Vector2) { backRect.x + 60, backRect.y + 20 }, 32, 2, ColorAlphaOverride(WHITE, alpha));
 
-        // Draw debug
-        if (options->showDebug && debugToolToggles.showObjects)
-        {
-            DrawRectangleLinesEx(difficultyRect, 1, RED);
-            DrawRectangleLinesEx(difficultyDecrementRect, 1, RED);
-            DrawRectangleLinesEx(difficultyIncrementRect, 1, RED);
-            DrawRectangleLinesEx(resolutionRect, 1, RED);
-            DrawRectangleLinesEx(resolutionDecrementRect, 1, RED);
-            DrawRectangleLinesEx(resolutionIncrementRect, 1, RED);
-            DrawRectangleLinesEx(fpsRect, 1, RED);
-            DrawRectangleLinesEx(fpsDecrementRect, 1, RED);
-            DrawRectangleLinesEx(fpsIncrementRect, 1, RED);
+    // Back
+    DrawRectangleRec(scene->backRect, scene->isBackHovered ? ColorAlphaOverride(MAIN_ORANGE, alpha) : ColorAlphaOverride(MAIN_BROWN, alpha));
+    DrawTextEx(meowFont, "Back", (Vector2) { scene->backRect.x + 60, scene->backRect.y + 20 }, 32, 2, ColorAlphaOverride(WHITE, alpha));
 
-            DrawRectangleLinesEx(musicRect, 1, RED);
-            DrawRectangleLinesEx(soundFxRect, 1, RED);
-            DrawRectangleLinesEx(fullscreenRect, 1, RED);
-            DrawRectangleLinesEx(debugRect, 1, RED);
-        }
+    // Draw debug
+    if (options->showDebug && debugToolToggles.showObjects)
+    {
+        DrawRectangleLinesEx(scene->difficultyRect, 1, RED);
+        DrawRectangleLinesEx(scene->difficultyDecrementRect, 1, RED);
+        DrawRectangleLinesEx(scene->difficultyIncrementRect, 1, RED);
+        DrawRectangleLinesEx(scene->resolutionRect, 1, RED);
+        DrawRectangleLinesEx(scene->resolutionDecrementRect, 1, RED);
+        DrawRectangleLinesEx(scene->resolutionIncrementRect, 1, RED);
+        DrawRectangleLinesEx(scene->fpsRect, 1, RED);
+        DrawRectangleLinesEx(scene->fpsDecrementRect, 1, RED);
+        DrawRectangleLinesEx(scene->fpsIncrementRect, 1, RED);
+        DrawRectangleLinesEx(scene->qualityRect, 1, RED);
+        DrawRectangleLinesEx(scene->qualityDecrementRect, 1, RED);
+        DrawRectangleLinesEx(scene->qualityIncrementRect, 1, RED);
+
+        DrawRectangleLinesEx(scene->musicRect, 1, RED);
+        DrawRectangleLinesEx(scene->soundFxRect, 1, RED);
+        DrawRectangleLinesEx(scene->fullscreenRect, 1, RED);
+        DrawRectangleLinesEx(scene->debugRect, 1, RED);
+    }
 
-        DrawOuterWorld();
+    DrawOuterWorld();
+}
 
-        if (options->showDebug)
-            DrawDebugOverlay(camera);
+int RandomCustomerTexture(Shift* shift)
+{
+    return NextRandomInt(&shift->random[RANDOM_CUSTOMERS], 0, (sizeof(customersImageData) / sizeof(customersImageData[0])) - 1);
+}
+// Puts every station and cup back in its starting state, the plate has to be loaded first
+void ResetCounter(Cup* cups)
+{
+    // Every cup has its own resting spot around the plate
+    for (int i = 0; i < MAX_CUPS; i++)
+    {
+        cups[i] = (Cup){ 0 };
+        cups[i].texture = RecipeTexture(RECIPE_EMPTY);
+        cups[i].frameRectangle = frameRectCup(&cups[i], 2, 1);
+        cups[i].originalPosition.x = plate.position.x + cupPlateOffsets[i].x + plate.texture.width / 2 - cups[i].frameRectangle.width / 2;
+        cups[i].originalPosition.y = plate.position.y + cupPlateOffsets[i].y + plate.texture.height / 2 - cups[i].frameRectangle.height / 2;
+        cups[i].position = cups[i].originalPosition;
+    }
 
-        EndMode2D();
-        EndDrawing();
+    for (int i = 0; i < INGREDIENT_COUNT; i++)
+    {
+        const IngredientInfo* info = &ingredientInfo[i];
+        Ingredient* ingredient = &ingredients[i];
+
+        *ingredient = (Ingredient){
+            .texture = ingredientTextures[i],
+            .canChangeCupTexture = info->startsReady,
+            .position = IngredientRestPosition((IngredientId)i),
+            .currentFrame = 1,
+            .id = (IngredientId)i,
+        };
+        ingredient->frameRectangle = frameRect(ingredient, info->totalFrames, ingredient->currentFrame);
+        // Picking uses the alpha masks built when the spritesheets were loaded
+        ingredient->hitMask = &ingredientHitMasks[i];
     }
+}
 
-    ExitApplication();
+// Dragable stations come straight from the registry
+void DrawCupDebug(const Cup* cup, int index, bool held)
+{
+    DrawRectangleLinesEx((Rectangle) { cup->position.x, cup->position.y, cup->frameRectangle.width, cup->frameRectangle.height }, 1, RED);
+    DrawRectangle(cup->position.x, cup->position.y - 60, 400, 60, Fade(GRAY, 0.7));
+    DrawTextEx(meowFont, TextFormat("Powder type: %d, Water: %d, Creamer: %d", cup->powderType, cup->hasWater, cup->creamerType), (Vector2) { cup->position.x, cup->position.y - 20 }, 20, 1, WHITE);
+    DrawTextEx(meowFont, TextFormat("Topping: %d, Sauce: %d", cup->toppingType, cup->sauceType), (Vector2) { cup->position.x, cup->position.y - 40 }, 20, 1, WHITE);
+    DrawTextEx(meowFont, TextFormat("%s %d | XY %.2f,%.2f | Held %s", "Cup", index, cup->position.x, cup->position.y, held ? "[Yes]" : "[No]"), (Vector2) { cup->position.x, cup->position.y - 60 }, 20, 1, WHITE);
 }
 
-int RandomCustomerTexture()
+int CollectDragSources(DragSource* sources)
 {
-    // Seed the random number generator with the current time
-    srand(time(NULL));
+    int count = 0;
+    for (int i = 0; i < INGREDIENT_COUNT; i++)
+    {
+        const IngredientInfo* info = &ingredientInfo[i];
+        if (!info->draggable) continue;
 
-    int randomIndex = rand() % (sizeof(customersImageData) / sizeof(customersImageData[0]));
-    return randomIndex;
+        Ingredient* popObject = info->popObject != INGREDIENT_NO_POP ? &ingredients[info->popObject] : NULL;
+        sources[count++] = (DragSource){ &ingredients[i], popObject, info->z };
+    }
+    return count;
 }
-void GameUpdate(Camera2D *camera)
+
+// Lives outside the frame loop so the drag controller can keep pointing at the cups between frames
+typedef struct {
+    Cup cups[MAX_CUPS];
+    DragSource dragSources[INGREDIENT_COUNT];
+    DragController dragController;
+    HitIndex hitIndex;
+    Rectangle endScene;
+
+    bool passedInitialPhrase;
+    bool isHovering;
+    bool hoversoundPlayed;
+    bool isendSceneHovered;
+} GameScene;
+
+GameScene gameScene;
+
+void GameEnter(Camera2D* camera)
 {
-    double lastFrameTime = GetTime();
-    bool isDragging = false;
-    bool isDraggingOnce = false;
+    GameScene* scene = &gameScene;
 
-    bool isHovering = false;
-    bool hoversoundPlayed = false;
+    SampleSoakRound();
+
+    // The gate plays one shift at every difficulty in turn
+    if (perfGate.enabled)
+        options->difficulty = (Difficulty)(EASY + perfGate.gamesPlayed++);
+    EnterPerfScene((PerfScene)(PERF_SCENE_GAME_EASY + options->difficulty));
+
+    scene->isHovering = false;
+    scene->hoversoundPlayed = false;
+    scene->isendSceneHovered = false;
 
     // Start from night
     currentColorIndex = 3;
@@ -2653,367 +6396,438 @@ void GameUpdate(Camera2D *camera)
     dayNightCycleDuration = gameDuration * 3;
     colorTransitionTime = 0.2f;
 
-    bool passedInitialPhrase = false;
-
-    Cup cup = {
-        LoadTexture(ASSETS_PATH"combination/EMPTY.png"),
-        (Vector2) {0, 0},
-        NONE,
-        false,
-        NONE,
-        NONE,
-        NONE,
-        false,
-        '\0'
-    };
+    scene->passedInitialPhrase = false;
 
+    // Only the counter uses the plate, it is released again in GameExit
     plate = (DropArea){ LoadTexture(ASSETS_PATH"/spritesheets/MAT.png"), oriplatePosition };
-    Texture2D cups = LoadTexture(ASSETS_PATH"/spritesheets/CUPS.png");
-
-    teaPowder = (Ingredient){ teaPowderTexture, true, oriteapowderPosition, oriteapowderPosition };
-    teaPowder.totalFrames = 3;
-    teaPowder.currentFrame = 1;
-    teaPowder.frameRectangle = frameRect(teaPowder, teaPowder.totalFrames, teaPowder.currentFrame);
-
-    cocoaPowder = (Ingredient){ cocoaPowderTexture, true, oricocoapowderPosition, oricocoapowderPosition };
-    cocoaPowder.totalFrames = 3;
-    cocoaPowder.currentFrame = 1;
-    cocoaPowder.frameRectangle = frameRect(cocoaPowder, cocoaPowder.totalFrames, cocoaPowder.currentFrame);
-
-    caramelSauce = (Ingredient){ caramelSauceTexture, true, oricaramelPosition, oricaramelPosition };
-    caramelSauce.totalFrames = 3;
-    caramelSauce.currentFrame = 1;
-    caramelSauce.frameRectangle = frameRect(caramelSauce, caramelSauce.totalFrames, caramelSauce.currentFrame);
-
-    chocolateSauce = (Ingredient){ chocolateSauceTexture, true, orichocolatePosition, orichocolatePosition };
-    chocolateSauce.totalFrames = 3;
-    chocolateSauce.currentFrame = 1;
-    chocolateSauce.frameRectangle = frameRect(chocolateSauce, chocolateSauce.totalFrames, chocolateSauce.currentFrame);
-
-    condensedMilk = (Ingredient){ condensedMilkTexture, true, oricondensedmilkPosition, oricondensedmilkPosition };
-    condensedMilk.totalFrames = 2;
-    condensedMilk.currentFrame = 1;
-    condensedMilk.frameRectangle = frameRect(condensedMilk, condensedMilk.totalFrames, condensedMilk.currentFrame);
-
-    normalMilk = (Ingredient){ normalMilkTexture, true, orimilkPosition, orimilkPosition };
-    normalMilk.totalFrames = 2;
-    normalMilk.currentFrame = 1;
-    normalMilk.frameRectangle = frameRect(normalMilk, normalMilk.totalFrames, normalMilk.currentFrame);
-
-    marshMellow = (Ingredient){ marshMellowTexture, true, orimarshmellowPosition, orimarshmellowPosition };
-    marshMellow.totalFrames = 2;
-    marshMellow.currentFrame = 1;
-    marshMellow.frameRectangle = frameRect(marshMellow, marshMellow.totalFrames, marshMellow.currentFrame);
-
-    whippedCream = (Ingredient){ whippedCreamTexture, true, oriwhippedPosition, oriwhippedPosition };
-    whippedCream.totalFrames = 2;
-    whippedCream.currentFrame = 1;
-    whippedCream.frameRectangle = frameRect(whippedCream, whippedCream.totalFrames, whippedCream.currentFrame);
-
-    hotWater = (Ingredient){ hotWaterTexture, true, oriwaterPosition, oriwaterPosition };
-    hotWater.totalFrames = 17;
-    hotWater.currentFrame = 1;
-    hotWater.frameRectangle = frameRect(hotWater, hotWater.totalFrames, hotWater.currentFrame);
-    hotWater.canChangeCupTexture = false;
-
-    greenChon = (Ingredient){ greenChonTexture, false, hiddenPosition, hiddenPosition };
-    greenChon.totalFrames = 1;
-    greenChon.currentFrame = 1;
-    greenChon.frameRectangle = frameRect(greenChon, greenChon.totalFrames, greenChon.currentFrame);
-
-    cocoaChon = (Ingredient){ cocoaChonTexture, false, hiddenPosition, hiddenPosition };
-    cocoaChon.totalFrames = 1;
-    cocoaChon.currentFrame = 1;
-	cocoaChon.frameRectangle = frameRect(cocoaChon, cocoaChon.totalFrames, cocoaChon.currentFrame);
-
-
-    trashCan = (Ingredient){ trashCanTexture, false, trashCanPosition, trashCanPosition };
-    trashCan.currentFrame = 1;
-    trashCan.totalFrames = 2;
-    trashCan.frameRectangle = frameRect(trashCan, trashCan.totalFrames, trashCan.currentFrame);
-
-    Texture2D* currentDrag = NULL;
-
-    Customer customer1;
-    Customer customer2;
-    Customer customer3;
-
-    Customers customers;
-
-    Vector2 customer1Position = { baseX + 50, baseY + 100 };
-    Vector2 customer2Position = { baseX + 650, baseY + 100 };
-    Vector2 customer3Position = { baseX + 1250, baseY + 100 };
-
-    Rectangle endScene = { 770, -500, 140, 70 };
-
-    double initialReset[3];
-    RandomCustomerInitialResetBasedOnDifficulty(&initialReset);
-
-    customer1 = CreateCustomerWithOrder(1, 0, RandomCustomerTimeoutBasedOnDifficulty(), customer1Position, RandomCustomerTexture(), initialReset[0]);
-    customer2 = CreateCustomerWithOrder(1, 0, RandomCustomerTimeoutBasedOnDifficulty(), customer2Position, RandomCustomerTexture(), initialReset[1]);
-    customer3 = CreateCustomerWithOrder(1, 0, RandomCustomerTimeoutBasedOnDifficulty(), customer3Position, RandomCustomerTexture(), initialReset[2]);
-    customer1.visible = false;
-    customer2.visible = false;
-    customer3.visible = false;
-
-    customers.customer1 = customer1;
-    customers.customer2 = customer2;
-    customers.customer3 = customer3;
-    
-    while (!WindowShouldClose())
-    {
-        // Calculate delta time
-        double deltaTime = GetTime() - lastFrameTime;
-        lastFrameTime = GetTime();
 
-        WindowUpdate(camera);
+    ResetCounter(scene->cups);
 
-        bool anyDragDetected = false;
+    // Pick up recipe mix changes made since the last shift
+    LoadRecipeCatalog(&recipeCatalog, RECIPE_CATALOG_FILE);
 
-        if (!IsMouseButtonDown(MOUSE_LEFT_BUTTON))
-        {
-            dragAndDropLocked = false;
-        }
+    // Customer and boiler timers run on this scene's simulation time
+    BeginShift(&gameShift, options->difficulty, randomStreams, false);
 
-        if (!dragAndDropLocked)
-        {
-            // Dragable items
-            if (currentDrag == NULL || currentDrag == &teaPowder.texture) {
-                currentDrag = DragAndDropIngredientPop(&teaPowder, &greenChon, &cup, camera);
-                if (currentDrag != NULL) anyDragDetected = true;
-            }if (currentDrag == NULL || currentDrag == &cocoaPowder.texture) {
-                // currentDrag = DragAndDropIngredient(&cocoaPowder, &plate, &cup, camera);
-                currentDrag = DragAndDropIngredientPop(&cocoaPowder, &cocoaChon, &cup, camera);
-                if (currentDrag != NULL) anyDragDetected = true;
-            }if (currentDrag == NULL || currentDrag == &condensedMilk.texture) {
-                currentDrag = DragAndDropIngredient(&condensedMilk, &cup, camera);
-                if (currentDrag != NULL) anyDragDetected = true;
-            }if (currentDrag == NULL || currentDrag == &normalMilk.texture) {
-                currentDrag = DragAndDropIngredient(&normalMilk, &cup, camera);
-                if (currentDrag != NULL) anyDragDetected = true;
-            }if (currentDrag == NULL || currentDrag == &whippedCream.texture) {
-                currentDrag = DragAndDropIngredient(&whippedCream, &cup, camera);
-                if (currentDrag != NULL) anyDragDetected = true;
-            }if (currentDrag == NULL || currentDrag == &marshMellow.texture) {
-                currentDrag = DragAndDropIngredient(&marshMellow, &cup, camera);
-                if (currentDrag != NULL) anyDragDetected = true;
-            }if (currentDrag == NULL || currentDrag == &caramelSauce.texture) {
-                currentDrag = DragAndDropIngredient(&caramelSauce, &cup, camera);
-                if (currentDrag != NULL) anyDragDetected = true;
-            }if (currentDrag == NULL || currentDrag == &chocolateSauce.texture) {
-                currentDrag = DragAndDropIngredient(&chocolateSauce, &cup, camera);
-                if (currentDrag != NULL) anyDragDetected = true;
-            }if (currentDrag == NULL || currentDrag == &hotWater.texture) {
-                currentDrag = DragAndDropIngredient(&hotWater, &cup, camera);
-                if (currentDrag != NULL) anyDragDetected = true;
-            }
-            if (currentDrag == NULL || currentDrag == &cup.texture) {
-                currentDrag = DragAndDropCup(&cup, &plate, camera, &customers, &trashCan);
-                if (currentDrag != NULL) anyDragDetected = true;
-            }
-        }
+    scene->endScene = (Rectangle){ 770, -500, 140, 70 };
 
-        
+    int dragSourceCount = CollectDragSources(scene->dragSources);
+    scene->dragController = CreateDragController(scene->dragSources, dragSourceCount, scene->cups, MAX_CUPS);
 
-        if (!dragAndDropLocked && !anyDragDetected && IsMouseButtonDown(MOUSE_LEFT_BUTTON))
-        {
-            dragAndDropLocked = true;
-        }
+    // Clicks from the previous scene must not reach the counter
+    ClearInputEvents();
+    polledPointerCount = 0;
+}
 
-        bool previousIsDragging = isDragging;
+static inline bool IsFreeplay(Difficulty difficulty)
+{
+    return difficulty == FREEPLAY_EASY || difficulty == FREEPLAY_MEDIUM || difficulty == FREEPLAY_HARD;
+}
 
-        // If something is dragged now, play sound
-        if (currentDrag != NULL && !isDraggingOnce)
-		{
-            PlaySoundFx(FX_PICKUP);
-            isDraggingOnce = true;
-		}
-		else if (currentDrag == NULL)
-		{
-            if(previousIsDragging != isDraggingOnce)
-                PlaySoundFx(FX_DROP);
-
-            isDraggingOnce = false;
-		}
-
-        isHovering = false;
-        // check mouse not down
-        if (IsMouseButtonUp(MOUSE_LEFT_BUTTON)) {
-            // call highlightItem for each item
-            isHovering = highlightItem(&teaPowder, camera) || isHovering;
-            isHovering = highlightItem(&cocoaPowder, camera) || isHovering;
-            isHovering = highlightItem(&condensedMilk, camera) || isHovering;
-            isHovering = highlightItem(&normalMilk, camera) || isHovering;
-            isHovering = highlightItem(&whippedCream, camera) || isHovering;
-            isHovering = highlightItem(&marshMellow, camera) || isHovering;
-            isHovering = highlightItem(&caramelSauce, camera) || isHovering;
-            isHovering = highlightItem(&chocolateSauce, camera) || isHovering;
-            isHovering = highlightItem(&hotWater, camera) || isHovering;
-            isHovering = highlightItem(&trashCan,camera) || isHovering;
-        }
-        else {
-            isHovering = false;
-        }
-        if (isHovering && !hoversoundPlayed) {
+void GameUpdate(Camera2D* camera, double deltaTime)
+{
+    GameScene* scene = &gameScene;
+    Shift* shift = &gameShift;
+    Ingredient* trashCan = &ingredients[INGREDIENT_TRASH_CAN];
 
-            hoversoundPlayed = true;
-            //PlaySound(hover);
+    // Sample input and index the interactive items once, everything below queries these
+    InputSnapshot input = TakeInputSnapshot(camera);
+    BuildHitIndex(&scene->hitIndex, &scene->dragController, trashCan);
 
-        }
-        else if (!isHovering) {
-            hoversoundPlayed = false;
-        }
+    PumpInputEvents();
+    UpdateDragController(&scene->dragController, camera, &scene->hitIndex, shift, trashCan);
+
+    // Nothing is highlighted while the mouse is down or something is being dragged
+    const HitEntry* hovered = NULL;
+    if (!input.mouseDown && !IsDragging(&scene->dragController))
+        hovered = QueryHitIndex(&scene->hitIndex, input.mouseWorld);
+
+    scene->isHovering = false;
+    for (int i = 0; i < INGREDIENT_COUNT; i++)
+        scene->isHovering = highlightItem(&ingredients[i], hovered) || scene->isHovering;
+    if (scene->isHovering && !scene->hoversoundPlayed) {
+
+        scene->hoversoundPlayed = true;
+        //PlaySound(hover);
 
-        Vector2 mousePos = GetScreenToWorld2D(GetMousePosition(), *camera);
-        if (CheckCollisionPointRec(mousePos, (Rectangle) { cup.position.x, cup.position.y, cup.frameRectangle.width, cup.frameRectangle.height })) {
-            cup.frameRectangle = frameRectCup(cup, 2, 2);
+    }
+    else if (!scene->isHovering) {
+        scene->hoversoundPlayed = false;
+    }
+
+    // Cups keep their hover frame while dragged
+    for (int i = 0; i < MAX_CUPS; i++)
+    {
+        Cup* cup = &scene->cups[i];
+        if ((hovered != NULL && hovered->cup == cup) || IsCupHeld(&scene->dragController, cup)) {
+            cup->frameRectangle = frameRectCup(cup, 2, 2);
         }
         else {
-            cup.frameRectangle = frameRectCup(cup, 2, 1);
+            cup->frameRectangle = frameRectCup(cup, 2, 1);
         }
+    }
+
+    scene->isendSceneHovered = CheckCollisionPointRec(input.mouseWorld, scene->endScene);
+
+    if (!scene->passedInitialPhrase && currentColorIndex == 0)
+        scene->passedInitialPhrase = true;
+
+    // Day ended, show end scene
+    if (scene->passedInitialPhrase && currentColorIndex >= 2 && !IsFreeplay(options->difficulty))
+        ChangeScene(SCENE_ENDGAME);
 
-        Vector2 mouseWorldPos = GetScreenToWorld2D(GetMousePosition(), *camera);
-        bool isendSceneHovered = CheckCollisionPointRec(mouseWorldPos, endScene);
-        void (*transitionCallback)(Camera2D * camera) = NULL;
+    // Freeplay only ends on the End button
+    if (IsFreeplay(options->difficulty) && IsSessionMousePressed() && scene->isendSceneHovered)
+        ChangeScene(SCENE_ENDGAME);
 
-        if (!passedInitialPhrase && currentColorIndex == 0)
-            passedInitialPhrase = true;
+    Tick(shift, deltaTime);
+}
+
+void GameDraw(Camera2D* camera, double deltaTime)
+{
+    GameScene* scene = &gameScene;
+
+    ClearBackground(BLACK);
+
+    int imageWidth = backgroundTexture.width;
+    int imageHeight = backgroundTexture.height;
+
+    float scaleX = (float)BASE_SCREEN_WIDTH / imageWidth;
+    float scaleY = (float)BASE_SCREEN_HEIGHT / imageHeight;
+
+    DrawDayNightCycle(deltaTime);
+
+    render_customers(&gameShift);
+
+    DrawTextureEx(backgroundOverlayTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
+
+    DrawTexture(plate.texture, oriplatePosition.x, oriplatePosition.y, WHITE);
+
+    // Dragged objects follow the newest pointer sample, not the one polled before the update
+    LateLatchDragPointers(&scene->dragController, camera);
+
+    for (int i = 0; i < INGREDIENT_COUNT; i++)
+    {
+        if (i == INGREDIENT_COCOA_POWDER)
+            DrawTexture(cupsTexture, oricupsPostion.x, oricupsPostion.y, WHITE);
+
+        DrawDragableItemFrame(&ingredients[i]);
+    }
+
+
+    bool isCupAvailable = false;
+    for (int i = 0; i < MAX_CUPS; i++)
+    {
+        Cup* cup = &scene->cups[i];
+        if (cup->active)
+            DrawTextureRec(cup->texture, cup->frameRectangle, cup->position, WHITE);
+        else
+            isCupAvailable = true;
+    }
 
-        // Day ended, show end scene
-        if (passedInitialPhrase && currentColorIndex >= 2)
+    // Draw debug for cup
+    if (options->showDebug && debugToolToggles.showObjects)
+    {
+        for (int i = 0; i < MAX_CUPS; i++)
         {
-            // If not freeplay
-            if (options->difficulty != FREEPLAY_EASY && options->difficulty != FREEPLAY_MEDIUM && options->difficulty != FREEPLAY_HARD)
-			{
-                endgameUpdate(camera);
-			}
+            Cup* cup = &scene->cups[i];
+            if (cup->active)
+                DrawCupDebug(cup, i, IsCupHeld(&scene->dragController, cup));
         }
-        
-        Tick(&customers, deltaTime);
-        tickBoil(&hotWater);
 
-        // Draw
+        // Cups
+        DrawRectangleLinesEx((Rectangle) { oricupsPostion.x, oricupsPostion.y, cupsTexture.width, cupsTexture.height }, 1, RED);
+        DrawRectangle(oricupsPostion.x, oricupsPostion.y - 20, 400, 20, Fade(GRAY, 0.7));
+        DrawTextEx(meowFont, TextFormat("%s | XY %.2f,%.2f | Grabbable %s", "Cups", oricupsPostion.x, oricupsPostion.y, isCupAvailable ? "[Yes]" : "[No]"), (Vector2) { oricupsPostion.x, oricupsPostion.y - 20 }, 20, 1, WHITE);
 
-        BeginDrawing();
-        ClearBackground(BLACK);
+        // Plate
+        DrawRectangleLinesEx((Rectangle) { oriplatePosition.x, oriplatePosition.y, plate.texture.width, plate.texture.height }, 1, RED);
+        DrawRectangle(oriplatePosition.x, oriplatePosition.y - 20, 300, 20, Fade(GRAY, 0.7));
+        DrawTextEx(meowFont, TextFormat("%s | XY %.2f,%.2f", "Plate", oriplatePosition.x, oriplatePosition.y), (Vector2) { oriplatePosition.x, oriplatePosition.y - 20 }, 20, 1, WHITE);
+    }
 
+    DrawTextEx(meowFont, TextFormat("Score: %d", gameShift.score), (Vector2) { baseX + 20, baseY + 20 }, 26, 2, WHITE);
 
-        BeginMode2D(*camera);
-        
+    DrawOuterWorld();
+
+    // End game
+    if (IsFreeplay(options->difficulty))
+    {
+        DrawRectangleRec(scene->endScene, ColorAlphaOverride(RED, scene->isendSceneHovered ? 0.5f : 1.0f));
+        DrawTextEx(meowFont, "End", (Vector2) { scene->endScene.x + 42, scene->endScene.y + 22 }, 32, 2, ColorAlphaOverride(WHITE, scene->isendSceneHovered ? 0.5f : 1.0f));
+    }
+}
 
-        int imageWidth = backgroundTexture.width;
-        int imageHeight = backgroundTexture.height;
+void GamePresented(Camera2D* camera, double deltaTime)
+{
+    UpdateAutoplayer(&autoplayer, &gameScene.dragController, &gameShift, &ingredients[INGREDIENT_TRASH_CAN], camera, deltaTime);
+}
 
-        float scaleX = (float)BASE_SCREEN_WIDTH / imageWidth;
-        float scaleY = (float)BASE_SCREEN_HEIGHT / imageHeight;
+void GameExit()
+{
+    UnloadTexture(plate.texture);
+    plate.texture = (Texture2D){ 0 };
+}
 
-        DrawDayNightCycle(deltaTime);
+void ResetGameState()
+{
+    gameShift.score = 0;
 
-		render_customers(&customers);
+    // Reset hotWater boiling
+    gameShift.boilerHeating = false;
+    gameShift.boilerReady = false;
+    gameShift.boilerGeneration++;
+    ingredients[INGREDIENT_HOT_WATER].canChangeCupTexture = false;
+    ingredients[INGREDIENT_HOT_WATER].currentFrame = 1;
+}
 
-        DrawTextureEx(backgroundOverlayTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
+typedef struct {
+    Rectangle scoreRec;
+    Rectangle tryagain;
+    bool istryagainHovered;
+} EndgameScene;
 
-        DrawTexture(plate.texture, oriplatePosition.x, oriplatePosition.y, WHITE);
+EndgameScene endgameScene;
 
-        DrawDragableItemFrame(trashCan);
+void EndgameEnter(Camera2D* camera)
+{
+    EndgameScene* scene = &endgameScene;
 
+    scene->scoreRec = (Rectangle){ -277, -241, 600, 450 };
+    float centerX = scene->scoreRec.x + (scene->scoreRec.width / 2);
+    float centerY = scene->scoreRec.y + (scene->scoreRec.height / 2);
+    scene->tryagain = (Rectangle){ centerX - 90 , centerY + 50, 200, 70 };
+    scene->istryagainHovered = false;
 
-        DrawDragableItemFrame(hotWater);
-        DrawDragableItemFrame(condensedMilk);
-        DrawDragableItemFrame(normalMilk);
-        DrawTexture(cups, oricupsPostion.x, oricupsPostion.y, WHITE);
+    EnterPerfScene(PERF_SCENE_ENDGAME);
+}
 
-        DrawDragableItemFrame(cocoaPowder);
-        DrawDragableItemFrame(teaPowder);
+void EndgameUpdate(Camera2D* camera, double deltaTime)
+{
+    EndgameScene* scene = &endgameScene;
 
-        DrawDragableItemFrame(chocolateSauce);
-        DrawDragableItemFrame(caramelSauce);
+    // Soak runs go straight into the next shift
+    if (PerfSceneDwelled())
+        AutoplayerClick(&autoplayer, scene->tryagain, camera);
 
-        DrawDragableItemFrame(marshMellow);
-        DrawDragableItemFrame(whippedCream);
+    Vector2 mouseWorldPos = GetScreenToWorld2D(GetSessionMousePosition(), *camera);
+    scene->istryagainHovered = CheckCollisionPointRec(mouseWorldPos, scene->tryagain);
 
-        // DrawTexture(cup.texture, cup.position.x, cup.position.y, WHITE);
+    if (IsSessionMousePressed() && scene->istryagainHovered)
+    {
+        ResetGameState();
+        ChangeScene(SCENE_MENU);
+    }
+}
 
-        DrawTexture(greenChon.texture, greenChon.position.x, greenChon.position.y, WHITE);
-        DrawTexture(cocoaChon.texture, cocoaChon.position.x, cocoaChon.position.y, WHITE);
-        
+void EndgameDraw(Camera2D* camera, double deltaTime)
+{
+    const EndgameScene* scene = &endgameScene;
 
-        if (cup.active)
-            DrawTextureRec(cup.texture, cup.frameRectangle, cup.position, WHITE);
+    int imageWidth = backgroundTexture.width;
+    int imageHeight = backgroundTexture.height;
 
-        // Draw debug for cup
-        if (options->showDebug && debugToolToggles.showObjects)
-        {
-            DrawRectangleLinesEx((Rectangle) { cup.position.x, cup.position.y, cup.frameRectangle.width, cup.frameRectangle.height }, 1, RED);
-            DrawRectangle(cup.position.x, cup.position.y - 60, 400, 60, Fade(GRAY, 0.7));
-            DrawTextEx(meowFont, TextFormat("Powder type: %d, Water: %d, Creamer: %d", cup.powderType, cup.hasWater, cup.creamerType), (Vector2) { cup.position.x, cup.position.y - 20 }, 20, 1, WHITE);
-            DrawTextEx(meowFont, TextFormat("Topping: %d, Sauce: %d", cup.toppingType, cup.sauceType), (Vector2) { cup.position.x, cup.position.y - 40 }, 20, 1, WHITE);
-			DrawTextEx(meowFont, TextFormat("%s | XY %.2f,%.2f | Active %s", "Cup", cup.position.x, cup.position.y, cup.active ? "[Yes]" : "[No]"), (Vector2) { cup.position.x, cup.position.y - 60 }, 20, 1, WHITE);
-            
-            // Cups
-            DrawRectangleLinesEx((Rectangle) { oricupsPostion.x, oricupsPostion.y, cups.width, cups.height }, 1, RED);
-            DrawRectangle(oricupsPostion.x, oricupsPostion.y - 20, 400, 20, Fade(GRAY, 0.7));
-            DrawTextEx(meowFont, TextFormat("%s | XY %.2f,%.2f | Grabbable %s", "Cups", oricupsPostion.x, oricupsPostion.y, cup.active ? "[No]" : "[Yes]"), (Vector2) { oricupsPostion.x, oricupsPostion.y - 20 }, 20, 1, WHITE);
+    float scaleX = (float)BASE_SCREEN_WIDTH / imageWidth;
+    float scaleY = (float)BASE_SCREEN_HEIGHT / imageHeight;
 
-            // Plate
-            DrawRectangleLinesEx((Rectangle) { oriplatePosition.x, oriplatePosition.y, plate.texture.width, plate.texture.height }, 1, RED);
-            DrawRectangle(oriplatePosition.x, oriplatePosition.y - 20, 300, 20, Fade(GRAY, 0.7));
-            DrawTextEx(meowFont, TextFormat("%s | XY %.2f,%.2f", "Plate", oriplatePosition.x, oriplatePosition.y), (Vector2) { oriplatePosition.x, oriplatePosition.y - 20 }, 20, 1, WHITE);
-        }
+    float centerX = scene->scoreRec.x + (scene->scoreRec.width / 2);
+    float centerY = scene->scoreRec.y + (scene->scoreRec.height / 2);
 
-		/* Customers TEST AREA END*/
-        if(&customers.customer1 != NULL)
-            UpdateMenuCustomerBlink(&customers.customer1, deltaTime);
-        if (&customers.customer2 != NULL)
-            UpdateMenuCustomerBlink(&customers.customer2, deltaTime);
-        if (&customers.customer3 != NULL)
-            UpdateMenuCustomerBlink(&customers.customer3, deltaTime);
+    ClearBackground(RAYWHITE);
 
+    DrawTextureEx(backgroundTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
+    DrawRectangleRec(scene->scoreRec, MAIN_BROWN);
+    DrawRectangleLinesEx((Rectangle) {-217,-195, 480, 360}, 5, WHITE);
 
-        DrawTextEx(meowFont, TextFormat("Score: %d", global_score), (Vector2) { baseX + 20, baseY + 20 }, 26, 2, WHITE);
+    Vector2 scorePos;
+    scorePos.x = centerX - (MeasureText("Score", 55) / 2);
+    scorePos.y = centerY - 150;
+    DrawTextEx(meowFont, "Score", scorePos, 55, 2, WHITE);
 
-        DrawOuterWorld();
+    char *scoreText = TextFormat("%d", gameShift.score);
+    Vector2 scoreTextPos;
+    scoreTextPos.x = centerX - (MeasureText(scoreText, 100) / 2);
+    scoreTextPos.y = centerY - 80;
+    DrawTextEx(meowFont, scoreText, scoreTextPos, 100, 2, WHITE);
 
-        if (options->showDebug)
-            DrawDebugOverlay(camera);
+    DrawRectangleRec(scene->tryagain, ColorAlphaOverride(RED, scene->istryagainHovered ? 0.5f : 1.0f));
+    DrawTextEx(meowFont, "Menu", (Vector2) {-10,55}, 32, 2, ColorAlphaOverride(WHITE, scene->istryagainHovered ? 0.5f : 1.0f));
+}
 
-        // End game
-        if(options->difficulty == FREEPLAY_EASY || options->difficulty == FREEPLAY_MEDIUM || options->difficulty == FREEPLAY_HARD)
-		{
-            DrawRectangleRec(endScene, ColorAlphaOverride(RED, isendSceneHovered ? 0.5f : 1.0f));
-            DrawTextEx(meowFont, "End", (Vector2) { endScene.x + 42, endScene.y + 22 }, 32, 2, ColorAlphaOverride(WHITE, isendSceneHovered ? 0.5f : 1.0f));
-
-			if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && (isendSceneHovered))
-			{
-                if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-                    if (isendSceneHovered) {
-                        endgameUpdate(camera);
-                    }
-                }
+typedef struct {
+    float splashAlpha;              // Straight after the splash, the splash image fades out over the menu
 
-			}
-		}
+    float transitionOffset;
+    TaskHandle slideIn;
+    TaskHandle slideOut;
+    bool isTransitioningOut;        // Set on a click and never cleared, the next scene takes over once the slide ends
+    SceneId transitionTarget;
 
-        EndMode2D();
-        EndDrawing();
+    Rectangle startButtonRect;
+    Rectangle optionsButtonRect;
+    Rectangle exitButtonRect;
+    bool isStartButtonHovered;
+    bool isOptionsButtonHovered;
+    bool isExitButtonHovered;
+
+    int currentHoveredButton;
+    bool isHovering;
+} MenuScene;
+
+// The sidebar moves at 1500 px/s
+#define MENU_SLIDE_DURATION (BASE_SCREEN_WIDTH / 2 / 1500.0)
+#define MENU_SPLASH_FADE_DURATION 1.0
+
+MenuScene menuScene;
+
+// Slides the sidebar off to the left, then hands over to the scene that was picked
+bool MenuSlideOutTask(Task* task)
+{
+    MenuScene* scene = task->data;
+
+    TASK_BEGIN(task);
+    scene->slideOut = TweenFloat(&scene->transitionOffset, BASE_SCREEN_WIDTH / 2, MENU_SLIDE_DURATION);
+    TASK_WAIT_TASK(task, scene->slideOut);
+    ChangeScene(scene->transitionTarget);
+    TASK_END(task);
+}
+
+void MenuEnter(Camera2D* camera)
+{
+    MenuScene* scene = &menuScene;
+
+    // Back from the last shift of the tour
+    if (perfGate.enabled && perfGate.gamesPlayed > HARD - EASY)
+        FinishPerfGate();
+    EnterPerfScene(PERF_SCENE_MENU);
+
+    *scene = (MenuScene){ 0 };
+    bool playFade = scenes.previous == SCENE_SPLASH;
+    scene->currentHoveredButton = NO_HOVERED_BUTTON;
+
+    if (playFade)
+    {
+        scene->splashAlpha = 255.0f;
+        TweenFloat(&scene->splashAlpha, 0.0f, MENU_SPLASH_FADE_DURATION);
+    }
+    else
+    {
+        scene->transitionOffset = BASE_SCREEN_WIDTH / 2;
+        scene->slideIn = TweenFloat(&scene->transitionOffset, 0.0f, MENU_SLIDE_DURATION);
     }
 
-    UnloadTexture(backgroundTexture);
-    CloseWindow();
+    trashCanPosition = (Vector2){baseX , baseY + BASE_SCREEN_HEIGHT - 200};
+
+    PlayBgmIfStopped(&menuBgm);
+
+    if(playFade)
+    {
+        movingClouds[0] = (MovingCloud){ (Vector2) { GetRandomDoubleValue(RANDOM_AMBIENT, baseX - 200, baseX), GetRandomDoubleValue(RANDOM_AMBIENT, baseY, 0) }, 250.0f, 1.0f, cloud1Texture, false };
+        movingClouds[1] = (MovingCloud){ (Vector2) { GetRandomDoubleValue(RANDOM_AMBIENT, baseX - 200, baseX), GetRandomDoubleValue(RANDOM_AMBIENT, baseY, 0) }, 200.0f, 1.0f, cloud2Texture, false };
+        movingClouds[2] = (MovingCloud){ (Vector2) { GetRandomDoubleValue(RANDOM_AMBIENT, baseX - 200, baseX), GetRandomDoubleValue(RANDOM_AMBIENT, baseY, 0) }, 150.0f, 2.0f, cloud3Texture, true };
+        movingClouds[3] = (MovingCloud){ (Vector2) { GetRandomDoubleValue(RANDOM_AMBIENT, baseX - 200, baseX), GetRandomDoubleValue(RANDOM_AMBIENT, baseY, 0) }, 250.0f, 1.0f, cloud1Texture, false };
+        movingClouds[4] = (MovingCloud){ (Vector2) { GetRandomDoubleValue(RANDOM_AMBIENT, baseX - 200, baseX), GetRandomDoubleValue(RANDOM_AMBIENT, baseY, 0) }, 100.0f, 1.7f, cloud2Texture, false };
+        movingClouds[5] = (MovingCloud){ (Vector2) { GetRandomDoubleValue(RANDOM_AMBIENT, baseX - 200, baseX), GetRandomDoubleValue(RANDOM_AMBIENT, baseY, 0) }, 200.0f, 1.0f, cloud3Texture, true };
+        movingClouds[6] = (MovingCloud){ (Vector2) { GetRandomDoubleValue(RANDOM_AMBIENT, baseX - 200, baseX), GetRandomDoubleValue(RANDOM_AMBIENT, baseY, 0) }, 150.0f, 1.0f, cloud3Texture, true };
+
+        movingStars[0] = (MovingStar){ (Vector2) { GetRandomDoubleValue(RANDOM_AMBIENT, baseX - 200, baseX), baseY }, 50.0f, 3.0f, star1Texture };
+        movingStars[1] = (MovingStar){ (Vector2) { GetRandomDoubleValue(RANDOM_AMBIENT, baseX - 200, baseX), baseY }, 25.0f, 2.0f, star2Texture };
+
+        for (int i = 0; i < MAX_MENU_FALLING_ITEMS; i++) {
+            menuFallingItems[i].position = (Vector2){ GetRandomDoubleValue(RANDOM_AMBIENT, baseX, baseX + BASE_SCREEN_WIDTH - 20), baseY - GetRandomDoubleValue(RANDOM_AMBIENT, 200, 1000) };
+            menuFallingItems[i].textureIndex = GetRandomIntValue(RANDOM_AMBIENT, 0, menuFallingItemsNumber - 1);
+
+            // Random rotation and falling speed
+            menuFallingItems[i].rotation = GetRandomDoubleValue(RANDOM_AMBIENT, -360, 360);
+            menuFallingItems[i].fallingSpeed = GetRandomDoubleValue(RANDOM_AMBIENT, 1, 3);
+            menuFallingItems[i].fallingSpeed *= 100;
+
+            // Rotation speed is between -3 and 3, but should not execeed falling speed and should not be 0
+            menuFallingItems[i].rotationSpeed = GetRandomIntValue(RANDOM_AMBIENT, -3, 3);
+            if (abs(menuFallingItems[i].rotationSpeed) > menuFallingItems[i].fallingSpeed)
+                menuFallingItems[i].rotationSpeed = menuFallingItems[i].fallingSpeed;
+            if (menuFallingItems[i].rotationSpeed == 0)
+                menuFallingItems[i].rotationSpeed = 1;
+
+            menuFallingItems[i].rotationSpeed *= 100;
+
+        }
+    }
+}
 
+void HoverMenuButton(MenuScene* scene, int button)
+{
+    if (!scene->isHovering || scene->currentHoveredButton != button)
+    {
+        PlaySoundFx(FX_HOVER);
+        scene->isHovering = true;
+    }
+    scene->currentHoveredButton = button;
 }
 
-void ResetGameState()
+void MenuUpdate(Camera2D* camera, double deltaTime)
 {
-    global_score = 0;
+    MenuScene* scene = &menuScene;
+    bool isTransitioningIn = IsTaskRunning(scene->slideIn);
 
-    // Reset hotWater boiling
-    triggerHotWater = false;
-    hotWater.canChangeCupTexture = false;
-    hotWater.currentFrame = 1;
+    // Button positions and dimensions
+    scene->startButtonRect = (Rectangle){ baseX + 50 - scene->transitionOffset, baseY + 600 + 60, 400, 100 };
+    scene->optionsButtonRect = (Rectangle){ baseX + 50 - scene->transitionOffset, baseY + 600 + 160, 400, 100 };
+    scene->exitButtonRect = (Rectangle){ baseX + 50 - scene->transitionOffset, baseY + 600 + 350, 400, 100 };
+
+    // The gate tours the options screen once before the first shift
+    if (!isTransitioningIn && !scene->isTransitioningOut && PerfSceneDwelled())
+        AutoplayerClick(&autoplayer, perfGate.enabled && !perfGate.optionsVisited ? scene->optionsButtonRect : scene->startButtonRect, camera);
+
+    // Convert mouse position from screen space to world space
+    Vector2 mouseWorldPos = GetScreenToWorld2D(GetSessionMousePosition(), *camera);
+
+    scene->isStartButtonHovered = CheckCollisionPointRec(mouseWorldPos, scene->startButtonRect);
+    scene->isOptionsButtonHovered = CheckCollisionPointRec(mouseWorldPos, scene->optionsButtonRect);
+    scene->isExitButtonHovered = CheckCollisionPointRec(mouseWorldPos, scene->exitButtonRect);
+
+    // Check for button clicks
+    if (IsSessionMousePressed() && !scene->isTransitioningOut && !isTransitioningIn)
+    {
+        if (scene->isStartButtonHovered)
+        {
+            PlaySoundFx(FX_SELECT);
+            scene->transitionTarget = SCENE_GAME;
+            scene->isTransitioningOut = true;
+            StartTask(MenuSlideOutTask, scene);
+        }
+        else if (scene->isOptionsButtonHovered)
+        {
+            PlaySoundFx(FX_SELECT);
+            scene->transitionTarget = SCENE_OPTIONS;
+            scene->isTransitioningOut = true;
+            StartTask(MenuSlideOutTask, scene);
+        }
+        else if (scene->isExitButtonHovered)
+        {
+            ExitApplication();
+        }
+    }
+
+    // Play sound when hovering over a button, but only once
+    if (scene->isStartButtonHovered)
+        HoverMenuButton(scene, 0);
+    else if (scene->isOptionsButtonHovered)
+        HoverMenuButton(scene, 1);
+    else if (scene->isExitButtonHovered)
+        HoverMenuButton(scene, 2);
+    else
+    {
+        scene->currentHoveredButton = NO_HOVERED_BUTTON;
+        scene->isHovering = false;
+    }
 }
 
-void endgameUpdate(Camera2D *camera){
+void MenuDraw(Camera2D* camera, double deltaTime)
+{
+    MenuScene* scene = &menuScene;
+
+    ClearBackground(RAYWHITE);
 
     int imageWidth = backgroundTexture.width;
     int imageHeight = backgroundTexture.height;
@@ -3021,450 +6835,757 @@ void endgameUpdate(Camera2D *camera){
     float scaleX = (float)BASE_SCREEN_WIDTH / imageWidth;
     float scaleY = (float)BASE_SCREEN_HEIGHT / imageHeight;
 
-    Rectangle scoreRec = {-277,-241,600,450};
-    float centerX = scoreRec.x + (scoreRec.width / 2);
-    float centerY = scoreRec.y + (scoreRec.height / 2);
-    Rectangle tryagain = { centerX - 90 , centerY + 50, 200, 70 };
+    int imageLogoWidth = logoTexture.width;
+    int imageLogoHeight = logoTexture.height;
 
+    float scaleLogoX = (float)BASE_SCREEN_WIDTH / imageLogoWidth / 4;
+    float scaleLogoY = (float)BASE_SCREEN_HEIGHT / imageLogoHeight / 4;
 
-    while (!WindowShouldClose()){
-        WindowUpdate(camera);
-        Vector2 mouseWorldPos = GetScreenToWorld2D(GetMousePosition(), *camera);
-        bool istryagainHovered = CheckCollisionPointRec(mouseWorldPos, tryagain);
+    // Draw the background with the scaled dimensions
+    // DrawTextureEx(backgroundTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
 
-        BeginDrawing();
-        ClearBackground(RAYWHITE);
-        BeginMode2D(*camera);
+    DrawDayNightCycle(deltaTime);
+
+    // Draw falling items behind the menu
+    DrawMenuFallingItems(deltaTime, true);
+
+    // Draw customer images
+    DrawCustomerInMenu(deltaTime);
+
+    DrawTextureEx(backgroundOverlayTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
+
+    // Draw falling items in front of the menu
+    DrawMenuFallingItems(deltaTime, false);
+
+    // Left sidebar white
+    DrawTextureEx(backgroundOverlaySidebarTexture, (Vector2) { baseX - scene->transitionOffset, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
+
+    // Logo
+    DrawTextureEx(logoTexture, (Vector2) { baseX - scene->transitionOffset, baseY - 50 }, 0.0f, fmax(scaleLogoX, scaleLogoY), WHITE);
+
+    // Draw button labels
+    DrawTextEx(meowFont, "Start Game", (Vector2) { (int)(scene->startButtonRect.x + 40), (int)(scene->startButtonRect.y + 15) }, 60, 2, scene->isStartButtonHovered ? MAIN_ORANGE : MAIN_BROWN);
+    DrawTextEx(meowFont, "Settings", (Vector2) { (int)(scene->optionsButtonRect.x + 40), (int)(scene->optionsButtonRect.y + 15) }, 60, 2, scene->isOptionsButtonHovered ? MAIN_ORANGE : MAIN_BROWN);
+    DrawTextEx(meowFont, "Exit", (Vector2) { (int)(scene->exitButtonRect.x + 40), (int)(scene->exitButtonRect.y + 15) }, 60, 2, scene->isExitButtonHovered ? MAIN_ORANGE : MAIN_BROWN);
+
+    // Draw debug
+    if (options->showDebug && debugToolToggles.showObjects)
+    {
+        DrawRectangleLinesEx(scene->startButtonRect, 1, RED);
+        DrawRectangleLinesEx(scene->optionsButtonRect, 1, RED);
+        DrawRectangleLinesEx(scene->exitButtonRect, 1, RED);
+    }
+
+    DrawOuterWorld();
+
+    if (scene->splashAlpha > 0)
+    {
+        int splashBackgroundImageWidth = splashBackgroundTexture.width;
+        int splashBackgroundImageHeight = splashBackgroundTexture.height;
+
+        float splashBackgroundScaleX = (float)BASE_SCREEN_WIDTH / splashBackgroundImageWidth;
+        float splashBackgroundScaleY = (float)BASE_SCREEN_HEIGHT / splashBackgroundImageHeight;
+
+        DrawTextureEx(splashBackgroundTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(splashBackgroundScaleX, splashBackgroundScaleY), (Color) { 255, 255, 255, scene->splashAlpha });
+    }
+}
+
+// The menu takes input from its first frame on
+void MenuPresented(Camera2D* camera, double deltaTime)
+{
+    if (startupProfile.enabled)
+    {
+        MarkStartup(STARTUP_MARK_FIRST_FRAME);
+        MarkStartup(STARTUP_MARK_INTERACTIVE);
+        NextStartupIteration();
+    }
+}
+
+#define SPLASH_BEFORE_START 1.0         // White fades off the splash background
+#define SPLASH_FADE_IN 2.0
+#define SPLASH_STAY 3.0                 // Loading the global assets counts towards it, a slow load only extends it
+#define SPLASH_FADE_OUT 2.0
+#define SPLASH_HOLD 1.0                 // Background alone before the menu
+
+typedef struct {
+    float whiteAlpha;
+    float logoAlpha;
+    bool showLogo;
+
+    TaskHandle tween;
+    double stayStart;
+    Sound systemLoad;
+} SplashScene;
 
-        DrawTextureEx(backgroundTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
-        DrawRectangleRec(scoreRec, MAIN_BROWN);
-        DrawRectangleLinesEx((Rectangle) {-217,-195, 480, 360}, 5, WHITE);
+SplashScene splashScene;
 
-        Vector2 scorePos;
-        scorePos.x = centerX - (MeasureText("Score", 55) / 2);
-        scorePos.y = centerY - 150; 
-        DrawTextEx(meowFont, "Score", scorePos, 55, 2, WHITE);
+bool SplashTask(Task* task)
+{
+    SplashScene* scene = task->data;
 
-        char *scoreText = TextFormat("%d", global_score);
-        Vector2 scoreTextPos;
-        scoreTextPos.x = centerX - (MeasureText(scoreText, 100) / 2);
-        scoreTextPos.y = centerY - 80; 
-        DrawTextEx(meowFont, scoreText, scoreTextPos, 100, 2, WHITE);
+    TASK_BEGIN(task);
+    scene->tween = TweenFloat(&scene->whiteAlpha, 0.0f, SPLASH_BEFORE_START);
+    TASK_WAIT_TASK(task, scene->tween);
 
-        DrawRectangleRec(tryagain, ColorAlphaOverride(RED, istryagainHovered ? 0.5f : 1.0f));
-        DrawTextEx(meowFont, "Menu", (Vector2) {-10,55}, 32, 2, ColorAlphaOverride(WHITE, istryagainHovered ? 0.5f : 1.0f));
+    scene->systemLoad = LoadSound(ASSETS_PATH"audio/Meow1.mp3");
+    PlaySound(scene->systemLoad);
 
-        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && (istryagainHovered))
-        {
-            ResetGameState();
-            MainMenuUpdate(camera, false);
-        }
+    scene->showLogo = true;
+    scene->tween = TweenFloat(&scene->logoAlpha, 255.0f, SPLASH_FADE_IN);
+    TASK_WAIT_TASK(task, scene->tween);
 
-        if(options->showDebug)
-            DrawDebugOverlay(camera);
+    scene->stayStart = taskScheduler.time;
+    TASK_WAIT_LOAD(task, LoadGlobalAssetsStep);
+    TASK_WAIT_SECONDS(task, SPLASH_STAY - (taskScheduler.time - scene->stayStart));
 
-        EndMode2D();
-        EndDrawing();
-    }
+    scene->tween = TweenFloat(&scene->logoAlpha, 0.0f, SPLASH_FADE_OUT);
+    TASK_WAIT_TASK(task, scene->tween);
+    TASK_WAIT_SECONDS(task, SPLASH_HOLD);
+
+    ChangeScene(SCENE_MENU);
+    TASK_END(task);
 }
 
-void MainMenuUpdate(Camera2D* camera, bool playFade)
+void SplashEnter(Camera2D* camera)
 {
-    float fadeOutDuration = 1.0f;
-    double currentTime = 0;
-    double lastFrameTime = GetTime();
+    SplashScene* scene = &splashScene;
 
-    int splashBackgroundImageWidth = splashBackgroundTexture.width;
-    int splashBackgroundImageHeight = splashBackgroundTexture.height;
+    // Startup benchmarks load like DEBUG_FASTLOAD, the splash timing would only add a fixed wait
+    // The performance gate always plays the full splash so it has frames to measure
+    bool fastLoad = (DEBUG_FASTLOAD && !perfGate.enabled) || startupProfile.enabled;
 
-    float splashBackgroundScaleX = (float)BASE_SCREEN_WIDTH / splashBackgroundImageWidth;
-    float splashBackgroundScaleY = (float)BASE_SCREEN_HEIGHT / splashBackgroundImageHeight;
+    EnterPerfScene(PERF_SCENE_SPLASH);
 
-    float transitionOffset = 0;
+    *scene = (SplashScene){ 0 };
+    scene->whiteAlpha = 255.0f;
 
-    bool isFadeOutDone = false;
-    bool isTransitioningIn = !playFade;
-    bool isTransitioningOut = false;
+    if (fastLoad)
+    {
+        LoadGlobalAssets();
+        ChangeScene(SCENE_MENU);
+        return;
+    }
 
-    if(isTransitioningIn)
-        transitionOffset = BASE_SCREEN_WIDTH / 2;
+    StartTask(SplashTask, scene);
+}
 
-    trashCanPosition = (Vector2){baseX , baseY + BASE_SCREEN_HEIGHT - 200};
+void SplashDraw(Camera2D* camera, double deltaTime)
+{
+    const SplashScene* scene = &splashScene;
 
-    PlayBgmIfStopped(&menuBgm);
+    int imageWidth = splashBackgroundTexture.width;
+    int imageHeight = splashBackgroundTexture.height;
 
-    if(playFade)
-    {
-        movingClouds[0] = (MovingCloud){ (Vector2) { GetRandomDoubleValue(baseX - 200, baseX), GetRandomDoubleValue(baseY, 0) }, 250.0f, 1.0f, cloud1Texture, false };
-        movingClouds[1] = (MovingCloud){ (Vector2) { GetRandomDoubleValue(baseX - 200, baseX), GetRandomDoubleValue(baseY, 0) }, 200.0f, 1.0f, cloud2Texture, false };
-        movingClouds[2] = (MovingCloud){ (Vector2) { GetRandomDoubleValue(baseX - 200, baseX), GetRandomDoubleValue(baseY, 0) }, 150.0f, 2.0f, cloud3Texture, true };
-        movingClouds[3] = (MovingCloud){ (Vector2) { GetRandomDoubleValue(baseX - 200, baseX), GetRandomDoubleValue(baseY, 0) }, 250.0f, 1.0f, cloud1Texture, false };
-        movingClouds[4] = (MovingCloud){ (Vector2) { GetRandomDoubleValue(baseX - 200, baseX), GetRandomDoubleValue(baseY, 0) }, 100.0f, 1.7f, cloud2Texture, false };
-        movingClouds[5] = (MovingCloud){ (Vector2) { GetRandomDoubleValue(baseX - 200, baseX), GetRandomDoubleValue(baseY, 0) }, 200.0f, 1.0f, cloud3Texture, true };
-        movingClouds[6] = (MovingCloud){ (Vector2) { GetRandomDoubleValue(baseX - 200, baseX), GetRandomDoubleValue(baseY, 0) }, 150.0f, 1.0f, cloud3Texture, true };
+    float scaleX = (float)BASE_SCREEN_WIDTH / imageWidth;
+    float scaleY = (float)BASE_SCREEN_HEIGHT / imageHeight;
 
-        movingStars[0] = (MovingStar){ (Vector2) { GetRandomDoubleValue(baseX - 200, baseX), baseY }, 50.0f, 3.0f, star1Texture };
-        movingStars[1] = (MovingStar){ (Vector2) { GetRandomDoubleValue(baseX - 200, baseX), baseY }, 25.0f, 2.0f, star2Texture };
+    ClearBackground(RAYWHITE);
+    DrawTextureEx(splashBackgroundTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
 
-        for (int i = 0; i < 20; i++) {
-            menuFallingItems[i].position = (Vector2){ GetRandomDoubleValue(baseX, baseX + BASE_SCREEN_WIDTH - 20), baseY - GetRandomDoubleValue(200, 1000) };
-            menuFallingItems[i].textureIndex = GetRandomValue(0, menuFallingItemsNumber - 1);
+    if (scene->showLogo)
+        DrawTextureEx(splashOverlayTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), (Color) { 255, 255, 255, scene->logoAlpha });
+    else
+        DrawRectangle(baseX, baseY, BASE_SCREEN_WIDTH, BASE_SCREEN_HEIGHT, (Color) { 255, 255, 255, scene->whiteAlpha });
+}
 
-            // Random rotation and falling speed
-            menuFallingItems[i].rotation = GetRandomDoubleValue(-360, 360);
-            menuFallingItems[i].fallingSpeed = GetRandomDoubleValue(1, 3);
-            menuFallingItems[i].fallingSpeed *= 100;
+void SplashPresented(Camera2D* camera, double deltaTime)
+{
+    MarkStartup(STARTUP_MARK_FIRST_FRAME);
+}
 
-            // Rotation speed is between -3 and 3, but should not execeed falling speed and should not be 0
-            menuFallingItems[i].rotationSpeed = GetRandomValue(-3, 3);
-            if (abs(menuFallingItems[i].rotationSpeed) > menuFallingItems[i].fallingSpeed)
-                menuFallingItems[i].rotationSpeed = menuFallingItems[i].fallingSpeed;
-            if (menuFallingItems[i].rotationSpeed == 0)
-                menuFallingItems[i].rotationSpeed = 1;
+// The meow has long finished by the time the logo faded out
+void SplashExit()
+{
+    if (splashScene.systemLoad.frameCount > 0)
+        UnloadSound(splashScene.systemLoad);
+}
 
-            menuFallingItems[i].rotationSpeed *= 100;
+// Stress scene, every kind of entity scales on its own so the frame time can be read against each count
+// Launched with --stress, sliders set the counts, --stress-sweep ramps one kind and writes the curve to a CSV
+#define MAX_STRESS_ENTITIES 4096
+#define STRESS_PLOT_BUCKETS 128
+#define STRESS_SWEEP_SETTLE_FRAMES 10       // Skipped after every step, counts change mid frame
+#define STRESS_SWEEP_FRAMES 60              // Measured per step, the median is kept
+#define MAX_STRESS_SWEEP_STEPS 64
 
-        }
+typedef enum {
+    STRESS_CUSTOMERS = 0,
+    STRESS_CUPS,
+    STRESS_PARTICLES,
+    STRESS_CLOUDS,
+    STRESS_LABELS,
+    STRESS_OVERLAYS,                        // The first n of every other kind also draw their debug object overlay
+    STRESS_KIND_COUNT
+} StressKind;
+
+static inline char* StringFromStressKindEnum(StressKind kind)
+{
+    static const char* strings[] = { "customers", "cups", "particles", "clouds", "labels", "overlays" };
+    return strings[kind];
+}
+
+// STRESS_KIND_COUNT when the name is not a kind
+StressKind StressKindFromString(const char* name)
+{
+    for (int kind = 0; kind < STRESS_KIND_COUNT; kind++)
+    {
+        if (strcmp(name, StringFromStressKindEnum(kind)) == 0)
+            return (StressKind)kind;
     }
+    return STRESS_KIND_COUNT;
+}
+
+typedef struct {
+    Vector2 position;
+    int textureType;
+    CustomerEmotion emotion;
+    bool eyesClosed;
+    float blinkTimer;
+    Recipe order;
+} StressCustomer;
 
-    int currentHoveredButton = NULL;
-    void (*transitionCallback)(Camera2D * camera) = NULL;
+typedef struct {
+    bool enabled;
+    int counts[STRESS_KIND_COUNT];
+    StressKind plotKind;                    // Last slider touched, the plot follows it
+    float plot[STRESS_KIND_COUNT][STRESS_PLOT_BUCKETS];     // Smoothed ms, 0 until a frame ran at that count
+
+    bool sweeping;
+    StressKind sweepKind;
+    int sweepMax;
+    int sweepSteps;
+    int sweepStep;
+    int sweepFrame;
+    float sweepFrames[STRESS_SWEEP_FRAMES];
+    float sweepResults[MAX_STRESS_SWEEP_STEPS + 1];
+    const char* csvFile;
+
+    double frameStart;
+    float frameMs;
+
+    StressCustomer customers[MAX_STRESS_ENTITIES];
+    Cup cups[MAX_STRESS_ENTITIES];
+    float cupTimers[MAX_STRESS_ENTITIES];
+    MenuFallingItem particles[MAX_STRESS_ENTITIES];
+    MovingCloud clouds[MAX_STRESS_ENTITIES];
+    Vector2 labels[MAX_STRESS_ENTITIES];
+} Stress;
+
+Stress stress = { 0 };
+
+Vector2 RandomStressPosition()
+{
+    return (Vector2){ GetRandomDoubleValue(RANDOM_AMBIENT, baseX, baseX + BASE_SCREEN_WIDTH - 200), GetRandomDoubleValue(RANDOM_AMBIENT, baseY, baseY + BASE_SCREEN_HEIGHT - 200) };
+}
 
-    bool isHovering = false;
+void InitStressEntities()
+{
+    Texture2D cloudTextures[] = { cloud1Texture, cloud2Texture, cloud3Texture };
 
-    while (!WindowShouldClose())
+    for (int i = 0; i < MAX_STRESS_ENTITIES; i++)
     {
-        // Calculate delta time
-        double deltaTime = GetTime() - lastFrameTime;
-        lastFrameTime = GetTime();
-
-        if (!isFadeOutDone)
-            currentTime += GetFrameTime();
+        StressCustomer* customer = &stress.customers[i];
+        customer->position = RandomStressPosition();
+        customer->textureType = GetRandomIntValue(RANDOM_AMBIENT, 0, (sizeof(customersImageData) / sizeof(customersImageData[0])) - 1);
+        customer->emotion = (CustomerEmotion)GetRandomIntValue(RANDOM_AMBIENT, EMOTION_HAPPY, EMOTION_ANGRY);
+        customer->blinkTimer = (float)GetRandomDoubleValue(RANDOM_AMBIENT, 0.2, 6.0);
+        customer->order = SampleRecipeCatalog(&recipeCatalog, RecipeMixFromDifficulty(HARD), &randomStreams[RANDOM_ORDERS]);
+
+        Cup* cup = &stress.cups[i];
+        *cup = (Cup){ 0 };
+        cup->active = true;
+        cup->recipe = SampleRecipeCatalog(&recipeCatalog, RecipeMixFromDifficulty(HARD), &randomStreams[RANDOM_ORDERS]);
+        cup->texture = RecipeTexture(cup->recipe);
+        cup->position = RandomStressPosition();
+        stress.cupTimers[i] = (float)GetRandomDoubleValue(RANDOM_AMBIENT, 0.0, 1.0);
+
+        RespawnMenuFallingItem(&stress.particles[i]);
+        stress.particles[i].position.y = GetRandomDoubleValue(RANDOM_AMBIENT, baseY - 200, baseY + BASE_SCREEN_HEIGHT);
+
+        stress.clouds[i] = (MovingCloud){ RandomStressPosition(), (float)GetRandomDoubleValue(RANDOM_AMBIENT, 100, 250), 1.0f, cloudTextures[i % 3], i % 2 == 0 };
+
+        stress.labels[i] = RandomStressPosition();
+    }
+}
 
-        WindowUpdate(camera);
+// Same draw paths as the game, only the updates are simplified so every entity changes every frame
+void DrawStressEntities(double deltaTime)
+{
+    int overlays = stress.counts[STRESS_OVERLAYS];
 
-        // Button positions and dimensions
-        Rectangle startButtonRect = { baseX + 50 - transitionOffset, baseY + 600 + 60, 400, 100 };
-        Rectangle optionsButtonRect = { baseX + 50 - transitionOffset, baseY + 600 + 160, 400, 100 };
-        Rectangle exitButtonRect = { baseX + 50 - transitionOffset, baseY + 600 + 350, 400, 100 };
+    for (int i = 0; i < stress.counts[STRESS_CLOUDS]; i++)
+        UpdateMovingCloud(&stress.clouds[i], deltaTime, i < overlays);
 
-        // Convert mouse position from screen space to world space
-        Vector2 mouseWorldPos = GetScreenToWorld2D(GetMousePosition(), *camera);
+    for (int i = 0; i < stress.counts[STRESS_PARTICLES]; i++)
+        UpdateMenuFallingItem(&stress.particles[i], i, deltaTime, false, i < overlays);
 
-        bool isStartButtonHovered = CheckCollisionPointRec(mouseWorldPos, startButtonRect);
-        bool isOptionsButtonHovered = CheckCollisionPointRec(mouseWorldPos, optionsButtonRect);
-        bool isExitButtonHovered = CheckCollisionPointRec(mouseWorldPos, exitButtonRect);
+    for (int i = 0; i < stress.counts[STRESS_CUSTOMERS]; i++)
+    {
+        StressCustomer* customer = &stress.customers[i];
 
-        // Check for button clicks
-        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && !isTransitioningOut && !isTransitioningIn)
+        customer->blinkTimer -= (float)deltaTime;
+        if (customer->blinkTimer <= 0)
         {
-            if (isStartButtonHovered)
-            {
-                PlaySoundFx(FX_SELECT);
-                transitionCallback = GameUpdate;
-                isTransitioningOut = true;
-            }
-            else if (isOptionsButtonHovered)
-            {
-                PlaySoundFx(FX_SELECT);
-                transitionCallback = OptionsUpdate;
-                isTransitioningOut = true;
-            }
-            else if (isExitButtonHovered)
-            {
-                ExitApplication();
-            }
+            customer->eyesClosed = !customer->eyesClosed;
+            customer->blinkTimer = customer->eyesClosed ? 0.3f : 4.0f;
         }
 
-        // Play sound when hovering over a button, but only once
-        if (isStartButtonHovered)
-        {
-            if (!isHovering || currentHoveredButton != 0)
-            {
-                PlaySoundFx(FX_HOVER);
-                isHovering = true;
-            }
-            currentHoveredButton = 0;
-        }
-        else if (isOptionsButtonHovered)
-        {
-            if (!isHovering || currentHoveredButton != 1)
-            {
-                PlaySoundFx(FX_HOVER);
-                isHovering = true;
-            }
-            currentHoveredButton = 1;
-        }
-        else if (isExitButtonHovered)
+        DrawCustomerSprite(customer->textureType, customer->emotion, customer->eyesClosed, customer->position);
+        DrawOrderBubble(customer->order, customer->position);
+
+        if (i < overlays)
         {
-            if (!isHovering || currentHoveredButton != 2)
-            {
-                PlaySoundFx(FX_HOVER);
-                isHovering = true;
-            }
-            currentHoveredButton = 2;
+            const CustomerImageData* image = &customersImageData[customer->textureType];
+            DrawRectangleLinesEx((Rectangle) { customer->position.x, customer->position.y, image->happy.width / 2, image->happy.height / 2 }, 1, RED);
+            DrawRectangle(customer->position.x, customer->position.y - 20, 500, 20, Fade(GRAY, 0.7));
+            DrawTextEx(meowFont, TextFormat("%s | Blink %s | Order %s", StringFromCustomerEmotionEnum(customer->emotion), customer->eyesClosed ? "[Yes]" : "[No]", RecipeName(customer->order)), (Vector2) { customer->position.x, customer->position.y - 20 }, 20, 1, WHITE);
         }
-        else
+    }
+
+    // Each cup takes a new recipe once a second, the hover frame alternates like a cup under the cursor
+    for (int i = 0; i < stress.counts[STRESS_CUPS]; i++)
+    {
+        Cup* cup = &stress.cups[i];
+
+        stress.cupTimers[i] -= (float)deltaTime;
+        if (stress.cupTimers[i] <= 0)
         {
-            currentHoveredButton = NULL;
-            isHovering = false;
+            cup->recipe = SampleRecipeCatalog(&recipeCatalog, RecipeMixFromDifficulty(HARD), &randomStreams[RANDOM_ORDERS]);
+            cup->texture = RecipeTexture(cup->recipe);
+            stress.cupTimers[i] += 1.0f;
         }
 
-        // Draw
-
-        BeginDrawing();
-        BeginMode2D(*camera);
-        ClearBackground(RAYWHITE);
+        cup->frameRectangle = frameRectCup(cup, 2, stress.cupTimers[i] < 0.5f ? 2 : 1);
+        DrawTextureRec(cup->texture, cup->frameRectangle, cup->position, WHITE);
 
-        int imageWidth = backgroundTexture.width;
-        int imageHeight = backgroundTexture.height;
+        if (i < overlays)
+            DrawCupDebug(cup, i, false);
+    }
 
-        float scaleX = (float)BASE_SCREEN_WIDTH / imageWidth;
-        float scaleY = (float)BASE_SCREEN_HEIGHT / imageHeight;
+    for (int i = 0; i < stress.counts[STRESS_LABELS]; i++)
+        DrawTextEx(meowFont, TextFormat("Label %d | %.2f", i, GetSessionTime()), stress.labels[i], 20, 1, MAIN_BROWN);
+}
 
-        int imageLogoWidth = logoTexture.width;
-        int imageLogoHeight = logoTexture.height;
+Rectangle StressSliderRect(int kind)
+{
+    return (Rectangle){ baseX + 20, baseY + 60 + kind * 50, 400, 30 };
+}
 
-        float scaleLogoX = (float)BASE_SCREEN_WIDTH / imageLogoWidth / 4;
-        float scaleLogoY = (float)BASE_SCREEN_HEIGHT / imageLogoHeight / 4;
+void UpdateStressSliders(Camera2D* camera)
+{
+    if (stress.sweeping || !IsSessionMouseDown()) return;
 
-        // Draw the background with the scaled dimensions
-        // DrawTextureEx(backgroundTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
-        
-        DrawDayNightCycle(deltaTime);
+    Vector2 mouse = GetScreenToWorld2D(GetSessionMousePosition(), *camera);
+    for (int i = 0; i < STRESS_KIND_COUNT; i++)
+    {
+        Rectangle slider = StressSliderRect(i);
+        if (!CheckCollisionPointRec(mouse, slider)) continue;
 
-        // Draw falling items behind the menu
-        DrawMenuFallingItems(deltaTime, true);
+        // Quadratic so the low counts, where the game actually lives, get most of the slider
+        float fraction = (mouse.x - slider.x) / slider.width;
+        stress.counts[i] = (int)(fraction * fraction * MAX_STRESS_ENTITIES + 0.5f);
+        stress.plotKind = (StressKind)i;
+    }
+}
 
-        // Draw customer images
-        DrawCustomerInMenu(deltaTime);
+void DrawStressPanel(float frameMs)
+{
+    DrawRectangle(baseX, baseY, 440, 60 + STRESS_KIND_COUNT * 50, Fade(GRAY, 0.8));
+    DrawTextEx(meowFont, TextFormat("Stress | %.2f ms | %d textures", frameMs, liveTextureCount), (Vector2) { baseX + 20, baseY + 20 }, 24, 1, WHITE);
 
-        DrawTextureEx(backgroundOverlayTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
+    for (int i = 0; i < STRESS_KIND_COUNT; i++)
+    {
+        Rectangle slider = StressSliderRect(i);
+        float fraction = sqrtf((float)stress.counts[i] / MAX_STRESS_ENTITIES);
 
-        // Draw falling items in front of the menu
-        DrawMenuFallingItems(deltaTime, false);
+        DrawRectangleRec(slider, (StressKind)i == stress.plotKind ? MAIN_BROWN : DARKGRAY);
+        DrawRectangle(slider.x, slider.y, slider.width * fraction, slider.height, MAIN_ORANGE);
+        DrawTextEx(meowFont, TextFormat("%s %d", StringFromStressKindEnum(i), stress.counts[i]), (Vector2) { slider.x + 10, slider.y + 5 }, 20, 1, WHITE);
+    }
 
-        // If transitioning out, move the background to the left
-        if (isTransitioningOut)
-        {
-            float pixelsToMove = 900.0f;
-            float durationInSeconds = 0.6f;
-            float transitionSpeed = pixelsToMove / durationInSeconds;
+    // Frame time against the count of the selected kind, each bucket keeps a moving average
+    int graphWidth = 512;
+    int graphHeight = 200;
+    int graphX = baseX + BASE_SCREEN_WIDTH - 20 - graphWidth;
+    int graphY = baseY + BASE_SCREEN_HEIGHT - 20 - graphHeight;
+    const float* plot = stress.plot[stress.plotKind];
 
-            transitionOffset += transitionSpeed * deltaTime;
+    float maxMs = 1.0f;
+    for (int i = 0; i < STRESS_PLOT_BUCKETS; i++)
+        maxMs = fmaxf(maxMs, plot[i]);
 
-            if (transitionOffset >= BASE_SCREEN_WIDTH / 2)
-            {
-                transitionOffset = 0;
-                isTransitioningOut = false;
-                transitionCallback(camera);
-                break;
-            }
-        }
+    DrawRectangle(graphX, graphY, graphWidth, graphHeight, Fade(GRAY, 0.8));
+    for (int i = 0; i < STRESS_PLOT_BUCKETS; i++)
+    {
+        if (plot[i] <= 0) continue;
+        int height = (int)(plot[i] / maxMs * graphHeight);
+        DrawRectangle(graphX + i * graphWidth / STRESS_PLOT_BUCKETS, graphY + graphHeight - height, graphWidth / STRESS_PLOT_BUCKETS, height, MAIN_ORANGE);
+    }
+    DrawTextEx(meowFont, TextFormat("ms against %s, 0 - %d, peak %.2f ms", StringFromStressKindEnum(stress.plotKind), MAX_STRESS_ENTITIES, maxMs), (Vector2) { graphX, graphY - 24 }, 20, 1, WHITE);
+}
 
-        // If transitioning in, move the background to the right
-        if (isTransitioningIn)
-        {
-            float pixelsToMove = 900.0f;
-            float durationInSeconds = 0.6f;
-            float transitionSpeed = pixelsToMove / durationInSeconds;
+void ReportStressSweep()
+{
+    float maxMs = 0.0f;
+    for (int i = 0; i <= stress.sweepSteps; i++)
+        maxMs = fmaxf(maxMs, stress.sweepResults[i]);
 
-            transitionOffset -= transitionSpeed * deltaTime;
+    printf("\nStress sweep, %s 0 - %d, median of %d frames per step\n", StringFromStressKindEnum(stress.sweepKind), stress.sweepMax, STRESS_SWEEP_FRAMES);
+    for (int i = 0; i <= stress.sweepSteps; i++)
+    {
+        int bar = maxMs > 0 ? (int)(stress.sweepResults[i] / maxMs * 50) : 0;
+        printf("%8d %9.3f ms |%.*s\n", stress.sweepMax * i / stress.sweepSteps, stress.sweepResults[i], bar, "##################################################");
+    }
 
-            if (transitionOffset <= 0)
-            {
-                transitionOffset = 0;
-                isTransitioningIn = false;
-            }
-        }
+    FILE* file = fopen(stress.csvFile, "w");
+    if (file == NULL)
+    {
+        Log(LOG_WARNING, "Could not write stress sweep to %s", stress.csvFile);
+        return;
+    }
 
+    fprintf(file, "%s,frame_ms\n", StringFromStressKindEnum(stress.sweepKind));
+    for (int i = 0; i <= stress.sweepSteps; i++)
+        fprintf(file, "%d,%.4f\n", stress.sweepMax * i / stress.sweepSteps, stress.sweepResults[i]);
+    fclose(file);
 
-        // Left sidebar white 
-        DrawTextureEx(backgroundOverlaySidebarTexture, (Vector2) { baseX - transitionOffset, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
+    Log(LOG_INFO, "Stress sweep written to %s", stress.csvFile);
+}
 
-        // Logo
-        DrawTextureEx(logoTexture, (Vector2) { baseX - transitionOffset, baseY - 50 }, 0.0f, fmax(scaleLogoX, scaleLogoY), WHITE);
+// A sweep holds every step long enough to settle and take a median, then moves to the next count
+void RecordStressFrame(float frameMs)
+{
+    float* bucket = &stress.plot[stress.plotKind][stress.counts[stress.plotKind] * STRESS_PLOT_BUCKETS / (MAX_STRESS_ENTITIES + 1)];
+    *bucket = *bucket > 0 ? *bucket * 0.9f + frameMs * 0.1f : frameMs;
 
-        // Draw button labels
-        DrawTextEx(meowFont, "Start Game", (Vector2) { (int)(startButtonRect.x + 40), (int)(startButtonRect.y + 15) }, 60, 2, isStartButtonHovered ? MAIN_ORANGE : MAIN_BROWN);
-        DrawTextEx(meowFont, "Settings", (Vector2) { (int)(optionsButtonRect.x + 40), (int)(optionsButtonRect.y + 15) }, 60, 2, isOptionsButtonHovered ? MAIN_ORANGE : MAIN_BROWN);
-        DrawTextEx(meowFont, "Exit", (Vector2) { (int)(exitButtonRect.x + 40), (int)(exitButtonRect.y + 15) }, 60, 2, isExitButtonHovered ? MAIN_ORANGE : MAIN_BROWN);
+    if (!stress.sweeping) return;
 
-        // Draw debug
-        if (options->showDebug && debugToolToggles.showObjects)
-        {
-            DrawRectangleLinesEx(startButtonRect, 1, RED);
-            DrawRectangleLinesEx(optionsButtonRect, 1, RED);
-            DrawRectangleLinesEx(exitButtonRect, 1, RED);
-        }
+    int frame = stress.sweepFrame++ - STRESS_SWEEP_SETTLE_FRAMES;
+    if (frame >= 0)
+        stress.sweepFrames[frame] = frameMs;
+    if (frame + 1 < STRESS_SWEEP_FRAMES) return;
 
-        DrawOuterWorld();
+    qsort(stress.sweepFrames, STRESS_SWEEP_FRAMES, sizeof(float), CompareFloats);
+    stress.sweepResults[stress.sweepStep] = stress.sweepFrames[STRESS_SWEEP_FRAMES / 2];
 
-        // Calculate alpha based on the current time
-        if (playFade)
-        {
-            float alpha = (float)(255.0 * (1.0 - fmin(currentTime / fadeOutDuration, 1.0)));
-            if (!isFadeOutDone && alpha != 0)
-                DrawTextureEx(splashBackgroundTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(splashBackgroundScaleX, splashBackgroundScaleY), (Color) { 255, 255, 255, alpha });
-            else
-                isFadeOutDone = true;
-        }
+    if (++stress.sweepStep > stress.sweepSteps)
+    {
+        ReportStressSweep();
+        ExitApplication();
+    }
 
+    stress.sweepFrame = 0;
+    stress.counts[stress.sweepKind] = stress.sweepMax * stress.sweepStep / stress.sweepSteps;
+}
 
-        if(options->showDebug)
-            DrawDebugOverlay(camera);
+void StressEnter(Camera2D* camera)
+{
+    if (!LoadRecipeCatalog(&recipeCatalog, RECIPE_CATALOG_FILE))
+        LoadDefaultRecipeCatalog(&recipeCatalog);
+    InitStressEntities();
 
-        EndMode2D();
-        EndDrawing();
+    if (stress.sweeping)
+    {
+        stress.plotKind = stress.sweepKind;
+        stress.counts[stress.sweepKind] = 0;
     }
 
-    UnloadTexture(backgroundTexture);
-    CloseWindow();
+    stress.frameStart = GetMonotonicTime();
 }
 
-void SplashUpdate(Camera2D* camera)
+void StressUpdate(Camera2D* camera, double deltaTime)
 {
-#if DEBUG_FASTLOAD
-    const double beforeStart = 0;
-    double splashDuration = 0;
-    const double fadeInDuration = 0;
-    const double stayDuration = 0;
-    const double fadeOutDuration = 0;
-    const double afterEnd = 0;
+    // Wall clock from one frame start to the next, it includes the present
+    double now = GetMonotonicTime();
+    stress.frameMs = (float)((now - stress.frameStart) * 1000.0);
+    stress.frameStart = now;
 
-    LoadGlobalAssets();
-    MainMenuUpdate(camera, true);
-#else
-    const double beforeStart = 1.0;
-    double splashDuration = 8.0;
-    const double fadeInDuration = 2.0;
-    const double stayDuration = 3.0;
-    const double fadeOutDuration = 2.0;
-    const double afterEnd = 2.0;
-#endif
+    RecordStressFrame(stress.frameMs);
+    UpdateStressSliders(camera);
+}
 
-    double startTime = GetTime();
-    double currentTime = 0;
+void StressDraw(Camera2D* camera, double deltaTime)
+{
+    ClearBackground(RAYWHITE);
 
-    int imageWidth = splashBackgroundTexture.width;
-    int imageHeight = splashBackgroundTexture.height;
+    DrawStressEntities(deltaTime);
+    DrawStressPanel(stress.frameMs);
+}
 
-    float scaleX = (float)BASE_SCREEN_WIDTH / imageWidth;
-    float scaleY = (float)BASE_SCREEN_HEIGHT / imageHeight;
+const Scene sceneTable[SCENE_COUNT] = {
+    [SCENE_SPLASH] = { SplashEnter, NULL, SplashDraw, SplashPresented, SplashExit },
+    [SCENE_MENU] = { MenuEnter, MenuUpdate, MenuDraw, MenuPresented, NULL },
+    [SCENE_OPTIONS] = { OptionsEnter, OptionsUpdate, OptionsDraw, NULL, NULL },
+    [SCENE_GAME] = { GameEnter, GameUpdate, GameDraw, GamePresented, GameExit },
+    [SCENE_ENDGAME] = { EndgameEnter, EndgameUpdate, EndgameDraw, NULL, NULL },
+    [SCENE_STRESS] = { StressEnter, StressUpdate, StressDraw, NULL, NULL },
+};
 
-    BeginDrawing();
-    BeginMode2D(*camera);
-    ClearBackground(RAYWHITE);
+void ExitCurrentScene()
+{
+    if (scenes.current == SCENE_NONE) return;
+
+    const Scene* scene = &sceneTable[scenes.current];
+    CancelSceneTasks(scenes.current);
+    scenes.previous = scenes.current;
+    scenes.current = SCENE_NONE;
+    if (scene->exit != NULL)
+        scene->exit();
+}
 
-    if (options->showDebug)
-        DrawDebugOverlay(camera);
+// An enter hook may ask for another scene straight away, the splash does with DEBUG_FASTLOAD
+void SwitchScene(Camera2D* camera)
+{
+    while (scenes.next != SCENE_NONE && !scenes.quit)
+    {
+        SceneId next = scenes.next;
+        scenes.next = SCENE_NONE;
+
+        LogDebug("Scene %s -> %s", StringFromSceneIdEnum(scenes.current), StringFromSceneIdEnum(next));
+        ExitCurrentScene();
+        scenes.current = next;
+
+        const Scene* scene = &sceneTable[next];
+        if (scene->enter != NULL)
+            scene->enter(camera);
+    }
 
-    EndMode2D();
-    EndDrawing();
+    // The first delta of a scene never includes the time spent entering it
+    scenes.lastFrameTime = GetSessionTime();
+}
+
+// The only frame loop, scenes come and go between frames so the stack is the same depth every round
+void RunScenes(Camera2D* camera, SceneId first)
+{
+    ChangeScene(first);
 
-    while (currentTime < beforeStart)
+    while (!WindowShouldClose() && !scenes.quit)
     {
+        if (scenes.next != SCENE_NONE)
+            SwitchScene(camera);
+        if (scenes.quit)
+            break;
+
+        const Scene* scene = &sceneTable[scenes.current];
+
         WindowUpdate(camera);
-        currentTime = GetTime() - startTime;
+
+        // Calculate delta time
+        double deltaTime = GetSessionTime() - scenes.lastFrameTime;
+        scenes.lastFrameTime = GetSessionTime();
+
+        // Timed sequences and tweens advance first, the update sees this frame's values
+        RunTasks(deltaTime);
+        if (scene->update != NULL)
+            scene->update(camera, deltaTime);
+
+        // Only the counter reads the pointer events, anything an update left would just fill the queue.
+        // Callbacks during EndDrawing and the presented hook queue for the next update
+        ClearInputEvents();
 
         BeginDrawing();
         BeginMode2D(*camera);
-        float alpha = (float)(255.0 * (1.0 - fmin(currentTime / beforeStart, 1.0)));
 
-        DrawTextureEx(splashBackgroundTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
-        DrawRectangle(baseX, baseY, BASE_SCREEN_WIDTH, BASE_SCREEN_HEIGHT, (Color) { 255, 255, 255, alpha });
+        scene->draw(camera, deltaTime);
 
         if (options->showDebug)
             DrawDebugOverlay(camera);
 
         EndMode2D();
         EndDrawing();
-    }
+        RecordFrameEnd();
 
-    const Sound systemLoad = LoadSound(ASSETS_PATH"audio/Meow1.mp3");
-    PlaySound(systemLoad);
+        if (scene->presented != NULL)
+            scene->presented(camera, deltaTime);
 
-    bool doLoadGlobalAssets = true;
+        PumpLogWriter();
+    }
+}
 
-    // Reset time
-    startTime = GetTime();
+// Benchmark builds include this file and bring their own entry point
+#if !defined(SMM_BENCH)
+int main(int argc, char** argv)
+{
+    double processStart = GetMonotonicTime();
+    char stackMarker;
+    SetTraceLogCallback(CustomLogger);
 
-    while (currentTime < splashDuration)
+    // A fixed seed reproduces a session for profiling and replay, otherwise the clock picks one
+    uint64_t seed = (uint64_t)time(NULL) ^ ((uint64_t)clock() << 32);
+    const char* recordFile = NULL;
+    const char* replayFile = NULL;
+    int simulateShifts = 0;
+    int simulateThreads = 0;
+    int startupIterations = 0;
+    int soakRounds = 0;
+    const char* perfGateFile = NULL;
+    bool perfGateUpdate = false;
+    stress.csvFile = "smm_stress.csv";
+    stress.sweepSteps = 16;
+    int soakWarmupRounds = 2;
+    const char* startupJsonFile = "smm_startup.json";
+    const char* logFile = NULL;
+    for (int i = 1; i < argc; i++)
     {
-        WindowUpdate(camera);
-        currentTime = GetTime() - startTime;
-
-        int alpha = 0;
-
-        // Calculate alpha based on the current time
-        if (currentTime < fadeInDuration) {
-            // Fading in
-            alpha = (int)(255.0 * (currentTime / fadeInDuration));
-        }
-        else if (currentTime < fadeInDuration + stayDuration) {
-            // Fully visible (staying)
-            alpha = 255;
-            if(doLoadGlobalAssets)
-			{
-				LoadGlobalAssets();
-				doLoadGlobalAssets = false;
-			}
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordFile = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replayFile = argv[++i];
+        else if (strcmp(argv[i], "--headless") == 0)
+            nullRenderer.enabled = true;
+        else if (strcmp(argv[i], "--bot") == 0)
+            autoplayer.enabled = true;
+        else if (strcmp(argv[i], "--bot-speed") == 0 && i + 1 < argc)
+            autoplayer.speed = fmaxf((float)atof(argv[++i]), 0.1f);
+        else if (strcmp(argv[i], "--bot-errors") == 0 && i + 1 < argc)
+            autoplayer.errorRate = Clamp((float)atof(argv[++i]), 0.0f, 1.0f);
+        else if (strcmp(argv[i], "--simulate") == 0 && i + 1 < argc)
+            simulateShifts = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--sim-threads") == 0 && i + 1 < argc)
+            simulateThreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--startup-bench") == 0 && i + 1 < argc)
+            startupIterations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--startup-json") == 0 && i + 1 < argc)
+            startupJsonFile = argv[++i];
+        else if (strcmp(argv[i], "--soak") == 0 && i + 1 < argc)
+            soakRounds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--soak-warmup") == 0 && i + 1 < argc)
+            soakWarmupRounds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--perf-gate") == 0 && i + 1 < argc)
+            perfGateFile = argv[++i];
+        else if (strcmp(argv[i], "--perf-gate-update") == 0)
+            perfGateUpdate = true;
+        else if (strcmp(argv[i], "--log-file") == 0 && i + 1 < argc)
+            logFile = argv[++i];
+        else if (strcmp(argv[i], "--stress") == 0)
+            stress.enabled = true;
+        else if (strcmp(argv[i], "--stress-sweep") == 0 && i + 2 < argc)
+        {
+            StressKind kind = StressKindFromString(argv[i + 1]);
+            if (kind == STRESS_KIND_COUNT)
+                Log(LOG_WARNING, "Unknown stress kind %s, ignoring --stress-sweep", argv[i + 1]);
+            else
+            {
+                stress.enabled = stress.sweeping = true;
+                stress.sweepKind = kind;
+                stress.sweepMax = Clamp(atoi(argv[i + 2]), 1, MAX_STRESS_ENTITIES);
+                i += 2;
+            }
         }
-        else {
-            // Fading out
-            alpha = (int)(255.0 * (1.0 - fmin((currentTime - fadeInDuration - stayDuration) / fadeOutDuration, 1.0)));
+        else if (strcmp(argv[i], "--stress-steps") == 0 && i + 1 < argc)
+            stress.sweepSteps = Clamp(atoi(argv[++i]), 1, MAX_STRESS_SWEEP_STEPS);
+        else if (strcmp(argv[i], "--stress-csv") == 0 && i + 1 < argc)
+            stress.csvFile = argv[++i];
+        else if (strncmp(argv[i], "--stress-", 9) == 0 && i + 1 < argc)
+        {
+            // Starting counts, --stress-customers 200 and so on
+            StressKind kind = StressKindFromString(argv[i] + 9);
+            if (kind == STRESS_KIND_COUNT)
+                Log(LOG_WARNING, "Unknown option %s", argv[i]);
+            else
+                stress.counts[kind] = Clamp(atoi(argv[++i]), 0, MAX_STRESS_ENTITIES);
         }
+    }
 
-        // Extends splash screen duration if loading takes too long
-        if (currentTime > fadeInDuration + stayDuration && doLoadGlobalAssets)
-		{
-			splashDuration += 0.1;
-		}
-
-        BeginDrawing();
-        BeginMode2D(*camera);
-        ClearBackground(RAYWHITE);
-        DrawTextureEx(splashBackgroundTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
-        DrawTextureEx(splashOverlayTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), (Color) { 255, 255, 255, alpha });
-        
-        if (options->showDebug)
-            DrawDebugOverlay(camera);
+    StartLogWriter(logFile);
 
-        EndMode2D();
-        EndDrawing();
+    // The gate tours the scenes with the bot, headless, from the same seed every run
+    if (perfGateFile != NULL)
+    {
+        perfGate.enabled = true;
+        perfGate.update = perfGateUpdate;
+        perfGate.baselineFile = perfGateFile;
+        nullRenderer.enabled = true;
+        autoplayer.enabled = true;
+        seed = PERF_GATE_SEED;
     }
 
-    // Reset time
-    startTime = GetTime();
+    // A soak is the bot playing headless on a fixed step clock, as fast as the CPU allows
+    if (soakRounds > 0)
+    {
+        soak.enabled = true;
+        soak.rounds = soakRounds < MAX_SOAK_ROUNDS ? soakRounds : MAX_SOAK_ROUNDS;
+        soak.warmupRounds = soakWarmupRounds > 0 ? soakWarmupRounds : 0;
+        soak.stackBase = (uintptr_t)&stackMarker;
+        nullRenderer.enabled = true;
+        autoplayer.enabled = true;
+    }
 
+    if (startupIterations > 0)
+        StartStartupProfile(startupIterations, processStart, startupJsonFile);
 
-    while (currentTime < afterEnd)
+    // Balancing runs need no window, only the recipe names behind the catalog
+    if (simulateShifts > 0)
     {
-        WindowUpdate(camera);
-        currentTime = GetTime() - startTime;
-
-        BeginDrawing();
-        BeginMode2D(*camera);
-        ClearBackground(RAYWHITE);
-        DrawTextureEx(splashBackgroundTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
-        DrawTextureEx(splashOverlayTexture, (Vector2) { baseX, baseY }, 0.0f, fmax(scaleX, scaleY), WHITE);
-        EndMode2D();
-        EndDrawing();
+        LoadRecipeTables(false);
+        if (!LoadRecipeCatalog(&recipeCatalog, RECIPE_CATALOG_FILE))
+            LoadDefaultRecipeCatalog(&recipeCatalog);
+        int result = RunSimulation(simulateShifts, simulateThreads, autoplayer.speed, autoplayer.errorRate, seed);
+        StopLogWriter();
+        return result;
     }
 
-    // UnloadSound(systemLoad);
+    GameOptions _options;
 
-    MainMenuUpdate(camera, true);
-}
+    _options.difficulty = EASY;
+    _options.resolution = (Resolution){ 1280, 720 };
+    _options.targetFps = 120;
+    _options.fullscreen = false;  // Default to windowed mode
+    _options.showDebug = DEBUG_SHOW;
+    _options.musicEnabled = true;
+    _options.soundFxEnabled = true;
+    _options.powerSaving = true;
+    _options.idleTimeout = 60.0f;
+    _options.pauseAudioWhenIdle = true;
+    _options.quality = QUALITY_HIGH;
+    _options.msaa = true;
+    _options.fallingItemCount = MAX_MENU_FALLING_ITEMS;
+    _options.cloudCount = MAX_MOVING_CLOUDS;
+    _options.textureFilter = TEXTURE_FILTER_POINT;
+
+    options = &_options;
+
+    // First run has no settings yet, the hardware probe picks a preset after the window is up
+    // The gate plays on the defaults so a player's settings cannot move its numbers
+    bool isFirstRun = !perfGate.enabled && !LoadGameOptions(options);
 
-int main()
-{
     SetConfigFlags(FLAG_WINDOW_RESIZABLE);
-    SetConfigFlags(FLAG_MSAA_4X_HINT);
+    if (options->msaa && !nullRenderer.enabled)
+        SetConfigFlags(FLAG_MSAA_4X_HINT);
+
+    // Headless still needs a GL context for textures, Mesa falls back to llvmpipe without a GPU
+    if (nullRenderer.enabled)
+    {
+#if defined(__linux__)
+        setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+#endif
+        SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    }
+
+    // Without a display or a GL context the gate has nothing to measure, that is a skip rather than a failure
+    if (perfGate.enabled && !CanCreateWindow())
+    {
+        Log(LOG_WARNING, "No display to create a window on, skipping the performance gate");
+        StopLogWriter();
+        return PERF_GATE_SKIPPED;
+    }
 
-    SetTraceLogCallback(CustomLogger);
     InitWindow(BASE_SCREEN_WIDTH, BASE_SCREEN_HEIGHT, "SuperMeowMeow");
-    InitAudioDevice();
+    if (perfGate.enabled && !IsWindowReady())
+    {
+        Log(LOG_WARNING, "Could not create a GL context, skipping the performance gate");
+        StopLogWriter();
+        return PERF_GATE_SKIPPED;
+    }
+    MarkStartup(STARTUP_MARK_INIT_WINDOW);
+    InstallInputEventHooks();
+    if (!nullRenderer.enabled)
+    {
+        InitAudioDevice();
+        MarkStartup(STARTUP_MARK_INIT_AUDIO);
+    }
     // Center of screen
     SetWindowPosition(200, 200);
 
@@ -3474,33 +7595,63 @@ int main()
     camera.rotation = 0.0f;
     camera.zoom = 1.0f;
 
-    GameOptions _options;
+    startupProfile.baseTextureCount = liveTextureCount;
+    LoadSplashAssets();
 
-    _options.difficulty = EASY;
-    _options.resolution = (Resolution){ 1280, 720 };
-    _options.targetFps = 120;
-    _options.fullscreen = false;  // Default to windowed mode
-    _options.showDebug = DEBUG_SHOW;
-    _options.musicEnabled = true;
-    _options.soundFxEnabled = true;
+    if (isFirstRun && !nullRenderer.enabled)
+    {
+        ApplyQualityPreset(options, RunHardwareProbe());
+        SaveGameOptions(options);
+    }
 
-    options = &_options;
+    // A replay brings its own seed and options, a recording stores the ones in effect now
+    if (replayFile == NULL || !OpenSessionReplay(replayFile, options, &seed))
+        StartSession(SESSION_LIVE);
+    else
+        autoplayer.enabled = false;     // The recording already holds the bot's input
+    SeedRandomStreams(seed);
+    if (recordFile != NULL && session.mode == SESSION_LIVE)
+        OpenSessionRecording(recordFile, options, seed);
 
-    SetTargetFPS(options->targetFps);
-    SetRuntimeResolution(&camera, options->resolution.x, options->resolution.y);
+    // Nothing to hear and nobody waiting on a frame, run as fast as the CPU allows
+    if (nullRenderer.enabled)
+    {
+        options->musicEnabled = false;
+        options->soundFxEnabled = false;
+        options->powerSaving = false;
+        options->targetFps = 0;
+    }
 
+    // Rounds must end for the soak to move on, and frames advance the clock by a fixed step
+    if (soak.enabled)
+    {
+        if (options->difficulty >= FREEPLAY_EASY)
+            options->difficulty -= FREEPLAY_EASY - EASY;
+        session.fixedStep = 1.0 / 60.0;
+    }
+    if (perfGate.enabled)
+        session.fixedStep = 1.0 / 60.0;
 
-    meowFont = LoadFontEx(ASSETS_PATH"font/SantJoanDespi-Regular.otf", 256, 0, 250);
-    SetTextureFilter(meowFont.texture, TEXTURE_FILTER_ANISOTROPIC_4X);
+    // Stress frames run unthrottled, a capped frame rate would hide everything below the cap
+    if (stress.enabled)
+    {
+        options->powerSaving = false;
+        options->targetFps = 0;
+    }
 
-    logoTexture = LoadTexture(ASSETS_PATH"image/elements/studio_logo.png");
-    splashBackgroundTexture = LoadTexture(ASSETS_PATH"image/backgrounds/splash.png");
-    splashOverlayTexture = LoadTexture(ASSETS_PATH"image/backgrounds/splash_overlay.png");
+    SetTargetFPS(options->targetFps);
+    SetRuntimeResolution(&camera, options->resolution.x, options->resolution.y);
+
+    ApplyTextureQuality();
 
 
     SetExitKey(KEY_NULL);
 
-    SplashUpdate(&camera);
-    UnloadGlobalAssets();
-    return 0;
+    if (stress.enabled)
+        LoadGlobalAssets();
+    RunScenes(&camera, stress.enabled ? SCENE_STRESS : SCENE_SPLASH);
+
+    ShutdownApplication();
+    return applicationExitCode;
 }
+#endif